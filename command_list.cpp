@@ -0,0 +1,185 @@
+// command_list.cpp
+//
+// One list, recorded on the render thread. It is either valid for the key
+// it was recorded under, being recorded, or empty.
+
+#include "command_list.h"
+
+#include <string.h>
+
+enum CommandType {
+	COMMAND_OBJECT,
+	COMMAND_BIND,
+	COMMAND_UNBIND,
+	COMMAND_DRAW
+};
+
+struct Command {
+	CommandType type;
+	int object;                    // COMMAND_OBJECT: recorded object slot
+	RenderBindFunc func;           // COMMAND_BIND, COMMAND_UNBIND
+	void* user;
+	const Mesh* mesh;              // COMMAND_DRAW
+};
+
+static Command g_commands[COMMAND_LIST_SIZE];
+static int g_commandCount = 0;
+static unsigned char g_key[COMMAND_KEY_SIZE];
+static int g_keySize = 0;
+static bool g_valid = false;
+static bool g_recording = false;
+static bool g_overflow = false;
+static bool g_replayEnabled = true;
+
+static int g_recordings = 0, g_replays = 0, g_invalidations = 0, g_overflows = 0;
+static bool g_lastFrameReplayed = false;
+
+void InvalidateCommandList(void)
+{
+	if (g_valid)
+		g_invalidations++;
+	g_valid = false;
+}
+
+void SetCommandListReplay(bool enabled)
+{
+	g_replayEnabled = enabled;
+	InvalidateCommandList();
+}
+
+void BeginCommandRecording(const void* key, int keySize)
+{
+	g_valid = false;
+	g_lastFrameReplayed = false;
+	if (!g_replayEnabled || keySize > COMMAND_KEY_SIZE)
+		return;
+
+	memcpy(g_key, key, keySize);
+	g_keySize = keySize;
+	g_commandCount = 0;
+	g_overflow = false;
+	g_recording = true;
+	ClearRecordedObjects();
+}
+
+void EndCommandRecording(void)
+{
+	if (!g_recording)
+		return;
+	g_recording = false;
+	if (g_overflow) {
+		g_overflows++;
+		return;
+	}
+	g_valid = true;
+	g_recordings++;
+}
+
+bool ReplayCommandList(const void* key, int keySize)
+{
+	if (!g_valid || keySize != g_keySize || memcmp(key, g_key, keySize) != 0)
+		return false;
+
+	for (int i = 0; i < g_commandCount; i++) {
+		const Command* command = &g_commands[i];
+
+		switch (command->type) {
+		case COMMAND_OBJECT:
+			SetRecordedObject(command->object);
+			break;
+		case COMMAND_BIND:
+			if (command->func != NULL)
+				command->func(command->user);
+			else
+				UseSceneProgram();
+			break;
+		case COMMAND_UNBIND:
+			command->func(command->user);
+			break;
+		case COMMAND_DRAW:
+			DrawMesh(command->mesh);
+			break;
+		}
+	}
+	g_replays++;
+	g_lastFrameReplayed = true;
+	return true;
+}
+
+// The next command to fill, or NULL when not recording or out of room
+static Command* AddCommand(CommandType type)
+{
+	if (!g_recording || g_overflow)
+		return NULL;
+	if (g_commandCount == COMMAND_LIST_SIZE) {
+		g_overflow = true;
+		return NULL;
+	}
+	Command* command = &g_commands[g_commandCount++];
+	memset(command, 0, sizeof(*command));
+	command->type = type;
+	return command;
+}
+
+void CommandSetObject(const Matrix4* model, MaterialHandle material, bool textured)
+{
+	if (!g_recording || g_overflow) {
+		SetRendererObject(model, material, textured);
+		return;
+	}
+	int slot = RecordRendererObject(model, material, textured);
+	if (slot < 0) {
+		g_overflow = true;
+		SetRendererObject(model, material, textured);
+		return;
+	}
+	Command* command = AddCommand(COMMAND_OBJECT);
+	if (command != NULL)
+		command->object = slot;
+}
+
+void CommandBind(RenderBindFunc func, void* user)
+{
+	Command* command = AddCommand(COMMAND_BIND);
+
+	if (command != NULL) {
+		command->func = func;
+		command->user = user;
+	}
+	if (func != NULL)
+		func(user);
+	else
+		UseSceneProgram();
+}
+
+void CommandUnbind(RenderBindFunc func, void* user)
+{
+	Command* command = AddCommand(COMMAND_UNBIND);
+
+	if (command != NULL) {
+		command->func = func;
+		command->user = user;
+	}
+	func(user);
+}
+
+void CommandDraw(const Mesh* mesh)
+{
+	Command* command = AddCommand(COMMAND_DRAW);
+
+	if (command != NULL)
+		command->mesh = mesh;
+	DrawMesh(mesh);
+}
+
+void PrintCommandListStats(FILE* out)
+{
+	if (!g_replayEnabled) {
+		fprintf(out, "Command list: off\n");
+		return;
+	}
+	fprintf(out, "Command list: %d commands, last frame %s\n",
+		g_valid ? g_commandCount : 0, g_lastFrameReplayed ? "replayed" : "recorded");
+	fprintf(out, "  %d recordings, %d replays, %d invalidations, %d overflows\n",
+		g_recordings, g_replays, g_invalidations, g_overflows);
+}
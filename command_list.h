@@ -0,0 +1,49 @@
+// command_list.h
+//
+// A frame's scene draws, recorded as the render queue issues them and
+// replayed while nothing they depend on has changed. The list holds what
+// came out of the sort: bind and unbind calls, objects and draws, in a
+// flat array of small commands. Objects go into renderer storage that
+// outlives the frame (RecordRendererObject), so a replay is only the
+// binds and the draws: no RenderObjects walk, no sort, no uniform uploads.
+//
+// The caller describes what the frame depends on with a key, such as the
+// camera and the object transforms. A replay under a different key fails
+// and the caller records the frame again. Changes the key cannot see (a
+// different texture path, say) must call InvalidateCommandList().
+
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <stdio.h>
+
+#include "matrix.h"
+#include "mesh.h"
+#include "render_queue.h"
+#include "renderer.h"
+
+#define COMMAND_LIST_SIZE  1024         // commands one recording can hold
+#define COMMAND_KEY_SIZE   256          // bytes of key
+
+// Until EndCommandRecording(), the Command* calls below are recorded as
+// well as issued. A recording that overflows is dropped.
+void BeginCommandRecording(const void* key, int keySize);
+void EndCommandRecording(void);
+
+// Issues the recorded commands if the list is valid for key
+bool ReplayCommandList(const void* key, int keySize);
+void InvalidateCommandList(void);
+
+// false records nothing and never replays
+void SetCommandListReplay(bool enabled);
+
+// Issue a command, recording it when recording. A NULL bind function binds
+// the scene program.
+void CommandSetObject(const Matrix4* model, MaterialHandle material, bool textured);
+void CommandBind(RenderBindFunc func, void* user);
+void CommandUnbind(RenderBindFunc func, void* user);
+void CommandDraw(const Mesh* mesh);
+
+void PrintCommandListStats(FILE* out);
+
+#endif
@@ -0,0 +1,341 @@
+// deferred.cpp
+//
+// Two framebuffers share the color texture: the G-buffer one, with every
+// target and the depth texture, and a color-only one for the lighting
+// pass, which samples that depth. All light quads go in one vertex buffer
+// and one draw; each vertex carries its light's index in z.
+
+#include "deferred.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "light_clusters.h"
+#include "renderer.h"
+#include "shader.h"
+
+#include <string.h>
+
+enum {
+	TARGET_COLOR,
+	TARGET_ALBEDO,
+	TARGET_NORMAL,
+	TARGET_DEPTH,
+	DEFERRED_TARGETS
+};
+
+static bool g_deferredAvailable = false;
+static bool g_deferredEnabled = false;
+static bool g_frameActive = false;
+static GLuint g_program = 0;
+static GLint g_projectionLocation = -1, g_viewportLocation = -1;
+static GLuint g_textures[DEFERRED_TARGETS];
+static GLuint g_gbufferFramebuffer = 0, g_lightFramebuffer = 0;
+static GLuint g_quadArray = 0, g_quadBuffer = 0;
+static int g_width = 0, g_height = 0;
+
+// Where the frame goes once lit
+static GLint g_savedFramebuffer = 0;
+static GLint g_savedViewport[4];
+
+static float g_bounds[MAX_POINT_LIGHTS][4];
+static float g_quads[MAX_POINT_LIGHTS * 6][3];
+
+// Totals, and the last frame's lights
+static int g_frames = 0, g_resizes = 0, g_lights = 0;
+static double g_lightPixels = 0;
+
+static const char* g_lightVertexShader =
+	"in vec3 a_position;\n"
+	"flat out int v_light;\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = vec4(a_position.xy, 0.0, 1.0);\n"
+	"	v_light = int(a_position.z);\n"
+	"}\n";
+
+// The point light term of the scene fragment shader, for one light, with
+// the eye position rebuilt from depth
+static const char* g_lightFragmentShader =
+	"struct Material {\n"
+	"	vec4 ambient;\n"
+	"	vec4 diffuse;\n"
+	"	vec4 specular;\n"
+	"	float shininess;\n"
+	"};\n"
+	"\n"
+	"layout(std140) uniform Materials {\n"
+	"	Material u_materials[MAX_MATERIALS];\n"
+	"};\n"
+	"\n"
+	"uniform sampler2D u_gbufferAlbedo;\n"
+	"uniform sampler2D u_gbufferNormal;\n"
+	"uniform sampler2D u_gbufferDepth;\n"
+	"uniform samplerBuffer u_pointLights;\n"
+	"uniform mat4 u_projection;\n"
+	"uniform vec2 u_viewport;\n"
+	"flat in int v_light;\n"
+	"\n"
+	"vec3 DecodeNormal(vec2 folded)\n"
+	"{\n"
+	"	folded = folded * 2.0 - 1.0;\n"
+	"	vec3 n = vec3(folded, 1.0 - abs(folded.x) - abs(folded.y));\n"
+	"	if (n.z < 0.0)\n"
+	"		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+	"	return normalize(n);\n"
+	"}\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	ivec2 pixel = ivec2(gl_FragCoord.xy);\n"
+	"	vec4 albedo = texelFetch(u_gbufferAlbedo, pixel, 0);\n"
+	"	int material = int(albedo.a * 255.0 + 0.5) - 1;\n"
+	"	if (material < 0)\n"
+	"		discard;\n"
+	"\n"
+	"	float depth = texelFetch(u_gbufferDepth, pixel, 0).r * 2.0 - 1.0;\n"
+	"	vec2 ndc = gl_FragCoord.xy / u_viewport * 2.0 - 1.0;\n"
+	"	float z = -u_projection[3][2] / (depth + u_projection[2][2]);\n"
+	"	vec3 position = vec3(-z * (ndc + u_projection[2].xy) /\n"
+	"		vec2(u_projection[0][0], u_projection[1][1]), z);\n"
+	"\n"
+	"	vec4 light = texelFetch(u_pointLights, 2 * v_light);\n"
+	"	vec3 toLight = light.xyz - position;\n"
+	"	float distance2 = dot(toLight, toLight);\n"
+	"	float reach = 1.0 - distance2 / (light.w * light.w);\n"
+	"	if (reach <= 0.0)\n"
+	"		discard;\n"
+	"	vec3 normal = DecodeNormal(texelFetch(u_gbufferNormal, pixel, 0).xy);\n"
+	"	vec3 direction = toLight * inversesqrt(distance2);\n"
+	"	float diffuse = dot(normal, direction);\n"
+	"	if (diffuse <= 0.0)\n"
+	"		discard;\n"
+	"\n"
+	"	Material m = u_materials[material];\n"
+	"	vec3 view = normalize(-position);\n"
+	"	float specular = pow(max(dot(normal, normalize(direction + view)), 0.0), m.shininess);\n"
+	"	vec3 lightColor = texelFetch(u_pointLights, 2 * v_light + 1).rgb * (reach * reach);\n"
+	"	fragColor = vec4(lightColor * (diffuse * m.diffuse.rgb + specular * m.specular.rgb) *\n"
+	"		albedo.rgb, 0.0);\n"
+	"}\n";
+
+static void AllocateTargets(int width, int height)
+{
+	static const GLenum formats[DEFERRED_TARGETS][3] = {
+		{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+		{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+		{ GL_RG16, GL_RG, GL_UNSIGNED_SHORT },
+		{ GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT }
+	};
+
+	for (int i = 0; i < DEFERRED_TARGETS; i++) {
+		CachedBindTexture(GL_TEXTURE_2D, g_textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, formats[i][0], width, height, 0,
+			formats[i][1], formats[i][2], NULL);
+	}
+	CachedBindTexture(GL_TEXTURE_2D, 0);
+	g_width = width;
+	g_height = height;
+	g_resizes++;
+}
+
+bool InitDeferredShading(void)
+{
+	if (!AreLightClustersEnabled() || !g_glCaps.multipleRenderTargets || !g_glCaps.textureRG)
+		return false;
+	if (!SetRendererGBuffer(true))
+		return false;
+	SetRendererGBuffer(false);
+
+	g_program = CreateShaderProgram("deferred lighting", SceneShaderHeader(),
+		g_lightVertexShader, g_lightFragmentShader);
+	if (!g_program)
+		return false;
+	static const char* samplers[3] = { "u_gbufferAlbedo", "u_gbufferNormal", "u_gbufferDepth" };
+	CachedUseProgram(g_program);
+	for (int i = 0; i < 3; i++)
+		glUniform1i(glGetUniformLocation(g_program, samplers[i]), DEFERRED_TEXTURE_UNIT + i);
+	glUniform1i(glGetUniformLocation(g_program, "u_pointLights"), CLUSTER_TEXTURE_UNIT + 2);
+	g_projectionLocation = glGetUniformLocation(g_program, "u_projection");
+	g_viewportLocation = glGetUniformLocation(g_program, "u_viewport");
+	CachedUseProgram(0);
+
+	// Sampled with texelFetch, so no filtering and no mipmaps
+	glGenTextures(DEFERRED_TARGETS, g_textures);
+	for (int i = 0; i < DEFERRED_TARGETS; i++) {
+		CachedBindTexture(GL_TEXTURE_2D, g_textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	AllocateTargets(1, 1);
+	g_resizes = 0;
+
+	static const GLenum targets[3] = {
+		GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2
+	};
+	glGenFramebuffers(1, &g_gbufferFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, g_gbufferFramebuffer);
+	for (int i = 0; i < 3; i++)
+		glFramebufferTexture2D(GL_FRAMEBUFFER, targets[i], GL_TEXTURE_2D, g_textures[i], 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+		g_textures[TARGET_DEPTH], 0);
+	glDrawBuffers(3, targets);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+	glGenFramebuffers(1, &g_lightFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, g_lightFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+		g_textures[TARGET_COLOR], 0);
+	complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete) {
+		glDeleteFramebuffers(1, &g_gbufferFramebuffer);
+		glDeleteFramebuffers(1, &g_lightFramebuffer);
+		CachedDeleteTextures(DEFERRED_TARGETS, g_textures);
+		DeleteShaderProgram(g_program);
+		g_program = 0;
+		return false;
+	}
+
+	glGenVertexArrays(1, &g_quadArray);
+	CachedBindVertexArray(g_quadArray);
+	glGenBuffers(1, &g_quadBuffer);
+	CachedBindBuffer(GL_ARRAY_BUFFER, g_quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(g_quads), NULL, GL_STREAM_DRAW);
+	glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(g_quads[0]), NULL);
+	glEnableVertexAttribArray(ATTRIB_POSITION);
+	CachedBindVertexArray(0);
+	CachedBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	g_deferredAvailable = true;
+	return true;
+}
+
+bool IsDeferredShadingAvailable(void)
+{
+	return g_deferredAvailable;
+}
+
+void SetDeferredShading(bool enabled)
+{
+	g_deferredEnabled = enabled;
+}
+
+bool IsDeferredShadingEnabled(void)
+{
+	return g_deferredAvailable && g_deferredEnabled;
+}
+
+void BeginDeferredFrame(void)
+{
+	if (!IsDeferredShadingEnabled())
+		return;
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &g_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, g_savedViewport);
+	int width = g_savedViewport[2], height = g_savedViewport[3];
+	if (width != g_width || height != g_height)
+		AllocateTargets(width, height);
+
+	// The G-buffer fills its own texture from the corner, whatever the
+	// viewport's offset
+	static const GLenum albedoNormal[3] = { GL_NONE, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	static const GLenum all[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	GLfloat clearColor[4];
+	glBindFramebuffer(GL_FRAMEBUFFER, g_gbufferFramebuffer);
+	glViewport(0, 0, width, height);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+	glDrawBuffers(3, albedoNormal);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDrawBuffers(3, all);
+
+	SetRendererGBuffer(true);
+	g_frameActive = true;
+}
+
+// One quad per light over its screen bounds; returns the vertex count
+static int BuildLightQuads(void)
+{
+	int count = GetPointLightBounds(g_bounds, MAX_POINT_LIGHTS);
+	g_lights = count;
+	g_lightPixels = 0;
+	for (int i = 0; i < count; i++) {
+		const float* b = g_bounds[i];
+		static const int corners[6][2] = { { 0, 1 }, { 2, 1 }, { 2, 3 }, { 0, 1 }, { 2, 3 }, { 0, 3 } };
+		for (int v = 0; v < 6; v++) {
+			g_quads[i * 6 + v][0] = b[corners[v][0]];
+			g_quads[i * 6 + v][1] = b[corners[v][1]];
+			g_quads[i * 6 + v][2] = (float) i;
+		}
+		g_lightPixels += (b[2] - b[0]) * (b[3] - b[1]) / 4 * g_width * g_height;
+	}
+	return count * 6;
+}
+
+void EndDeferredFrame(const Matrix4* projection)
+{
+	if (!g_frameActive)
+		return;
+	SetRendererGBuffer(false);
+	g_frameActive = false;
+	g_frames++;
+
+	// Light quads add into the color target, reading the rest
+	int vertices = BuildLightQuads();
+	if (vertices > 0) {
+		glBindFramebuffer(GL_FRAMEBUFFER, g_lightFramebuffer);
+		for (int i = 0; i < 3; i++) {
+			CachedActiveTexture(GL_TEXTURE0 + DEFERRED_TEXTURE_UNIT + i);
+			CachedBindTexture(GL_TEXTURE_2D, g_textures[TARGET_ALBEDO + i]);
+		}
+		CachedActiveTexture(GL_TEXTURE0);
+
+		CachedUseProgram(g_program);
+		glUniformMatrix4fv(g_projectionLocation, 1, GL_FALSE, projection->m);
+		glUniform2f(g_viewportLocation, (float) g_width, (float) g_height);
+
+		bool depthTest = CachedIsEnabled(GL_DEPTH_TEST);
+		CachedDisable(GL_DEPTH_TEST);
+		CachedEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+
+		CachedBindBuffer(GL_ARRAY_BUFFER, g_quadBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(g_quads), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, vertices * sizeof(g_quads[0]), g_quads);
+		CachedBindVertexArray(g_quadArray);
+		glDrawArrays(GL_TRIANGLES, 0, vertices);
+
+		CachedDisable(GL_BLEND);
+		if (depthTest)
+			CachedEnable(GL_DEPTH_TEST);
+	}
+
+	// Back into the frame's framebuffer and viewport
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, g_gbufferFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, g_savedFramebuffer);
+	glBlitFramebuffer(0, 0, g_width, g_height, g_savedViewport[0], g_savedViewport[1],
+		g_savedViewport[0] + g_width, g_savedViewport[1] + g_height,
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, g_savedFramebuffer);
+	glViewport(g_savedViewport[0], g_savedViewport[1], g_savedViewport[2], g_savedViewport[3]);
+}
+
+void PrintDeferredStats(FILE* out)
+{
+	if (!g_deferredAvailable) {
+		fprintf(out, "Deferred shading: unavailable\n");
+		return;
+	}
+	fprintf(out, "Deferred shading: %s, %dx%d G-buffer (%d KB), %d frames, %d resizes\n",
+		g_deferredEnabled ? "on" : "off", g_width, g_height, g_width * g_height * 16 / 1024,
+		g_frames, g_resizes);
+	if (g_deferredEnabled) {
+		double screen = (double) g_width * g_height;
+		fprintf(out, "  %d light quads last frame covering %.0f pixels, %.2f screens\n",
+			g_lights, g_lightPixels, screen > 0 ? g_lightPixels / screen : 0.0);
+	}
+}
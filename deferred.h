@@ -0,0 +1,45 @@
+// deferred.h
+//
+// Deferred shading of the point lights, as an alternative to shading them
+// in the scene program's clustered loop. The scene is drawn once into a
+// G-buffer with the scene program's G-buffer variant (renderer.h): the
+// main light and shadow go straight to the color target, and each pixel
+// keeps its texel color and material index (RGBA8), its normal folded into
+// two 16 bit channels and its depth, 16 bytes in all. Only then is each
+// point light drawn, as a quad over the screen rectangle its sphere can
+// reach, adding its light to the pixels it does reach. A pixel overdrawn
+// many times is lit once, and a light costs the pixels it covers.
+//
+// The result is copied into whatever framebuffer was bound when the frame
+// began; its depth buffer is left as it was.
+//
+// Needs the GLSL renderer with clustered point lights (texture buffers),
+// multiple render targets and RG textures. Without them the scene stays
+// forward shaded.
+
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <stdio.h>
+
+#include "matrix.h"
+
+#define DEFERRED_TEXTURE_UNIT 6         // albedo, normal and depth on 6, 7 and 8
+
+// After InitRenderer()
+bool InitDeferredShading(void);
+bool IsDeferredShadingAvailable(void);
+
+// Switches between deferred and forward shading from the next frame
+void SetDeferredShading(bool enabled);
+bool IsDeferredShadingEnabled(void);
+
+// Bracket the scene's draws when IsDeferredShadingEnabled(). Begin sizes
+// the G-buffer to the viewport, binds and clears it; End lights it, for
+// the frame's projection, and copies the result back.
+void BeginDeferredFrame(void);
+void EndDeferredFrame(const Matrix4* projection);
+
+void PrintDeferredStats(FILE* out);
+
+#endif
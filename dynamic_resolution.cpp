@@ -0,0 +1,238 @@
+// dynamic_resolution.cpp
+//
+// The scale applies to both axes, so pixel count, and roughly fill cost,
+// goes with its square. It moves in steps of 1/DYNRES_STEPS, which keeps
+// the framebuffer from being reallocated every frame over noise. Timer
+// results are read DYNRES_QUERY_FRAMES frames late so the CPU never waits.
+//
+// Software rasterizers record timestamps when commands are queued, not
+// when their pixels are written, so the queries miss exactly the fill cost
+// this is meant to track. There the scene is finished with glFinish and
+// timed on the CPU instead; the rasterizer runs on the CPU anyway, so the
+// wait costs little.
+
+#include "dynamic_resolution.h"
+#include "gl_extensions.h"
+#include "platform.h"
+
+#include <math.h>
+#include <string.h>
+
+#define DYNRES_QUERY_FRAMES  4
+#define DYNRES_STEPS         20      // scale granularity
+#define DYNRES_MIN_SCALE     0.4
+#define DYNRES_HEADROOM      0.85    // raise only if the result stays below this share
+#define DYNRES_SETTLE        8       // measured frames between changes
+#define DYNRES_SMOOTHING     0.2     // weight of each new measurement
+
+struct TimedFrame {
+	GLuint start, end;
+	bool pending;
+	int scaleStep;             // frames rendered at an older scale are ignored
+};
+
+static bool g_dynresEnabled = false;
+static double g_budgetMs = 0;
+static int g_scaleStep = DYNRES_STEPS;        // scale = step / DYNRES_STEPS
+static GLuint g_framebuffer = 0;
+static GLuint g_colorBuffer = 0, g_depthBuffer = 0;
+static int g_bufferWidth = 0, g_bufferHeight = 0;
+static int g_windowWidth = 0, g_windowHeight = 0;
+static TimedFrame g_timedFrames[DYNRES_QUERY_FRAMES];
+static int g_timedFrame = 0;
+static double g_gpuMs = 0;                    // smoothed
+static int g_framesSinceChange = 0;
+static bool g_cpuTimed = false;               // software rasterizer
+static double g_frameStart = 0;
+
+// Cumulative
+static long g_dynresFrames = 0;
+static long g_dynresResizes = 0;
+static long g_dynresDecreases = 0;
+static long g_dynresIncreases = 0;
+
+static void AllocateBuffers(int width, int height)
+{
+	glBindRenderbuffer(GL_RENDERBUFFER, g_colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, g_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	g_bufferWidth = width;
+	g_bufferHeight = height;
+	g_dynresResizes++;
+}
+
+static bool IsSoftwareRenderer(void)
+{
+	static const char* names[] = { "llvmpipe", "softpipe", "Software", "SwiftShader", "GDI Generic" };
+	const char* renderer = (const char*) glGetString(GL_RENDERER);
+
+	for (int i = 0; renderer != NULL && i < (int) (sizeof(names) / sizeof(names[0])); i++) {
+		if (strstr(renderer, names[i]) != NULL)
+			return true;
+	}
+	return false;
+}
+
+static void AddMeasurement(double ms)
+{
+	g_gpuMs = g_gpuMs > 0 ? g_gpuMs + DYNRES_SMOOTHING * (ms - g_gpuMs) : ms;
+	g_framesSinceChange++;
+}
+
+// Folds in every finished measurement and adjusts the scale
+static void UpdateController(void)
+{
+	for (int i = 0; i < DYNRES_QUERY_FRAMES && !g_cpuTimed; i++) {
+		TimedFrame* frame = &g_timedFrames[i];
+		GLint available = 0;
+		GLuint64 start = 0, end = 0;
+		if (!frame->pending)
+			continue;
+		glGetQueryObjectiv(frame->end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+		glGetQueryObjectui64v(frame->start, GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(frame->end, GL_QUERY_RESULT, &end);
+		frame->pending = false;
+		if (frame->scaleStep == g_scaleStep)
+			AddMeasurement((end - start) * 1e-6);
+	}
+
+	if (g_gpuMs <= 0 || g_framesSinceChange < DYNRES_SETTLE)
+		return;
+
+	int minStep = (int) ceil(DYNRES_MIN_SCALE * DYNRES_STEPS);
+	int step = g_scaleStep;
+	if (g_gpuMs > g_budgetMs) {
+		// Over budget: jump straight to the pixel count that should fit
+		double scale = (double) g_scaleStep / DYNRES_STEPS * sqrt(g_budgetMs / g_gpuMs);
+		step = (int) floor(scale * DYNRES_STEPS);
+		if (step >= g_scaleStep)
+			step = g_scaleStep - 1;
+	} else {
+		double ratio = (double) (g_scaleStep + 1) / g_scaleStep;
+		if (g_gpuMs * ratio * ratio < g_budgetMs * DYNRES_HEADROOM)
+			step = g_scaleStep + 1;
+	}
+	if (step < minStep)
+		step = minStep;
+	if (step > DYNRES_STEPS)
+		step = DYNRES_STEPS;
+
+	if (step != g_scaleStep) {
+		if (step < g_scaleStep)
+			g_dynresDecreases++;
+		else
+			g_dynresIncreases++;
+		// Assume cost follows pixel count until measured again
+		double ratio = (double) step / g_scaleStep;
+		g_gpuMs *= ratio * ratio;
+		g_scaleStep = step;
+		g_framesSinceChange = 0;
+	}
+}
+
+bool InitDynamicResolution(double budgetMs)
+{
+	g_cpuTimed = IsSoftwareRenderer();
+	if (!g_glCaps.framebufferObject || (!g_glCaps.timerQuery && !g_cpuTimed) || budgetMs <= 0)
+		return false;
+
+	glGenFramebuffers(1, &g_framebuffer);
+	glGenRenderbuffers(1, &g_colorBuffer);
+	glGenRenderbuffers(1, &g_depthBuffer);
+	AllocateBuffers(1, 1);
+	glBindFramebuffer(GL_FRAMEBUFFER, g_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_depthBuffer);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete) {
+		glDeleteFramebuffers(1, &g_framebuffer);
+		glDeleteRenderbuffers(1, &g_colorBuffer);
+		glDeleteRenderbuffers(1, &g_depthBuffer);
+		return false;
+	}
+
+	memset(g_timedFrames, 0, sizeof(g_timedFrames));
+	for (int i = 0; i < DYNRES_QUERY_FRAMES && !g_cpuTimed; i++) {
+		glGenQueries(1, &g_timedFrames[i].start);
+		glGenQueries(1, &g_timedFrames[i].end);
+	}
+	g_budgetMs = budgetMs;
+	g_dynresResizes = 0;
+	g_dynresEnabled = true;
+	return true;
+}
+
+bool IsDynamicResolutionEnabled(void)
+{
+	return g_dynresEnabled;
+}
+
+void BeginDynamicResolutionFrame(int windowWidth, int windowHeight)
+{
+	if (!g_dynresEnabled)
+		return;
+
+	UpdateController();
+	g_windowWidth = windowWidth;
+	g_windowHeight = windowHeight;
+	int width = (windowWidth * g_scaleStep + DYNRES_STEPS / 2) / DYNRES_STEPS;
+	int height = (windowHeight * g_scaleStep + DYNRES_STEPS / 2) / DYNRES_STEPS;
+	if (width < 1) width = 1;
+	if (height < 1) height = 1;
+	if (width != g_bufferWidth || height != g_bufferHeight)
+		AllocateBuffers(width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, g_framebuffer);
+	glViewport(0, 0, width, height);
+
+	// A frame whose last measurement is still in flight goes untimed
+	TimedFrame* frame = &g_timedFrames[g_timedFrame];
+	if (g_cpuTimed) {
+		g_frameStart = GetTimeSeconds();
+	} else if (!frame->pending) {
+		glQueryCounter(frame->start, GL_TIMESTAMP);
+		frame->scaleStep = g_scaleStep;
+	}
+}
+
+void EndDynamicResolutionFrame(void)
+{
+	if (!g_dynresEnabled)
+		return;
+
+	TimedFrame* frame = &g_timedFrames[g_timedFrame];
+	if (g_cpuTimed) {
+		glFinish();
+		AddMeasurement((GetTimeSeconds() - g_frameStart) * 1000);
+	} else if (!frame->pending) {
+		glQueryCounter(frame->end, GL_TIMESTAMP);
+		frame->pending = true;
+	}
+	g_timedFrame = (g_timedFrame + 1) % DYNRES_QUERY_FRAMES;
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, g_framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, g_bufferWidth, g_bufferHeight, 0, 0, g_windowWidth, g_windowHeight,
+		GL_COLOR_BUFFER_BIT, g_bufferWidth == g_windowWidth ? GL_NEAREST : GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, g_windowWidth, g_windowHeight);
+	g_dynresFrames++;
+}
+
+void PrintDynamicResolutionStats(FILE* out)
+{
+	if (!g_dynresEnabled) {
+		fprintf(out, "Dynamic resolution: off\n");
+		return;
+	}
+	fprintf(out, "Dynamic resolution: %dx%d of %dx%d (%.0f%%), %s %.2f ms of %.2f ms budget\n",
+		g_bufferWidth, g_bufferHeight, g_windowWidth, g_windowHeight,
+		100.0 * g_scaleStep / DYNRES_STEPS, g_cpuTimed ? "software" : "GPU", g_gpuMs, g_budgetMs);
+	fprintf(out, "  %ld frames, %ld lowered, %ld raised, %ld reallocations\n",
+		g_dynresFrames, g_dynresDecreases, g_dynresIncreases, g_dynresResizes);
+}
@@ -0,0 +1,29 @@
+// dynamic_resolution.h
+//
+// Renders the scene into an offscreen framebuffer whose size follows a GPU
+// time budget, then stretches it over the window. Timer queries around
+// the scene measure each frame; a frame or two later the controller lowers
+// the resolution when the budget is exceeded and raises it again once
+// there is clear headroom, so a fill-bound renderer loses sharpness
+// instead of frames. The aspect ratio always matches the window's.
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <stdio.h>
+
+// After InitGLExtensions; false (and the window is rendered to directly)
+// without framebuffer objects, or without timer queries on a hardware
+// renderer
+bool InitDynamicResolution(double budgetMs);
+bool IsDynamicResolutionEnabled(void);
+
+// Brackets the scene. Begin binds the offscreen framebuffer and sets the
+// viewport to its size; End upscales into the window and restores the
+// window viewport.
+void BeginDynamicResolutionFrame(int windowWidth, int windowHeight);
+void EndDynamicResolutionFrame(void);
+
+void PrintDynamicResolutionStats(FILE* out);
+
+#endif
@@ -0,0 +1,126 @@
+// gl_extensions.cpp
+//
+// Runtime lookup of post-1.1 OpenGL entry points.
+
+#include "gl_extensions.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#	include <GL/glx.h>
+#endif
+
+#define GLEXT_DEFINE(ret, name, args) PFN_##name p_##name = NULL;
+GLEXT_FUNCTIONS(GLEXT_DEFINE)
+#undef GLEXT_DEFINE
+
+GLCaps g_glCaps;
+
+static void* GetGLProcAddress(const char* name)
+{
+#ifdef _WIN32
+	void* proc = (void*) wglGetProcAddress(name);
+	// Some ICDs return small sentinel values instead of NULL
+	if (proc == (void*) 0 || proc == (void*) 1 || proc == (void*) 2 ||
+		proc == (void*) 3 || proc == (void*) -1)
+		return NULL;
+	return proc;
+#else
+	return (void*) glXGetProcAddressARB((const GLubyte*) name);
+#endif
+}
+
+bool HasGLExtension(const char* name)
+{
+	const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+	size_t length = strlen(name);
+
+	if (extensions == NULL)
+		return false;
+
+	// Match whole space separated tokens only
+	for (const char* p = strstr(extensions, name); p != NULL; p = strstr(p + length, name)) {
+		if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+			return true;
+	}
+	return false;
+}
+
+static bool HasVersion(int major, int minor)
+{
+	return g_glCaps.major > major || (g_glCaps.major == major && g_glCaps.minor >= minor);
+}
+
+void InitGLExtensions(void)
+{
+	const char* version = (const char*) glGetString(GL_VERSION);
+
+	memset(&g_glCaps, 0, sizeof(g_glCaps));
+	if (version == NULL || sscanf(version, "%d.%d", &g_glCaps.major, &g_glCaps.minor) != 2) {
+		g_glCaps.major = 1;
+		g_glCaps.minor = 1;
+	}
+
+#define GLEXT_LOAD(ret, name, args) p_##name = (PFN_##name) GetGLProcAddress(#name);
+	GLEXT_FUNCTIONS(GLEXT_LOAD)
+#undef GLEXT_LOAD
+
+	g_glCaps.pixelBufferObject =
+		(HasVersion(2, 1) || HasGLExtension("GL_ARB_pixel_buffer_object")) &&
+		glGenBuffers && glDeleteBuffers && glBindBuffer && glBufferData &&
+		glMapBuffer && glUnmapBuffer;
+	g_glCaps.mapBufferRange =
+		(HasVersion(3, 0) || HasGLExtension("GL_ARB_map_buffer_range")) &&
+		glMapBufferRange;
+	g_glCaps.bufferStorage =
+		(HasVersion(4, 4) || HasGLExtension("GL_ARB_buffer_storage")) &&
+		glBufferStorage;
+	g_glCaps.sync =
+		(HasVersion(3, 2) || HasGLExtension("GL_ARB_sync")) &&
+		glFenceSync && glClientWaitSync && glDeleteSync;
+	g_glCaps.timerQuery =
+		(HasVersion(3, 3) || HasGLExtension("GL_ARB_timer_query")) &&
+		glGenQueries && glDeleteQueries && glGetQueryObjectiv && glGetQueryObjectui64v &&
+		glQueryCounter && glGetInteger64v;
+	// NV_conditional_render has different names; require 3.0
+	g_glCaps.conditionalRender = HasVersion(3, 0) &&
+		glGenQueries && glDeleteQueries && glBeginQuery && glEndQuery &&
+		glGetQueryObjectiv && glBeginConditionalRender && glEndConditionalRender;
+	// EXT_framebuffer_object has different names and no blit; require ARB
+	g_glCaps.framebufferObject =
+		(HasVersion(3, 0) || HasGLExtension("GL_ARB_framebuffer_object")) &&
+		glGenFramebuffers && glDeleteFramebuffers && glBindFramebuffer &&
+		glCheckFramebufferStatus && glGenRenderbuffers && glDeleteRenderbuffers &&
+		glBindRenderbuffer && glRenderbufferStorage && glFramebufferRenderbuffer &&
+		glFramebufferTexture2D && glBlitFramebuffer;
+	g_glCaps.multipleRenderTargets = g_glCaps.framebufferObject && HasVersion(3, 0) &&
+		glDrawBuffers && glBindFragDataLocation;
+	g_glCaps.textureCompressionS3TC =
+		HasGLExtension("GL_EXT_texture_compression_s3tc") && glCompressedTexSubImage2D;
+	g_glCaps.packedPixels = HasVersion(1, 2) || HasGLExtension("GL_EXT_packed_pixels");
+	g_glCaps.textureRG = HasVersion(3, 0) || HasGLExtension("GL_ARB_texture_rg");
+	g_glCaps.textureSwizzle = HasVersion(3, 3) || HasGLExtension("GL_ARB_texture_swizzle") ||
+		HasGLExtension("GL_EXT_texture_swizzle");
+	g_glCaps.rgb565 = HasVersion(4, 1) || HasGLExtension("GL_ARB_ES2_compatibility");
+	// The ARB_shader_objects entry points have different names; require 2.0
+	g_glCaps.shaderObjects = HasVersion(2, 0) &&
+		glCreateShader && glShaderSource && glCompileShader && glGetShaderiv &&
+		glGetShaderInfoLog && glDeleteShader && glCreateProgram && glAttachShader &&
+		glLinkProgram && glGetProgramiv && glGetProgramInfoLog && glDeleteProgram &&
+		glUseProgram && glBindAttribLocation && glGetUniformLocation && glUniform1i &&
+		glUniform1f && glUniform2f && glUniformMatrix4fv && glActiveTexture;
+	g_glCaps.vertexArrayObject = g_glCaps.shaderObjects &&
+		(HasVersion(3, 0) || HasGLExtension("GL_ARB_vertex_array_object")) &&
+		glGenVertexArrays && glDeleteVertexArrays && glBindVertexArray &&
+		glVertexAttribPointer && glEnableVertexAttribArray &&
+		glGenBuffers && glDeleteBuffers && glBindBuffer && glBufferData;
+	g_glCaps.uniformBufferObject = g_glCaps.shaderObjects &&
+		(HasVersion(3, 1) || HasGLExtension("GL_ARB_uniform_buffer_object")) &&
+		glBindBufferRange && glBindBufferBase && glGetUniformBlockIndex &&
+		glUniformBlockBinding && glBufferSubData;
+	g_glCaps.textureBufferObject = g_glCaps.shaderObjects &&
+		(HasVersion(3, 1) || (HasGLExtension("GL_ARB_texture_buffer_object") &&
+		HasGLExtension("GL_EXT_texture_integer"))) &&
+		glTexBuffer && glGenBuffers && glBindBuffer && glBufferData;
+}
@@ -0,0 +1,414 @@
+// gl_extensions.h
+//
+// opengl32.lib only exports the OpenGL 1.1 entry points, so everything newer
+// is looked up at runtime after the context exists. Call InitGLExtensions()
+// once from InitGraphics() and test g_glCaps before using a feature; every
+// caller keeps a 1.1 fallback path.
+
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#ifdef _WIN32
+#	include <windows.h>
+#endif
+#include <GL/gl.h>
+#include <stddef.h>
+
+#ifndef APIENTRY
+#	define APIENTRY
+#endif
+
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#endif
+#ifndef GL_VERSION_2_0
+typedef char GLchar;
+#endif
+#ifndef GL_VERSION_3_2
+typedef struct __GLsync* GLsync;
+typedef unsigned long long GLuint64;
+typedef long long GLint64;
+#endif
+
+// OpenGL 1.2
+#ifndef GL_CLAMP_TO_EDGE
+#	define GL_CLAMP_TO_EDGE                 0x812F
+#endif
+#ifndef GL_TEXTURE_BASE_LEVEL
+#	define GL_TEXTURE_BASE_LEVEL            0x813C
+#endif
+#ifndef GL_TEXTURE_MAX_LEVEL
+#	define GL_TEXTURE_MAX_LEVEL             0x813D
+#endif
+#ifndef GL_UNSIGNED_SHORT_5_6_5
+#	define GL_UNSIGNED_SHORT_5_6_5          0x8363
+#endif
+
+// Texture formats: RG (3.0), swizzle (3.3), RGB565 (4.1)
+#ifndef GL_RG
+#	define GL_RG                            0x8227
+#endif
+#ifndef GL_R8
+#	define GL_R8                            0x8229
+#endif
+#ifndef GL_RG8
+#	define GL_RG8                           0x822B
+#endif
+#ifndef GL_RG16
+#	define GL_RG16                          0x822C
+#endif
+#ifndef GL_TEXTURE_SWIZZLE_RGBA
+#	define GL_TEXTURE_SWIZZLE_RGBA          0x8E46
+#endif
+#ifndef GL_RGB565
+#	define GL_RGB565                        0x8D62
+#endif
+
+// Multitexture (1.3)
+#ifndef GL_TEXTURE0
+#	define GL_TEXTURE0                      0x84C0
+#endif
+#ifndef GL_TEXTURE1
+#	define GL_TEXTURE1                      0x84C1
+#endif
+
+// S3TC texture compression
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#	define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#	define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Buffer objects (1.5) and pixel buffer objects (2.1)
+#ifndef GL_STREAM_DRAW
+#	define GL_STREAM_DRAW                   0x88E0
+#endif
+#ifndef GL_STREAM_READ
+#	define GL_STREAM_READ                   0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#	define GL_READ_ONLY                     0x88B8
+#endif
+#ifndef GL_WRITE_ONLY
+#	define GL_WRITE_ONLY                    0x88B9
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#	define GL_PIXEL_PACK_BUFFER             0x88EB
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#	define GL_PIXEL_UNPACK_BUFFER           0x88EC
+#endif
+
+// Shader objects (2.0)
+#ifndef GL_FRAGMENT_SHADER
+#	define GL_FRAGMENT_SHADER               0x8B30
+#endif
+#ifndef GL_VERTEX_SHADER
+#	define GL_VERTEX_SHADER                 0x8B31
+#endif
+#ifndef GL_COMPILE_STATUS
+#	define GL_COMPILE_STATUS                0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#	define GL_LINK_STATUS                   0x8B82
+#endif
+#ifndef GL_INFO_LOG_LENGTH
+#	define GL_INFO_LOG_LENGTH               0x8B84
+#endif
+
+// Vertex buffers (1.5), vertex arrays (3.0) and uniform buffers (3.1)
+#ifndef GL_ARRAY_BUFFER
+#	define GL_ARRAY_BUFFER                  0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#	define GL_ELEMENT_ARRAY_BUFFER          0x8893
+#endif
+#ifndef GL_STATIC_DRAW
+#	define GL_STATIC_DRAW                   0x88E4
+#endif
+#ifndef GL_DYNAMIC_DRAW
+#	define GL_DYNAMIC_DRAW                  0x88E8
+#endif
+#ifndef GL_UNIFORM_BUFFER
+#	define GL_UNIFORM_BUFFER                0x8A11
+#endif
+#ifndef GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+#	define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#endif
+#ifndef GL_INVALID_INDEX
+#	define GL_INVALID_INDEX                 0xFFFFFFFFu
+#endif
+
+// Texture buffer objects (3.1)
+#ifndef GL_TEXTURE_BUFFER
+#	define GL_TEXTURE_BUFFER                0x8C2A
+#endif
+#ifndef GL_RGBA32F
+#	define GL_RGBA32F                       0x8814
+#endif
+#ifndef GL_RG32UI
+#	define GL_RG32UI                        0x823C
+#endif
+#ifndef GL_R16UI
+#	define GL_R16UI                         0x8234
+#endif
+
+// Framebuffer objects (3.0)
+#ifndef GL_DEPTH_COMPONENT24
+#	define GL_DEPTH_COMPONENT24             0x81A6
+#endif
+#ifndef GL_READ_FRAMEBUFFER
+#	define GL_READ_FRAMEBUFFER              0x8CA8
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER
+#	define GL_DRAW_FRAMEBUFFER              0x8CA9
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER_BINDING
+#	define GL_DRAW_FRAMEBUFFER_BINDING      0x8CA6
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+#	define GL_FRAMEBUFFER_COMPLETE          0x8CD5
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+#	define GL_COLOR_ATTACHMENT0             0x8CE0
+#endif
+#ifndef GL_COLOR_ATTACHMENT1
+#	define GL_COLOR_ATTACHMENT1             0x8CE1
+#endif
+#ifndef GL_COLOR_ATTACHMENT2
+#	define GL_COLOR_ATTACHMENT2             0x8CE2
+#endif
+#ifndef GL_DEPTH_ATTACHMENT
+#	define GL_DEPTH_ATTACHMENT              0x8D00
+#endif
+#ifndef GL_FRAMEBUFFER
+#	define GL_FRAMEBUFFER                   0x8D40
+#endif
+#ifndef GL_RENDERBUFFER
+#	define GL_RENDERBUFFER                  0x8D41
+#endif
+
+// Depth textures (1.4) and shadow comparison (3.0)
+#ifndef GL_TEXTURE_COMPARE_MODE
+#	define GL_TEXTURE_COMPARE_MODE          0x884C
+#endif
+#ifndef GL_TEXTURE_COMPARE_FUNC
+#	define GL_TEXTURE_COMPARE_FUNC          0x884D
+#endif
+#ifndef GL_COMPARE_REF_TO_TEXTURE
+#	define GL_COMPARE_REF_TO_TEXTURE        0x884E
+#endif
+
+// Buffer mapping (3.0) and immutable storage (4.4)
+#ifndef GL_MAP_WRITE_BIT
+#	define GL_MAP_WRITE_BIT                 0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#	define GL_MAP_PERSISTENT_BIT            0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#	define GL_MAP_COHERENT_BIT              0x0080
+#endif
+
+// Queries (1.5), conditional rendering (3.0) and timer queries (3.3)
+#ifndef GL_SAMPLES_PASSED
+#	define GL_SAMPLES_PASSED                0x8914
+#endif
+#ifndef GL_QUERY_RESULT
+#	define GL_QUERY_RESULT                  0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#	define GL_QUERY_RESULT_AVAILABLE        0x8867
+#endif
+#ifndef GL_QUERY_WAIT
+#	define GL_QUERY_WAIT                    0x8E13
+#endif
+#ifndef GL_TIMESTAMP
+#	define GL_TIMESTAMP                     0x8E28
+#endif
+
+// Sync objects (3.2)
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#	define GL_SYNC_GPU_COMMANDS_COMPLETE    0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#	define GL_ALREADY_SIGNALED              0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#	define GL_CONDITION_SATISFIED           0x911C
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#	define GL_SYNC_FLUSH_COMMANDS_BIT       0x00000001
+#endif
+
+// Entry points resolved by InitGLExtensions(); NULL when unsupported
+#define GLEXT_FUNCTIONS(F) \
+	F(void,       glActiveTexture,   (GLenum texture)) \
+	F(void,       glCompressedTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void* data)) \
+	F(void,       glGenBuffers,      (GLsizei n, GLuint* buffers)) \
+	F(void,       glDeleteBuffers,   (GLsizei n, const GLuint* buffers)) \
+	F(void,       glBindBuffer,      (GLenum target, GLuint buffer)) \
+	F(void,       glBufferData,      (GLenum target, GLsizeiptr size, const void* data, GLenum usage)) \
+	F(void,       glBufferSubData,   (GLenum target, GLintptr offset, GLsizeiptr size, const void* data)) \
+	F(void*,      glMapBuffer,       (GLenum target, GLenum access)) \
+	F(GLboolean,  glUnmapBuffer,     (GLenum target)) \
+	F(void*,      glMapBufferRange,  (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)) \
+	F(void,       glBufferStorage,   (GLenum target, GLsizeiptr size, const void* data, GLbitfield flags)) \
+	F(GLsync,     glFenceSync,       (GLenum condition, GLbitfield flags)) \
+	F(GLenum,     glClientWaitSync,  (GLsync sync, GLbitfield flags, GLuint64 timeout)) \
+	F(void,       glDeleteSync,      (GLsync sync)) \
+	F(void,       glGenQueries,      (GLsizei n, GLuint* ids)) \
+	F(void,       glDeleteQueries,   (GLsizei n, const GLuint* ids)) \
+	F(void,       glBeginQuery,      (GLenum target, GLuint id)) \
+	F(void,       glEndQuery,        (GLenum target)) \
+	F(void,       glBeginConditionalRender, (GLuint id, GLenum mode)) \
+	F(void,       glEndConditionalRender, (void)) \
+	F(void,       glGetQueryObjectiv, (GLuint id, GLenum pname, GLint* params)) \
+	F(void,       glGetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64* params)) \
+	F(void,       glQueryCounter,    (GLuint id, GLenum target)) \
+	F(void,       glGetInteger64v,   (GLenum pname, GLint64* data)) \
+	F(void,       glGenFramebuffers, (GLsizei n, GLuint* framebuffers)) \
+	F(void,       glDeleteFramebuffers, (GLsizei n, const GLuint* framebuffers)) \
+	F(void,       glBindFramebuffer, (GLenum target, GLuint framebuffer)) \
+	F(GLenum,     glCheckFramebufferStatus, (GLenum target)) \
+	F(void,       glGenRenderbuffers, (GLsizei n, GLuint* renderbuffers)) \
+	F(void,       glDeleteRenderbuffers, (GLsizei n, const GLuint* renderbuffers)) \
+	F(void,       glBindRenderbuffer, (GLenum target, GLuint renderbuffer)) \
+	F(void,       glRenderbufferStorage, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height)) \
+	F(void,       glFramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer)) \
+	F(void,       glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)) \
+	F(void,       glDrawBuffers,     (GLsizei n, const GLenum* bufs)) \
+	F(void,       glBindFragDataLocation, (GLuint program, GLuint color, const GLchar* name)) \
+	F(void,       glBlitFramebuffer, (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)) \
+	F(void,       glGenVertexArrays, (GLsizei n, GLuint* arrays)) \
+	F(void,       glDeleteVertexArrays, (GLsizei n, const GLuint* arrays)) \
+	F(void,       glBindVertexArray, (GLuint array)) \
+	F(void,       glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)) \
+	F(void,       glEnableVertexAttribArray, (GLuint index)) \
+	F(void,       glBindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)) \
+	F(void,       glBindBufferBase,  (GLenum target, GLuint index, GLuint buffer)) \
+	F(GLuint,     glGetUniformBlockIndex, (GLuint program, const GLchar* uniformBlockName)) \
+	F(void,       glUniformBlockBinding, (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding)) \
+	F(void,       glTexBuffer,       (GLenum target, GLenum internalformat, GLuint buffer)) \
+	F(GLuint,     glCreateShader,    (GLenum type)) \
+	F(void,       glShaderSource,    (GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length)) \
+	F(void,       glCompileShader,   (GLuint shader)) \
+	F(void,       glGetShaderiv,     (GLuint shader, GLenum pname, GLint* params)) \
+	F(void,       glGetShaderInfoLog, (GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog)) \
+	F(void,       glDeleteShader,    (GLuint shader)) \
+	F(GLuint,     glCreateProgram,   (void)) \
+	F(void,       glAttachShader,    (GLuint program, GLuint shader)) \
+	F(void,       glLinkProgram,     (GLuint program)) \
+	F(void,       glGetProgramiv,    (GLuint program, GLenum pname, GLint* params)) \
+	F(void,       glGetProgramInfoLog, (GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog)) \
+	F(void,       glDeleteProgram,   (GLuint program)) \
+	F(void,       glUseProgram,      (GLuint program)) \
+	F(void,       glBindAttribLocation, (GLuint program, GLuint index, const GLchar* name)) \
+	F(GLint,      glGetUniformLocation, (GLuint program, const GLchar* name)) \
+	F(void,       glUniform1i,       (GLint location, GLint v0)) \
+	F(void,       glUniform1f,       (GLint location, GLfloat v0)) \
+	F(void,       glUniform2f,       (GLint location, GLfloat v0, GLfloat v1)) \
+	F(void,       glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+
+#define GLEXT_DECLARE(ret, name, args) \
+	typedef ret (APIENTRY* PFN_##name) args; \
+	extern PFN_##name p_##name;
+GLEXT_FUNCTIONS(GLEXT_DECLARE)
+#undef GLEXT_DECLARE
+
+#define glActiveTexture   p_glActiveTexture
+#define glCompressedTexSubImage2D  p_glCompressedTexSubImage2D
+#define glGenBuffers      p_glGenBuffers
+#define glDeleteBuffers   p_glDeleteBuffers
+#define glBindBuffer      p_glBindBuffer
+#define glBufferData      p_glBufferData
+#define glBufferSubData   p_glBufferSubData
+#define glMapBuffer       p_glMapBuffer
+#define glUnmapBuffer     p_glUnmapBuffer
+#define glMapBufferRange  p_glMapBufferRange
+#define glBufferStorage   p_glBufferStorage
+#define glFenceSync       p_glFenceSync
+#define glClientWaitSync  p_glClientWaitSync
+#define glDeleteSync      p_glDeleteSync
+#define glGenQueries      p_glGenQueries
+#define glDeleteQueries   p_glDeleteQueries
+#define glBeginQuery      p_glBeginQuery
+#define glEndQuery        p_glEndQuery
+#define glBeginConditionalRender  p_glBeginConditionalRender
+#define glEndConditionalRender  p_glEndConditionalRender
+#define glGetQueryObjectiv  p_glGetQueryObjectiv
+#define glGetQueryObjectui64v  p_glGetQueryObjectui64v
+#define glQueryCounter    p_glQueryCounter
+#define glGetInteger64v   p_glGetInteger64v
+#define glGenFramebuffers  p_glGenFramebuffers
+#define glDeleteFramebuffers  p_glDeleteFramebuffers
+#define glBindFramebuffer  p_glBindFramebuffer
+#define glCheckFramebufferStatus  p_glCheckFramebufferStatus
+#define glGenRenderbuffers  p_glGenRenderbuffers
+#define glDeleteRenderbuffers  p_glDeleteRenderbuffers
+#define glBindRenderbuffer  p_glBindRenderbuffer
+#define glRenderbufferStorage  p_glRenderbufferStorage
+#define glFramebufferRenderbuffer  p_glFramebufferRenderbuffer
+#define glFramebufferTexture2D  p_glFramebufferTexture2D
+#define glDrawBuffers     p_glDrawBuffers
+#define glBindFragDataLocation  p_glBindFragDataLocation
+#define glBlitFramebuffer  p_glBlitFramebuffer
+#define glGenVertexArrays  p_glGenVertexArrays
+#define glDeleteVertexArrays  p_glDeleteVertexArrays
+#define glBindVertexArray  p_glBindVertexArray
+#define glVertexAttribPointer  p_glVertexAttribPointer
+#define glEnableVertexAttribArray  p_glEnableVertexAttribArray
+#define glBindBufferRange  p_glBindBufferRange
+#define glBindBufferBase  p_glBindBufferBase
+#define glGetUniformBlockIndex  p_glGetUniformBlockIndex
+#define glUniformBlockBinding  p_glUniformBlockBinding
+#define glTexBuffer       p_glTexBuffer
+#define glCreateShader    p_glCreateShader
+#define glShaderSource    p_glShaderSource
+#define glCompileShader   p_glCompileShader
+#define glGetShaderiv     p_glGetShaderiv
+#define glGetShaderInfoLog  p_glGetShaderInfoLog
+#define glDeleteShader    p_glDeleteShader
+#define glCreateProgram   p_glCreateProgram
+#define glAttachShader    p_glAttachShader
+#define glLinkProgram     p_glLinkProgram
+#define glGetProgramiv    p_glGetProgramiv
+#define glGetProgramInfoLog  p_glGetProgramInfoLog
+#define glDeleteProgram   p_glDeleteProgram
+#define glUseProgram      p_glUseProgram
+#define glBindAttribLocation  p_glBindAttribLocation
+#define glGetUniformLocation  p_glGetUniformLocation
+#define glUniform1i       p_glUniform1i
+#define glUniform1f       p_glUniform1f
+#define glUniform2f       p_glUniform2f
+#define glUniformMatrix4fv  p_glUniformMatrix4fv
+
+struct GLCaps {
+	int major, minor;              // context version
+	bool pixelBufferObject;        // ARB_pixel_buffer_object / 2.1
+	bool mapBufferRange;           // ARB_map_buffer_range / 3.0
+	bool bufferStorage;            // ARB_buffer_storage / 4.4
+	bool sync;                     // ARB_sync / 3.2
+	bool timerQuery;               // ARB_timer_query / 3.3
+	bool conditionalRender;        // 3.0, with occlusion queries
+	bool framebufferObject;        // ARB_framebuffer_object / 3.0, with blits
+	bool multipleRenderTargets;    // 3.0 draw buffers and bound fragment outputs
+	bool textureCompressionS3TC;   // EXT_texture_compression_s3tc
+	bool packedPixels;             // EXT_packed_pixels / 1.2
+	bool textureRG;                // ARB_texture_rg / 3.0
+	bool textureSwizzle;           // ARB_texture_swizzle / 3.3
+	bool rgb565;                   // ARB_ES2_compatibility / 4.1
+	bool shaderObjects;            // GLSL vertex and fragment shaders / 2.0
+	bool vertexArrayObject;        // ARB_vertex_array_object / 3.0, with vertex buffers
+	bool uniformBufferObject;      // ARB_uniform_buffer_object / 3.1
+	bool textureBufferObject;      // ARB_texture_buffer_object / 3.1, integer formats
+};
+
+extern GLCaps g_glCaps;
+
+void InitGLExtensions(void);
+bool HasGLExtension(const char* name);
+
+#endif
@@ -0,0 +1,383 @@
+// gl_state.cpp
+//
+// Every shadowed value carries a known flag; an unknown value never
+// filters a call.
+
+#include "gl_state.h"
+
+#include <string.h>
+
+#define STATE_MAX_CAPS        16
+#define STATE_TEXTURE_UNITS   8
+#define STATE_BUFFER_INDICES  16       // indexed uniform buffer bindings
+
+enum StateCounter {
+	COUNT_CAPABILITY,
+	COUNT_TEXTURE,
+	COUNT_PROGRAM,
+	COUNT_VERTEX_ARRAY,
+	COUNT_BUFFER,
+	COUNT_MATERIAL,
+	COUNT_KINDS
+};
+
+static const char* g_counterNames[COUNT_KINDS] = {
+	"enable/disable", "texture binds", "programs", "vertex arrays",
+	"buffer binds", "materials/colors"
+};
+
+struct StateCounts {
+	int issued[COUNT_KINDS];
+	int filtered[COUNT_KINDS];
+};
+
+struct Capability {
+	GLenum cap;
+	bool known;
+	bool enabled;
+};
+
+struct Binding {
+	bool known;
+	GLuint name;
+};
+
+struct IndexedBinding {
+	bool known;
+	GLuint buffer;
+	GLintptr offset;
+	GLsizeiptr size;                   // 0 = whole buffer (BindBufferBase)
+};
+
+struct Vector4State {
+	bool known;
+	GLfloat value[4];
+};
+
+// The buffer targets shadowed by CachedBindBuffer
+static const GLenum g_bufferTargets[] = {
+	GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER
+};
+#define BUFFER_TARGETS ((int) (sizeof(g_bufferTargets) / sizeof(g_bufferTargets[0])))
+
+static bool g_caching = true;
+static Capability g_caps[STATE_MAX_CAPS];
+static int g_capCount = 0;
+static Binding g_activeTexture;        // name holds the unit index
+static Binding g_textures[STATE_TEXTURE_UNITS];
+static Binding g_program;
+static Binding g_vertexArray;
+static Binding g_buffers[BUFFER_TARGETS];
+static IndexedBinding g_uniformBuffers[STATE_BUFFER_INDICES];
+static Vector4State g_ambient, g_diffuse, g_specular, g_color;
+static Vector4State g_shininess;       // value[0] only
+
+static StateCounts g_frameCounts, g_lastCounts;
+static long long g_totalIssued = 0, g_totalFiltered = 0;
+
+// True when the call can be dropped. With caching off redundant calls are
+// issued anyway and counted as both.
+static bool Filter(StateCounter counter, bool redundant)
+{
+	if (redundant)
+		g_frameCounts.filtered[counter]++;
+	if (redundant && g_caching)
+		return true;
+	g_frameCounts.issued[counter]++;
+	return false;
+}
+
+void InvalidateGLState(void)
+{
+	g_capCount = 0;
+	g_activeTexture.known = false;
+	for (int i = 0; i < STATE_TEXTURE_UNITS; i++)
+		g_textures[i].known = false;
+	g_program.known = false;
+	g_vertexArray.known = false;
+	for (int i = 0; i < BUFFER_TARGETS; i++)
+		g_buffers[i].known = false;
+	for (int i = 0; i < STATE_BUFFER_INDICES; i++)
+		g_uniformBuffers[i].known = false;
+	g_ambient.known = g_diffuse.known = g_specular.known = false;
+	g_shininess.known = g_color.known = false;
+}
+
+void SetGLStateCaching(bool enabled)
+{
+	g_caching = enabled;
+}
+
+void BeginGLStateFrame(void)
+{
+	for (int i = 0; i < COUNT_KINDS; i++) {
+		g_totalIssued += g_frameCounts.issued[i];
+		g_totalFiltered += g_frameCounts.filtered[i];
+	}
+	g_lastCounts = g_frameCounts;
+	memset(&g_frameCounts, 0, sizeof(g_frameCounts));
+}
+
+static Capability* FindCapability(GLenum cap)
+{
+	for (int i = 0; i < g_capCount; i++) {
+		if (g_caps[i].cap == cap)
+			return &g_caps[i];
+	}
+	if (g_capCount == STATE_MAX_CAPS)
+		return NULL;
+	Capability* c = &g_caps[g_capCount++];
+	c->cap = cap;
+	c->known = false;
+	return c;
+}
+
+static void SetCapability(GLenum cap, bool enabled)
+{
+	Capability* c = FindCapability(cap);
+
+	if (Filter(COUNT_CAPABILITY, c != NULL && c->known && c->enabled == enabled))
+		return;
+	if (enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	if (c != NULL) {
+		c->known = true;
+		c->enabled = enabled;
+	}
+}
+
+void CachedEnable(GLenum cap)
+{
+	SetCapability(cap, true);
+}
+
+void CachedDisable(GLenum cap)
+{
+	SetCapability(cap, false);
+}
+
+bool CachedIsEnabled(GLenum cap)
+{
+	Capability* c = FindCapability(cap);
+
+	if (c != NULL && c->known)
+		return c->enabled;
+	bool enabled = glIsEnabled(cap) != GL_FALSE;
+	if (c != NULL) {
+		c->known = true;
+		c->enabled = enabled;
+	}
+	return enabled;
+}
+
+void CachedActiveTexture(GLenum unit)
+{
+	GLuint index = unit - GL_TEXTURE0;
+
+	if (Filter(COUNT_TEXTURE, g_activeTexture.known && g_activeTexture.name == index))
+		return;
+	glActiveTexture(unit);
+	g_activeTexture.known = true;
+	g_activeTexture.name = index;
+}
+
+// The shadow of the active unit's 2D binding, or NULL if the unit is
+// unknown or past the shadowed range. Without multitexture there is only
+// unit 0.
+static Binding* ActiveTextureBinding(void)
+{
+	if (!glActiveTexture)
+		return &g_textures[0];
+	if (!g_activeTexture.known || g_activeTexture.name >= STATE_TEXTURE_UNITS)
+		return NULL;
+	return &g_textures[g_activeTexture.name];
+}
+
+void CachedBindTexture(GLenum target, GLuint texture)
+{
+	Binding* binding = target == GL_TEXTURE_2D ? ActiveTextureBinding() : NULL;
+
+	if (Filter(COUNT_TEXTURE, binding != NULL && binding->known && binding->name == texture))
+		return;
+	glBindTexture(target, texture);
+	if (binding != NULL) {
+		binding->known = true;
+		binding->name = texture;
+	}
+}
+
+// Deleting a bound texture reverts every unit it was bound on to 0
+void CachedDeleteTextures(GLsizei count, const GLuint* textures)
+{
+	glDeleteTextures(count, textures);
+	for (int unit = 0; unit < STATE_TEXTURE_UNITS; unit++) {
+		for (GLsizei i = 0; i < count; i++) {
+			if (g_textures[unit].known && g_textures[unit].name == textures[i])
+				g_textures[unit].name = 0;
+		}
+	}
+}
+
+void CachedUseProgram(GLuint program)
+{
+	if (Filter(COUNT_PROGRAM, g_program.known && g_program.name == program))
+		return;
+	glUseProgram(program);
+	g_program.known = true;
+	g_program.name = program;
+}
+
+void CachedBindVertexArray(GLuint array)
+{
+	if (Filter(COUNT_VERTEX_ARRAY, g_vertexArray.known && g_vertexArray.name == array))
+		return;
+	glBindVertexArray(array);
+	g_vertexArray.known = true;
+	g_vertexArray.name = array;
+}
+
+void CachedDeleteVertexArrays(GLsizei count, const GLuint* arrays)
+{
+	glDeleteVertexArrays(count, arrays);
+	for (GLsizei i = 0; i < count; i++) {
+		if (g_vertexArray.known && g_vertexArray.name == arrays[i])
+			g_vertexArray.name = 0;
+	}
+}
+
+static Binding* FindBufferBinding(GLenum target)
+{
+	for (int i = 0; i < BUFFER_TARGETS; i++) {
+		if (g_bufferTargets[i] == target)
+			return &g_buffers[i];
+	}
+	return NULL;
+}
+
+void CachedBindBuffer(GLenum target, GLuint buffer)
+{
+	Binding* binding = FindBufferBinding(target);
+
+	if (Filter(COUNT_BUFFER, binding != NULL && binding->known && binding->name == buffer))
+		return;
+	glBindBuffer(target, buffer);
+	if (binding != NULL) {
+		binding->known = true;
+		binding->name = buffer;
+	}
+}
+
+void CachedBindBufferRange(GLenum target, GLuint index, GLuint buffer,
+	GLintptr offset, GLsizeiptr size)
+{
+	IndexedBinding* binding = target == GL_UNIFORM_BUFFER && index < STATE_BUFFER_INDICES ?
+		&g_uniformBuffers[index] : NULL;
+
+	if (Filter(COUNT_BUFFER, binding != NULL && binding->known && binding->buffer == buffer &&
+		binding->offset == offset && binding->size == size))
+		return;
+	if (size == 0)
+		glBindBufferBase(target, index, buffer);
+	else
+		glBindBufferRange(target, index, buffer, offset, size);
+
+	// Indexed binds also replace the generic binding
+	Binding* generic = FindBufferBinding(target);
+	if (generic != NULL) {
+		generic->known = true;
+		generic->name = buffer;
+	}
+	if (binding != NULL) {
+		binding->known = true;
+		binding->buffer = buffer;
+		binding->offset = offset;
+		binding->size = size;
+	}
+}
+
+void CachedBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	CachedBindBufferRange(target, index, buffer, 0, 0);
+}
+
+void CachedDeleteBuffers(GLsizei count, const GLuint* buffers)
+{
+	glDeleteBuffers(count, buffers);
+	for (GLsizei i = 0; i < count; i++) {
+		for (int t = 0; t < BUFFER_TARGETS; t++) {
+			if (g_buffers[t].known && g_buffers[t].name == buffers[i])
+				g_buffers[t].name = 0;
+		}
+		for (int b = 0; b < STATE_BUFFER_INDICES; b++) {
+			if (g_uniformBuffers[b].buffer == buffers[i])
+				g_uniformBuffers[b].known = false;
+		}
+	}
+}
+
+static bool SetVector(Vector4State* state, const GLfloat* value, int count)
+{
+	if (Filter(COUNT_MATERIAL, state->known && memcmp(state->value, value, count * sizeof(GLfloat)) == 0))
+		return false;
+	state->known = true;
+	memcpy(state->value, value, count * sizeof(GLfloat));
+	return true;
+}
+
+static Vector4State* FindMaterial(GLenum pname)
+{
+	switch (pname) {
+	case GL_AMBIENT:   return &g_ambient;
+	case GL_DIFFUSE:   return &g_diffuse;
+	case GL_SPECULAR:  return &g_specular;
+	case GL_SHININESS: return &g_shininess;
+	}
+	return NULL;
+}
+
+void CachedMaterialfv(GLenum face, GLenum pname, const GLfloat* params)
+{
+	Vector4State* state = face == GL_FRONT ? FindMaterial(pname) : NULL;
+
+	if (state == NULL) {
+		// GL_FRONT_AND_BACK and the rest change what we shadow
+		Filter(COUNT_MATERIAL, false);
+		glMaterialfv(face, pname, params);
+		g_ambient.known = g_diffuse.known = g_specular.known = g_shininess.known = false;
+		return;
+	}
+	if (SetVector(state, params, pname == GL_SHININESS ? 1 : 4))
+		glMaterialfv(face, pname, params);
+}
+
+void CachedMaterialf(GLenum face, GLenum pname, GLfloat param)
+{
+	CachedMaterialfv(face, pname, &param);
+}
+
+void CachedColor4fv(const GLfloat* color)
+{
+	if (SetVector(&g_color, color, 4))
+		glColor4fv(color);
+}
+
+void PrintGLStateStats(FILE* out)
+{
+	int issued = 0, filtered = 0;
+	const char* dropped = g_caching ? "filtered" : "redundant";
+
+	for (int i = 0; i < COUNT_KINDS; i++) {
+		issued += g_lastCounts.issued[i];
+		filtered += g_lastCounts.filtered[i];
+	}
+	fprintf(out, "GL state cache%s: %d calls issued, %d %s last frame\n",
+		g_caching ? "" : " (off)", issued, filtered, dropped);
+	for (int i = 0; i < COUNT_KINDS; i++) {
+		if (g_lastCounts.issued[i] + g_lastCounts.filtered[i] > 0)
+			fprintf(out, "  %-17s %4d issued, %4d %s\n", g_counterNames[i],
+				g_lastCounts.issued[i], g_lastCounts.filtered[i], dropped);
+	}
+	fprintf(out, "  %lld issued, %lld %s in total\n", g_totalIssued, g_totalFiltered, dropped);
+}
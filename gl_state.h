@@ -0,0 +1,59 @@
+// gl_state.h
+//
+// CPU shadow of the GL state the demo changes every frame: enables, the
+// active texture unit and its 2D bindings, the program, the vertex array,
+// buffer bindings, and the fixed-function material and color. A call that
+// would not change the shadowed value is dropped before it reaches the
+// driver; issued and dropped calls are counted per frame.
+//
+// The shadow is only right if every change goes through here. Values start
+// unknown, so the first call for each always reaches GL; code that changes
+// state behind the cache's back (glPushAttrib, a library) must call
+// InvalidateGLState() afterwards.
+
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <stdio.h>
+
+#include "gl_extensions.h"
+
+// Forgets everything; call once the context exists and after foreign state
+// changes
+void InvalidateGLState(void);
+
+// false passes every call through, still counting what would have been
+// filtered, to measure the cache against the driver
+void SetGLStateCaching(bool enabled);
+
+// Starts a new frame of counters
+void BeginGLStateFrame(void);
+
+void CachedEnable(GLenum cap);
+void CachedDisable(GLenum cap);
+bool CachedIsEnabled(GLenum cap);
+
+void CachedActiveTexture(GLenum unit);
+void CachedBindTexture(GLenum target, GLuint texture);
+void CachedDeleteTextures(GLsizei count, const GLuint* textures);
+
+void CachedUseProgram(GLuint program);
+
+void CachedBindVertexArray(GLuint array);
+void CachedDeleteVertexArrays(GLsizei count, const GLuint* arrays);
+
+// Element array bindings belong to the vertex array and pass straight through
+void CachedBindBuffer(GLenum target, GLuint buffer);
+void CachedBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void CachedBindBufferRange(GLenum target, GLuint index, GLuint buffer,
+	GLintptr offset, GLsizeiptr size);
+void CachedDeleteBuffers(GLsizei count, const GLuint* buffers);
+
+// Only GL_FRONT ambient, diffuse, specular and shininess are shadowed
+void CachedMaterialfv(GLenum face, GLenum pname, const GLfloat* params);
+void CachedMaterialf(GLenum face, GLenum pname, GLfloat param);
+void CachedColor4fv(const GLfloat* color);
+
+void PrintGLStateStats(FILE* out);
+
+#endif
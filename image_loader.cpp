@@ -0,0 +1,1119 @@
+// image_loader.cpp
+//
+// PNG, TGA, PPM/PGM and SGI .rgb decoders for image_loader.h.
+//
+// PNG data is inflated through a 64 KB window and handed to the row
+// assembler as it is produced, so the only PNG working memory is the window
+// and two filter rows, both borrowed from the staging pool. The other
+// formats are read directly from the mapping.
+
+#include "image_loader.h"
+#include "staging_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned ReadBE16(const unsigned char* p)
+{
+	return ((unsigned) p[0] << 8) | p[1];
+}
+
+static unsigned long ReadBE32(const unsigned char* p)
+{
+	return ((unsigned long) p[0] << 24) | ((unsigned long) p[1] << 16) |
+		((unsigned long) p[2] << 8) | p[3];
+}
+
+static unsigned ReadLE16(const unsigned char* p)
+{
+	return p[0] | ((unsigned) p[1] << 8);
+}
+
+static bool IsSpace(int c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/****************************************************************
+*																*
+*			    Inflate (RFC 1950 / 1951)						*
+*																*
+****************************************************************/
+
+#define INFLATE_WINDOW      32768
+#define INFLATE_BUFFER      (2 * INFLATE_WINDOW)
+#define INFLATE_MAX_MATCH   258
+#define HUFFMAN_FAST_BITS   9
+
+// Receives decompressed bytes; return false to stop inflating early
+typedef bool (*InflateSink)(void* user, const unsigned char* data, size_t length);
+// Supplies the next piece of compressed input; false at end of input
+typedef bool (*InflateSource)(void* user, const unsigned char** data, size_t* length);
+
+struct Huffman {
+	unsigned short fast[1 << HUFFMAN_FAST_BITS];  // symbol << 4 | length, 0 = slow path
+	short count[16];
+	short symbol[288];
+};
+
+struct Inflater {
+	const unsigned char* in;
+	const unsigned char* inEnd;
+	InflateSource source;
+	void* sourceUser;
+	unsigned long bitBuffer;
+	int bitCount;
+	int padding;             // zero bits appended past the end of input
+	bool overrun;
+
+	unsigned char* out;
+	size_t outPos, outFlushed;
+	InflateSink sink;
+	void* sinkUser;
+	bool stop;
+};
+
+static const unsigned short kLengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const unsigned char kLengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short kDistanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const unsigned char kDistanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static void NeedBits(Inflater* z, int n)
+{
+	while (z->bitCount < n) {
+		size_t length;
+		while (z->in == z->inEnd && z->padding == 0) {
+			if (z->source == NULL || !z->source(z->sourceUser, &z->in, &length)) {
+				z->in = z->inEnd = NULL;
+				break;
+			}
+			z->inEnd = z->in + length;
+		}
+		if (z->in != z->inEnd)
+			z->bitBuffer |= (unsigned long) *z->in++ << z->bitCount;
+		else
+			z->padding += 8;
+		z->bitCount += 8;
+	}
+}
+
+static void DropBits(Inflater* z, int n)
+{
+	z->bitBuffer >>= n;
+	z->bitCount -= n;
+	if (z->bitCount < z->padding)
+		z->overrun = true;
+}
+
+static unsigned GetBits(Inflater* z, int n)
+{
+	NeedBits(z, n);
+	unsigned value = (unsigned) (z->bitBuffer & ((1UL << n) - 1));
+	DropBits(z, n);
+	return value;
+}
+
+static bool BuildHuffman(Huffman* h, const unsigned char* lengths, int n)
+{
+	short offsets[16];
+	int left = 1;
+
+	memset(h->count, 0, sizeof(h->count));
+	memset(h->fast, 0, sizeof(h->fast));
+	for (int i = 0; i < n; i++)
+		h->count[lengths[i]]++;
+	h->count[0] = 0;
+
+	// Over-subscribed codes are invalid; incomplete ones are allowed
+	for (int len = 1; len < 16; len++) {
+		left = (left << 1) - h->count[len];
+		if (left < 0)
+			return false;
+	}
+
+	offsets[1] = 0;
+	for (int len = 1; len < 15; len++)
+		offsets[len + 1] = offsets[len] + h->count[len];
+	for (int i = 0; i < n; i++) {
+		if (lengths[i])
+			h->symbol[offsets[lengths[i]]++] = (short) i;
+	}
+
+	// Lookup table for short codes, indexed by the bit-reversed code
+	int code = 0, k = 0;
+	for (int len = 1; len < 16; len++) {
+		for (int j = 0; j < h->count[len]; j++, k++, code++) {
+			if (len > HUFFMAN_FAST_BITS)
+				continue;
+			int reversed = 0;
+			for (int b = 0; b < len; b++)
+				reversed |= ((code >> b) & 1) << (len - 1 - b);
+			for (int fill = reversed; fill < (1 << HUFFMAN_FAST_BITS); fill += 1 << len)
+				h->fast[fill] = (unsigned short) ((h->symbol[k] << 4) | len);
+		}
+		code <<= 1;
+	}
+	return true;
+}
+
+static int DecodeSymbol(Inflater* z, const Huffman* h)
+{
+	NeedBits(z, HUFFMAN_FAST_BITS);
+	unsigned entry = h->fast[z->bitBuffer & ((1 << HUFFMAN_FAST_BITS) - 1)];
+	if (entry) {
+		DropBits(z, entry & 15);
+		return entry >> 4;
+	}
+
+	// Long code: walk the canonical code one bit at a time
+	int code = 0, first = 0, index = 0;
+	for (int len = 1; len < 16; len++) {
+		code |= GetBits(z, 1);
+		int count = h->count[len];
+		if (code - count < first)
+			return h->symbol[index + (code - first)];
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+static void FlushOutput(Inflater* z)
+{
+	if (z->outPos > z->outFlushed && !z->stop &&
+		!z->sink(z->sinkUser, z->out + z->outFlushed, z->outPos - z->outFlushed))
+		z->stop = true;
+	z->outFlushed = z->outPos;
+}
+
+// Guarantees room for one maximum length match, keeping a full window behind
+static void MakeRoom(Inflater* z)
+{
+	if (z->outPos + INFLATE_MAX_MATCH <= INFLATE_BUFFER)
+		return;
+	FlushOutput(z);
+	memmove(z->out, z->out + z->outPos - INFLATE_WINDOW, INFLATE_WINDOW);
+	z->outPos = z->outFlushed = INFLATE_WINDOW;
+}
+
+static bool InflateStored(Inflater* z)
+{
+	DropBits(z, z->bitCount & 7);
+	unsigned length = GetBits(z, 16);
+	unsigned complement = GetBits(z, 16);
+	if (z->overrun || (length ^ 0xffff) != complement)
+		return false;
+	while (length-- > 0 && !z->overrun) {
+		MakeRoom(z);
+		z->out[z->outPos++] = (unsigned char) GetBits(z, 8);
+	}
+	return !z->overrun;
+}
+
+static bool InflateCodes(Inflater* z, const Huffman* lit, const Huffman* dist)
+{
+	while (!z->overrun && !z->stop) {
+		int symbol = DecodeSymbol(z, lit);
+		if (symbol < 256) {
+			if (symbol < 0)
+				return false;
+			MakeRoom(z);
+			z->out[z->outPos++] = (unsigned char) symbol;
+			continue;
+		}
+		if (symbol == 256)
+			break;
+
+		symbol -= 257;
+		if (symbol >= 29)
+			return false;
+		int length = kLengthBase[symbol] + GetBits(z, kLengthExtra[symbol]);
+		symbol = DecodeSymbol(z, dist);
+		if (symbol < 0 || symbol >= 30)
+			return false;
+		size_t distance = kDistanceBase[symbol] + GetBits(z, kDistanceExtra[symbol]);
+
+		MakeRoom(z);
+		if (distance > z->outPos)
+			return false;
+		unsigned char* out = z->out + z->outPos;
+		const unsigned char* from = out - distance;
+		for (int i = 0; i < length; i++)
+			out[i] = from[i];
+		z->outPos += length;
+	}
+	return !z->overrun;
+}
+
+static bool InflateFixed(Inflater* z)
+{
+	unsigned char lengths[288 + 30];
+	Huffman lit, dist;
+	int i = 0;
+
+	for (; i < 144; i++) lengths[i] = 8;
+	for (; i < 256; i++) lengths[i] = 9;
+	for (; i < 280; i++) lengths[i] = 7;
+	for (; i < 288; i++) lengths[i] = 8;
+	for (; i < 288 + 30; i++) lengths[i] = 5;
+	BuildHuffman(&lit, lengths, 288);
+	BuildHuffman(&dist, lengths + 288, 30);
+	return InflateCodes(z, &lit, &dist);
+}
+
+static bool InflateDynamic(Inflater* z)
+{
+	static const unsigned char order[19] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	unsigned char lengths[288 + 32];
+	Huffman lit, dist;
+
+	int nlen = GetBits(z, 5) + 257;
+	int ndist = GetBits(z, 5) + 1;
+	int ncode = GetBits(z, 4) + 4;
+	if (nlen > 286 || ndist > 30)
+		return false;
+
+	memset(lengths, 0, sizeof(lengths));
+	for (int i = 0; i < ncode; i++)
+		lengths[order[i]] = (unsigned char) GetBits(z, 3);
+	if (!BuildHuffman(&lit, lengths, 19))
+		return false;
+
+	int index = 0;
+	while (index < nlen + ndist) {
+		int symbol = DecodeSymbol(z, &lit);
+		if (symbol < 0 || z->overrun)
+			return false;
+		if (symbol < 16) {
+			lengths[index++] = (unsigned char) symbol;
+			continue;
+		}
+
+		unsigned char length = 0;
+		int repeat;
+		if (symbol == 16) {
+			if (index == 0)
+				return false;
+			length = lengths[index - 1];
+			repeat = 3 + GetBits(z, 2);
+		} else if (symbol == 17) {
+			repeat = 3 + GetBits(z, 3);
+		} else {
+			repeat = 11 + GetBits(z, 7);
+		}
+		if (index + repeat > nlen + ndist)
+			return false;
+		while (repeat--)
+			lengths[index++] = length;
+	}
+
+	if (lengths[256] == 0 ||
+		!BuildHuffman(&lit, lengths, nlen) ||
+		!BuildHuffman(&dist, lengths + nlen, ndist))
+		return false;
+	return InflateCodes(z, &lit, &dist);
+}
+
+// Inflates a zlib stream from source into sink
+static bool InflateZlib(InflateSource source, void* sourceUser, InflateSink sink, void* sinkUser)
+{
+	Inflater z;
+	bool ok = true;
+	int last;
+
+	memset(&z, 0, sizeof(z));
+	z.source = source;
+	z.sourceUser = sourceUser;
+	z.sink = sink;
+	z.sinkUser = sinkUser;
+	z.out = (unsigned char*) AcquireStagingBuffer(INFLATE_BUFFER);
+	if (z.out == NULL)
+		return false;
+
+	unsigned cmf = GetBits(&z, 8);
+	unsigned flg = GetBits(&z, 8);
+	if (z.overrun || (cmf & 15) != 8 || (cmf * 256 + flg) % 31 != 0 || (flg & 0x20))
+		ok = false;
+
+	while (ok && !z.stop) {
+		last = GetBits(&z, 1);
+		switch (GetBits(&z, 2)) {
+		case 0:  ok = InflateStored(&z);  break;
+		case 1:  ok = InflateFixed(&z);   break;
+		case 2:  ok = InflateDynamic(&z); break;
+		default: ok = false;              break;
+		}
+		if (last)
+			break;
+	}
+	if (ok)
+		FlushOutput(&z);
+
+	ReleaseStagingBuffer(z.out);
+	return ok;
+}
+
+/****************************************************************
+*																*
+*			    PNG												*
+*																*
+****************************************************************/
+
+static const unsigned char kPngSignature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+
+static const int kAdam7[7][4] = {   // x start, y start, x step, y step
+	{ 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 },
+	{ 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+
+struct PngDecoder {
+	int width, height;
+	int bitDepth, colorType, samples;
+	bool interlaced;
+	const unsigned char* palette;
+	int paletteSize;
+	const unsigned char* trns;
+	int trnsSize;
+
+	// IDAT walk
+	const unsigned char* chunk;
+	const unsigned char* end;
+	bool inIdat;
+
+	// Row assembly
+	unsigned char* dst;
+	int pitch;
+	unsigned char* cur;
+	unsigned char* prev;
+	int filterBytes;
+	int pass, passCount;
+	int passWidth, passHeight, passRow;
+	size_t rowBytes, filled;
+	bool done, error;
+};
+
+static bool PngNextIdat(void* user, const unsigned char** data, size_t* length)
+{
+	PngDecoder* png = (PngDecoder*) user;
+
+	while (png->end - png->chunk >= 12) {
+		unsigned long size = ReadBE32(png->chunk);
+		const unsigned char* type = png->chunk + 4;
+		if (size > (unsigned long) (png->end - png->chunk - 12))
+			return false;
+		const unsigned char* body = png->chunk + 8;
+		png->chunk += 12 + size;
+		if (memcmp(type, "IDAT", 4) == 0) {
+			png->inIdat = true;
+			*data = body;
+			*length = size;
+			return true;
+		}
+		if (png->inIdat)
+			return false;    // IDAT chunks must be consecutive
+	}
+	return false;
+}
+
+static unsigned PngSample(const unsigned char* row, int bitDepth, int index)
+{
+	if (bitDepth == 8)
+		return row[index];
+	if (bitDepth == 16)
+		return ReadBE16(row + 2 * index);
+	int bit = index * bitDepth;
+	return (row[bit >> 3] >> (8 - bitDepth - (bit & 7))) & ((1 << bitDepth) - 1);
+}
+
+static unsigned char PngTo8(unsigned value, int bitDepth)
+{
+	if (bitDepth == 16)
+		return (unsigned char) (value >> 8);
+	if (bitDepth == 8)
+		return (unsigned char) value;
+	return (unsigned char) (value * 255 / ((1 << bitDepth) - 1));
+}
+
+static void PngStartPass(PngDecoder* png)
+{
+	for (; png->pass < png->passCount; png->pass++) {
+		int xs = 0, ys = 0, xstep = 1, ystep = 1;
+		if (png->interlaced) {
+			xs = kAdam7[png->pass][0];
+			ys = kAdam7[png->pass][1];
+			xstep = kAdam7[png->pass][2];
+			ystep = kAdam7[png->pass][3];
+		}
+		png->passWidth = png->width > xs ? (png->width - xs + xstep - 1) / xstep : 0;
+		png->passHeight = png->height > ys ? (png->height - ys + ystep - 1) / ystep : 0;
+		if (png->passWidth > 0 && png->passHeight > 0) {
+			png->rowBytes = ((size_t) png->passWidth * png->samples * png->bitDepth + 7) / 8;
+			memset(png->prev, 0, png->rowBytes + 1);
+			png->passRow = 0;
+			png->filled = 0;
+			return;
+		}
+	}
+	png->done = true;
+}
+
+static void PngEmitRow(PngDecoder* png)
+{
+	const unsigned char* row = png->cur + 1;
+	int xs = 0, ys = 0, xstep = 1, ystep = 1;
+
+	if (png->interlaced) {
+		xs = kAdam7[png->pass][0];
+		ys = kAdam7[png->pass][1];
+		xstep = kAdam7[png->pass][2];
+		ystep = kAdam7[png->pass][3];
+	}
+	int y = ys + png->passRow * ystep;
+	unsigned char* out = png->dst + (size_t) (png->height - 1 - y) * png->pitch + 4 * xs;
+	int bd = png->bitDepth;
+
+	for (int i = 0; i < png->passWidth; i++, out += 4 * xstep) {
+		unsigned r, g, b, a = 255;
+		switch (png->colorType) {
+		case 0:
+			r = g = b = PngSample(row, bd, i);
+			if (png->trnsSize >= 2 && r == ReadBE16(png->trns))
+				a = 0;
+			out[0] = out[1] = out[2] = PngTo8(r, bd);
+			out[3] = (unsigned char) a;
+			break;
+		case 2:
+			r = PngSample(row, bd, 3 * i);
+			g = PngSample(row, bd, 3 * i + 1);
+			b = PngSample(row, bd, 3 * i + 2);
+			if (png->trnsSize >= 6 && r == ReadBE16(png->trns) &&
+				g == ReadBE16(png->trns + 2) && b == ReadBE16(png->trns + 4))
+				a = 0;
+			out[0] = PngTo8(r, bd);
+			out[1] = PngTo8(g, bd);
+			out[2] = PngTo8(b, bd);
+			out[3] = (unsigned char) a;
+			break;
+		case 3: {
+			unsigned index = PngSample(row, bd, i);
+			if ((int) index < png->paletteSize) {
+				out[0] = png->palette[3 * index];
+				out[1] = png->palette[3 * index + 1];
+				out[2] = png->palette[3 * index + 2];
+			} else {
+				out[0] = out[1] = out[2] = 0;
+			}
+			out[3] = (int) index < png->trnsSize ? png->trns[index] : 255;
+			break;
+		}
+		case 4:
+			out[0] = out[1] = out[2] = PngTo8(PngSample(row, bd, 2 * i), bd);
+			out[3] = PngTo8(PngSample(row, bd, 2 * i + 1), bd);
+			break;
+		case 6:
+			out[0] = PngTo8(PngSample(row, bd, 4 * i), bd);
+			out[1] = PngTo8(PngSample(row, bd, 4 * i + 1), bd);
+			out[2] = PngTo8(PngSample(row, bd, 4 * i + 2), bd);
+			out[3] = PngTo8(PngSample(row, bd, 4 * i + 3), bd);
+			break;
+		}
+	}
+}
+
+static bool PngUnfilter(PngDecoder* png)
+{
+	unsigned char* x = png->cur + 1;
+	const unsigned char* p = png->prev + 1;
+	size_t n = png->rowBytes;
+	size_t bpp = png->filterBytes;
+	size_t i;
+
+	switch (png->cur[0]) {
+	case 0:
+		break;
+	case 1:
+		for (i = bpp; i < n; i++)
+			x[i] = (unsigned char) (x[i] + x[i - bpp]);
+		break;
+	case 2:
+		for (i = 0; i < n; i++)
+			x[i] = (unsigned char) (x[i] + p[i]);
+		break;
+	case 3:
+		for (i = 0; i < bpp && i < n; i++)
+			x[i] = (unsigned char) (x[i] + (p[i] >> 1));
+		for (; i < n; i++)
+			x[i] = (unsigned char) (x[i] + ((x[i - bpp] + p[i]) >> 1));
+		break;
+	case 4:
+		for (i = 0; i < bpp && i < n; i++)
+			x[i] = (unsigned char) (x[i] + p[i]);
+		for (; i < n; i++) {
+			int a = x[i - bpp], b = p[i], c = p[i - bpp];
+			int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+			int predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+			x[i] = (unsigned char) (x[i] + predictor);
+		}
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+static bool PngSink(void* user, const unsigned char* data, size_t length)
+{
+	PngDecoder* png = (PngDecoder*) user;
+
+	while (length > 0 && !png->done) {
+		size_t n = png->rowBytes + 1 - png->filled;
+		if (n > length)
+			n = length;
+		memcpy(png->cur + png->filled, data, n);
+		png->filled += n;
+		data += n;
+		length -= n;
+		if (png->filled <= png->rowBytes)
+			continue;
+
+		if (!PngUnfilter(png)) {
+			png->error = true;
+			return false;
+		}
+		PngEmitRow(png);
+
+		unsigned char* swap = png->prev;
+		png->prev = png->cur;
+		png->cur = swap;
+		png->filled = 0;
+		if (++png->passRow == png->passHeight) {
+			png->pass++;
+			PngStartPass(png);
+		}
+	}
+	return !png->done;
+}
+
+// Reads IHDR and the PLTE/tRNS chunks ahead of the image data
+static bool PngParse(const unsigned char* data, size_t size, PngDecoder* png)
+{
+	memset(png, 0, sizeof(*png));
+	if (size < 8 + 25 || memcmp(data, kPngSignature, 8) != 0 ||
+		ReadBE32(data + 8) != 13 || memcmp(data + 12, "IHDR", 4) != 0)
+		return false;
+
+	const unsigned char* ihdr = data + 16;
+	png->width = (int) ReadBE32(ihdr);
+	png->height = (int) ReadBE32(ihdr + 4);
+	png->bitDepth = ihdr[8];
+	png->colorType = ihdr[9];
+	png->interlaced = ihdr[12] == 1;
+	if (png->width <= 0 || png->height <= 0 || ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] > 1)
+		return false;
+
+	int bd = png->bitDepth;
+	switch (png->colorType) {
+	case 0: png->samples = 1; if (bd != 1 && bd != 2 && bd != 4 && bd != 8 && bd != 16) return false; break;
+	case 3: png->samples = 1; if (bd != 1 && bd != 2 && bd != 4 && bd != 8) return false; break;
+	case 2: png->samples = 3; if (bd != 8 && bd != 16) return false; break;
+	case 4: png->samples = 2; if (bd != 8 && bd != 16) return false; break;
+	case 6: png->samples = 4; if (bd != 8 && bd != 16) return false; break;
+	default: return false;
+	}
+
+	png->end = data + size;
+	for (const unsigned char* p = data + 33; png->end - p >= 12; ) {
+		unsigned long length = ReadBE32(p);
+		if (length > (unsigned long) (png->end - p - 12))
+			return false;
+		if (memcmp(p + 4, "IDAT", 4) == 0) {
+			png->chunk = p;
+			break;
+		}
+		if (memcmp(p + 4, "PLTE", 4) == 0) {
+			png->palette = p + 8;
+			png->paletteSize = (int) (length / 3);
+		} else if (memcmp(p + 4, "tRNS", 4) == 0) {
+			png->trns = p + 8;
+			png->trnsSize = (int) length;
+		}
+		p += 12 + length;
+	}
+	return png->chunk != NULL && (png->colorType != 3 || png->palette != NULL);
+}
+
+static bool DecodePng(const ImageFile* image, unsigned char* dst, int pitch)
+{
+	PngDecoder png;
+
+	if (!PngParse(image->file.data, image->file.size, &png))
+		return false;
+
+	png.dst = dst;
+	png.pitch = pitch;
+	png.filterBytes = (png.samples * png.bitDepth + 7) / 8;
+	png.passCount = png.interlaced ? 7 : 1;
+
+	size_t maxRow = ((size_t) png.width * png.samples * png.bitDepth + 7) / 8 + 1;
+	unsigned char* rows = (unsigned char*) AcquireStagingBuffer(2 * maxRow);
+	if (rows == NULL)
+		return false;
+	png.cur = rows;
+	png.prev = rows + maxRow;
+	PngStartPass(&png);
+
+	bool ok = InflateZlib(PngNextIdat, &png, PngSink, &png);
+	ReleaseStagingBuffer(rows);
+	return ok && png.done && !png.error;
+}
+
+/****************************************************************
+*																*
+*			    TGA												*
+*																*
+****************************************************************/
+
+static void TgaPixel(const unsigned char* p, int depth, bool gray, unsigned char* out)
+{
+	if (gray) {
+		out[0] = out[1] = out[2] = p[0];
+		out[3] = depth == 16 ? p[1] : 255;
+		return;
+	}
+	switch (depth) {
+	case 15:
+	case 16: {
+		unsigned v = ReadLE16(p);
+		out[0] = (unsigned char) (((v >> 10) & 31) * 255 / 31);
+		out[1] = (unsigned char) (((v >> 5) & 31) * 255 / 31);
+		out[2] = (unsigned char) ((v & 31) * 255 / 31);
+		out[3] = 255;
+		break;
+	}
+	case 24:
+		out[0] = p[2];
+		out[1] = p[1];
+		out[2] = p[0];
+		out[3] = 255;
+		break;
+	case 32:
+		out[0] = p[2];
+		out[1] = p[1];
+		out[2] = p[0];
+		out[3] = p[3];
+		break;
+	}
+}
+
+static bool DecodeTga(const ImageFile* image, unsigned char* dst, int pitch)
+{
+	const unsigned char* data = image->file.data;
+	const unsigned char* end = data + image->file.size;
+	int type = data[2];
+	int cmapFirst = ReadLE16(data + 3);
+	int cmapLength = ReadLE16(data + 5);
+	int cmapDepth = data[7];
+	int depth = data[16];
+	bool topDown = (data[17] & 0x20) != 0;
+	bool alphaBits = (data[17] & 0x0f) != 0;
+	bool rle = type >= 9;
+	bool mapped = (type & 7) == 1;
+	bool gray = (type & 7) == 3;
+	int bytesPerPixel = (depth + 7) / 8;
+	int cmapBytes = (cmapDepth + 7) / 8;
+	const unsigned char* cmap = data + 18 + data[0];
+	const unsigned char* p = image->file.data + image->dataOffset;
+	int x = 0, y = 0;
+	unsigned char* out = dst + (size_t) (topDown ? image->height - 1 : 0) * pitch;
+
+	while (y < image->height) {
+		int run = 1;
+		bool repeat = false;
+		if (rle) {
+			if (p >= end)
+				return false;
+			run = (*p & 0x7f) + 1;
+			repeat = (*p & 0x80) != 0;
+			p++;
+		}
+		if (end - p < (repeat ? 1 : run) * bytesPerPixel)
+			return false;
+
+		for (int k = 0; k < run && y < image->height; k++) {
+			const unsigned char* pixel = repeat ? p : p + k * bytesPerPixel;
+			unsigned char* texel = out + 4 * x;
+			if (mapped) {
+				int index = (bytesPerPixel == 2 ? (int) ReadLE16(pixel) : pixel[0]) - cmapFirst;
+				if (index < 0 || index >= cmapLength)
+					return false;
+				TgaPixel(cmap + index * cmapBytes, cmapDepth, false, texel);
+			} else {
+				TgaPixel(pixel, depth, gray, texel);
+			}
+			if (depth == 32 && !alphaBits && !mapped)
+				texel[3] = 255;
+
+			if (++x == image->width) {
+				x = 0;
+				y++;
+				out = dst + (size_t) (topDown ? image->height - 1 - y : y) * pitch;
+			}
+		}
+		p += (repeat ? 1 : run) * bytesPerPixel;
+	}
+	return true;
+}
+
+static bool OpenTga(ImageFile* image)
+{
+	const unsigned char* data = image->file.data;
+	size_t size = image->file.size;
+
+	if (size < 18)
+		return false;
+	int type = data[2];
+	int depth = data[16];
+	int cmapDepth = data[7];
+	size_t offset = 18 + data[0];
+	if (data[1] == 1)
+		offset += (size_t) ReadLE16(data + 5) * ((cmapDepth + 7) / 8);
+	image->width = ReadLE16(data + 12);
+	image->height = ReadLE16(data + 14);
+	image->dataOffset = offset;
+
+	switch (type & ~8) {
+	case 1:
+		if (data[1] != 1 || (depth != 8 && depth != 16) ||
+			(cmapDepth != 15 && cmapDepth != 16 && cmapDepth != 24 && cmapDepth != 32))
+			return false;
+		image->channels = cmapDepth == 32 ? 4 : 3;
+		break;
+	case 2:
+		if (depth != 15 && depth != 16 && depth != 24 && depth != 32)
+			return false;
+		image->channels = depth == 32 ? 4 : 3;
+		break;
+	case 3:
+		if (depth != 8 && depth != 16)
+			return false;
+		image->channels = depth == 16 ? 2 : 1;
+		break;
+	default:
+		return false;
+	}
+	return image->width > 0 && image->height > 0 && offset <= size;
+}
+
+/****************************************************************
+*																*
+*			    PPM / PGM										*
+*																*
+****************************************************************/
+
+// Reads the next decimal number, skipping whitespace and # comments
+static bool PpmNumber(const unsigned char** pp, const unsigned char* end, int* value)
+{
+	const unsigned char* p = *pp;
+
+	for (;;) {
+		while (p < end && IsSpace(*p))
+			p++;
+		if (p < end && *p == '#') {
+			while (p < end && *p != '\n')
+				p++;
+			continue;
+		}
+		break;
+	}
+	if (p == end || *p < '0' || *p > '9')
+		return false;
+	*value = 0;
+	while (p < end && *p >= '0' && *p <= '9') {
+		*value = *value * 10 + (*p - '0');
+		if (*value > 0xffffff)
+			return false;
+		p++;
+	}
+	*pp = p;
+	return true;
+}
+
+static bool PpmHeader(const ImageFile* image, int* kind, int* width, int* height,
+	int* maxval, size_t* offset)
+{
+	const unsigned char* data = image->file.data;
+	const unsigned char* end = data + image->file.size;
+	const unsigned char* p = data + 2;
+
+	if (image->file.size < 3 || data[0] != 'P' || data[1] < '2' || data[1] > '6' || data[1] == '4')
+		return false;
+	*kind = data[1] - '0';
+	if (!PpmNumber(&p, end, width) || !PpmNumber(&p, end, height) ||
+		!PpmNumber(&p, end, maxval) || *maxval == 0 || *maxval > 65535)
+		return false;
+	// Exactly one whitespace byte separates the header from binary data
+	if (p == end || !IsSpace(*p))
+		return false;
+	*offset = (size_t) (p + 1 - data);
+	return *width > 0 && *height > 0;
+}
+
+static bool OpenPpm(ImageFile* image)
+{
+	int kind, maxval;
+
+	if (!PpmHeader(image, &kind, &image->width, &image->height, &maxval, &image->dataOffset))
+		return false;
+	image->channels = (kind == 3 || kind == 6) ? 3 : 1;
+	return true;
+}
+
+static bool DecodePpm(const ImageFile* image, unsigned char* dst, int pitch)
+{
+	int kind, width, height, maxval;
+	size_t offset;
+
+	if (!PpmHeader(image, &kind, &width, &height, &maxval, &offset))
+		return false;
+
+	const unsigned char* p = image->file.data + offset;
+	const unsigned char* end = image->file.data + image->file.size;
+	bool ascii = kind <= 3;
+	int channels = image->channels;
+	int sampleBytes = maxval < 256 ? 1 : 2;
+
+	if (!ascii && (size_t) (end - p) < (size_t) width * height * channels * sampleBytes)
+		return false;
+	if (ascii)
+		p--;   // PpmNumber skips the separator itself
+
+	for (int y = 0; y < height; y++) {
+		unsigned char* out = dst + (size_t) (height - 1 - y) * pitch;
+		for (int x = 0; x < width; x++, out += 4) {
+			for (int c = 0; c < channels; c++) {
+				int value;
+				if (ascii) {
+					if (!PpmNumber(&p, end, &value))
+						return false;
+				} else if (sampleBytes == 1) {
+					value = *p++;
+				} else {
+					value = (int) ReadBE16(p);
+					p += 2;
+				}
+				if (value > maxval)
+					value = maxval;
+				out[c] = (unsigned char) (maxval == 255 ? value : value * 255 / maxval);
+			}
+			if (channels == 1)
+				out[1] = out[2] = out[0];
+			out[3] = 255;
+		}
+	}
+	return true;
+}
+
+/****************************************************************
+*																*
+*			    SGI .rgb										*
+*																*
+****************************************************************/
+
+#define SGI_HEADER_SIZE 512
+
+static bool OpenSgi(ImageFile* image)
+{
+	const unsigned char* data = image->file.data;
+
+	if (image->file.size < SGI_HEADER_SIZE || ReadBE16(data) != 474)
+		return false;
+	int storage = data[2];
+	int bpc = data[3];
+	int dimension = ReadBE16(data + 4);
+	image->width = ReadBE16(data + 6);
+	image->height = dimension >= 2 ? ReadBE16(data + 8) : 1;
+	image->channels = dimension >= 3 ? ReadBE16(data + 10) : 1;
+	image->dataOffset = SGI_HEADER_SIZE;
+	if (image->channels > 4)
+		image->channels = 4;
+	return storage <= 1 && (bpc == 1 || bpc == 2) && dimension >= 1 && dimension <= 3 &&
+		ReadBE32(data + 104) == 0 && image->width > 0 && image->height > 0 &&
+		image->channels > 0;
+}
+
+// Stores one channel value; gray images fan channel 0 out to R, G and B
+static void SgiPut(unsigned char* texel, int component, bool gray, unsigned char value)
+{
+	if (gray)
+		texel[0] = texel[1] = texel[2] = value;
+	else
+		texel[component] = value;
+}
+
+static bool SgiRleRow(const unsigned char* p, const unsigned char* end, int bpc,
+	unsigned char* out, int width, int component, bool gray)
+{
+	int x = 0;
+
+	while (end - p >= bpc) {
+		unsigned pixel = bpc == 1 ? p[0] : ReadBE16(p);
+		int count = pixel & 0x7f;
+		p += bpc;
+		if (count == 0)
+			break;
+		if (x + count > width)
+			return false;
+		if (pixel & 0x80) {
+			if (end - p < count * bpc)
+				return false;
+			for (; count > 0; count--, x++, p += bpc)
+				SgiPut(out + 4 * x, component, gray, p[0]);   // high byte for 16 bit data
+		} else {
+			if (end - p < bpc)
+				return false;
+			unsigned char value = p[0];   // high byte for 16 bit data
+			p += bpc;
+			for (; count > 0; count--, x++)
+				SgiPut(out + 4 * x, component, gray, value);
+		}
+	}
+	return x == width;
+}
+
+static bool DecodeSgi(const ImageFile* image, unsigned char* dst, int pitch)
+{
+	const unsigned char* data = image->file.data;
+	size_t size = image->file.size;
+	bool rle = data[2] == 1;
+	int bpc = data[3];
+	int channels = image->channels;
+	int width = image->width, height = image->height;
+	size_t tableSize = (size_t) height * channels * 4;
+
+	if (rle && size < SGI_HEADER_SIZE + 2 * tableSize)
+		return false;
+	if (!rle && size < SGI_HEADER_SIZE + (size_t) width * height * channels * bpc)
+		return false;
+
+	// Channels without data in the file
+	if (channels != 2 && channels != 4) {
+		for (int y = 0; y < height; y++) {
+			unsigned char* out = dst + (size_t) y * pitch;
+			for (int x = 0; x < width; x++)
+				out[4 * x + 3] = 255;
+		}
+	}
+
+	// Planar storage, bottom row first: the row order already matches GL
+	for (int c = 0; c < channels; c++) {
+		bool gray = c == 0 && channels <= 2;
+		int component = (channels == 2 && c == 1) ? 3 : c;
+		for (int y = 0; y < height; y++) {
+			unsigned char* out = dst + (size_t) y * pitch;
+			size_t row = (size_t) c * height + y;
+			if (rle) {
+				unsigned long start = ReadBE32(data + SGI_HEADER_SIZE + 4 * row);
+				unsigned long length = ReadBE32(data + SGI_HEADER_SIZE + tableSize + 4 * row);
+				if (start > size || length > size - start)
+					return false;
+				if (!SgiRleRow(data + start, data + start + length, bpc, out, width, component, gray))
+					return false;
+			} else {
+				const unsigned char* p = data + SGI_HEADER_SIZE + row * width * bpc;
+				for (int x = 0; x < width; x++, p += bpc)
+					SgiPut(out + 4 * x, component, gray, p[0]);
+			}
+		}
+	}
+	return true;
+}
+
+/****************************************************************
+*																*
+*			    Entry points									*
+*																*
+****************************************************************/
+
+bool OpenImage(ImageFile* image, const char* path)
+{
+	memset(image, 0, sizeof(*image));
+	if (!MapFile(&image->file, path))
+		return false;
+
+	const unsigned char* data = image->file.data;
+	size_t size = image->file.size;
+	bool ok = false;
+
+	if (size >= 8 && memcmp(data, kPngSignature, 8) == 0) {
+		PngDecoder png;
+		image->format = IMAGE_PNG;
+		if (PngParse(data, size, &png)) {
+			static const int channels[7] = { 1, 0, 3, 3, 2, 0, 4 };
+			image->width = png.width;
+			image->height = png.height;
+			image->channels = channels[png.colorType];
+			if (png.colorType == 3 && png.trns != NULL)
+				image->channels = 4;
+			image->dataOffset = (size_t) (png.chunk - data);
+			ok = true;
+		}
+	} else if (size >= 2 && ReadBE16(data) == 474) {
+		image->format = IMAGE_SGI;
+		ok = OpenSgi(image);
+	} else if (size >= 2 && data[0] == 'P' && data[1] >= '2' && data[1] <= '6') {
+		image->format = IMAGE_PPM;
+		ok = OpenPpm(image);
+	} else {
+		// TGA has no signature; it is the fallback
+		image->format = IMAGE_TGA;
+		ok = OpenTga(image);
+	}
+
+	if (!ok)
+		CloseImage(image);
+	return ok;
+}
+
+void CloseImage(ImageFile* image)
+{
+	UnmapFile(&image->file);
+	image->format = IMAGE_UNKNOWN;
+}
+
+bool DecodeImage(const ImageFile* image, unsigned char* dst, int pitch)
+{
+	switch (image->format) {
+	case IMAGE_PNG: return DecodePng(image, dst, pitch);
+	case IMAGE_TGA: return DecodeTga(image, dst, pitch);
+	case IMAGE_PPM: return DecodePpm(image, dst, pitch);
+	case IMAGE_SGI: return DecodeSgi(image, dst, pitch);
+	default:        return false;
+	}
+}
+
+void GenerateImageTexture(int y0, int rows, int width, int height,
+	unsigned char* dst, void* user)
+{
+	const ImageFile* image = (const ImageFile*) user;
+
+	if (y0 == 0 && rows == image->height && width == image->width &&
+		DecodeImage(image, dst, width * 4))
+		return;
+
+	// Unreadable data shows up as magenta rather than garbage
+	for (int i = 0; i < rows * width; i++, dst += 4) {
+		dst[0] = 255;
+		dst[1] = 0;
+		dst[2] = 255;
+		dst[3] = 255;
+	}
+}
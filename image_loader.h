@@ -0,0 +1,44 @@
+// image_loader.h
+//
+// Native loaders for PNG, TGA, PPM/PGM and SGI .rgb images. Files are memory
+// mapped and decoded one row at a time straight into the caller's RGBA8
+// buffer (for example a streaming slot or staging buffer); no full-size
+// intermediate copy is made. Rows are written bottom row first, which is the
+// order glTexImage2D expects. The loaders keep no global state, so any
+// number of images can be decoded concurrently on worker threads.
+
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include "platform.h"
+
+enum ImageFormat {
+	IMAGE_UNKNOWN,
+	IMAGE_PNG,
+	IMAGE_TGA,
+	IMAGE_PPM,
+	IMAGE_SGI
+};
+
+struct ImageFile {
+	MappedFile file;
+	ImageFormat format;
+	int width, height;
+	int channels;           // in the file: 1 gray, 2 gray+alpha, 3 RGB, 4 RGBA
+	size_t dataOffset;      // first byte after the header
+};
+
+// Maps path and parses its header; format is detected from the contents
+bool OpenImage(ImageFile* image, const char* path);
+void CloseImage(ImageFile* image);
+
+// Decodes the whole image as RGBA8 into dst, pitch bytes between rows.
+// Returns false on a truncated or corrupt file.
+bool DecodeImage(const ImageFile* image, unsigned char* dst, int pitch);
+
+// TextureGenerator for texture_stream.h; user is an open ImageFile. The
+// streamer always asks for the whole image in one call.
+void GenerateImageTexture(int y0, int rows, int width, int height,
+	unsigned char* dst, void* user);
+
+#endif
@@ -0,0 +1,115 @@
+// input.cpp
+//
+// Single producer, single consumer ring as in simulation.cpp. A full ring
+// drops the new event and counts it; at one drain per frame that takes
+// hundreds of events within a single frame.
+
+#include "input.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include "platform.h"
+
+#define INPUT_QUEUE_SIZE  256   // power of two
+
+static InputEvent g_inputEvents[INPUT_QUEUE_SIZE];
+static volatile long g_inputHead = 0;     // written by the callbacks
+static volatile long g_inputTail = 0;     // written by the frame loop
+static double g_keyHeldSince[256];        // frame loop only
+
+// Cumulative
+static volatile long g_inputPosted = 0;
+static volatile long g_inputDropped = 0;
+static long g_inputCoalesced = 0;
+static long g_inputDrains = 0;
+
+static void PostEvent(InputEventType type, int key, int state, int x, int y)
+{
+	long head = AtomicLoad(&g_inputHead);
+
+	if (head - AtomicLoad(&g_inputTail) >= INPUT_QUEUE_SIZE) {
+		AtomicIncrement(&g_inputDropped);
+		return;
+	}
+	InputEvent* event = &g_inputEvents[head & (INPUT_QUEUE_SIZE - 1)];
+	event->type = type;
+	event->key = key;
+	event->state = state;
+	event->x = x;
+	event->y = y;
+	event->time = GetTimeSeconds();
+	AtomicStore(&g_inputHead, head + 1);
+	AtomicIncrement(&g_inputPosted);
+}
+
+void PostKeyEvent(InputEventType type, unsigned char key, int x, int y)
+{
+	PostEvent(type, key, 0, x, y);
+}
+
+void PostMouseButtonEvent(int button, int state, int x, int y)
+{
+	PostEvent(INPUT_MOUSE_BUTTON, button, state, x, y);
+}
+
+void PostMouseMotionEvent(int x, int y)
+{
+	PostEvent(INPUT_MOUSE_MOTION, 0, 0, x, y);
+}
+
+void PostKeysReleasedEvent(void)
+{
+	PostEvent(INPUT_KEYS_RELEASED, 0, 0, 0, 0);
+}
+
+unsigned char UnshiftedKey(unsigned char key)
+{
+	static const char shifted[] = "~!@#$%^&*()_+{}|:\"<>?";
+	static const char unshifted[] = "`1234567890-=[]\\;',./";
+
+	const char* found = key != 0 ? strchr(shifted, key) : NULL;
+	if (found != NULL)
+		return (unsigned char) unshifted[found - shifted];
+	return (unsigned char) tolower(key);
+}
+
+int DrainInputEvents(InputEvent* events, int maxEvents)
+{
+	long head = AtomicLoad(&g_inputHead);
+	long tail = g_inputTail;
+	int count = 0;
+
+	for (; tail != head && count < maxEvents; tail++) {
+		const InputEvent* event = &g_inputEvents[tail & (INPUT_QUEUE_SIZE - 1)];
+		// Only the latest of consecutive motion events matters
+		if (event->type == INPUT_MOUSE_MOTION && count > 0 &&
+			events[count - 1].type == INPUT_MOUSE_MOTION) {
+			events[count - 1] = *event;
+			g_inputCoalesced++;
+			continue;
+		}
+		unsigned char key = UnshiftedKey((unsigned char) event->key);
+		if (event->type == INPUT_KEY_DOWN && g_keyHeldSince[key] == 0)
+			g_keyHeldSince[key] = event->time;
+		else if (event->type == INPUT_KEY_UP)
+			g_keyHeldSince[key] = 0;
+		else if (event->type == INPUT_KEYS_RELEASED)
+			memset(g_keyHeldSince, 0, sizeof(g_keyHeldSince));
+		events[count++] = *event;
+	}
+	AtomicStore(&g_inputTail, tail);
+	g_inputDrains++;
+	return count;
+}
+
+double GetKeyHeldSince(unsigned char key)
+{
+	return g_keyHeldSince[UnshiftedKey(key)];
+}
+
+void PrintInputStats(FILE* out)
+{
+	fprintf(out, "Input: %ld events over %ld frames, %ld motion events coalesced, %ld dropped\n",
+		AtomicLoad(&g_inputPosted), g_inputDrains, g_inputCoalesced, AtomicLoad(&g_inputDropped));
+}
@@ -0,0 +1,50 @@
+// input.h
+//
+// Timestamped input events. The GLUT callbacks only record what happened
+// and when into a lock-free ring; the frame loop drains it once per frame,
+// so input costs the same however many events the window system delivers
+// between frames. Runs of mouse motion are coalesced into their last
+// position on the way out.
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+
+enum InputEventType {
+	INPUT_KEY_DOWN,
+	INPUT_KEY_UP,
+	INPUT_MOUSE_BUTTON,
+	INPUT_MOUSE_MOTION,
+	INPUT_KEYS_RELEASED   // focus or visibility lost; no key up will follow
+};
+
+struct InputEvent {
+	InputEventType type;
+	int key;              // character, or GLUT mouse button
+	int state;            // GLUT_DOWN / GLUT_UP for buttons
+	int x, y;
+	double time;          // GetTimeSeconds() when the callback ran
+};
+
+// From the GLUT callbacks
+void PostKeyEvent(InputEventType type, unsigned char key, int x, int y);
+void PostMouseButtonEvent(int button, int state, int x, int y);
+void PostMouseMotionEvent(int x, int y);
+void PostKeysReleasedEvent(void);
+
+// Copies out up to maxEvents pending events, oldest first; returns the count
+int DrainInputEvents(InputEvent* events, int maxEvents);
+
+// Shift may change while a key is held, and the key up then reports the
+// other character; held keys are tracked by what the key gives unshifted
+// (US layout)
+unsigned char UnshiftedKey(unsigned char key);
+
+// Timestamp of the drained key down for a key still held, else 0, by
+// UnshiftedKey()
+double GetKeyHeldSince(unsigned char key);
+
+void PrintInputStats(FILE* out);
+
+#endif
@@ -0,0 +1,322 @@
+// job_system.cpp
+//
+// The deques are the Chase-Lev kind with a fixed capacity: the owner moves
+// bottom without contention and only races thieves, through a compare
+// exchange on top, for the last job. The platform atomics are full
+// barriers, which covers the ordering the algorithm needs. A full deque or
+// shared queue runs the job inline instead. Idle workers spin briefly,
+// then sleep on an event that each submission signals.
+
+#include "job_system.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+
+#define JOB_DEQUE_SIZE     1024   // power of two
+#define JOB_SHARED_SIZE    1024
+#define JOB_SPIN_ROUNDS    64
+#define JOB_MAX_RANGES     256    // ParallelFor jobs per call
+
+#ifdef _WIN32
+#	define JOB_THREAD_LOCAL __declspec(thread)
+#else
+#	define JOB_THREAD_LOCAL __thread
+#endif
+
+struct JobEntry {
+	JobFunc func;
+	void* data;
+	JobCounter* counter;
+};
+
+struct JobDeque {
+	volatile long top;              // thieves take from here
+	volatile long bottom;           // the owner pushes and pops here
+	JobEntry entries[JOB_DEQUE_SIZE];
+};
+
+struct JobWorker {
+	JobDeque deque;
+	Thread thread;
+	int index;
+	volatile long executed;
+	volatile long stolen;
+};
+
+struct ParallelForRange {
+	ParallelForFunc func;
+	void* user;
+	int begin, end;
+};
+
+static JobWorker* g_workers = NULL;     // [0] is the thread that called Init
+static int g_workerCount = 0;           // including [0]
+static volatile long g_jobQuit = 0;
+static Event g_jobEvent;
+
+static JobEntry g_shared[JOB_SHARED_SIZE];
+static int g_sharedHead = 0, g_sharedCount = 0;
+static volatile long g_sharedPending = 0;
+static Mutex g_sharedMutex;
+static volatile long g_sharedExecuted = 0;
+
+static JOB_THREAD_LOCAL int t_workerIndex = -1;
+
+static bool PushJob(JobDeque* deque, const JobEntry* job)
+{
+	long bottom = deque->bottom;
+
+	if (bottom - AtomicLoad(&deque->top) >= JOB_DEQUE_SIZE)
+		return false;
+	deque->entries[bottom & (JOB_DEQUE_SIZE - 1)] = *job;
+	AtomicStore(&deque->bottom, bottom + 1);
+	return true;
+}
+
+static bool PopJob(JobDeque* deque, JobEntry* job)
+{
+	long bottom = deque->bottom - 1;
+
+	AtomicStore(&deque->bottom, bottom);
+	long top = AtomicLoad(&deque->top);
+	if (top > bottom) {
+		AtomicStore(&deque->bottom, bottom + 1);
+		return false;
+	}
+	*job = deque->entries[bottom & (JOB_DEQUE_SIZE - 1)];
+	if (top == bottom) {
+		// Last job: whoever moves top first gets it
+		bool won = AtomicCompareExchange(&deque->top, top + 1, top) == top;
+		AtomicStore(&deque->bottom, bottom + 1);
+		return won;
+	}
+	return true;
+}
+
+static bool StealJob(JobDeque* deque, JobEntry* job)
+{
+	long top = AtomicLoad(&deque->top);
+
+	if (top >= AtomicLoad(&deque->bottom))
+		return false;
+	*job = deque->entries[top & (JOB_DEQUE_SIZE - 1)];
+	return AtomicCompareExchange(&deque->top, top + 1, top) == top;
+}
+
+static bool PushSharedJob(const JobEntry* job)
+{
+	bool pushed = false;
+
+	MutexLock(&g_sharedMutex);
+	if (g_sharedCount < JOB_SHARED_SIZE) {
+		g_shared[(g_sharedHead + g_sharedCount) % JOB_SHARED_SIZE] = *job;
+		g_sharedCount++;
+		AtomicIncrement(&g_sharedPending);
+		pushed = true;
+	}
+	MutexUnlock(&g_sharedMutex);
+	return pushed;
+}
+
+static bool PopSharedJob(JobEntry* job)
+{
+	bool popped = false;
+
+	if (AtomicLoad(&g_sharedPending) == 0)
+		return false;
+	MutexLock(&g_sharedMutex);
+	if (g_sharedCount > 0) {
+		*job = g_shared[g_sharedHead];
+		g_sharedHead = (g_sharedHead + 1) % JOB_SHARED_SIZE;
+		g_sharedCount--;
+		AtomicDecrement(&g_sharedPending);
+		popped = true;
+	}
+	MutexUnlock(&g_sharedMutex);
+	return popped;
+}
+
+static void ExecuteJob(const JobEntry* job)
+{
+	job->func(job->data);
+	if (job->counter != NULL)
+		AtomicDecrement(job->counter);
+}
+
+// Own deque first, then the shared queue, then the other deques
+static bool FindJob(int self, JobEntry* job)
+{
+	if (self >= 0 && PopJob(&g_workers[self].deque, job))
+		return true;
+	if (PopSharedJob(job))
+		return true;
+	for (int i = 1; i <= g_workerCount; i++) {
+		int victim = (self + i + g_workerCount) % g_workerCount;
+		if (victim != self && StealJob(&g_workers[victim].deque, job)) {
+			if (self >= 0)
+				AtomicIncrement(&g_workers[self].stolen);
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool RunOneJob(int self)
+{
+	JobEntry job;
+
+	if (!FindJob(self, &job))
+		return false;
+	ExecuteJob(&job);
+	if (self >= 0)
+		AtomicIncrement(&g_workers[self].executed);
+	else
+		AtomicIncrement(&g_sharedExecuted);
+	return true;
+}
+
+static void JobWorkerThread(void* arg)
+{
+	JobWorker* worker = (JobWorker*) arg;
+	int idle = 0;
+
+	t_workerIndex = worker->index;
+	while (!AtomicLoad(&g_jobQuit)) {
+		if (RunOneJob(worker->index)) {
+			// There may be more; pass the wakeup on
+			if (idle >= JOB_SPIN_ROUNDS)
+				EventSignal(&g_jobEvent);
+			idle = 0;
+		} else if (++idle >= JOB_SPIN_ROUNDS) {
+			EventWait(&g_jobEvent, 1);
+		}
+	}
+}
+
+void InitJobSystem(int workers)
+{
+	if (g_workers != NULL)
+		return;
+	if (workers < 0)
+		workers = GetProcessorCount() - 1;
+	if (workers > JOB_MAX_WORKERS - 1)
+		workers = JOB_MAX_WORKERS - 1;
+	if (workers <= 0)
+		return;
+
+	MutexInit(&g_sharedMutex);
+	EventInit(&g_jobEvent);
+	g_workers = (JobWorker*) calloc(workers + 1, sizeof(JobWorker));
+	g_workerCount = 1;
+	t_workerIndex = 0;
+	for (int i = 1; i <= workers; i++) {
+		g_workers[i].index = i;
+		if (!ThreadStart(&g_workers[i].thread, JobWorkerThread, &g_workers[i]))
+			break;
+		g_workerCount++;
+	}
+}
+
+void ShutdownJobSystem(void)
+{
+	if (g_workers == NULL)
+		return;
+
+	AtomicStore(&g_jobQuit, 1);
+	for (int i = 1; i < g_workerCount; i++)
+		EventSignal(&g_jobEvent);
+	for (int i = 1; i < g_workerCount; i++)
+		ThreadJoin(&g_workers[i].thread);
+
+	free(g_workers);
+	g_workers = NULL;
+	g_workerCount = 0;
+	t_workerIndex = -1;
+	EventDestroy(&g_jobEvent);
+	MutexDestroy(&g_sharedMutex);
+}
+
+int GetJobWorkerCount(void)
+{
+	return g_workerCount;
+}
+
+void RunJobs(const Job* jobs, int count, JobCounter* counter)
+{
+	if (counter != NULL)
+		AtomicAdd(counter, count);
+
+	for (int i = 0; i < count; i++) {
+		JobEntry entry = { jobs[i].func, jobs[i].data, counter };
+		bool queued = false;
+		if (g_workerCount > 1) {
+			queued = t_workerIndex >= 0 ? PushJob(&g_workers[t_workerIndex].deque, &entry) :
+				PushSharedJob(&entry);
+		}
+		if (!queued)
+			ExecuteJob(&entry);
+	}
+	if (g_workerCount > 1)
+		EventSignal(&g_jobEvent);
+}
+
+void WaitForCounter(JobCounter* counter)
+{
+	while (AtomicLoad(counter) > 0) {
+		// Whatever is left is running on other threads
+		if (g_workerCount <= 1 || !RunOneJob(t_workerIndex))
+			SleepMs(0);
+	}
+}
+
+static void ParallelForJob(void* data)
+{
+	ParallelForRange* range = (ParallelForRange*) data;
+	range->func(range->begin, range->end, range->user);
+}
+
+void ParallelFor(int count, int grain, ParallelForFunc func, void* user)
+{
+	ParallelForRange ranges[JOB_MAX_RANGES];
+	Job jobs[JOB_MAX_RANGES];
+	JobCounter counter = 0;
+
+	if (count <= 0)
+		return;
+	if (grain <= 0)
+		grain = count / ((g_workerCount > 0 ? g_workerCount : 1) * 4) + 1;
+	if ((count + grain - 1) / grain > JOB_MAX_RANGES)
+		grain = (count + JOB_MAX_RANGES - 1) / JOB_MAX_RANGES;
+	if (g_workerCount <= 1 || grain >= count) {
+		func(0, count, user);
+		return;
+	}
+
+	int jobCount = 0;
+	for (int begin = 0; begin < count; begin += grain, jobCount++) {
+		ranges[jobCount].func = func;
+		ranges[jobCount].user = user;
+		ranges[jobCount].begin = begin;
+		ranges[jobCount].end = begin + grain < count ? begin + grain : count;
+		jobs[jobCount].func = ParallelForJob;
+		jobs[jobCount].data = &ranges[jobCount];
+	}
+	RunJobs(jobs, jobCount, &counter);
+	WaitForCounter(&counter);
+}
+
+void PrintJobStats(FILE* out)
+{
+	if (g_workerCount <= 1) {
+		fprintf(out, "Jobs: no worker threads, running inline\n");
+		return;
+	}
+	fprintf(out, "Jobs: %d threads, %ld run by other threads\n", g_workerCount,
+		AtomicLoad(&g_sharedExecuted));
+	for (int i = 0; i < g_workerCount; i++) {
+		fprintf(out, "  thread %d: %ld run, %ld stolen\n", i,
+			AtomicLoad(&g_workers[i].executed), AtomicLoad(&g_workers[i].stolen));
+	}
+}
@@ -0,0 +1,47 @@
+// job_system.h
+//
+// Small jobs spread over every core. Each worker thread, and the thread
+// that called InitJobSystem, owns a work-stealing deque: it pushes and
+// pops its own jobs at one end while idle workers steal from the other.
+// Other threads (the texture streaming thread) submit through a shared
+// queue. A JobCounter counts a batch's unfinished jobs; waiting on it runs
+// other jobs meanwhile, so jobs can wait on jobs they started without
+// tying up a thread. Jobs must not touch OpenGL.
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdio.h>
+
+#define JOB_MAX_WORKERS 32
+
+typedef void (*JobFunc)(void* data);
+typedef void (*ParallelForFunc)(int begin, int end, void* user);
+
+struct Job {
+	JobFunc func;
+	void* data;
+};
+
+// Unfinished jobs; start at zero
+typedef volatile long JobCounter;
+
+// A negative count starts one worker per core besides the calling thread.
+// Until this is called, and with no workers, jobs run on the caller.
+void InitJobSystem(int workers);
+void ShutdownJobSystem(void);
+int GetJobWorkerCount(void);
+
+// Adds count to counter (which may be NULL) and queues the jobs; each
+// decrements it when done
+void RunJobs(const Job* jobs, int count, JobCounter* counter);
+// Runs queued jobs until counter reaches zero
+void WaitForCounter(JobCounter* counter);
+
+// Calls func over [0, count) in ranges of about grain items (0 picks a
+// size giving each thread a few) and returns when all are done
+void ParallelFor(int count, int grain, ParallelForFunc func, void* user);
+
+void PrintJobStats(FILE* out);
+
+#endif
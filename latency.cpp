@@ -0,0 +1,178 @@
+// latency.cpp
+//
+// Timer queries give the GPU time the frame's commands completed; the
+// offset to GetTimeSeconds() is sampled with glGetInteger64v(GL_TIMESTAMP)
+// when the query is issued. Fences only say a frame is done by the time
+// they are polled, once per frame, so they overstate latency by up to a
+// frame. Without either, the time glutSwapBuffers returned is recorded,
+// which leaves out the GPU entirely.
+
+#include "latency.h"
+#include "gl_extensions.h"
+#include "platform.h"
+
+#include <string.h>
+
+#define LATENCY_PENDING    8     // frames measured at once
+#define LATENCY_BUCKET_MS  2
+#define LATENCY_BUCKETS    50    // plus one for everything slower
+
+enum {
+	LATENCY_TIMER,
+	LATENCY_FENCE,
+	LATENCY_SWAP
+};
+
+struct PendingFrame {
+	bool used;
+	double inputTime;
+	GLuint query;          // timer mode
+	double gpuOffset;      // GetTimeSeconds() minus GPU time, in seconds
+	GLsync fence;          // fence mode
+};
+
+static int g_latencyMode = LATENCY_SWAP;
+static PendingFrame g_pendingFrames[LATENCY_PENDING];
+
+// Cumulative
+static long g_latencyHistogram[LATENCY_BUCKETS + 1];
+static long g_latencyCount = 0;
+static long g_latencySkipped = 0;       // no free pending slot
+static double g_latencySum = 0;
+static double g_latencyMin = 0, g_latencyMax = 0;
+
+static void RecordLatency(double seconds)
+{
+	if (seconds < 0)
+		seconds = 0;
+	int bucket = (int) (seconds * 1000 / LATENCY_BUCKET_MS);
+	if (bucket > LATENCY_BUCKETS)
+		bucket = LATENCY_BUCKETS;
+	g_latencyHistogram[bucket]++;
+	if (g_latencyCount == 0 || seconds < g_latencyMin)
+		g_latencyMin = seconds;
+	if (g_latencyCount == 0 || seconds > g_latencyMax)
+		g_latencyMax = seconds;
+	g_latencySum += seconds;
+	g_latencyCount++;
+}
+
+// Records every pending frame the GPU has finished
+static void PollPendingFrames(void)
+{
+	for (int i = 0; i < LATENCY_PENDING; i++) {
+		PendingFrame* frame = &g_pendingFrames[i];
+		if (!frame->used)
+			continue;
+
+		if (g_latencyMode == LATENCY_TIMER) {
+			GLint available = 0;
+			GLuint64 gpuTime = 0;
+			glGetQueryObjectiv(frame->query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+			glGetQueryObjectui64v(frame->query, GL_QUERY_RESULT, &gpuTime);
+			RecordLatency(gpuTime * 1e-9 + frame->gpuOffset - frame->inputTime);
+		} else {
+			GLenum status = glClientWaitSync(frame->fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				continue;
+			RecordLatency(GetTimeSeconds() - frame->inputTime);
+			glDeleteSync(frame->fence);
+			frame->fence = NULL;
+		}
+		frame->used = false;
+	}
+}
+
+void InitLatencyTracking(void)
+{
+	memset(g_pendingFrames, 0, sizeof(g_pendingFrames));
+	if (g_glCaps.timerQuery) {
+		g_latencyMode = LATENCY_TIMER;
+		for (int i = 0; i < LATENCY_PENDING; i++)
+			glGenQueries(1, &g_pendingFrames[i].query);
+	} else if (g_glCaps.sync) {
+		g_latencyMode = LATENCY_FENCE;
+	} else {
+		g_latencyMode = LATENCY_SWAP;
+	}
+}
+
+void EndLatencyFrame(double inputTime)
+{
+	PendingFrame* frame = NULL;
+
+	if (g_latencyMode != LATENCY_SWAP)
+		PollPendingFrames();
+	if (inputTime <= 0)
+		return;
+
+	if (g_latencyMode == LATENCY_SWAP) {
+		RecordLatency(GetTimeSeconds() - inputTime);
+		return;
+	}
+
+	for (int i = 0; i < LATENCY_PENDING && frame == NULL; i++) {
+		if (!g_pendingFrames[i].used)
+			frame = &g_pendingFrames[i];
+	}
+	if (frame == NULL) {
+		g_latencySkipped++;
+		return;
+	}
+
+	frame->used = true;
+	frame->inputTime = inputTime;
+	if (g_latencyMode == LATENCY_TIMER) {
+		GLint64 gpuNow = 0;
+		glQueryCounter(frame->query, GL_TIMESTAMP);
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		frame->gpuOffset = GetTimeSeconds() - gpuNow * 1e-9;
+	} else {
+		frame->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+// Upper edge of the bucket holding the given fraction of samples
+static double LatencyPercentile(double fraction)
+{
+	long target = (long) (fraction * g_latencyCount + 0.5), seen = 0;
+
+	for (int i = 0; i <= LATENCY_BUCKETS; i++) {
+		seen += g_latencyHistogram[i];
+		if (seen >= target && seen > 0)
+			return i < LATENCY_BUCKETS ? (i + 1) * LATENCY_BUCKET_MS : g_latencyMax * 1000;
+	}
+	return 0;
+}
+
+void PrintLatencyStats(FILE* out)
+{
+	static const char* modeNames[] = { "GPU timestamps", "fences", "swap return, no GPU" };
+
+	fprintf(out, "Input latency (%s): %ld frames", modeNames[g_latencyMode], g_latencyCount);
+	if (g_latencyCount == 0) {
+		fprintf(out, "\n");
+		return;
+	}
+	fprintf(out, ", mean %.1f ms, min %.1f, max %.1f, p50 <%.0f, p95 <%.0f, p99 <%.0f",
+		g_latencySum / g_latencyCount * 1000, g_latencyMin * 1000, g_latencyMax * 1000,
+		LatencyPercentile(0.5), LatencyPercentile(0.95), LatencyPercentile(0.99));
+	if (g_latencySkipped > 0)
+		fprintf(out, ", %ld not measured", g_latencySkipped);
+	fprintf(out, "\n");
+
+	for (int i = 0; i <= LATENCY_BUCKETS; i++) {
+		if (g_latencyHistogram[i] == 0)
+			continue;
+		if (i < LATENCY_BUCKETS)
+			fprintf(out, "  %3d-%3d ms ", i * LATENCY_BUCKET_MS, (i + 1) * LATENCY_BUCKET_MS);
+		else
+			fprintf(out, "  %3d+    ms ", i * LATENCY_BUCKET_MS);
+		int width = (int) (60 * g_latencyHistogram[i] / g_latencyCount);
+		for (int j = 0; j < width || j == 0; j++)
+			fputc('#', out);
+		fprintf(out, " %ld\n", g_latencyHistogram[i]);
+	}
+}
@@ -0,0 +1,23 @@
+// latency.h
+//
+// Input-to-photon latency. Each frame reports the timestamp of the newest
+// input event it is the first to show; after glutSwapBuffers a GPU
+// timestamp query (or failing that a fence) marks when the frame finished
+// rendering, and the difference goes into a histogram. Scanout adds up to
+// one refresh on top, which no query can see.
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+
+// After InitGLExtensions
+void InitLatencyTracking(void);
+
+// Right after glutSwapBuffers. inputTime is a GetTimeSeconds() timestamp,
+// or 0 if the frame shows no new input.
+void EndLatencyFrame(double inputTime);
+
+void PrintLatencyStats(FILE* out);
+
+#endif
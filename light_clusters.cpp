@@ -0,0 +1,290 @@
+// light_clusters.cpp
+//
+// Cluster (x, y, z) is entry (z * CLUSTER_Y + y) * CLUSTER_X + x. Slice z
+// covers eye depths near * (far / near)^(z / CLUSTER_Z) onwards, so the
+// shader finds it as log(depth) * scale - bias.
+
+#include "light_clusters.h"
+#include "gl_state.h"
+#include "platform.h"
+#include "shader.h"
+
+#include <math.h>
+#include <string.h>
+
+// Mirrors the std140 Clusters block
+struct ClusterBlock {
+	float scale[4];                // x, y unused; z slices per log depth; w log(near) * z
+	int count[4];                  // clusters across, up, deep; lights this frame
+};
+
+struct ClusterBounds {
+	int x0, x1, y0, y1, z0, z1;    // inclusive
+	float screen[4];               // NDC x0, y0, x1, y1, on the screen
+};
+
+enum {
+	BUFFER_RANGES,
+	BUFFER_INDICES,
+	BUFFER_LIGHTS,
+	CLUSTER_BUFFERS
+};
+
+static bool g_clustersEnabled = false;
+static GLuint g_blockBuffer = 0;
+static GLuint g_buffers[CLUSTER_BUFFERS];
+static GLuint g_textures[CLUSTER_BUFFERS];
+
+static PointLight g_lights[MAX_POINT_LIGHTS];
+static int g_lightCount = 0;
+
+// Built each frame
+static ClusterBounds g_bounds[MAX_POINT_LIGHTS];
+static float g_eyeLights[MAX_POINT_LIGHTS][8];      // position, radius; color, 0
+static unsigned int g_ranges[CLUSTER_COUNT][2];      // first index, count
+static unsigned int g_capacity[CLUSTER_COUNT];       // references each cluster keeps
+static unsigned short g_indices[MAX_LIGHT_INDICES];
+
+// Last frame
+static int g_visibleLights = 0, g_indexCount = 0, g_occupied = 0, g_maxPerCluster = 0;
+static int g_droppedIndices = 0;
+static double g_buildSeconds = 0;
+
+bool InitLightClusters(GLuint program)
+{
+	if (!g_glCaps.textureBufferObject || !program)
+		return false;
+
+	static const GLenum formats[CLUSTER_BUFFERS] = { GL_RG32UI, GL_R16UI, GL_RGBA32F };
+	static const char* samplers[CLUSTER_BUFFERS] = {
+		"u_clusterRanges", "u_lightIndices", "u_pointLights"
+	};
+
+	glGenBuffers(CLUSTER_BUFFERS, g_buffers);
+	glGenTextures(CLUSTER_BUFFERS, g_textures);
+	CachedUseProgram(program);
+	for (int i = 0; i < CLUSTER_BUFFERS; i++) {
+		CachedBindBuffer(GL_TEXTURE_BUFFER, g_buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+		CachedActiveTexture(GL_TEXTURE0 + CLUSTER_TEXTURE_UNIT + i);
+		CachedBindTexture(GL_TEXTURE_BUFFER, g_textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], g_buffers[i]);
+		glUniform1i(glGetUniformLocation(program, samplers[i]), CLUSTER_TEXTURE_UNIT + i);
+	}
+	CachedActiveTexture(GL_TEXTURE0);
+	CachedBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenBuffers(1, &g_blockBuffer);
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_blockBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterBlock), NULL, GL_DYNAMIC_DRAW);
+	CachedBindBufferBase(GL_UNIFORM_BUFFER, BLOCK_CLUSTERS, g_blockBuffer);
+
+	g_clustersEnabled = true;
+	return true;
+}
+
+bool AreLightClustersEnabled(void)
+{
+	return g_clustersEnabled;
+}
+
+void SetPointLights(const PointLight* lights, int count)
+{
+	if (count > MAX_POINT_LIGHTS)
+		count = MAX_POINT_LIGHTS;
+	if (count < 0)
+		count = 0;
+	memcpy(g_lights, lights, count * sizeof(PointLight));
+	g_lightCount = count;
+}
+
+static int ClampInt(int value, int low, int high)
+{
+	return value < low ? low : (value > high ? high : value);
+}
+
+static int Tile(float ndc, int tiles)
+{
+	return ClampInt((int) floorf((ndc * 0.5f + 0.5f) * tiles), 0, tiles - 1);
+}
+
+// The clusters a sphere at eye position center can light, or false if it
+// is outside the frustum. Screen bounds come from projecting the corners
+// of the sphere's eye space box, which is conservative.
+static bool BoundLight(const Matrix4* projection, const float center[3], float radius,
+	float nearPlane, float farPlane, float zScale, float zBias, ClusterBounds* bounds)
+{
+	const float* m = projection->m;
+	float nearDepth = -center[2] - radius;
+	float farDepth = -center[2] + radius;
+
+	if (farDepth < nearPlane || nearDepth > farPlane)
+		return false;
+	bounds->z0 = ClampInt((int) floorf(logf(nearDepth > nearPlane ? nearDepth : nearPlane) * zScale - zBias),
+		0, CLUSTER_Z - 1);
+	bounds->z1 = ClampInt((int) floorf(logf(farDepth < farPlane ? farDepth : farPlane) * zScale - zBias),
+		0, CLUSTER_Z - 1);
+
+	// Reaching the near plane, it can cover any part of the screen
+	if (nearDepth <= nearPlane) {
+		bounds->x0 = bounds->y0 = 0;
+		bounds->x1 = CLUSTER_X - 1;
+		bounds->y1 = CLUSTER_Y - 1;
+		bounds->screen[0] = bounds->screen[1] = -1;
+		bounds->screen[2] = bounds->screen[3] = 1;
+		return true;
+	}
+
+	float xMin = 1e30f, xMax = -1e30f, yMin = 1e30f, yMax = -1e30f;
+	for (int d = 0; d < 2; d++) {
+		float depth = d ? farDepth : nearDepth;
+		for (int s = -1; s <= 1; s += 2) {
+			float x = (m[0] * (center[0] + s * radius) - m[8] * depth) / depth;
+			float y = (m[5] * (center[1] + s * radius) - m[9] * depth) / depth;
+			xMin = x < xMin ? x : xMin;
+			xMax = x > xMax ? x : xMax;
+			yMin = y < yMin ? y : yMin;
+			yMax = y > yMax ? y : yMax;
+		}
+	}
+	if (xMax < -1 || xMin > 1 || yMax < -1 || yMin > 1)
+		return false;
+	bounds->screen[0] = xMin > -1 ? xMin : -1;
+	bounds->screen[1] = yMin > -1 ? yMin : -1;
+	bounds->screen[2] = xMax < 1 ? xMax : 1;
+	bounds->screen[3] = yMax < 1 ? yMax : 1;
+	bounds->x0 = Tile(xMin, CLUSTER_X);
+	bounds->x1 = Tile(xMax, CLUSTER_X);
+	bounds->y0 = Tile(yMin, CLUSTER_Y);
+	bounds->y1 = Tile(yMax, CLUSTER_Y);
+	return true;
+}
+
+static void UploadBuffer(int buffer, GLsizeiptr size, const void* data)
+{
+	CachedBindBuffer(GL_TEXTURE_BUFFER, g_buffers[buffer]);
+	glBufferData(GL_TEXTURE_BUFFER, size > 0 ? size : 16, size > 0 ? data : NULL, GL_STREAM_DRAW);
+}
+
+void BuildLightClusters(const Matrix4* projection, const Matrix4* view, bool lighting)
+{
+	if (!g_clustersEnabled)
+		return;
+	double start = GetTimeSeconds();
+
+	// Planes and slice spacing from the projection matrix
+	const float* m = projection->m;
+	float nearPlane = m[14] / (m[10] - 1);
+	float farPlane = m[14] / (m[10] + 1);
+	float zScale = CLUSTER_Z / logf(farPlane / nearPlane);
+	float zBias = logf(nearPlane) * zScale;
+
+	// Bound the visible lights, counting each cluster's references
+	int visible = 0;
+	memset(g_ranges, 0, sizeof(g_ranges));
+	for (int i = 0; lighting && i < g_lightCount; i++) {
+		const PointLight* light = &g_lights[i];
+		float world[4] = { light->position[0], light->position[1], light->position[2], 1 };
+		float eye[4];
+
+		MatrixTransform(view, world, eye);
+		ClusterBounds* bounds = &g_bounds[visible];
+		if (!BoundLight(projection, eye, light->radius, nearPlane, farPlane, zScale, zBias, bounds))
+			continue;
+
+		float* packed = g_eyeLights[visible];
+		packed[0] = eye[0];
+		packed[1] = eye[1];
+		packed[2] = eye[2];
+		packed[3] = light->radius;
+		packed[4] = light->color[0];
+		packed[5] = light->color[1];
+		packed[6] = light->color[2];
+		packed[7] = 0;
+		for (int z = bounds->z0; z <= bounds->z1; z++)
+			for (int y = bounds->y0; y <= bounds->y1; y++)
+				for (int x = bounds->x0; x <= bounds->x1; x++)
+					g_ranges[(z * CLUSTER_Y + y) * CLUSTER_X + x][1]++;
+		visible++;
+	}
+
+	// Prefix sum into first indices; clusters past the index budget lose
+	// their lights
+	unsigned int total = 0;
+	g_occupied = g_maxPerCluster = g_droppedIndices = 0;
+	for (int c = 0; c < CLUSTER_COUNT; c++) {
+		unsigned int count = g_ranges[c][1];
+		if (total + count > MAX_LIGHT_INDICES) {
+			g_droppedIndices += count;
+			count = 0;
+		}
+		g_capacity[c] = count;
+		g_ranges[c][0] = total;
+		g_ranges[c][1] = 0;
+		total += count;
+		if (count > 0)
+			g_occupied++;
+		if ((int) count > g_maxPerCluster)
+			g_maxPerCluster = count;
+	}
+
+	// Fill, in light order
+	for (int i = 0; i < visible; i++) {
+		const ClusterBounds* bounds = &g_bounds[i];
+		for (int z = bounds->z0; z <= bounds->z1; z++) {
+			for (int y = bounds->y0; y <= bounds->y1; y++) {
+				for (int x = bounds->x0; x <= bounds->x1; x++) {
+					int c = (z * CLUSTER_Y + y) * CLUSTER_X + x;
+					if (g_ranges[c][1] < g_capacity[c])
+						g_indices[g_ranges[c][0] + g_ranges[c][1]++] = (unsigned short) i;
+				}
+			}
+		}
+	}
+
+	UploadBuffer(BUFFER_RANGES, sizeof(g_ranges), g_ranges);
+	UploadBuffer(BUFFER_INDICES, total * sizeof(unsigned short), g_indices);
+	UploadBuffer(BUFFER_LIGHTS, visible * sizeof(g_eyeLights[0]), g_eyeLights);
+	CachedBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	ClusterBlock block;
+	block.scale[0] = block.scale[1] = 0;
+	block.scale[2] = zScale;
+	block.scale[3] = zBias;
+	block.count[0] = CLUSTER_X;
+	block.count[1] = CLUSTER_Y;
+	block.count[2] = CLUSTER_Z;
+	block.count[3] = visible;
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_blockBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+
+	for (int i = 0; i < CLUSTER_BUFFERS; i++) {
+		CachedActiveTexture(GL_TEXTURE0 + CLUSTER_TEXTURE_UNIT + i);
+		CachedBindTexture(GL_TEXTURE_BUFFER, g_textures[i]);
+	}
+	CachedActiveTexture(GL_TEXTURE0);
+
+	g_visibleLights = visible;
+	g_indexCount = total;
+	g_buildSeconds = GetTimeSeconds() - start;
+}
+
+int GetPointLightBounds(float (*bounds)[4], int maxCount)
+{
+	int count = g_visibleLights < maxCount ? g_visibleLights : maxCount;
+	for (int i = 0; i < count; i++)
+		memcpy(bounds[i], g_bounds[i].screen, sizeof(bounds[i]));
+	return count;
+}
+
+void PrintLightClusterStats(FILE* out)
+{
+	if (!g_clustersEnabled) {
+		fprintf(out, "Light clusters: unavailable, %d point lights ignored\n", g_lightCount);
+		return;
+	}
+	fprintf(out, "Light clusters: %d of %d point lights visible, %d of %d clusters lit\n",
+		g_visibleLights, g_lightCount, g_occupied, CLUSTER_COUNT);
+	fprintf(out, "  %d light references, at most %d in a cluster, %d dropped, built in %.3f ms\n",
+		g_indexCount, g_maxPerCluster, g_droppedIndices, g_buildSeconds * 1000.0);
+}
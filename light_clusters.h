@@ -0,0 +1,60 @@
+// light_clusters.h
+//
+// Clustered forward shading for many point lights. The view frustum is
+// cut into CLUSTER_X x CLUSTER_Y tiles across the screen and CLUSTER_Z
+// slices in depth, spaced exponentially between the near and far planes
+// so that clusters stay roughly as deep as they are wide. Every frame each
+// light's sphere is bounded in cluster coordinates on the CPU and its
+// index appended to every cluster it reaches. The per-cluster ranges, the
+// index list and the lights, in eye space, go to texture buffers; the
+// scene fragment shader finds its cluster and loops over those lights
+// only, so a pixel pays for the lights that can reach it rather than for
+// every light in the scene.
+//
+// Needs texture buffer objects and the GLSL renderer. Without them point
+// lights are ignored and GL_LIGHT0 is the only light.
+
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <stdio.h>
+
+#include "gl_extensions.h"
+#include "matrix.h"
+
+#define MAX_POINT_LIGHTS     1024
+#define MAX_LIGHT_INDICES    65536      // light references over all clusters
+#define CLUSTER_X            16
+#define CLUSTER_Y            8
+#define CLUSTER_Z            24
+#define CLUSTER_COUNT        (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define CLUSTER_TEXTURE_UNIT 2          // ranges, indices and lights on 2, 3 and 4
+
+struct PointLight {
+	float position[3];             // world space
+	float radius;                  // the light reaches nothing past this
+	float color[3];
+};
+
+// Called by InitRenderer() for the scene program, which declares the
+// Clusters block and the u_clusterRanges, u_lightIndices and u_pointLights
+// samplers
+bool InitLightClusters(GLuint program);
+bool AreLightClustersEnabled(void);
+
+// Copies up to MAX_POINT_LIGHTS lights for the following frames
+void SetPointLights(const PointLight* lights, int count);
+
+// Called by BeginRendererFrame(): assigns the lights to clusters for this
+// camera, uploads the result and binds it. With lighting off no point
+// light is assigned.
+void BuildLightClusters(const Matrix4* projection, const Matrix4* view, bool lighting);
+
+// The screen rectangle, in NDC (x0, y0, x1, y1), that each light kept by
+// the last BuildLightClusters() can reach, in u_pointLights order.
+// Returns the number of lights.
+int GetPointLightBounds(float (*bounds)[4], int maxCount);
+
+void PrintLightClusterStats(FILE* out);
+
+#endif
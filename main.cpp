@@ -13,8 +13,10 @@
 
 
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 //HACK TO FORCE COMPILE AS WIN32
@@ -22,18 +24,56 @@
 
 #ifdef _WIN32
 #	include <windows.h>
-#else
-#	include <sys/time.h>
 #endif
 #include <GL/glut.h>
 
+#include "command_list.h"
+#include "deferred.h"
+#include "dynamic_resolution.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "image_loader.h"
+#include "input.h"
+#include "job_system.h"
+#include "light_clusters.h"
+#include "latency.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "mesh_lod.h"
+#include "occlusion_query.h"
+#include "software_occlusion.h"
+#include "procedural.h"
+#include "render_queue.h"
+#include "renderer.h"
+#include "shadow_map.h"
+#include "simulation.h"
+#include "staging_pool.h"
+#include "texture_dynamic.h"
+#include "texture_format.h"
+#include "texture_manager.h"
+#include "texture_stream.h"
+#include "teapot.h"
+#include "virtual_texture.h"
+
 #define VIEWING_DISTANCE_MIN  1.5
-#define TEXTURE_ID_CUBE 1
+#define CUBE_PATTERN_SCALE    8.0    // cells per face, as the checkerboard texture
+#define ANIMATED_SIZE         256    // animated cube texture
+#define ANIMATED_DISC         40     // bouncing disc diameter, texels
+#define ANIMATED_BAND         24     // scrolling band height, texels
+#define VIRTUAL_SIZE          16384  // virtual cube texture, texels per side
+#define VIRTUAL_CACHE_SLOTS   16     // page cache is 16x16 pages
+#define MAX_FRAME_EVENTS      64     // input events handled per frame
+#define TEAPOT_GRID           7      // quads per patch edge, as glutSolidTeapot
+#define GROUND_SIZE           6      // -shadows ground plane, under the cube
+#define SHADOW_RADIUS         4.5f   // shadowed sphere around g_shadowCenter
 
 enum {
 	MENU_LIGHTING = 1,
 	MENU_POLYMODE,
 	MENU_TEXTURING,
+	MENU_TEXSTATS,
+	MENU_PATTERN,
+	MENU_DEFERRED,
 	MENU_EXIT
 };
 
@@ -42,7 +82,7 @@ typedef int BOOL;
 #define FALSE 0
 
 static BOOL g_bLightingEnabled = TRUE;
-static BOOL g_bFillPolygons = TRUE;
+static RendererWireframe g_wireframe = WIREFRAME_OFF;
 static BOOL g_bTexture = TRUE;
 static BOOL g_bButton1Down = FALSE;
 static GLfloat g_fViewDistance = 3 * VIEWING_DISTANCE_MIN;
@@ -52,135 +92,357 @@ static int g_Width = 600;                          // Initial window width
 static int g_Height = 600;                         // Initial window height
 static int g_yClick = 0;
 static float g_lightPos[4] = { 10, 30, 10, 1 };  // Position of light
-#ifdef _WIN32
-static DWORD last_idle_time;
-#else
-static struct timeval last_idle_time;
-#endif
-
-struct Vector3 {
-    float x, y, z;
+static TextureHandle g_cubeTexture = TEXTURE_NONE;
+static size_t g_textureBudgetBytes = 0;            // 0 = unlimited
+static int g_jobWorkers = -1;                      // -1 = one per core
+static double g_frameBudgetMs = 0;                 // dynamic resolution, 0 = off
+static BOOL g_bLateLatch = FALSE;                  // sample input just before the camera is set
+static double g_latchedInputTime = 0;              // newest input applied by this thread
+static double g_shownInputTime = 0;                // newest input already on screen
+static const char* g_textureFile = NULL;           // Cube texture, NULL = checkerboard
+static ImageFile g_cubeImage;
+static ProceduralPattern g_cubePattern = PATTERN_NONE;  // NONE = cube texture
+static BOOL g_bAnimatedTexture = FALSE;
+static DynamicTextureHandle g_cubeDynamic = DYNAMIC_TEXTURE_NONE;
+static BOOL g_bVirtualTexture = FALSE;
+static VirtualTextureHandle g_cubeVirtual = VIRTUAL_TEXTURE_NONE;
+static Mesh g_cubeMesh;
+static MeshLod g_teapotLod;
+static int g_teapotLevel = -1;                     // LOD picked when last drawn
+static BOOL g_bOcclusion = FALSE;                  // -occlusion
+static OcclusionHandle g_teapotOcclusion = OCCLUSION_NONE;
+static MaterialHandle g_cubeMaterial = MATERIAL_NONE;
+static MaterialHandle g_teapotMaterial = MATERIAL_NONE;
+static PointLight g_pointLights[MAX_POINT_LIGHTS];
+static int g_pointLightCount = 0;                  // -lights, besides GL_LIGHT0
+static BOOL g_bShadows = FALSE;                    // -shadows
+static int g_shadowMapSize = 1024;
+static Mesh g_groundMesh;
+static MaterialHandle g_groundMaterial = MATERIAL_NONE;
+static const float g_shadowCenter[3] = { 1, -0.5f, 0 };
+static BOOL g_bDeferred = FALSE;                   // -deferred, or toggled at runtime
+
+// What RenderObjects' draws depend on, for command list replay, the
+// window height because the teapot's LOD does. All floats, so no padding
+// spoils the byte comparison.
+struct FrameKey {
+	Matrix4 projection;
+	Matrix4 view;
+	Vector3 teapotPosition;
+	Vector3 teapotRotation;
+	float height;
+};
 
-    Vector3() { x = y = z = 0; }
-    Vector3(float a, float b, float c) : x(a), y(b), z(c) {}
+// Render queue shader ids; procedural patterns follow SHADER_PATTERN
+enum SceneShader {
+	SHADER_SCENE,
+	SHADER_VIRTUAL,
+	SHADER_PATTERN
 };
 
-Vector3 cameraCenterPosition;
-Vector3 teapotPosition;
-Vector3 teapotRotation = Vector3(45, 0, 0);
-float perspectiveView = 65;
-bool isLookAtCube = true;
+// Bind functions for the cube's draws, one per way it can be textured
+static void BindCubePattern(void*)
+{
+	BeginProceduralPattern(g_cubePattern, CUBE_PATTERN_SCALE);
+}
+
+static void UnbindCubePattern(void*)
+{
+	EndProceduralPattern();
+}
+
+static void BindCubeVirtual(void*)
+{
+	BindVirtualTexture(g_cubeVirtual);
+}
+
+static void UnbindCubeVirtual(void*)
+{
+	UnbindVirtualTexture();
+}
 
-void DrawCubeFace(float fSize)
+static void BindCubeTexture(void*)
 {
-	fSize /= 2.0;
-	glBegin(GL_QUADS);
-	glVertex3f(-fSize, -fSize, fSize);    glTexCoord2f (0, 0);
-	glVertex3f(fSize, -fSize, fSize);     glTexCoord2f (1, 0);
-	glVertex3f(fSize, fSize, fSize);      glTexCoord2f (1, 1);
-	glVertex3f(-fSize, fSize, fSize);     glTexCoord2f (0, 1);
-	glEnd();
+	if (g_cubeDynamic != DYNAMIC_TEXTURE_NONE)
+		BindDynamicTexture(g_cubeDynamic);
+	else
+		BindManagedTexture(g_cubeTexture);
+	UseSceneProgram();
 }
 
-void DrawCubeWithTextureCoords (float fSize)
+// Child object (teapot) ... relative transform
+void GetTeapotModel(const SceneState* scene, Matrix4* model)
 {
-	glPushMatrix();
-	DrawCubeFace (fSize);
-	glRotatef (90, 1, 0, 0);
-	DrawCubeFace (fSize);
-	glRotatef (90, 1, 0, 0);
-	DrawCubeFace (fSize);
-	glRotatef (90, 1, 0, 0);
-	DrawCubeFace (fSize);
-	glRotatef (90, 0, 1, 0);
-	DrawCubeFace (fSize);
-	glRotatef (180, 0, 1, 0);
-	DrawCubeFace (fSize);
-	glPopMatrix();
+	MatrixIdentity(model);
+	MatrixTranslate(model,
+        2 + scene->teapotPosition.x,
+        0 + scene->teapotPosition.y,
+        0 + scene->teapotPosition.z
+    );
+	MatrixRotate(model, scene->teapotRotation.x, 1, 0, 0);
+	MatrixRotate(model, scene->teapotRotation.y, 0, 1, 0);
+	MatrixRotate(model, scene->teapotRotation.z, 0, 0, 1);
 }
 
-void RenderObjects(void)
+// The ground sits under the cube, which rests on it
+void GetGroundModel(Matrix4* model)
 {
-	float colorBronzeDiff[4] = { 0.8, 0.6, 0.0, 1.0 };
-	float colorBronzeSpec[4] = { 1.0, 1.0, 0.4, 1.0 };
-	float colorWhite[4]       = { 1.0, 1.0, 1.0, 1.0 };
-	float colorNone[4]       = { 0.0, 0.0, 0.0, 0.0 };
+	MatrixIdentity(model);
+	MatrixTranslate(model, 0, -0.5f, 0);
+}
 
-	glMatrixMode(GL_MODELVIEW);
-	glPushMatrix();
+void RenderObjects(const SceneState* scene)
+{
+	RenderDraw draw;
 
 	// Main object (cube) ... transform to its coordinates, and render
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, colorWhite);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, colorNone);
-	glColor4fv(colorWhite);
-	glBindTexture(GL_TEXTURE_2D, TEXTURE_ID_CUBE);
-	DrawCubeWithTextureCoords(1.0);
-
-	// Child object (teapot) ... relative transform, and render
-	glPushMatrix();
-	glTranslatef(
-        2 + teapotPosition.x,
-        0 + teapotPosition.y,
-        0 + teapotPosition.z
-    );
-	glRotatef(teapotRotation.x, 1, 0, 0);
-	glRotatef(teapotRotation.y, 0, 1, 0);
-	glRotatef(teapotRotation.z, 0, 0, 1);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, colorBronzeDiff);
-	glMaterialfv(GL_FRONT, GL_SPECULAR, colorBronzeSpec);
-	glMaterialf(GL_FRONT, GL_SHININESS, 50.0);
-	glColor4fv(colorBronzeDiff);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glutSolidTeapot(0.3);
-	glPopMatrix();
+	memset(&draw, 0, sizeof(draw));
+	draw.pass = RENDER_PASS_OPAQUE;
+	draw.mesh = &g_cubeMesh;
+	MatrixIdentity(&draw.model);
+	draw.material = g_cubeMaterial;
+	draw.textured = true;
+	if (g_bTexture && IsProceduralPatternAvailable(g_cubePattern)) {
+		draw.shader = SHADER_PATTERN + g_cubePattern;
+		draw.bind = BindCubePattern;
+		draw.unbind = UnbindCubePattern;
+	} else if (g_bTexture && IsVirtualTextureAvailable(g_cubeVirtual)) {
+		draw.shader = SHADER_VIRTUAL;
+		draw.bind = BindCubeVirtual;
+		draw.unbind = UnbindCubeVirtual;
+	} else {
+		draw.shader = SHADER_SCENE;
+		draw.texture = g_cubeDynamic != DYNAMIC_TEXTURE_NONE ?
+			GetDynamicTextureName(g_cubeDynamic) : GetTextureName(g_cubeTexture);
+		draw.bind = BindCubeTexture;
+	}
+	SubmitDraw(&draw);
+
+	// Child object (teapot) ... relative transform, and render unless the
+	// cube hides it
+	GetTeapotModel(scene, &draw.model);
+	draw.material = g_teapotMaterial;
+	draw.textured = false;
+	draw.shader = SHADER_SCENE;
+	draw.texture = 0;
+	draw.bind = NULL;
+	draw.unbind = NULL;
+	draw.occlusion = g_teapotOcclusion;
+	if (!IsMeshOccluded(&g_teapotLod.levels[0], &draw.model)) {
+		draw.mesh = SelectMeshLod(&g_teapotLod, &draw.model, &g_teapotLevel);
+		SubmitDraw(&draw);
+	}
+
+	// Something for the shadows to fall on
+	if (g_groundMesh.indexCount > 0) {
+		draw.mesh = &g_groundMesh;
+		GetGroundModel(&draw.model);
+		draw.material = g_groundMaterial;
+		draw.occlusion = OCCLUSION_NONE;
+		SubmitDraw(&draw);
+	}
+
+	FlushRenderQueue();
+}
+
+// Colored point lights circling the cube and teapot at assorted radii,
+// heights and speeds. Their reach shrinks as their number grows, so the
+// scene is about as bright with a thousand as with a hundred.
+static float Saturate(float x)
+{
+	return x < 0 ? 0 : (x > 1 ? 1 : x);
+}
 
-	glPopMatrix();
+void UpdatePointLights(double time)
+{
+	float reach = 0.8f * powf(256.0f / (g_pointLightCount > 0 ? g_pointLightCount : 1), 1 / 3.0f);
+
+	if (reach < 0.3f)
+		reach = 0.3f;
+	else if (reach > 1.5f)
+		reach = 1.5f;
+	for (int i = 0; i < g_pointLightCount; i++) {
+		PointLight* light = &g_pointLights[i];
+		float spread = fmodf(i * 0.618034f, 1.0f);
+		float height = fmodf(i * 0.414214f, 1.0f);
+		float speed = (0.2f + 0.6f * fmodf(i * 0.732051f, 1.0f)) * (i % 2 ? 1 : -1);
+		float angle = (float) (time * speed) + i * 2.399963f;
+		float hue = spread * 6;
+
+		light->position[0] = 1 + (0.8f + 2.2f * spread) * cosf(angle);
+		light->position[1] = -1.2f + 2.4f * height;
+		light->position[2] = (0.8f + 2.2f * spread) * sinf(angle);
+		light->radius = reach;
+		light->color[0] = Saturate(fabsf(hue - 3) - 1);
+		light->color[1] = Saturate(2 - fabsf(hue - 2));
+		light->color[2] = Saturate(2 - fabsf(hue - 4));
+	}
+	SetPointLights(g_pointLights, g_pointLightCount);
+}
+
+// The main light's shadow casters: the cube only when the light has moved,
+// the teapot every frame
+void RenderShadowMap(const SceneState* scene)
+{
+	Matrix4 model;
+
+	if (BeginShadowMap(g_lightPos, g_shadowCenter, SHADOW_RADIUS)) {
+		MatrixIdentity(&model);
+		DrawShadowCaster(&g_cubeMesh, &model);
+	}
+	BeginDynamicShadowCasters();
+	GetTeapotModel(scene, &model);
+	DrawShadowCaster(&g_teapotLod.levels[g_teapotLevel > 0 ? g_teapotLevel : 0], &model);
+	EndShadowMap();
 }
 
+void ProcessInput(void);
+
 void display(void)
 {
-	// Clear frame buffer and depth buffer
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	BeginGLStateFrame();
+
+	// Apply everything that arrived since the last frame, unless that waits
+	// for the late latch below
+	if (!g_bLateLatch)
+		ProcessInput();
+
+	// Draw the newest complete snapshot; the simulation thread keeps
+	// ticking while this frame renders
+	const SceneState* scene = AcquireSceneState();
+
+	// Upload whatever texture data the streaming thread has finished
+	UpdateTextureStreaming();
+	BeginTextureFrame();
+	UpdateDynamicTextures(scene->time);
+
+	// Late latching: sample input as late as possible, after the texture
+	// work, and carry held keys and the mouse forward to this moment
+	// rather than to the last simulation tick
+	SceneState latched;
+	if (g_bLateLatch) {
+		ProcessInput();
+		latched = *AcquireSceneState();
+		LatchSceneState(&latched, GetTimeSeconds());
+		latched.viewDistance = g_fViewDistance;
+		scene = &latched;
+	}
+
+	// The shadow map has its own framebuffer and resolution
+	if (IsShadowMapEnabled())
+		RenderShadowMap(scene);
+
+	// Everything from here to the upscale renders at the current dynamic
+	// resolution, if enabled
+	BeginDynamicResolutionFrame(g_Width, g_Height);
+
+	// The field of view is simulation state, so the projection follows it
+	Matrix4 projection, view;
+	MatrixPerspective(&projection, scene->perspectiveView, (float)g_Width / g_Height,
+		g_nearPlane, g_farPlane);
 
 	// Set up viewing transformation, looking down -Z axis
-	glLoadIdentity();
 
 	// Modify here
-	if(isLookAtCube) {
-        gluLookAt(
+	if(scene->isLookAtCube) {
+        MatrixLookAt(&view,
             2,
             1,
-            g_fViewDistance,
-            cameraCenterPosition.x,
-            cameraCenterPosition.y,
-            cameraCenterPosition.z,
+            scene->viewDistance,
+            scene->cameraCenterPosition.x,
+            scene->cameraCenterPosition.y,
+            scene->cameraCenterPosition.z,
             0,
             1,
             0
         );
 	} else {
-	    gluLookAt(
-            teapotPosition.x + 2,
-            teapotPosition.y + 1,
-            teapotPosition.z + g_fViewDistance,
-            teapotPosition.x + 2,
-            teapotPosition.y,
-            teapotPosition.z,
+	    MatrixLookAt(&view,
+            scene->teapotPosition.x + 2,
+            scene->teapotPosition.y + 1,
+            scene->teapotPosition.z + scene->viewDistance,
+            scene->teapotPosition.x + 2,
+            scene->teapotPosition.y,
+            scene->teapotPosition.z,
             0,
             1,
             0
         );
 	}
 
+	// Camera and the stationary light, once for the whole frame, and the
+	// point lights, which move on their own
+	UpdatePointLights(scene->time);
+	BeginRendererFrame(&projection, &view, g_lightPos);
+	BeginRenderQueue(&view, g_nearPlane, g_farPlane);
+	BeginOcclusionFrame(&view, g_nearPlane);
+
+	// The cube rasterizes on the job threads while this one goes on
+	// issuing GL; the teapot's test waits for it
+	BeginSoftwareOcclusion(&projection, &view);
+	if (IsSoftwareOcclusionEnabled()) {
+		Matrix4 model;
+		MatrixIdentity(&model);
+		AddOccluder(&g_cubeMesh, &model);
+		RasterizeOccluders();
+	}
+
+	// Find the virtual texture pages this view needs and load them; the
+	// feedback pass draws into the back buffer, so it goes before the clear
+	if (g_cubeVirtual != VIRTUAL_TEXTURE_NONE && g_bTexture) {
+		Matrix4 model;
+		MatrixIdentity(&model);
+		SetRendererObject(&model, g_cubeMaterial, true);
+		BeginVirtualFeedback();
+		SetVirtualFeedbackTexture(g_cubeVirtual);
+		DrawMesh(&g_cubeMesh);
+		EndVirtualFeedback();
+		UpdateVirtualTexturing();
+	}
+
+	// Clear frame buffer and depth buffer
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// Set up the stationary light
-	glLightfv(GL_LIGHT0, GL_POSITION, g_lightPos);
+	// Deferred shading draws the scene into its G-buffer instead, and
+	// lights that before the frame goes on
+	BeginDeferredFrame();
+
+	// Render the scene, or redraw last frame's recording of it when neither
+	// the camera nor the teapot has moved. Occlusion tests depend on the
+	// last frame's results, so those frames are always drawn afresh.
+	FrameKey key;
+	key.projection = projection;
+	key.view = view;
+	key.teapotPosition = scene->teapotPosition;
+	key.teapotRotation = scene->teapotRotation;
+	key.height = (float) g_Height;
+	if (IsOcclusionCullingEnabled()) {
+		BeginLodFrame(&projection, &view, g_Height);
+		RenderObjects(scene);
+	} else if (!ReplayCommandList(&key, sizeof(key))) {
+		BeginLodFrame(&projection, &view, g_Height);
+		BeginCommandRecording(&key, sizeof(key));
+		RenderObjects(scene);
+		EndCommandRecording();
+	}
+	EndDeferredFrame(&projection);
+	EndDynamicResolutionFrame();
 
-	// Render the scene
-	RenderObjects();
+	// Keep texture memory within budget once the frame's draws have marked
+	// the textures in use, so those are only ever trimmed
+	EnforceTextureBudget();
 
 	// Make sure changes appear onscreen
 	glutSwapBuffers();
+
+	// Time from the newest input this frame is the first to show
+	double inputTime = scene->inputTime > g_latchedInputTime ? scene->inputTime : g_latchedInputTime;
+	if (inputTime > g_shownInputTime) {
+		EndLatencyFrame(inputTime);
+		g_shownInputTime = inputTime;
+	} else {
+		EndLatencyFrame(0);
+	}
 }
 
 void reshape(GLint width, GLint height)
@@ -189,23 +451,15 @@ void reshape(GLint width, GLint height)
 	g_Height = height;
 
 	glViewport(0, 0, g_Width, g_Height);
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(perspectiveView, (float)g_Width / g_Height, g_nearPlane, g_farPlane);
-	glMatrixMode(GL_MODELVIEW);
-}
-
-void* createTexture(int* width, int* height, int* nComponents) {
-	// Checker board texture
-	const int W = 128;
-	const int H = 128;
-	*width = W;
-	*height = H;
-	*nComponents = 4;
-	unsigned char* data = new unsigned char[W*H*4];
-	unsigned char* ptr = data;
-	for (int i = 0; i < H; i++) {
-		for (int j = 0; j < W; j++) {
+}
+
+void GenerateCheckerTexture(int y0, int rows, int width, int height,
+	unsigned char* dst, void* user)
+{
+	// Checker board texture, 16 texel squares
+	unsigned char* ptr = dst;
+	for (int i = y0; i < y0 + rows; i++) {
+		for (int j = 0; j < width; j++) {
 			int c = 255*(((i/16) % 2) ^ ((j/16) % 2));
 
 			ptr[0] = c;
@@ -215,88 +469,275 @@ void* createTexture(int* width, int* height, int* nComponents) {
 			ptr+=4;
 		}
 	}
-	return (void*) data;
 }
 
-void InitGraphics(void)
+// Bump the version string whenever GenerateCheckerTexture changes
+TextureCacheKey CheckerTextureKey(void* user)
+{
+	return HashTextureKeyString("checkerboard 128x128 16 v1", 0);
+}
+
+// Keyed by the file contents, so an edited image never hits a stale entry
+TextureCacheKey ImageTextureKey(void* user)
 {
-	int width, height;
-	int nComponents;
-	void* pTextureImage;
+	ImageFile* image = (ImageFile*) user;
+	return HashTextureKey(image->file.data, image->file.size, HashTextureKeyString("image v1", 0));
+}
 
-	if (g_bTexture)
-		glEnable(GL_TEXTURE_2D); else
-		glDisable(GL_TEXTURE_2D);
+void LoadCheckerTexture(TextureHandle handle, GLuint name, void* user)
+{
+	StreamTextureCached(name, 128, 128, GenerateCheckerTexture, CheckerTextureKey, user);
+}
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS);
-	glShadeModel(GL_SMOOTH);
-	glEnable(GL_LIGHTING);
-	glEnable(GL_LIGHT0);
-
-	// Create texture for cube; load marble texture from file and bind it
-
-	pTextureImage = createTexture(&width, &height, &nComponents); //read_texture("marble.rgb", &width, &height, &nComponents);
-	glBindTexture(GL_TEXTURE_2D, TEXTURE_ID_CUBE);
-	gluBuild2DMipmaps(GL_TEXTURE_2D,     // texture to specify
-		GL_RGBA,           // internal texture storage format
-		width,             // texture width
-		height,            // texture height
-		GL_RGBA,           // pixel format
-		GL_UNSIGNED_BYTE,	// color component format
-		pTextureImage);    // pointer to texture image
+void LoadImageTexture(TextureHandle handle, GLuint name, void* user)
+{
+	ImageFile* image = (ImageFile*) user;
+	StreamTextureCached(name, image->width, image->height, GenerateImageTexture,
+		ImageTextureKey, image);
+}
+
+static struct {
+	int discX, discY;
+	int scroll;
+} g_animatedState;
+
+void PutCheckerTexel(unsigned char* p, int x, int y)
+{
+	unsigned char c = 255*(((y/32) % 2) ^ ((x/32) % 2));
+	p[0] = c;
+	p[1] = c;
+	p[2] = c;
+	p[3] = 255;
+}
+
+// Bounces between 0 and range
+int TriangleWave(double t, int range)
+{
+	int phase = (int) t % (2 * range);
+	return phase < range ? phase : 2 * range - phase;
+}
+
+// Checkerboard with a disc bouncing over it and a band of stripes
+// scrolling along the bottom. Only the disc's old and new squares and the
+// band are redrawn and reported dirty.
+int UpdateAnimatedTexture(double time, int width, int height,
+	unsigned char* pixels, DirtyRect* dirty, int maxDirty, void* user)
+{
+	int count = 0;
+	int discX = TriangleWave(time * 70, width - ANIMATED_DISC);
+	int discY = ANIMATED_BAND + TriangleWave(time * 45, height - ANIMATED_BAND - ANIMATED_DISC);
+	int scroll = (int) (time * 32) % 16;
+	bool first = g_animatedState.discX < 0;
+
+	if (first) {
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				PutCheckerTexel(pixels + 4 * (y * width + x), x, y);
+	} else if (discX != g_animatedState.discX || discY != g_animatedState.discY) {
+		DirtyRect old = { g_animatedState.discX, g_animatedState.discY, ANIMATED_DISC, ANIMATED_DISC };
+		for (int y = old.y; y < old.y + old.height; y++)
+			for (int x = old.x; x < old.x + old.width; x++)
+				PutCheckerTexel(pixels + 4 * (y * width + x), x, y);
+		dirty[count++] = old;
+	}
+
+	if (first || discX != g_animatedState.discX || discY != g_animatedState.discY) {
+		float r = ANIMATED_DISC / 2.0f;
+		for (int y = 0; y < ANIMATED_DISC; y++) {
+			for (int x = 0; x < ANIMATED_DISC; x++) {
+				float dx = x + 0.5f - r, dy = y + 0.5f - r;
+				if (dx * dx + dy * dy > r * r)
+					continue;
+				unsigned char* p = pixels + 4 * ((discY + y) * width + discX + x);
+				p[0] = 220;
+				p[1] = 60;
+				p[2] = 30;
+			}
+		}
+		DirtyRect rect = { discX, discY, ANIMATED_DISC, ANIMATED_DISC };
+		dirty[count++] = rect;
+		g_animatedState.discX = discX;
+		g_animatedState.discY = discY;
+	}
 
+	if (first || scroll != g_animatedState.scroll) {
+		for (int y = 0; y < ANIMATED_BAND; y++) {
+			for (int x = 0; x < width; x++) {
+				unsigned char* p = pixels + 4 * (y * width + x);
+				unsigned char c = ((x + y + scroll) / 8) % 2 ? 255 : 40;
+				p[0] = c;
+				p[1] = c;
+				p[2] = 40;
+				p[3] = 255;
+			}
+		}
+		DirtyRect band = { 0, 0, width, ANIMATED_BAND };
+		dirty[count++] = band;
+		g_animatedState.scroll = scroll;
+	}
+
+	return first ? -1 : count;
+}
+
+// A texture far too large to load whole: a fine checkerboard over a color
+// gradient, with grid lines every 1024 texels. Coarse levels average the
+// checkerboard out rather than alias it.
+void GenerateVirtualPage(int level, int x0, int y0, int size,
+	unsigned char* dst, void* user)
+{
+	int footprint = 1 << level;        // level 0 texels per texel
+
+	for (int y = 0; y < size; y++) {
+		int vy = (y0 + y) * footprint;
+		vy = vy < 0 ? 0 : (vy >= VIRTUAL_SIZE ? VIRTUAL_SIZE - 1 : vy);
+		for (int x = 0; x < size; x++) {
+			int vx = (x0 + x) * footprint;
+			vx = vx < 0 ? 0 : (vx >= VIRTUAL_SIZE ? VIRTUAL_SIZE - 1 : vx);
+
+			float u = (float) vx / VIRTUAL_SIZE, v = (float) vy / VIRTUAL_SIZE;
+			float shade = footprint >= 16 ? 0.8f : (((vx / 16) ^ (vy / 16)) & 1 ? 1.0f : 0.6f);
+			int lineWidth = footprint > 4 ? footprint : 4;
+			if (vx % 1024 < lineWidth || vy % 1024 < lineWidth)
+				shade = 0.1f;
+
+			dst[0] = (unsigned char) (255 * shade * u);
+			dst[1] = (unsigned char) (255 * shade * v);
+			dst[2] = (unsigned char) (255 * shade * (1 - u));
+			dst[3] = 255;
+			dst += 4;
+		}
+	}
+}
+
+// Create texture for cube; the image is decoded (or the checkerboard
+// generated) on the streaming thread and arrives coarsest mip first, so
+// the first frame never waits for it
+void CreateCubeTexture(void)
+{
+	if (g_textureFile != NULL) {
+		if (OpenImage(&g_cubeImage, g_textureFile))
+			g_cubeTexture = CreateManagedTexture(g_textureFile, g_cubeImage.width,
+				g_cubeImage.height, 32, LoadImageTexture, &g_cubeImage);
+		else
+			fprintf(stderr, "Cannot load texture %s\n", g_textureFile);
+	}
+	if (g_cubeTexture == TEXTURE_NONE)
+		g_cubeTexture = CreateManagedTexture("checkerboard", 128, 128, 32,
+			LoadCheckerTexture, NULL);
+
+	CachedBindTexture(GL_TEXTURE_2D, GetTextureName(g_cubeTexture));
 	glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
 		GL_LINEAR_MIPMAP_LINEAR);
-	glTexEnvf (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 }
 
-void MouseButton(int button, int state, int x, int y)
+// The bronze teapot and the white cube, drawn from buffers when the
+// renderer has them
+void CreateSceneObjects(void)
 {
-	// Respond to mouse button presses.
-	// If button1 pressed, mark this state so we know in motion function.
-
-	if (button == GLUT_LEFT_BUTTON)
-	{
-		g_bButton1Down = (state == GLUT_DOWN) ? TRUE : FALSE;
-		g_yClick = y - 3 * g_fViewDistance;
+	static const Material white = {
+		{ 0.2f, 0.2f, 0.2f, 1 }, { 1, 1, 1, 1 }, { 0, 0, 0, 0 }, 50
+	};
+	static const Material bronze = {
+		{ 0.2f, 0.2f, 0.2f, 1 }, { 0.8f, 0.6f, 0, 1 }, { 1, 1, 0.4f, 1 }, 50
+	};
+
+	g_cubeMaterial = CreateMaterial(&white);
+	g_teapotMaterial = CreateMaterial(&bronze);
+	CreateCubeMesh(&g_cubeMesh, 1.0);
+
+	// Finer than glutSolidTeapot for close-ups, coarser in the distance
+	static const int teapotGrids[MAX_LOD_LEVELS] = { 10, TEAPOT_GRID, 4, 2 };
+	for (int i = 0; i < MAX_LOD_LEVELS; i++) {
+		Mesh mesh;
+		if (CreateTeapotMesh(&mesh, 0.3, teapotGrids[i]))
+			AddMeshLodLevel(&g_teapotLod, &mesh, TeapotTessellationError(0.3, teapotGrids[i]));
+	}
+	if (g_bShadows) {
+		static const Material gray = {
+			{ 0.2f, 0.2f, 0.2f, 1 }, { 0.6f, 0.6f, 0.6f, 1 }, { 0, 0, 0, 0 }, 1
+		};
+		g_groundMaterial = CreateMaterial(&gray);
+		CreatePlaneMesh(&g_groundMesh, GROUND_SIZE);
 	}
 }
 
-void MouseMotion(int x, int y)
+void InitGraphics(void)
 {
-	// If button1 pressed, zoom in/out if mouse is moved up/down.
+	InitGLExtensions();
+	InvalidateGLState();
 
-	if (g_bButton1Down)
-	{
-		g_fViewDistance = (y - g_yClick) / 3.0;
-		if (g_fViewDistance < VIEWING_DISTANCE_MIN)
-			g_fViewDistance = VIEWING_DISTANCE_MIN;
-		glutPostRedisplay();
+	CachedEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+
+	// Lights and materials live in uniform buffers when the driver has
+	// them; otherwise in GL_LIGHT0 and glMaterial as before
+	if (!InitRenderer()) {
+		glShadeModel(GL_SMOOTH);
+		CachedEnable(GL_LIGHT0);
+		glTexEnvf (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	}
+	SetRendererLighting(g_bLightingEnabled);
+	SetRendererTexturing(g_bTexture);
+	CreateSceneObjects();
+	if (g_bShadows && !InitShadowMap(g_shadowMapSize))
+		fprintf(stderr, "Shadows need the GLSL renderer and framebuffer objects\n");
+	if (!InitDeferredShading() && g_bDeferred)
+		fprintf(stderr, "Deferred shading needs point lights and multiple render targets\n");
+	SetDeferredShading(g_bDeferred != FALSE);
+	if (g_bOcclusion) {
+		// The cube is the occluder; only the teapot is tested
+		if (InitOcclusionQueries())
+			g_teapotOcclusion = CreateOcclusionQuery();
+		else
+			fprintf(stderr, "Occlusion culling needs conditional rendering (GL 3.0)\n");
 	}
+
+	InitLatencyTracking();
+	if (g_frameBudgetMs > 0 && !InitDynamicResolution(g_frameBudgetMs))
+		fprintf(stderr, "Dynamic resolution needs framebuffer objects and timer queries\n");
+	InitTextureStreaming();
+	atexit(ShutdownTextureStreaming);
+	SetTextureBudget(g_textureBudgetBytes);
+	InitProceduralPatterns();
+
+	// A procedural cube needs no texture at all, unless GLSL is missing
+	if (g_cubePattern != PATTERN_NONE && !IsProceduralPatternAvailable(g_cubePattern)) {
+		fprintf(stderr, "Procedural %s needs GLSL; using the cube texture\n",
+			ProceduralPatternName(g_cubePattern));
+		g_cubePattern = PATTERN_NONE;
+	}
+	if (g_bAnimatedTexture) {
+		g_animatedState.discX = -1;
+		g_cubeDynamic = CreateDynamicTexture("animated", ANIMATED_SIZE, ANIMATED_SIZE,
+			UpdateAnimatedTexture, NULL);
+	}
+	if (g_bVirtualTexture) {
+		if (InitVirtualTexturing(VIRTUAL_CACHE_SLOTS))
+			g_cubeVirtual = CreateVirtualTexture("virtual", VIRTUAL_SIZE, VIRTUAL_SIZE,
+				GenerateVirtualPage, NULL);
+		if (g_cubeVirtual == VIRTUAL_TEXTURE_NONE)
+			fprintf(stderr, "Virtual texturing needs GLSL; using the cube texture\n");
+	}
+	if (g_cubePattern == PATTERN_NONE && g_cubeDynamic == DYNAMIC_TEXTURE_NONE &&
+		g_cubeVirtual == VIRTUAL_TEXTURE_NONE)
+		CreateCubeTexture();
 }
 
-void AnimateScene(void)
+void MouseButton(int button, int state, int x, int y)
 {
-	float dt;
-
-#ifdef _WIN32
-	DWORD time_now;
-	time_now = GetTickCount();
-	dt = (float) (time_now - last_idle_time) / 1000.0;
-#else
-	// Figure out time elapsed since last call to idle function
-	struct timeval time_now;
-	gettimeofday(&time_now, NULL);
-	dt = (float)(time_now.tv_sec  - last_idle_time.tv_sec) +
-		1.0e-6*(time_now.tv_usec - last_idle_time.tv_usec);
-#endif
+	PostMouseButtonEvent(button, state, x, y);
+}
 
-	// Save time_now for next time
-	last_idle_time = time_now;
+void MouseMotion(int x, int y)
+{
+	// Drawing is driven by the idle callback; no redisplay per event
+	PostMouseMotionEvent(x, y);
+}
 
-	// Force redraw
+void AnimateScene(void)
+{
+	// The simulation thread advances time on its own; just keep drawing
 	glutPostRedisplay();
 }
 
@@ -306,23 +747,58 @@ void SelectFromMenu(int idCommand)
 	{
 	case MENU_LIGHTING:
 		g_bLightingEnabled = !g_bLightingEnabled;
-		if (g_bLightingEnabled)
-			glEnable(GL_LIGHTING);
-		else
-			glDisable(GL_LIGHTING);
+		SetRendererLighting(g_bLightingEnabled);
 		break;
 
 	case MENU_POLYMODE:
-		g_bFillPolygons = !g_bFillPolygons;
-		glPolygonMode (GL_FRONT_AND_BACK, g_bFillPolygons ? GL_FILL : GL_LINE);
+		// Filled, wireframe, wireframe over the shading
+		g_wireframe = (RendererWireframe) ((g_wireframe + 1) % 3);
+		SetRendererWireframe(g_wireframe);
 		break;
 
 	case MENU_TEXTURING:
 		g_bTexture = !g_bTexture;
-		if (g_bTexture)
-			glEnable(GL_TEXTURE_2D);
-		else
-			glDisable(GL_TEXTURE_2D);
+		SetRendererTexturing(g_bTexture);
+		InvalidateCommandList();
+		break;
+
+	case MENU_TEXSTATS:
+		PrintTextureStats(stdout);
+		PrintStagingStats(stdout);
+		PrintTextureCacheStats(stdout);
+		PrintDynamicTextureStats(stdout);
+		PrintVirtualTextureStats(stdout);
+		PrintJobStats(stdout);
+		PrintInputStats(stdout);
+		PrintLatencyStats(stdout);
+		PrintDynamicResolutionStats(stdout);
+		PrintRendererStats(stdout);
+		PrintGLStateStats(stdout);
+		PrintRenderQueueStats(stdout);
+		PrintCommandListStats(stdout);
+		PrintLightClusterStats(stdout);
+		PrintShadowMapStats(stdout);
+		PrintLodStats(stdout);
+		PrintOcclusionStats(stdout);
+		PrintSoftwareOcclusionStats(stdout);
+		PrintDeferredStats(stdout);
+		break;
+
+	case MENU_PATTERN:
+		// Next available pattern, then back to the texture, created on
+		// first use if we started procedural
+		do {
+			g_cubePattern = (ProceduralPattern) ((g_cubePattern + 1) % PATTERN_COUNT);
+		} while (g_cubePattern != PATTERN_NONE && !IsProceduralPatternAvailable(g_cubePattern));
+		if (g_cubePattern == PATTERN_NONE && g_cubeTexture == TEXTURE_NONE &&
+			g_cubeDynamic == DYNAMIC_TEXTURE_NONE && g_cubeVirtual == VIRTUAL_TEXTURE_NONE)
+			CreateCubeTexture();
+		InvalidateCommandList();
+		break;
+
+	case MENU_DEFERRED:
+		g_bDeferred = !g_bDeferred;
+		SetDeferredShading(g_bDeferred != FALSE);
 		break;
 
 	case MENU_EXIT:
@@ -336,101 +812,43 @@ void SelectFromMenu(int idCommand)
 
 void Keyboard(unsigned char key, int x, int y)
 {
+	PostKeyEvent(INPUT_KEY_DOWN, key, x, y);
+}
+
+void KeyboardUp(unsigned char key, int x, int y)
+{
+	PostKeyEvent(INPUT_KEY_UP, key, x, y);
+}
+
+// Keys held as the window loses focus or is hidden never send their up
+// event; GLUT has no focus callback, so leaving the window stands in for it
+void WindowEntry(int state)
+{
+	if (state == GLUT_LEFT)
+		PostKeysReleasedEvent();
+}
+
+void WindowVisibility(int state)
+{
+	if (state == GLUT_NOT_VISIBLE)
+		PostKeysReleasedEvent();
+}
 
-    float movementSpeed = 0.1;
-    float rotateSpeed = 3;
-    float perspectiveSpeed = 2.5;
+void HandleKey(const InputEvent* event)
+{
+	// Scene changes belong to the simulation thread; only GL state is
+	// handled here
+	if (event->type == INPUT_KEY_UP) {
+		PostSimulationKey(event->key, false, event->time);
+		return;
+	}
 
-	switch (key)
+	switch (event->key)
 	{
 	case 27:             // ESCAPE key
 		exit (0);
 		break;
 
-    case 'w' : case 'W' :
-        cameraCenterPosition.y += movementSpeed;
-        break;
-
-    case 'a' : case 'A' :
-        cameraCenterPosition.x -= movementSpeed;
-        break;
-
-    case 's' : case 'S' :
-        cameraCenterPosition.y -= movementSpeed;
-        break;
-
-    case 'd' : case 'D' :
-        cameraCenterPosition.x += movementSpeed;
-        break;
-
-    case 'u' : case 'U' :
-        teapotPosition.y += movementSpeed;
-        break;
-
-    case 'h' : case 'H' :
-        teapotPosition.x -= movementSpeed;
-        break;
-
-    case 'j' : case 'J' :
-        teapotPosition.y -= movementSpeed;
-        break;
-
-    case 'k' : case 'K' :
-        teapotPosition.x += movementSpeed;
-        break;
-
-    case 'y' : case 'Y' :
-        teapotPosition.z -= movementSpeed;
-        break;
-
-    case 'i' : case 'I' :
-        teapotPosition.z += movementSpeed;
-        break;
-
-    case '3' :
-        teapotRotation.x -= rotateSpeed;
-        if(teapotRotation.x < 0) teapotRotation.x += 360;
-        break;
-
-    case '4' :
-        teapotRotation.x += rotateSpeed;
-        if(teapotRotation.x > 360) teapotRotation.x -= 360;
-        break;
-
-    case '5' :
-        teapotRotation.y -= rotateSpeed;
-        if(teapotRotation.y < 0) teapotRotation.y += 360;
-        break;
-
-    case '6' :
-        teapotRotation.y += rotateSpeed;
-        if(teapotRotation.y > 360) teapotRotation.y -= 360;
-        break;
-
-    case '7' :
-        teapotRotation.z -= rotateSpeed;
-        if(teapotRotation.z < 0) teapotRotation.z += 360;
-        break;
-
-    case '8' :
-        teapotRotation.z += rotateSpeed;
-        if(teapotRotation.z > 360) teapotRotation.z -= 360;
-        break;
-
-    case '+' :
-        perspectiveView -= perspectiveSpeed;
-        reshape(g_Width, g_Height);
-        break;
-
-    case '-' :
-        perspectiveView += perspectiveSpeed;
-        reshape(g_Width, g_Height);
-        break;
-
-    case '1' :
-        isLookAtCube = !isLookAtCube;
-        break;
-
 	case 'l':
         SelectFromMenu(MENU_LIGHTING);
 		break;
@@ -442,6 +860,68 @@ void Keyboard(unsigned char key, int x, int y)
 	case 't':
 		SelectFromMenu(MENU_TEXTURING);
 		break;
+
+	case 'm':
+		SelectFromMenu(MENU_TEXSTATS);
+		break;
+
+	case 'c':
+		SelectFromMenu(MENU_PATTERN);
+		break;
+
+	case 'g':
+		SelectFromMenu(MENU_DEFERRED);
+		break;
+
+	default:
+		PostSimulationKey(event->key, true, event->time);
+		return;
+	}
+	g_latchedInputTime = event->time;
+}
+
+void ProcessInput(void)
+{
+	InputEvent events[MAX_FRAME_EVENTS];
+	int count = DrainInputEvents(events, MAX_FRAME_EVENTS);
+
+	for (int i = 0; i < count; i++) {
+		const InputEvent* event = &events[i];
+		switch (event->type)
+		{
+		case INPUT_KEY_DOWN:
+		case INPUT_KEY_UP:
+			HandleKey(event);
+			break;
+
+		case INPUT_KEYS_RELEASED:
+			PostSimulationKeysReleased(event->time);
+			break;
+
+		case INPUT_MOUSE_BUTTON:
+			// If button1 pressed, mark this state so we know in motion function.
+			if (event->key == GLUT_LEFT_BUTTON)
+			{
+				g_bButton1Down = (event->state == GLUT_DOWN) ? TRUE : FALSE;
+				g_yClick = event->y - 3 * g_fViewDistance;
+			}
+			break;
+
+		case INPUT_MOUSE_MOTION:
+			// If button1 pressed, zoom in/out if mouse is moved up/down.
+			if (g_bButton1Down)
+			{
+				g_fViewDistance = (event->y - g_yClick) / 3.0;
+				if (g_fViewDistance < VIEWING_DISTANCE_MIN)
+					g_fViewDistance = VIEWING_DISTANCE_MIN;
+				PostSimulationViewDistance(g_fViewDistance, event->time);
+			}
+			break;
+		}
+
+		// Late latching puts every event on screen this frame
+		if (g_bLateLatch && event->time > g_latchedInputTime)
+			g_latchedInputTime = event->time;
 	}
 }
 
@@ -451,8 +931,11 @@ int BuildPopupMenu (void)
 
 	menu = glutCreateMenu (SelectFromMenu);
 	glutAddMenuEntry ("Toggle lighting\tl", MENU_LIGHTING);
-	glutAddMenuEntry ("Toggle polygon fill\tp", MENU_POLYMODE);
+	glutAddMenuEntry ("Cycle wireframe\tp", MENU_POLYMODE);
 	glutAddMenuEntry ("Toggle texturing\tt", MENU_TEXTURING);
+	glutAddMenuEntry ("Print texture stats\tm", MENU_TEXSTATS);
+	glutAddMenuEntry ("Cycle cube pattern\tc", MENU_PATTERN);
+	glutAddMenuEntry ("Toggle deferred shading\tg", MENU_DEFERRED);
 	glutAddMenuEntry ("Exit demo\tEsc", MENU_EXIT);
 
 	return menu;
@@ -462,6 +945,85 @@ int main(int argc, char** argv)
 {
 	// GLUT Window Initialization:
 	glutInit (&argc, argv);
+
+	// Remaining options: -texbudget <MB> caps GPU texture memory,
+	// -texture <file> puts a PNG, TGA, PPM or SGI .rgb image on the cube,
+	// -hugepages backs large staging buffers with huge pages,
+	// -notexcache disables the on-disk texture cache, -texcompress stores
+	// textures S3TC compressed, -notexreduce keeps every texture RGBA8
+	// instead of packing gray and 565-exact images smaller,
+	// -procedural <checker|stripes|noise> shades the cube procedurally,
+	// -animated gives the cube an animated, partially updated texture,
+	// -virtual gives it a 16384x16384 virtual texture paged in on demand,
+	// -jobs <n> sets the number of job system worker threads,
+	// -latelatch samples input just before the camera is set,
+	// -dynres <ms> scales the render resolution to keep GPU time in budget,
+	// -nostatecache sends every state change to GL, redundant or not,
+	// -nosort draws in submission order instead of sorting the render queue,
+	// -norecord redraws unchanged frames from scratch instead of replaying them,
+	// -lights <n> adds n moving point lights, shaded with clustered lighting,
+	// -shadows adds a ground plane and shadows from the main light,
+	// -shadowsize <n> sets the shadow map's width and height in texels,
+	// -lod <pixels> sets the screen-space error allowed before the teapot
+	// gets a finer tessellation, 0 always drawing the finest,
+	// -occlusion skips objects hidden behind others with occlusion queries,
+	// -softocclusion skips them by rasterizing the occluders on the CPU,
+	// -deferred starts with the point lights deferred shaded ('g' toggles)
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-texbudget") == 0 && i + 1 < argc)
+			g_textureBudgetBytes = (size_t) (atof(argv[++i]) * 1024 * 1024);
+		else if (strcmp(argv[i], "-texture") == 0 && i + 1 < argc)
+			g_textureFile = argv[++i];
+		else if (strcmp(argv[i], "-hugepages") == 0)
+			SetStagingHugePages(true);
+		else if (strcmp(argv[i], "-notexcache") == 0)
+			SetTextureCacheDirectory(NULL);
+		else if (strcmp(argv[i], "-texcompress") == 0)
+			SetTexelCompression(true);
+		else if (strcmp(argv[i], "-notexreduce") == 0)
+			SetTexelReduction(false);
+		else if (strcmp(argv[i], "-procedural") == 0 && i + 1 < argc)
+			g_cubePattern = FindProceduralPattern(argv[++i]);
+		else if (strcmp(argv[i], "-animated") == 0)
+			g_bAnimatedTexture = TRUE;
+		else if (strcmp(argv[i], "-virtual") == 0)
+			g_bVirtualTexture = TRUE;
+		else if (strcmp(argv[i], "-jobs") == 0 && i + 1 < argc)
+			g_jobWorkers = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-latelatch") == 0)
+			g_bLateLatch = TRUE;
+		else if (strcmp(argv[i], "-dynres") == 0 && i + 1 < argc)
+			g_frameBudgetMs = atof(argv[++i]);
+		else if (strcmp(argv[i], "-nostatecache") == 0)
+			SetGLStateCaching(false);
+		else if (strcmp(argv[i], "-nosort") == 0)
+			SetRenderQueueSorting(false);
+		else if (strcmp(argv[i], "-norecord") == 0)
+			SetCommandListReplay(false);
+		else if (strcmp(argv[i], "-lights") == 0 && i + 1 < argc)
+			g_pointLightCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-shadows") == 0)
+			g_bShadows = TRUE;
+		else if (strcmp(argv[i], "-shadowsize") == 0 && i + 1 < argc)
+			g_shadowMapSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-lod") == 0 && i + 1 < argc)
+			SetLodErrorThreshold((float) atof(argv[++i]));
+		else if (strcmp(argv[i], "-occlusion") == 0)
+			g_bOcclusion = TRUE;
+		else if (strcmp(argv[i], "-softocclusion") == 0)
+			SetSoftwareOcclusion(true);
+		else if (strcmp(argv[i], "-deferred") == 0)
+			g_bDeferred = TRUE;
+	}
+	if (g_pointLightCount > MAX_POINT_LIGHTS)
+		g_pointLightCount = MAX_POINT_LIGHTS;
+	else if (g_pointLightCount < 0)
+		g_pointLightCount = 0;
+
+	// Before anything that queues jobs; shut down after everything that does
+	InitJobSystem(g_jobWorkers);
+	atexit(ShutdownJobSystem);
+
 	glutInitWindowSize (g_Width, g_Height);
 	glutInitDisplayMode ( GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
 	glutCreateWindow ("CS248 GLUT example");
@@ -473,20 +1035,27 @@ int main(int argc, char** argv)
 	glutDisplayFunc (display);
 	glutReshapeFunc (reshape);
 	glutKeyboardFunc (Keyboard);
+	glutKeyboardUpFunc (KeyboardUp);
+	glutIgnoreKeyRepeat (1);      // held keys are tracked by their up events
 	glutMouseFunc (MouseButton);
 	glutMotionFunc (MouseMotion);
+	glutEntryFunc (WindowEntry);
+	glutVisibilityFunc (WindowVisibility);
 	glutIdleFunc (AnimateScene);
 
 	// Create our popup menu
 	BuildPopupMenu ();
 	glutAttachMenu (GLUT_RIGHT_BUTTON);
 
-	// Get the initial time, for use by animation
-#ifdef _WIN32
-	last_idle_time = GetTickCount();
-#else
-	gettimeofday (&last_idle_time, NULL);
-#endif
+	// Start the simulation from the initial scene
+	SceneState initial;
+	initial.teapotRotation = Vector3(45, 0, 0);
+	initial.perspectiveView = 65;
+	initial.isLookAtCube = true;
+	initial.viewDistance = g_fViewDistance;
+	initial.time = 0;
+	initial.tick = 0;
+	StartSimulation(&initial);
 
 	// Turn the flow of control over to GLUT
 	glutMainLoop ();
@@ -0,0 +1,153 @@
+// matrix.cpp
+//
+// Formulas from the OpenGL and GLU reference pages for the calls mirrored.
+
+#include "matrix.h"
+
+#include <math.h>
+#include <string.h>
+
+void MatrixIdentity(Matrix4* out)
+{
+	memset(out, 0, sizeof(*out));
+	out->m[0] = out->m[5] = out->m[10] = out->m[15] = 1;
+}
+
+void MatrixMultiply(Matrix4* out, const Matrix4* a, const Matrix4* b)
+{
+	Matrix4 result;
+
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			float sum = 0;
+			for (int k = 0; k < 4; k++)
+				sum += a->m[k * 4 + row] * b->m[column * 4 + k];
+			result.m[column * 4 + row] = sum;
+		}
+	}
+	*out = result;
+}
+
+void MatrixTranslate(Matrix4* m, float x, float y, float z)
+{
+	Matrix4 t;
+
+	MatrixIdentity(&t);
+	t.m[12] = x;
+	t.m[13] = y;
+	t.m[14] = z;
+	MatrixMultiply(m, m, &t);
+}
+
+void MatrixRotate(Matrix4* m, float degrees, float x, float y, float z)
+{
+	float length = sqrtf(x * x + y * y + z * z);
+	Matrix4 r;
+
+	if (length == 0)
+		return;
+	x /= length;
+	y /= length;
+	z /= length;
+
+	float radians = degrees * 3.14159265f / 180;
+	float c = cosf(radians), s = sinf(radians), t = 1 - c;
+
+	MatrixIdentity(&r);
+	r.m[0] = x * x * t + c;
+	r.m[1] = y * x * t + z * s;
+	r.m[2] = x * z * t - y * s;
+	r.m[4] = x * y * t - z * s;
+	r.m[5] = y * y * t + c;
+	r.m[6] = y * z * t + x * s;
+	r.m[8] = x * z * t + y * s;
+	r.m[9] = y * z * t - x * s;
+	r.m[10] = z * z * t + c;
+	MatrixMultiply(m, m, &r);
+}
+
+void MatrixScale(Matrix4* m, float x, float y, float z)
+{
+	Matrix4 s;
+
+	MatrixIdentity(&s);
+	s.m[0] = x;
+	s.m[5] = y;
+	s.m[10] = z;
+	MatrixMultiply(m, m, &s);
+}
+
+void MatrixPerspective(Matrix4* out, float fovy, float aspect, float zNear, float zFar)
+{
+	float f = 1 / tanf(fovy * 3.14159265f / 360);
+
+	memset(out, 0, sizeof(*out));
+	out->m[0] = f / aspect;
+	out->m[5] = f;
+	out->m[10] = (zFar + zNear) / (zNear - zFar);
+	out->m[11] = -1;
+	out->m[14] = 2 * zFar * zNear / (zNear - zFar);
+}
+
+static void Normalize(float v[3])
+{
+	float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	if (length > 0) {
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+	}
+}
+
+static void Cross(float out[3], const float a[3], const float b[3])
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+void MatrixLookAt(Matrix4* out, float eyeX, float eyeY, float eyeZ,
+	float centerX, float centerY, float centerZ, float upX, float upY, float upZ)
+{
+	float forward[3] = { centerX - eyeX, centerY - eyeY, centerZ - eyeZ };
+	float up[3] = { upX, upY, upZ };
+	float side[3];
+
+	Normalize(forward);
+	Cross(side, forward, up);
+	Normalize(side);
+	Cross(up, side, forward);
+
+	MatrixIdentity(out);
+	for (int i = 0; i < 3; i++) {
+		out->m[i * 4 + 0] = side[i];
+		out->m[i * 4 + 1] = up[i];
+		out->m[i * 4 + 2] = -forward[i];
+	}
+	MatrixTranslate(out, -eyeX, -eyeY, -eyeZ);
+}
+
+void MatrixRigidInverse(Matrix4* out, const Matrix4* m)
+{
+	Matrix4 result;
+
+	// Transposed rotation, and the translation taken back through it
+	MatrixIdentity(&result);
+	for (int column = 0; column < 3; column++) {
+		for (int row = 0; row < 3; row++)
+			result.m[column * 4 + row] = m->m[row * 4 + column];
+		result.m[12 + column] = -(m->m[column * 4] * m->m[12] +
+			m->m[column * 4 + 1] * m->m[13] + m->m[column * 4 + 2] * m->m[14]);
+	}
+	*out = result;
+}
+
+void MatrixTransform(const Matrix4* m, const float in[4], float out[4])
+{
+	float result[4];
+
+	for (int row = 0; row < 4; row++)
+		result[row] = m->m[row] * in[0] + m->m[4 + row] * in[1] +
+			m->m[8 + row] * in[2] + m->m[12 + row] * in[3];
+	memcpy(out, result, sizeof(result));
+}
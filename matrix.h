@@ -0,0 +1,32 @@
+// matrix.h
+//
+// 4x4 float matrices in OpenGL's column-major layout, so they load straight
+// into glLoadMatrixf or a uniform block. The builders mirror the
+// fixed-function calls they replace: MatrixTranslate, MatrixRotate and
+// MatrixScale post-multiply like glTranslatef, glRotatef and glScalef;
+// MatrixPerspective and MatrixLookAt match gluPerspective and gluLookAt.
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+struct Matrix4 {
+	float m[16];                   // m[column * 4 + row]
+};
+
+void MatrixIdentity(Matrix4* out);
+void MatrixMultiply(Matrix4* out, const Matrix4* a, const Matrix4* b);   // out = a * b; out may alias
+void MatrixTranslate(Matrix4* m, float x, float y, float z);
+void MatrixRotate(Matrix4* m, float degrees, float x, float y, float z);
+void MatrixScale(Matrix4* m, float x, float y, float z);
+void MatrixPerspective(Matrix4* out, float fovy, float aspect, float zNear, float zFar);
+void MatrixLookAt(Matrix4* out, float eyeX, float eyeY, float eyeZ,
+	float centerX, float centerY, float centerZ, float upX, float upY, float upZ);
+
+// Inverse of a rotation and translation, such as a MatrixLookAt view;
+// out may alias
+void MatrixRigidInverse(Matrix4* out, const Matrix4* m);
+
+// out = m * (x, y, z, w)
+void MatrixTransform(const Matrix4* m, const float in[4], float out[4]);
+
+#endif
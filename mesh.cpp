@@ -0,0 +1,185 @@
+// mesh.cpp
+//
+// Mesh storage and upload, and the cube.
+
+#include "mesh.h"
+#include "gl_state.h"
+#include "matrix.h"
+#include "shader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Attributes of the MeshVertex array bound to GL_ARRAY_BUFFER
+static void SetVertexAttributes(void)
+{
+	glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+		(const void*) offsetof(MeshVertex, position));
+	glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+		(const void*) offsetof(MeshVertex, normal));
+	glVertexAttribPointer(ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+		(const void*) offsetof(MeshVertex, texCoord));
+	glEnableVertexAttribArray(ATTRIB_POSITION);
+	glEnableVertexAttribArray(ATTRIB_NORMAL);
+	glEnableVertexAttribArray(ATTRIB_TEXCOORD);
+}
+
+void UploadMeshWireframe(const Mesh* mesh)
+{
+	if (mesh->wireArray || !mesh->vertexArray)
+		return;
+
+	MeshVertex* unshared = (MeshVertex*) malloc(mesh->indexCount * sizeof(MeshVertex));
+	if (unshared == NULL)
+		return;
+	for (int i = 0; i < mesh->indexCount; i++)
+		unshared[i] = mesh->vertices[mesh->indices[i]];
+
+	glGenVertexArrays(1, &mesh->wireArray);
+	CachedBindVertexArray(mesh->wireArray);
+	glGenBuffers(1, &mesh->wireBuffer);
+	CachedBindBuffer(GL_ARRAY_BUFFER, mesh->wireBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh->indexCount * sizeof(MeshVertex),
+		unshared, GL_STATIC_DRAW);
+	SetVertexAttributes();
+	CachedBindBuffer(GL_ARRAY_BUFFER, 0);
+	free(unshared);
+}
+
+static void UploadMesh(Mesh* mesh)
+{
+	glGenVertexArrays(1, &mesh->vertexArray);
+	CachedBindVertexArray(mesh->vertexArray);
+
+	glGenBuffers(1, &mesh->vertexBuffer);
+	CachedBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mesh->vertexCount * sizeof(MeshVertex),
+		mesh->vertices, GL_STATIC_DRAW);
+	SetVertexAttributes();
+
+	// The element binding is vertex array state; the array binding is not
+	glGenBuffers(1, &mesh->indexBuffer);
+	CachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indexCount * sizeof(unsigned int),
+		mesh->indices, GL_STATIC_DRAW);
+
+	CachedBindVertexArray(0);
+	CachedBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool CreateMesh(Mesh* mesh, const MeshVertex* vertices, int vertexCount,
+	const unsigned int* indices, int indexCount)
+{
+	memset(mesh, 0, sizeof(*mesh));
+	if (vertexCount <= 0 || indexCount <= 0)
+		return false;
+
+	mesh->vertices = (MeshVertex*) malloc(vertexCount * sizeof(MeshVertex));
+	mesh->indices = (unsigned int*) malloc(indexCount * sizeof(unsigned int));
+	if (mesh->vertices == NULL || mesh->indices == NULL) {
+		DestroyMesh(mesh);
+		return false;
+	}
+	memcpy(mesh->vertices, vertices, vertexCount * sizeof(MeshVertex));
+	memcpy(mesh->indices, indices, indexCount * sizeof(unsigned int));
+	mesh->vertexCount = vertexCount;
+	mesh->indexCount = indexCount;
+
+	for (int axis = 0; axis < 3; axis++)
+		mesh->boundsMin[axis] = mesh->boundsMax[axis] = vertices[0].position[axis];
+	for (int i = 1; i < vertexCount; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			float p = vertices[i].position[axis];
+			if (p < mesh->boundsMin[axis])
+				mesh->boundsMin[axis] = p;
+			if (p > mesh->boundsMax[axis])
+				mesh->boundsMax[axis] = p;
+		}
+	}
+
+	if (g_glCaps.vertexArrayObject)
+		UploadMesh(mesh);
+	return true;
+}
+
+void DestroyMesh(Mesh* mesh)
+{
+	if (mesh->vertexArray)
+		CachedDeleteVertexArrays(1, &mesh->vertexArray);
+	if (mesh->vertexBuffer)
+		CachedDeleteBuffers(1, &mesh->vertexBuffer);
+	if (mesh->indexBuffer)
+		CachedDeleteBuffers(1, &mesh->indexBuffer);
+	if (mesh->wireArray)
+		CachedDeleteVertexArrays(1, &mesh->wireArray);
+	if (mesh->wireBuffer)
+		CachedDeleteBuffers(1, &mesh->wireBuffer);
+	free(mesh->vertices);
+	free(mesh->indices);
+	memset(mesh, 0, sizeof(*mesh));
+}
+
+bool CreateCubeMesh(Mesh* mesh, float size)
+{
+	// The +Z face turned onto the others by the rotations the immediate
+	// mode cube used, applied cumulatively
+	static const float turns[6][4] = {
+		{ 0, 1, 0, 0 }, { 90, 1, 0, 0 }, { 90, 1, 0, 0 },
+		{ 90, 1, 0, 0 }, { 90, 0, 1, 0 }, { 180, 0, 1, 0 }
+	};
+	// That cube issued each glTexCoord after its glVertex, so every corner
+	// took the coordinate meant for the corner before it
+	static const float corners[4][4] = {
+		{ -1, -1, 0, 1 }, { 1, -1, 0, 0 }, { 1, 1, 1, 0 }, { -1, 1, 1, 1 }
+	};
+	MeshVertex vertices[24];
+	unsigned int indices[36];
+	float half = size / 2;
+	Matrix4 face;
+
+	MatrixIdentity(&face);
+	for (int f = 0; f < 6; f++) {
+		MatrixRotate(&face, turns[f][0], turns[f][1], turns[f][2], turns[f][3]);
+		float normal[4] = { 0, 0, 1, 0 };
+		MatrixTransform(&face, normal, normal);
+
+		for (int c = 0; c < 4; c++) {
+			MeshVertex* v = &vertices[f * 4 + c];
+			float position[4] = { corners[c][0] * half, corners[c][1] * half, half, 1 };
+			MatrixTransform(&face, position, position);
+			memcpy(v->position, position, sizeof(v->position));
+			memcpy(v->normal, normal, sizeof(v->normal));
+			v->texCoord[0] = corners[c][2];
+			v->texCoord[1] = corners[c][3];
+		}
+
+		unsigned int* quad = &indices[f * 6];
+		quad[0] = f * 4;
+		quad[1] = f * 4 + 1;
+		quad[2] = f * 4 + 2;
+		quad[3] = f * 4;
+		quad[4] = f * 4 + 2;
+		quad[5] = f * 4 + 3;
+	}
+	return CreateMesh(mesh, vertices, 24, indices, 36);
+}
+
+bool CreatePlaneMesh(Mesh* mesh, float size)
+{
+	static const float corners[4][2] = { { -1, 1 }, { 1, 1 }, { 1, -1 }, { -1, -1 } };
+	static const unsigned int indices[6] = { 0, 1, 2, 0, 2, 3 };
+	MeshVertex vertices[4];
+	float half = size / 2;
+
+	for (int c = 0; c < 4; c++) {
+		MeshVertex* v = &vertices[c];
+		v->position[0] = corners[c][0] * half;
+		v->position[1] = 0;
+		v->position[2] = corners[c][1] * half;
+		v->normal[0] = v->normal[2] = 0;
+		v->normal[1] = 1;
+		v->texCoord[0] = corners[c][0] * 0.5f + 0.5f;
+		v->texCoord[1] = 0.5f - corners[c][1] * 0.5f;
+	}
+	return CreateMesh(mesh, vertices, 4, indices, 6);
+}
@@ -0,0 +1,51 @@
+// mesh.h
+//
+// Indexed triangle meshes. The vertices and indices stay in memory for CPU
+// work such as bounds and culling, and, when the driver has vertex array
+// objects, are also uploaded once into static buffers with the attributes
+// bound to the ATTRIB_* locations from shader.h. DrawMesh() in renderer.h
+// picks whichever copy the active path needs. The renderer's wireframe
+// also needs each triangle's three vertices unshared, in index order, to
+// tell a triangle's corners apart by gl_VertexID; that copy is only
+// uploaded the first time a mesh is drawn as wireframe.
+
+#ifndef MESH_H
+#define MESH_H
+
+#include "gl_extensions.h"
+
+struct MeshVertex {
+	float position[3];
+	float normal[3];
+	float texCoord[2];
+};
+
+struct Mesh {
+	MeshVertex* vertices;
+	unsigned int* indices;
+	int vertexCount, indexCount;
+	float boundsMin[3], boundsMax[3];
+	GLuint vertexArray;            // 0 = draw from the arrays above
+	GLuint vertexBuffer, indexBuffer;
+	mutable GLuint wireArray;      // indexCount vertices, 0 = not yet uploaded
+	mutable GLuint wireBuffer;
+};
+
+// Copies the data; returns false on an empty mesh or out of memory
+bool CreateMesh(Mesh* mesh, const MeshVertex* vertices, int vertexCount,
+	const unsigned int* indices, int indexCount);
+void DestroyMesh(Mesh* mesh);
+
+// Uploads the unshared triangles behind wireArray, once; leaves wireArray
+// 0 without vertex array objects or memory
+void UploadMeshWireframe(const Mesh* mesh);
+
+// The cube of side size centered on the origin, with face normals and the
+// texture coordinates the demo has always put on it
+bool CreateCubeMesh(Mesh* mesh, float size);
+
+// A size by size square in the y = 0 plane, centered on the origin and
+// facing +y
+bool CreatePlaneMesh(Mesh* mesh, float size);
+
+#endif
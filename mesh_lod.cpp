@@ -0,0 +1,129 @@
+// mesh_lod.cpp
+//
+// An object's projected error is its error scaled by pixels per unit at
+// the eye depth of its bounding sphere's nearest point.
+
+#include "mesh_lod.h"
+
+#include <math.h>
+#include <string.h>
+
+static Matrix4 g_view;
+static float g_pixelsPerUnit = 0;      // at unit eye depth
+static float g_threshold = 1;
+
+// Per frame, and the last complete frame
+static int g_selections[MAX_LOD_LEVELS], g_lastSelections[MAX_LOD_LEVELS];
+static int g_switches = 0, g_lastSwitches = 0;
+static int g_triangles = 0, g_finestTriangles = 0;
+static int g_lastTriangles = 0, g_lastFinestTriangles = 0;
+
+bool AddMeshLodLevel(MeshLod* lod, const Mesh* mesh, float error)
+{
+	if (lod->levelCount == MAX_LOD_LEVELS ||
+		(lod->levelCount > 0 && error < lod->errors[lod->levelCount - 1]))
+		return false;
+
+	lod->levels[lod->levelCount] = *mesh;
+	lod->errors[lod->levelCount] = error;
+	lod->levelCount++;
+	return true;
+}
+
+void DestroyMeshLod(MeshLod* lod)
+{
+	for (int i = 0; i < lod->levelCount; i++)
+		DestroyMesh(&lod->levels[i]);
+	memset(lod, 0, sizeof(*lod));
+}
+
+void BeginLodFrame(const Matrix4* projection, const Matrix4* view, int viewportHeight)
+{
+	memcpy(g_lastSelections, g_selections, sizeof(g_selections));
+	memset(g_selections, 0, sizeof(g_selections));
+	g_lastSwitches = g_switches;
+	g_lastTriangles = g_triangles;
+	g_lastFinestTriangles = g_finestTriangles;
+	g_switches = g_triangles = g_finestTriangles = 0;
+
+	// m[5] is cot(fovy / 2): half the viewport height spans that many
+	// units at unit depth
+	g_view = *view;
+	g_pixelsPerUnit = projection->m[5] * viewportHeight / 2;
+}
+
+void SetLodErrorThreshold(float pixels)
+{
+	g_threshold = pixels > 0 ? pixels : 0;
+}
+
+// Pixels per object unit at the bounding sphere's nearest point
+static float ProjectedScale(const Mesh* mesh, const Matrix4* model)
+{
+	float center[4], radius2 = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		float half = (mesh->boundsMax[axis] - mesh->boundsMin[axis]) / 2;
+		center[axis] = mesh->boundsMin[axis] + half;
+		radius2 += half * half;
+	}
+	center[3] = 1;
+
+	Matrix4 modelView;
+	MatrixMultiply(&modelView, &g_view, model);
+	MatrixTransform(&modelView, center, center);
+
+	// Inside the sphere, or close enough that a pixel is tiny, any error
+	// shows
+	float depth = -center[2] - sqrtf(radius2);
+	return depth > 1e-3f ? g_pixelsPerUnit / depth : 1e30f;
+}
+
+const Mesh* SelectMeshLod(const MeshLod* lod, const Matrix4* model, int* level)
+{
+	if (lod->levelCount == 0)
+		return NULL;
+
+	int current = *level;
+	if (g_threshold > 0) {
+		float scale = ProjectedScale(&lod->levels[0], model);
+		int coarsest = 0;
+		while (coarsest + 1 < lod->levelCount &&
+			lod->errors[coarsest + 1] * scale <= g_threshold)
+			coarsest++;
+
+		if (current < 0 || current >= lod->levelCount) {
+			current = coarsest;
+		} else if (coarsest < current) {
+			current = coarsest;
+		} else {
+			while (current < coarsest &&
+				lod->errors[current + 1] * scale <= g_threshold * LOD_HYSTERESIS)
+				current++;
+		}
+	} else {
+		current = 0;
+	}
+
+	if (*level >= 0 && current != *level)
+		g_switches++;
+	*level = current;
+	g_selections[current]++;
+	g_triangles += lod->levels[current].indexCount / 3;
+	g_finestTriangles += lod->levels[0].indexCount / 3;
+	return &lod->levels[current];
+}
+
+void PrintLodStats(FILE* out)
+{
+	if (g_threshold <= 0) {
+		fprintf(out, "Mesh LOD: off, finest level always\n");
+		return;
+	}
+	fprintf(out, "Mesh LOD: %.2f pixel error threshold, objects per level last frame", g_threshold);
+	for (int i = 0; i < MAX_LOD_LEVELS; i++)
+		fprintf(out, " %d", g_lastSelections[i]);
+	fprintf(out, "\n  %d of %d triangles (%.0f%%), %d level switches\n",
+		g_lastTriangles, g_lastFinestTriangles,
+		g_lastFinestTriangles > 0 ? 100.0 * g_lastTriangles / g_lastFinestTriangles : 100.0,
+		g_lastSwitches);
+}
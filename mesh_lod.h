@@ -0,0 +1,49 @@
+// mesh_lod.h
+//
+// Discrete levels of detail. A MeshLod holds the same surface tessellated
+// several times, finest first, each with its geometric error: how far it
+// strays from the true surface, in object units. Each frame every object
+// picks the coarsest level whose error, projected to the screen at the
+// object's nearest point, stays under a pixel threshold.
+//
+// To keep objects near a boundary from switching level every frame, an
+// object only drops to a coarser level once that level's error is well
+// under the threshold, and goes back to a finer one only once its current
+// level's error is over it.
+
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <stdio.h>
+
+#include "matrix.h"
+#include "mesh.h"
+
+#define MAX_LOD_LEVELS 4
+#define LOD_HYSTERESIS 0.7f             // coarser levels must project under threshold * this
+
+struct MeshLod {
+	Mesh levels[MAX_LOD_LEVELS];       // finest first
+	float errors[MAX_LOD_LEVELS];      // object space, increasing
+	int levelCount;
+};
+
+// Appends the next coarser level, taking over the mesh. Returns false when
+// the LOD is full or error is below the previous level's.
+bool AddMeshLodLevel(MeshLod* lod, const Mesh* mesh, float error);
+void DestroyMeshLod(MeshLod* lod);
+
+// Starts a frame for a camera drawing viewportHeight pixels high
+void BeginLodFrame(const Matrix4* projection, const Matrix4* view, int viewportHeight);
+
+// The level to draw an object with. level is the object's own state: its
+// last pick, or -1 before the first. Model matrices must be rigid.
+const Mesh* SelectMeshLod(const MeshLod* lod, const Matrix4* model, int* level);
+
+// Largest projected error allowed, in pixels; 0 always draws the finest
+// level
+void SetLodErrorThreshold(float pixels);
+
+void PrintLodStats(FILE* out);
+
+#endif
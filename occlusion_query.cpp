@@ -0,0 +1,166 @@
+// occlusion_query.cpp
+//
+// Handles are slot index + 1. The bounding box is the unit cube mesh
+// scaled and moved onto the mesh bounds.
+
+#include "occlusion_query.h"
+#include "gl_extensions.h"
+
+#include <string.h>
+
+struct OcclusionSlot {
+	GLuint query;
+	bool visible;                  // by the last result read
+	bool pending;                  // issued, result not read yet
+	bool boxed;                    // issued on the bounding box
+};
+
+static bool g_occlusionEnabled = false;
+static OcclusionSlot g_slots[MAX_OCCLUSION_QUERIES];
+static int g_slotCount = 0;
+static Mesh g_boxMesh;
+static Matrix4 g_view;
+static float g_nearPlane = 0;
+
+// Per frame, and the last complete frame
+static int g_tested = 0, g_boxTests = 0, g_nearTests = 0;
+static int g_lastTested = 0, g_lastBoxTests = 0, g_lastNearTests = 0;
+static int g_culled = 0, g_pendingResults = 0;     // results read this frame
+
+bool InitOcclusionQueries(void)
+{
+	if (!g_glCaps.conditionalRender || !CreateCubeMesh(&g_boxMesh, 1))
+		return false;
+
+	memset(g_slots, 0, sizeof(g_slots));
+	g_slotCount = 0;
+	g_occlusionEnabled = true;
+	return true;
+}
+
+bool IsOcclusionCullingEnabled(void)
+{
+	return g_occlusionEnabled;
+}
+
+OcclusionHandle CreateOcclusionQuery(void)
+{
+	if (!g_occlusionEnabled || g_slotCount == MAX_OCCLUSION_QUERIES)
+		return OCCLUSION_NONE;
+
+	OcclusionSlot* slot = &g_slots[g_slotCount];
+	glGenQueries(1, &slot->query);
+	slot->visible = true;
+	slot->pending = false;
+	return ++g_slotCount;
+}
+
+void BeginOcclusionFrame(const Matrix4* view, float nearPlane)
+{
+	g_lastTested = g_tested;
+	g_lastBoxTests = g_boxTests;
+	g_lastNearTests = g_nearTests;
+	g_tested = g_boxTests = g_nearTests = 0;
+	g_view = *view;
+	g_nearPlane = nearPlane;
+	if (!g_occlusionEnabled)
+		return;
+
+	g_culled = g_pendingResults = 0;
+	for (int i = 0; i < g_slotCount; i++) {
+		OcclusionSlot* slot = &g_slots[i];
+		if (!slot->pending)
+			continue;
+
+		GLint available = 0, samples = 0;
+		glGetQueryObjectiv(slot->query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			g_pendingResults++;
+			continue;
+		}
+		glGetQueryObjectiv(slot->query, GL_QUERY_RESULT, &samples);
+		slot->visible = samples > 0;
+		slot->pending = false;
+		if (!slot->visible && slot->boxed)
+			g_culled++;
+	}
+}
+
+// Whether any corner of the mesh bounds is nearer than the near plane,
+// where the box would be clipped and could read as hidden
+static bool ReachesNearPlane(const Mesh* mesh, const Matrix4* model)
+{
+	Matrix4 modelView;
+	MatrixMultiply(&modelView, &g_view, model);
+	for (int corner = 0; corner < 8; corner++) {
+		float position[4] = {
+			corner & 1 ? mesh->boundsMax[0] : mesh->boundsMin[0],
+			corner & 2 ? mesh->boundsMax[1] : mesh->boundsMin[1],
+			corner & 4 ? mesh->boundsMax[2] : mesh->boundsMin[2],
+			1
+		};
+		MatrixTransform(&modelView, position, position);
+		if (-position[2] < g_nearPlane)
+			return true;
+	}
+	return false;
+}
+
+void DrawOccludable(OcclusionHandle handle, const Mesh* mesh, const Matrix4* model,
+	MaterialHandle material, bool textured)
+{
+	if (!g_occlusionEnabled || handle <= 0 || handle > g_slotCount) {
+		DrawMesh(mesh);
+		return;
+	}
+
+	OcclusionSlot* slot = &g_slots[handle - 1];
+	g_tested++;
+	slot->pending = true;
+
+	bool nearPlane = !slot->visible && ReachesNearPlane(mesh, model);
+	if (slot->visible || nearPlane) {
+		if (nearPlane)
+			g_nearTests++;
+		slot->boxed = false;
+		glBeginQuery(GL_SAMPLES_PASSED, slot->query);
+		DrawMesh(mesh);
+		glEndQuery(GL_SAMPLES_PASSED);
+		return;
+	}
+
+	// Depth tested against what is already drawn, writing nothing
+	Matrix4 box = *model;
+	MatrixTranslate(&box, (mesh->boundsMin[0] + mesh->boundsMax[0]) / 2,
+		(mesh->boundsMin[1] + mesh->boundsMax[1]) / 2, (mesh->boundsMin[2] + mesh->boundsMax[2]) / 2);
+	MatrixScale(&box, mesh->boundsMax[0] - mesh->boundsMin[0],
+		mesh->boundsMax[1] - mesh->boundsMin[1], mesh->boundsMax[2] - mesh->boundsMin[2]);
+	g_boxTests++;
+	slot->boxed = true;
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	SetRendererObject(&box, material, textured);
+	glBeginQuery(GL_SAMPLES_PASSED, slot->query);
+	DrawMesh(&g_boxMesh);
+	glEndQuery(GL_SAMPLES_PASSED);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_TRUE);
+
+	// The GPU waits for the box's result, the CPU does not
+	SetRendererObject(model, material, textured);
+	glBeginConditionalRender(slot->query, GL_QUERY_WAIT);
+	DrawMesh(mesh);
+	glEndConditionalRender();
+}
+
+void PrintOcclusionStats(FILE* out)
+{
+	if (!g_occlusionEnabled) {
+		fprintf(out, "Occlusion queries: off\n");
+		return;
+	}
+	fprintf(out, "Occlusion queries: %d objects tested last frame, %d by bounding box, "
+		"%d too near to box\n", g_lastTested, g_lastBoxTests, g_lastNearTests);
+	fprintf(out, "  %d culled by the last results read, %d results still in flight\n",
+		g_culled, g_pendingResults);
+}
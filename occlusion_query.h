@@ -0,0 +1,54 @@
+// occlusion_query.h
+//
+// Occlusion culling with hardware queries and conditional rendering. Each
+// tested object owns a query. An object whose last result showed it
+// visible is drawn as usual, with its query counting the samples it
+// passes. An object that was hidden first has its bounding box drawn with
+// color and depth writes off under the query, and is then drawn inside
+// glBeginConditionalRender on that query, so the GPU skips it when no
+// sample of the box passed.
+//
+// Results are only read a frame later, and only once available, so the
+// CPU never waits for the GPU; an object whose result is still in flight
+// keeps its last state. Draws should go front to back, as the render
+// queue sorts them, so that the occluders are in the depth buffer first.
+//
+// Which objects are tested by box changes from frame to frame, so frames
+// drawing tested objects must not be recorded into a command list.
+//
+// Needs GL 3.0 conditional rendering. Without it every object is drawn.
+
+#ifndef OCCLUSION_QUERY_H
+#define OCCLUSION_QUERY_H
+
+#include <stdio.h>
+
+#include "matrix.h"
+#include "mesh.h"
+#include "renderer.h"
+
+#define MAX_OCCLUSION_QUERIES 256
+
+typedef int OcclusionHandle;
+#define OCCLUSION_NONE 0
+
+// After InitRenderer()
+bool InitOcclusionQueries(void);
+bool IsOcclusionCullingEnabled(void);
+
+// OCCLUSION_NONE when disabled or out of queries
+OcclusionHandle CreateOcclusionQuery(void);
+
+// Collects whatever results from earlier frames are ready. Boxes reaching
+// in front of nearPlane cannot be tested and count as visible.
+void BeginOcclusionFrame(const Matrix4* view, float nearPlane);
+
+// Draws mesh as tested by handle, in place of DrawMesh(). The object
+// (model, material, textured) must be current; the box draw changes it
+// and puts it back.
+void DrawOccludable(OcclusionHandle handle, const Mesh* mesh, const Matrix4* model,
+	MaterialHandle material, bool textured);
+
+void PrintOcclusionStats(FILE* out);
+
+#endif
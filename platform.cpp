@@ -0,0 +1,339 @@
+// platform.cpp
+//
+// Win32 and POSIX implementations of the primitives declared in platform.h.
+
+#include "platform.h"
+
+#ifndef _WIN32
+#	include <errno.h>
+#	include <fcntl.h>
+#	include <stdio.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <sys/time.h>
+#	include <time.h>
+#	include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static DWORD WINAPI ThreadTrampoline(LPVOID param)
+{
+	Thread* thread = (Thread*) param;
+	thread->proc(thread->arg);
+	return 0;
+}
+#else
+static void* ThreadTrampoline(void* param)
+{
+	Thread* thread = (Thread*) param;
+	thread->proc(thread->arg);
+	return NULL;
+}
+#endif
+
+bool ThreadStart(Thread* thread, ThreadProc proc, void* arg)
+{
+	thread->proc = proc;
+	thread->arg = arg;
+#ifdef _WIN32
+	thread->handle = CreateThread(NULL, 0, ThreadTrampoline, thread, 0, NULL);
+	return thread->handle != NULL;
+#else
+	return pthread_create(&thread->handle, NULL, ThreadTrampoline, thread) == 0;
+#endif
+}
+
+void ThreadJoin(Thread* thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+#else
+	pthread_join(thread->handle, NULL);
+#endif
+}
+
+void MutexInit(Mutex* mutex)
+{
+#ifdef _WIN32
+	InitializeCriticalSection(&mutex->cs);
+#else
+	pthread_mutex_init(&mutex->mutex, NULL);
+#endif
+}
+
+void MutexDestroy(Mutex* mutex)
+{
+#ifdef _WIN32
+	DeleteCriticalSection(&mutex->cs);
+#else
+	pthread_mutex_destroy(&mutex->mutex);
+#endif
+}
+
+void MutexLock(Mutex* mutex)
+{
+#ifdef _WIN32
+	EnterCriticalSection(&mutex->cs);
+#else
+	pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+void MutexUnlock(Mutex* mutex)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(&mutex->cs);
+#else
+	pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
+
+void EventInit(Event* event)
+{
+#ifdef _WIN32
+	event->handle = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+	pthread_mutex_init(&event->mutex, NULL);
+	pthread_cond_init(&event->cond, NULL);
+	event->signaled = 0;
+#endif
+}
+
+void EventDestroy(Event* event)
+{
+#ifdef _WIN32
+	CloseHandle(event->handle);
+#else
+	pthread_cond_destroy(&event->cond);
+	pthread_mutex_destroy(&event->mutex);
+#endif
+}
+
+void EventSignal(Event* event)
+{
+#ifdef _WIN32
+	SetEvent(event->handle);
+#else
+	pthread_mutex_lock(&event->mutex);
+	event->signaled = 1;
+	pthread_cond_signal(&event->cond);
+	pthread_mutex_unlock(&event->mutex);
+#endif
+}
+
+bool EventWait(Event* event, int timeoutMs)
+{
+#ifdef _WIN32
+	return WaitForSingleObject(event->handle,
+		timeoutMs < 0 ? INFINITE : (DWORD) timeoutMs) == WAIT_OBJECT_0;
+#else
+	struct timespec deadline;
+	int result = 0;
+
+	if (timeoutMs >= 0) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += timeoutMs / 1000;
+		deadline.tv_nsec += (long) (timeoutMs % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	pthread_mutex_lock(&event->mutex);
+	while (!event->signaled && result != ETIMEDOUT) {
+		if (timeoutMs < 0)
+			pthread_cond_wait(&event->cond, &event->mutex);
+		else
+			result = pthread_cond_timedwait(&event->cond, &event->mutex, &deadline);
+	}
+	bool signaled = event->signaled != 0;
+	event->signaled = 0;
+	pthread_mutex_unlock(&event->mutex);
+	return signaled;
+#endif
+}
+
+long AtomicLoad(volatile long* p)
+{
+#ifdef _WIN32
+	return InterlockedCompareExchange(p, 0, 0);
+#else
+	return __sync_fetch_and_add(p, 0);
+#endif
+}
+
+void AtomicStore(volatile long* p, long value)
+{
+#ifdef _WIN32
+	InterlockedExchange(p, value);
+#else
+	__sync_synchronize();
+	*p = value;
+	__sync_synchronize();
+#endif
+}
+
+long AtomicIncrement(volatile long* p)
+{
+#ifdef _WIN32
+	return InterlockedIncrement(p);
+#else
+	return __sync_add_and_fetch(p, 1);
+#endif
+}
+
+long AtomicDecrement(volatile long* p)
+{
+#ifdef _WIN32
+	return InterlockedDecrement(p);
+#else
+	return __sync_sub_and_fetch(p, 1);
+#endif
+}
+
+long AtomicAdd(volatile long* p, long value)
+{
+#ifdef _WIN32
+	return InterlockedExchangeAdd(p, value) + value;
+#else
+	return __sync_add_and_fetch(p, value);
+#endif
+}
+
+long AtomicExchange(volatile long* p, long value)
+{
+#ifdef _WIN32
+	return InterlockedExchange(p, value);
+#else
+	// __sync_lock_test_and_set is only an acquire barrier
+	__sync_synchronize();
+	return __sync_lock_test_and_set(p, value);
+#endif
+}
+
+long AtomicCompareExchange(volatile long* p, long exchange, long comparand)
+{
+#ifdef _WIN32
+	return InterlockedCompareExchange(p, exchange, comparand);
+#else
+	return __sync_val_compare_and_swap(p, comparand, exchange);
+#endif
+}
+
+bool MapFile(MappedFile* file, const char* path)
+{
+	file->data = NULL;
+	file->size = 0;
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	file->mapping = NULL;
+	file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file->file == INVALID_HANDLE_VALUE)
+		return false;
+	if (!GetFileSizeEx(file->file, &size) || size.QuadPart == 0) {
+		CloseHandle(file->file);
+		return false;
+	}
+	file->mapping = CreateFileMapping(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (file->mapping != NULL)
+		file->data = (const unsigned char*) MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (file->data == NULL) {
+		if (file->mapping != NULL)
+			CloseHandle(file->mapping);
+		CloseHandle(file->file);
+		return false;
+	}
+	file->size = (size_t) size.QuadPart;
+	return true;
+#else
+	struct stat info;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	void* data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+	madvise(data, (size_t) info.st_size, MADV_SEQUENTIAL);
+	file->data = (const unsigned char*) data;
+	file->size = (size_t) info.st_size;
+	return true;
+#endif
+}
+
+void UnmapFile(MappedFile* file)
+{
+	if (file->data == NULL)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(file->data);
+	CloseHandle(file->mapping);
+	CloseHandle(file->file);
+#else
+	munmap((void*) file->data, file->size);
+#endif
+	file->data = NULL;
+	file->size = 0;
+}
+
+bool MakeDirectory(const char* path)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool RenameFile(const char* from, const char* to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from, to) == 0;
+#endif
+}
+
+double GetTimeSeconds(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER now;
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (double) now.QuadPart / (double) frequency.QuadPart;
+#else
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (double) now.tv_sec + 1.0e-6 * now.tv_usec;
+#endif
+}
+
+void SleepMs(int ms)
+{
+#ifdef _WIN32
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+int GetProcessorCount(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int) info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int) count : 1;
+#endif
+}
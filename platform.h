@@ -0,0 +1,94 @@
+// platform.h
+//
+// Thin portability layer over Win32 and POSIX for the pieces of threading and
+// timing the demo needs: threads, mutexes, auto-reset events, atomic integer
+// operations, read-only file mapping and a high resolution clock.
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#endif
+#include <stddef.h>
+
+typedef void (*ThreadProc)(void* arg);
+
+struct Thread {
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	ThreadProc proc;
+	void* arg;
+};
+
+struct Mutex {
+#ifdef _WIN32
+	CRITICAL_SECTION cs;
+#else
+	pthread_mutex_t mutex;
+#endif
+};
+
+// Auto-reset event: a waiter releases at most one pending signal
+struct Event {
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int signaled;
+#endif
+};
+
+// Read-only view of a whole file
+struct MappedFile {
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+};
+
+// The Thread struct must stay alive until ThreadJoin returns
+bool ThreadStart(Thread* thread, ThreadProc proc, void* arg);
+void ThreadJoin(Thread* thread);
+
+void MutexInit(Mutex* mutex);
+void MutexDestroy(Mutex* mutex);
+void MutexLock(Mutex* mutex);
+void MutexUnlock(Mutex* mutex);
+
+void EventInit(Event* event);
+void EventDestroy(Event* event);
+void EventSignal(Event* event);
+// Returns false if timeoutMs elapsed without a signal; negative waits forever
+bool EventWait(Event* event, int timeoutMs);
+
+// Full-barrier atomic operations on naturally aligned longs
+long AtomicLoad(volatile long* p);
+void AtomicStore(volatile long* p, long value);
+long AtomicIncrement(volatile long* p);   // returns the new value
+long AtomicDecrement(volatile long* p);   // returns the new value
+long AtomicAdd(volatile long* p, long value);  // returns the new value
+long AtomicExchange(volatile long* p, long value);  // returns the previous value
+// Stores exchange if *p == comparand; returns the previous value of *p
+long AtomicCompareExchange(volatile long* p, long exchange, long comparand);
+
+bool MapFile(MappedFile* file, const char* path);
+void UnmapFile(MappedFile* file);
+// Creates a directory; succeeds if it already exists
+bool MakeDirectory(const char* path);
+// Renames from to to, replacing an existing file
+bool RenameFile(const char* from, const char* to);
+
+double GetTimeSeconds(void);
+void SleepMs(int ms);
+int GetProcessorCount(void);
+
+#endif
@@ -0,0 +1,153 @@
+// procedural.cpp
+//
+// GLSL sources and programs for procedural.h; the version comes from
+// SceneShaderHeader().
+
+#include "procedural.h"
+#include "gl_state.h"
+#include "renderer.h"
+#include "shader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct PatternProgram {
+	GLuint program;
+	GLint lighting;
+	GLint scale;
+};
+
+static PatternProgram g_patterns[PATTERN_COUNT];
+
+static const char* g_patternNames[PATTERN_COUNT] = {
+	"none", "checker", "stripes", "noise"
+};
+
+// PATTERN selects the pattern at compile time. Checker and stripes are the
+// exact box filter of the pattern over the pixel footprint; the checker's
+// cell (0, 0) is black like the CPU checkerboard texture.
+static const char* g_patternFragmentShader =
+	"uniform float u_scale;\n"
+	"varying vec4 v_color;\n"
+	"varying vec2 v_texCoord;\n"
+	"#ifdef WIREFRAME\n"
+	"varying vec3 v_barycentric;\n"
+	"varying float v_wireframe;\n"
+	"#endif\n"
+	"\n"
+	"float Hash(vec2 p)\n"
+	"{\n"
+	"	return fract(sin(dot(p, vec2(127.1, 311.7))) * 43758.5453);\n"
+	"}\n"
+	"\n"
+	"float ValueNoise(vec2 p)\n"
+	"{\n"
+	"	vec2 i = floor(p);\n"
+	"	vec2 f = fract(p);\n"
+	"	vec2 u = f * f * (3.0 - 2.0 * f);\n"
+	"	return mix(mix(Hash(i), Hash(i + vec2(1.0, 0.0)), u.x),\n"
+	"		mix(Hash(i + vec2(0.0, 1.0)), Hash(i + vec2(1.0, 1.0)), u.x), u.y);\n"
+	"}\n"
+	"\n"
+	"// Integral of a 0/1 square wave with period 2\n"
+	"float StripeIntegral(float x)\n"
+	"{\n"
+	"	return floor(x * 0.5) + max(2.0 * fract(x * 0.5) - 1.0, 0.0);\n"
+	"}\n"
+	"\n"
+	"float Pattern(vec2 p)\n"
+	"{\n"
+	"	vec2 w = fwidth(p) + 0.0001;\n"
+	"#if PATTERN == 1\n"
+	"	vec2 i = 2.0 * (abs(fract((p - 0.5 * w) * 0.5) - 0.5) -\n"
+	"		abs(fract((p + 0.5 * w) * 0.5) - 0.5)) / w;\n"
+	"	return 0.5 - 0.5 * i.x * i.y;\n"
+	"#elif PATTERN == 2\n"
+	"	return (StripeIntegral(p.x + 0.5 * w.x) - StripeIntegral(p.x - 0.5 * w.x)) / w.x;\n"
+	"#else\n"
+	"	// Fade each octave to its mean before it drops below two pixels a cell\n"
+	"	float footprint = max(w.x, w.y);\n"
+	"	float sum = 0.0, amplitude = 0.5, frequency = 1.0;\n"
+	"	for (int octave = 0; octave < 6; octave++) {\n"
+	"		float fade = clamp(2.0 - 4.0 * footprint * frequency, 0.0, 1.0);\n"
+	"		sum += amplitude * mix(0.5, ValueNoise(p * frequency + float(octave) * 17.0), fade);\n"
+	"		amplitude *= 0.5;\n"
+	"		frequency *= 2.0;\n"
+	"	}\n"
+	"	return sum;\n"
+	"#endif\n"
+	"}\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"#ifdef WIREFRAME\n"
+	"	// The scene program's wireframe (renderer.cpp)\n"
+	"	vec3 pixels = v_barycentric / max(fwidth(v_barycentric), vec3(1e-6));\n"
+	"	float edge = min(min(pixels.x, pixels.y), pixels.z);\n"
+	"	if (v_wireframe > 0.5 && v_wireframe < 1.5 && edge > 1.0)\n"
+	"		discard;\n"
+	"#endif\n"
+	"	fragColor = v_color * vec4(vec3(Pattern(v_texCoord * u_scale)), 1.0);\n"
+	"#ifdef WIREFRAME\n"
+	"	if (v_wireframe > 1.5)\n"
+	"		fragColor.rgb *= clamp(edge, 0.0, 1.0);\n"
+	"#endif\n"
+	"#ifdef GBUFFER\n"
+	"	gbufferAlbedo = vec4(0.0);\n"
+	"#endif\n"
+	"}\n";
+
+void InitProceduralPatterns(void)
+{
+	memset(g_patterns, 0, sizeof(g_patterns));
+	if (!g_glCaps.shaderObjects)
+		return;
+
+	for (int pattern = PATTERN_NONE + 1; pattern < PATTERN_COUNT; pattern++) {
+		PatternProgram* p = &g_patterns[pattern];
+		char header[320];
+		snprintf(header, sizeof(header), "%s#define PATTERN %d\n", SceneShaderHeader(), pattern);
+		p->program = CreateShaderProgram(g_patternNames[pattern], header,
+			SceneVertexShader(), g_patternFragmentShader);
+		if (p->program) {
+			p->lighting = glGetUniformLocation(p->program, "u_lighting");
+			p->scale = glGetUniformLocation(p->program, "u_scale");
+		}
+	}
+}
+
+bool IsProceduralPatternAvailable(ProceduralPattern pattern)
+{
+	return pattern > PATTERN_NONE && pattern < PATTERN_COUNT && g_patterns[pattern].program != 0;
+}
+
+bool BeginProceduralPattern(ProceduralPattern pattern, float scale)
+{
+	if (!IsProceduralPatternAvailable(pattern))
+		return false;
+
+	PatternProgram* p = &g_patterns[pattern];
+	CachedUseProgram(p->program);
+	glUniform1i(p->lighting, CachedIsEnabled(GL_LIGHTING));
+	glUniform1f(p->scale, scale);
+	return true;
+}
+
+void EndProceduralPattern(void)
+{
+	CachedUseProgram(0);
+}
+
+const char* ProceduralPatternName(ProceduralPattern pattern)
+{
+	return (pattern >= 0 && pattern < PATTERN_COUNT) ? g_patternNames[pattern] : "?";
+}
+
+ProceduralPattern FindProceduralPattern(const char* name)
+{
+	for (int pattern = PATTERN_NONE + 1; pattern < PATTERN_COUNT; pattern++) {
+		if (strcmp(name, g_patternNames[pattern]) == 0)
+			return (ProceduralPattern) pattern;
+	}
+	return PATTERN_NONE;
+}
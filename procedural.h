@@ -0,0 +1,38 @@
+// procedural.h
+//
+// Procedural surface patterns evaluated per fragment in GLSL instead of
+// sampled from a texture: no texture memory, no upload, and sharp at any
+// distance. Each pattern is box filtered over the pixel footprint (from
+// fwidth) so it antialiases the way a mipmapped texture would, and the
+// noise drops octaves before they alias. The vertex shader reproduces
+// fixed-function lighting for GL_LIGHT0, so a patterned surface lights
+// exactly like a textured one with GL_MODULATE.
+
+#ifndef PROCEDURAL_H
+#define PROCEDURAL_H
+
+#include "gl_extensions.h"
+
+enum ProceduralPattern {
+	PATTERN_NONE,           // use the material's texture
+	PATTERN_CHECKER,
+	PATTERN_STRIPES,
+	PATTERN_NOISE,
+	PATTERN_COUNT
+};
+
+// Compiles one program per pattern; without GLSL every pattern is
+// unavailable and callers fall back to their texture
+void InitProceduralPatterns(void);
+bool IsProceduralPatternAvailable(ProceduralPattern pattern);
+
+// Binds the pattern's program; scale is pattern cells per texture
+// coordinate unit. Returns false, binding nothing, if unavailable.
+bool BeginProceduralPattern(ProceduralPattern pattern, float scale);
+void EndProceduralPattern(void);
+
+const char* ProceduralPatternName(ProceduralPattern pattern);
+// PATTERN_NONE if name is not a pattern
+ProceduralPattern FindProceduralPattern(const char* name);
+
+#endif
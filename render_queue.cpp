@@ -0,0 +1,191 @@
+// render_queue.cpp
+//
+// Key bits, high to low: pass 3, occlusion tested 1, shader 12,
+// texture 16, material 8, depth 24. Fields wider than their bits are masked; that only costs
+// ordering, never correctness.
+
+#include "render_queue.h"
+#include "command_list.h"
+
+#include <string.h>
+
+#define KEY_PASS_SHIFT      61
+#define KEY_TESTED_SHIFT    60
+#define KEY_SHADER_SHIFT    48
+#define KEY_TEXTURE_SHIFT   32
+#define KEY_MATERIAL_SHIFT  24
+#define KEY_DEPTH_MAX       0xffffff
+
+typedef unsigned long long RenderKey;
+
+static RenderDraw g_draws[RENDER_QUEUE_SIZE];
+static RenderKey g_keys[RENDER_QUEUE_SIZE];
+static int g_order[RENDER_QUEUE_SIZE];
+static int g_sortBuffer[RENDER_QUEUE_SIZE];
+static int g_drawCount = 0;
+
+static Matrix4 g_view;
+static float g_nearPlane = 1, g_farPlane = 1000;
+static bool g_sorting = true;
+
+static int g_frameDraws = 0, g_frameRuns = 0, g_frameSubmitRuns = 0, g_frameFlushes = 0;
+static int g_lastDraws = 0, g_lastRuns = 0, g_lastSubmitRuns = 0, g_lastFlushes = 0;
+static int g_sortPasses = 0, g_skippedPasses = 0;
+
+void BeginRenderQueue(const Matrix4* view, float nearPlane, float farPlane)
+{
+	g_lastDraws = g_frameDraws;
+	g_lastRuns = g_frameRuns;
+	g_lastSubmitRuns = g_frameSubmitRuns;
+	g_lastFlushes = g_frameFlushes;
+	g_frameDraws = g_frameRuns = g_frameSubmitRuns = g_frameFlushes = 0;
+
+	g_view = *view;
+	g_nearPlane = nearPlane;
+	g_farPlane = farPlane > nearPlane ? farPlane : nearPlane + 1;
+	g_drawCount = 0;
+}
+
+void SetRenderQueueSorting(bool enabled)
+{
+	g_sorting = enabled;
+}
+
+static bool SameBinding(const RenderDraw* a, const RenderDraw* b)
+{
+	return a->bind == b->bind && a->user == b->user && a->textured == b->textured;
+}
+
+// Distance along the view direction to the center of the mesh bounds,
+// quantized so that nearer sorts first
+static RenderKey DepthBits(const RenderDraw* draw)
+{
+	const Mesh* mesh = draw->mesh;
+	Matrix4 modelView;
+	float center[4], eye[4];
+
+	MatrixMultiply(&modelView, &g_view, &draw->model);
+	for (int i = 0; i < 3; i++)
+		center[i] = 0.5f * (mesh->boundsMin[i] + mesh->boundsMax[i]);
+	center[3] = 1;
+	MatrixTransform(&modelView, center, eye);
+
+	float t = (-eye[2] - g_nearPlane) / (g_farPlane - g_nearPlane);
+	if (t < 0)
+		t = 0;
+	else if (t > 1)
+		t = 1;
+	RenderKey depth = (RenderKey) (t * KEY_DEPTH_MAX);
+	return draw->pass == RENDER_PASS_TRANSPARENT ? KEY_DEPTH_MAX - depth : depth;
+}
+
+static RenderKey MakeKey(const RenderDraw* draw)
+{
+	return ((RenderKey) (draw->pass & 0x7) << KEY_PASS_SHIFT) |
+		((RenderKey) (draw->occlusion != OCCLUSION_NONE) << KEY_TESTED_SHIFT) |
+		((RenderKey) (draw->shader & 0xfff) << KEY_SHADER_SHIFT) |
+		((RenderKey) (draw->texture & 0xffff) << KEY_TEXTURE_SHIFT) |
+		((RenderKey) (draw->material & 0xff) << KEY_MATERIAL_SHIFT) |
+		DepthBits(draw);
+}
+
+void SubmitDraw(const RenderDraw* draw)
+{
+	if (g_drawCount == RENDER_QUEUE_SIZE)
+		FlushRenderQueue();
+	if (draw->mesh == NULL)
+		return;
+
+	// Runs the draws would need unsorted, for the stats
+	if (g_drawCount == 0 || !SameBinding(&g_draws[g_drawCount - 1], draw))
+		g_frameSubmitRuns++;
+
+	g_draws[g_drawCount] = *draw;
+	g_keys[g_drawCount] = MakeKey(draw);
+	g_order[g_drawCount] = g_drawCount;
+	g_drawCount++;
+}
+
+// LSD radix sort of g_order by g_keys, a byte at a time. Stable, so equal
+// keys keep submission order. A byte every key shares is skipped, which
+// with a handful of distinct states is most of them.
+static void SortQueue(void)
+{
+	int counts[8][256];
+	int* src = g_order;
+	int* dst = g_sortBuffer;
+
+	memset(counts, 0, sizeof(counts));
+	for (int i = 0; i < g_drawCount; i++) {
+		RenderKey key = g_keys[i];
+		for (int b = 0; b < 8; b++)
+			counts[b][(key >> (b * 8)) & 0xff]++;
+	}
+
+	for (int b = 0; b < 8; b++) {
+		int* count = counts[b];
+		int shift = b * 8;
+
+		if (count[(g_keys[0] >> shift) & 0xff] == g_drawCount) {
+			g_skippedPasses++;
+			continue;
+		}
+		int offset = 0;
+		for (int i = 0; i < 256; i++) {
+			int n = count[i];
+			count[i] = offset;
+			offset += n;
+		}
+		for (int i = 0; i < g_drawCount; i++) {
+			int index = src[i];
+			dst[count[(g_keys[index] >> shift) & 0xff]++] = index;
+		}
+		int* swap = src;
+		src = dst;
+		dst = swap;
+		g_sortPasses++;
+	}
+	if (src != g_order)
+		memcpy(g_order, src, g_drawCount * sizeof(int));
+}
+
+void FlushRenderQueue(void)
+{
+	const RenderDraw* previous = NULL;
+
+	if (g_drawCount == 0)
+		return;
+	if (g_sorting)
+		SortQueue();
+
+	for (int i = 0; i < g_drawCount; i++) {
+		const RenderDraw* draw = &g_draws[g_order[i]];
+		bool run = previous == NULL || !SameBinding(previous, draw);
+
+		if (run && previous != NULL && previous->unbind != NULL)
+			CommandUnbind(previous->unbind, previous->user);
+		CommandSetObject(&draw->model, draw->material, draw->textured);
+		if (run) {
+			CommandBind(draw->bind, draw->user);
+			g_frameRuns++;
+		}
+		if (draw->occlusion != OCCLUSION_NONE)
+			DrawOccludable(draw->occlusion, draw->mesh, &draw->model, draw->material, draw->textured);
+		else
+			CommandDraw(draw->mesh);
+		previous = draw;
+	}
+	if (previous->unbind != NULL)
+		CommandUnbind(previous->unbind, previous->user);
+
+	g_frameDraws += g_drawCount;
+	g_frameFlushes++;
+	g_drawCount = 0;
+}
+
+void PrintRenderQueueStats(FILE* out)
+{
+	fprintf(out, "Render queue%s: %d draws in %d state runs (%d as submitted), %d flushes last frame\n",
+		g_sorting ? "" : " (unsorted)", g_lastDraws, g_lastRuns, g_lastSubmitRuns, g_lastFlushes);
+	fprintf(out, "  %d radix passes, %d skipped\n", g_sortPasses, g_skippedPasses);
+}
@@ -0,0 +1,72 @@
+// render_queue.h
+//
+// Draws are submitted rather than issued. Each gets a 64-bit sort key,
+// from the most significant bits down: pass, occlusion tested, shader,
+// texture, material, and view depth. FlushRenderQueue() radix sorts the
+// keys and then issues the draws in order, binding a program and its
+// textures only when the next draw needs a different one. Within a pass draws therefore group by
+// state first, and among draws sharing all of it go front to back, so the
+// depth test rejects hidden fragments early. Transparent draws invert the
+// depth field and go back to front after everything opaque. Occlusion
+// tested draws follow the untested ones of their pass, which are what
+// occludes them.
+//
+// Draws are issued through command_list.h, so a flush inside a command
+// recording is recorded, except for occlusion tested draws, which go
+// through DrawOccludable() (occlusion_query.h).
+//
+// The shader and texture fields only order the draws; two draws share a
+// binding when their bind function, user pointer and textured flag match.
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <stdio.h>
+
+#include "matrix.h"
+#include "mesh.h"
+#include "occlusion_query.h"
+#include "renderer.h"
+
+#define RENDER_QUEUE_SIZE 1024          // draws before the queue flushes itself
+
+enum RenderPass {
+	RENDER_PASS_OPAQUE,
+	RENDER_PASS_TRANSPARENT
+};
+
+// Binds the program and textures for a run of draws, after
+// SetRendererObject() for the first of them. The unbind function, if any,
+// runs when the run ends.
+typedef void (*RenderBindFunc)(void* user);
+
+struct RenderDraw {
+	RenderPass pass;
+	int shader;                    // equal for draws that bind the same program
+	GLuint texture;                // the texture name bound, or 0
+	const Mesh* mesh;
+	Matrix4 model;
+	MaterialHandle material;
+	bool textured;
+	RenderBindFunc bind;           // NULL binds the scene program
+	RenderBindFunc unbind;
+	void* user;
+	OcclusionHandle occlusion;     // OCCLUSION_NONE draws unconditionally
+};
+
+// Starts a frame's queue. Depth is measured from the mesh bounds' center
+// in view space and quantized over [nearPlane, farPlane].
+void BeginRenderQueue(const Matrix4* view, float nearPlane, float farPlane);
+
+// Copies the draw
+void SubmitDraw(const RenderDraw* draw);
+
+// Sorts and issues everything submitted since the last flush
+void FlushRenderQueue(void);
+
+// false issues draws in submission order, for comparison
+void SetRenderQueueSorting(bool enabled);
+
+void PrintRenderQueueStats(FILE* out);
+
+#endif
@@ -0,0 +1,703 @@
+// renderer.cpp
+//
+// Uniform blocks use the std140 layout, mirrored by the structs below.
+
+#include "renderer.h"
+#include "gl_state.h"
+#include "light_clusters.h"
+#include "shader.h"
+#include "shadow_map.h"
+
+#include <string.h>
+
+#define OBJECT_SLOTS 256               // object blocks per buffer before it is orphaned
+#define RECORDED_OBJECTS 256           // objects a recorded command list can hold
+
+struct FrameBlock {
+	float projection[16];
+	float shadowMatrix[16];            // eye space to shadow map
+	float lightPosition[4];            // eye space
+	float lightAmbient[4];
+	float lightDiffuse[4];
+	float lightSpecular[4];
+	float sceneAmbient[4];
+	int lighting;
+	int texturing;
+	int shadowing;
+	int wireframe;                     // RendererWireframe
+};
+
+struct MaterialBlock {
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float shininess;
+	float pad[3];
+};
+
+struct ObjectBlock {
+	float modelView[16];
+	int material;
+	int textured;
+	int pad[2];
+};
+
+static bool g_rendererEnabled = false;
+static GLuint g_sceneProgram = 0;
+static GLuint g_frameBuffer = 0;
+static GLuint g_materialBuffer = 0;
+static GLuint g_objectBuffer = 0;
+static GLsizeiptr g_objectStride = 0;
+static int g_objectSlot = 0;
+static char g_sceneHeader[256];
+static char g_customHeader[320];          // SceneShaderHeader(): g_sceneHeader, wireframe and G-buffer output
+static bool g_shadowReceiving = false;    // the scene program samples the shadow map
+static GLuint g_gbufferProgram = 0;       // the scene program's G-buffer variant
+static bool g_gbuffer = false;            // UseSceneProgram() binds it
+static RendererWireframe g_wireframe = WIREFRAME_OFF;
+static RendererWireframe g_frameWireframe = WIREFRAME_OFF;   // the Frame block's
+
+// Objects that outlive the frame, for command list replay. The
+// fixed-function path loads them from here; the GLSL path from their
+// blocks in g_recordedBuffer.
+struct RecordedObject {
+	Matrix4 modelView;
+	MaterialHandle material;
+	bool textured;
+};
+
+static GLuint g_recordedBuffer = 0;
+static RecordedObject g_recordedObjects[RECORDED_OBJECTS];
+static int g_recordedCount = 0;
+
+static Material g_materials[MAX_MATERIALS];
+static int g_materialCount = 0;
+static bool g_lighting = true;
+static bool g_texturing = true;
+static Matrix4 g_view;
+
+// Per frame, and the last complete frame
+static int g_draws = 0, g_objects = 0, g_replayedObjects = 0;
+static int g_lastDraws = 0, g_lastObjects = 0, g_lastReplayedObjects = 0;
+
+static const char* g_sceneVertexShader =
+	"layout(std140) uniform Frame {\n"
+	"	mat4 u_projection;\n"
+	"	mat4 u_shadowMatrix;\n"
+	"	vec4 u_lightPosition;\n"
+	"	vec4 u_lightAmbient;\n"
+	"	vec4 u_lightDiffuse;\n"
+	"	vec4 u_lightSpecular;\n"
+	"	vec4 u_sceneAmbient;\n"
+	"	int u_lighting;\n"
+	"	int u_texturing;\n"
+	"	int u_shadowing;\n"
+	"	int u_wireframe;\n"
+	"};\n"
+	"\n"
+	"struct Material {\n"
+	"	vec4 ambient;\n"
+	"	vec4 diffuse;\n"
+	"	vec4 specular;\n"
+	"	float shininess;\n"
+	"};\n"
+	"\n"
+	"layout(std140) uniform Materials {\n"
+	"	Material u_materials[MAX_MATERIALS];\n"
+	"};\n"
+	"\n"
+	"layout(std140) uniform Object {\n"
+	"	mat4 u_modelView;\n"
+	"	int u_material;\n"
+	"	int u_textured;\n"
+	"};\n"
+	"\n"
+	"in vec3 a_position;\n"
+	"in vec3 a_normal;\n"
+	"in vec2 a_texCoord;\n"
+	"out vec4 v_color;\n"
+	"out vec2 v_texCoord;\n"
+	"out float v_textured;\n"
+	"\n"
+	"// For per-pixel point lights\n"
+	"out vec3 v_position;\n"
+	"out vec3 v_normal;\n"
+	"out vec4 v_clipPosition;\n"
+	"out vec4 v_diffuse;\n"
+	"out vec4 v_specular;\n"
+	"\n"
+	"// For the shadow map: the light's own contribution, which a shadow\n"
+	"// takes away\n"
+	"out vec4 v_shadowCoord;\n"
+	"out vec4 v_direct;\n"
+	"out float v_shadowing;\n"
+	"\n"
+	"// For the G-buffer\n"
+	"out float v_material;\n"
+	"\n"
+	"// For the wireframe, drawn from the mesh's unshared triangles: one\n"
+	"// corner of the triangle per component\n"
+	"out vec3 v_barycentric;\n"
+	"out float v_wireframe;\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	vec4 position = u_modelView * vec4(a_position, 1.0);\n"
+	"	Material material = u_materials[u_material];\n"
+	"	gl_Position = u_projection * position;\n"
+	"	v_texCoord = a_texCoord;\n"
+	"	v_textured = (u_texturing != 0 && u_textured != 0) ? 1.0 : 0.0;\n"
+	"\n"
+	"	// Model-view matrices are rigid, so they transform normals as is\n"
+	"	vec3 normal = normalize(mat3(u_modelView) * a_normal);\n"
+	"	v_position = position.xyz;\n"
+	"	v_normal = normal;\n"
+	"	v_clipPosition = gl_Position;\n"
+	"	v_diffuse = material.diffuse;\n"
+	"	v_specular = vec4(material.specular.rgb, material.shininess);\n"
+	"	v_shadowCoord = u_shadowMatrix * position;\n"
+	"	v_direct = vec4(0.0);\n"
+	"	v_shadowing = u_shadowing != 0 ? 1.0 : 0.0;\n"
+	"	v_material = float(u_material);\n"
+	"	v_barycentric = vec3(equal(ivec3(gl_VertexID % 3), ivec3(0, 1, 2)));\n"
+	"	v_wireframe = float(u_wireframe);\n"
+	"	if (u_lighting == 0) {\n"
+	"		v_color = material.diffuse;\n"
+	"		return;\n"
+	"	}\n"
+	"\n"
+	"	vec3 light = normalize(u_lightPosition.xyz - position.xyz * u_lightPosition.w);\n"
+	"	float diffuse = max(dot(normal, light), 0.0);\n"
+	"	vec4 direct = diffuse * u_lightDiffuse * material.diffuse;\n"
+	"	if (diffuse > 0.0) {\n"
+	"		vec3 halfway = normalize(light + vec3(0.0, 0.0, 1.0));\n"
+	"		float specular = pow(max(dot(normal, halfway), 0.0), material.shininess);\n"
+	"		direct += specular * u_lightSpecular * material.specular;\n"
+	"	}\n"
+	"	vec4 color = (u_sceneAmbient + u_lightAmbient) * material.ambient + direct;\n"
+	"	v_direct = direct;\n"
+	"	v_color = vec4(color.rgb, material.diffuse.a);\n"
+	"}\n";
+
+// Texture modulates the lit color, specular included, like GL_MODULATE.
+// Point lights, when clustered, add to the lit color per pixel, with a
+// falloff that reaches zero at the light's radius. The shadow map, when
+// there is one, takes away GL_LIGHT0's direct light in proportion to the
+// filtered comparison; outside the map everything is lit. The G-buffer
+// variant leaves the point lights out and stores what the deferred
+// lighting pass needs for them: the texel, the material index plus one
+// (0 marks pixels the pass skips) and the normal, folded octahedrally
+// into two channels. The wireframe measures each pixel's distance to the
+// nearest edge of its triangle in pixels, from how fast the barycentric
+// coordinates change across it: wireframe alone discards all but about a
+// pixel either side of the edges, the overlay fades the texel to black
+// over the pixel nearest them.
+static const char* g_sceneFragmentShader =
+	"uniform sampler2D u_texture;\n"
+	"varying vec4 v_color;\n"
+	"varying vec2 v_texCoord;\n"
+	"varying float v_textured;\n"
+	"varying vec3 v_barycentric;\n"
+	"varying float v_wireframe;\n"
+	"\n"
+	"#ifdef CLUSTERED_LIGHTS\n"
+	"layout(std140) uniform Clusters {\n"
+	"	vec4 u_clusterScale;\n"
+	"	ivec4 u_clusterCount;\n"
+	"};\n"
+	"\n"
+	"uniform usamplerBuffer u_clusterRanges;\n"
+	"uniform usamplerBuffer u_lightIndices;\n"
+	"uniform samplerBuffer u_pointLights;\n"
+	"varying vec3 v_position;\n"
+	"varying vec3 v_normal;\n"
+	"varying vec4 v_clipPosition;\n"
+	"varying vec4 v_diffuse;\n"
+	"varying vec4 v_specular;\n"
+	"\n"
+	"vec3 PointLighting()\n"
+	"{\n"
+	"	vec2 ndc = v_clipPosition.xy / v_clipPosition.w;\n"
+	"	ivec2 tile = clamp(ivec2(floor((ndc * 0.5 + 0.5) * vec2(u_clusterCount.xy))),\n"
+	"		ivec2(0), u_clusterCount.xy - 1);\n"
+	"	int slice = clamp(int(floor(log(-v_position.z) * u_clusterScale.z - u_clusterScale.w)),\n"
+	"		0, u_clusterCount.z - 1);\n"
+	"	int cluster = (slice * u_clusterCount.y + tile.y) * u_clusterCount.x + tile.x;\n"
+	"	uvec2 range = texelFetch(u_clusterRanges, cluster).xy;\n"
+	"\n"
+	"	vec3 normal = normalize(v_normal);\n"
+	"	vec3 view = normalize(-v_position);\n"
+	"	vec3 color = vec3(0.0);\n"
+	"	for (uint i = 0u; i < range.y; i++) {\n"
+	"		int index = int(texelFetch(u_lightIndices, int(range.x + i)).r);\n"
+	"		vec4 light = texelFetch(u_pointLights, 2 * index);\n"
+	"		vec3 toLight = light.xyz - v_position;\n"
+	"		float distance2 = dot(toLight, toLight);\n"
+	"		float reach = 1.0 - distance2 / (light.w * light.w);\n"
+	"		if (reach <= 0.0)\n"
+	"			continue;\n"
+	"		vec3 direction = toLight * inversesqrt(distance2);\n"
+	"		float diffuse = dot(normal, direction);\n"
+	"		if (diffuse <= 0.0)\n"
+	"			continue;\n"
+	"		float specular = pow(max(dot(normal, normalize(direction + view)), 0.0), v_specular.a);\n"
+	"		vec3 lightColor = texelFetch(u_pointLights, 2 * index + 1).rgb * (reach * reach);\n"
+	"		color += lightColor * (diffuse * v_diffuse.rgb + specular * v_specular.rgb);\n"
+	"	}\n"
+	"	return color;\n"
+	"}\n"
+	"#endif\n"
+	"\n"
+	"#ifdef SHADOW_MAP\n"
+	"uniform sampler2DShadow u_shadowMap;\n"
+	"varying vec4 v_shadowCoord;\n"
+	"varying vec4 v_direct;\n"
+	"varying float v_shadowing;\n"
+	"\n"
+	"float ShadowVisibility()\n"
+	"{\n"
+	"	vec3 coord = v_shadowCoord.xyz / v_shadowCoord.w;\n"
+	"	if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0))))\n"
+	"		return 1.0;\n"
+	"	return texture(u_shadowMap, coord);\n"
+	"}\n"
+	"#endif\n"
+	"\n"
+	"#ifdef GBUFFER\n"
+	"out vec4 gbufferAlbedo;\n"
+	"out vec4 gbufferNormal;\n"
+	"varying vec3 v_normal;\n"
+	"varying float v_material;\n"
+	"\n"
+	"vec2 EncodeNormal(vec3 n)\n"
+	"{\n"
+	"	n /= abs(n.x) + abs(n.y) + abs(n.z);\n"
+	"	vec2 folded = n.z >= 0.0 ? n.xy :\n"
+	"		(1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+	"	return folded * 0.5 + 0.5;\n"
+	"}\n"
+	"#endif\n"
+	"\n"
+	"float EdgeDistance()\n"
+	"{\n"
+	"	vec3 pixels = v_barycentric / max(fwidth(v_barycentric), vec3(1e-6));\n"
+	"	return min(min(pixels.x, pixels.y), pixels.z);\n"
+	"}\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	float edge = EdgeDistance();\n"
+	"	if (v_wireframe > 0.5 && v_wireframe < 1.5 && edge > 1.0)\n"
+	"		discard;\n"
+	"	vec4 color = v_color;\n"
+	"#ifdef SHADOW_MAP\n"
+	"	if (v_shadowing > 0.5)\n"
+	"		color.rgb -= (1.0 - ShadowVisibility()) * v_direct.rgb;\n"
+	"#endif\n"
+	"#ifdef CLUSTERED_LIGHTS\n"
+	"	if (u_clusterCount.w > 0)\n"
+	"		color.rgb += PointLighting();\n"
+	"#endif\n"
+	"	vec4 texel = mix(vec4(1.0), texture2D(u_texture, v_texCoord), v_textured);\n"
+	"	if (v_wireframe > 1.5)\n"
+	"		texel.rgb *= clamp(edge, 0.0, 1.0);\n"
+	"#ifdef GBUFFER\n"
+	"	gbufferAlbedo = vec4(texel.rgb, (floor(v_material + 0.5) + 1.0) / 255.0);\n"
+	"	gbufferNormal = vec4(EncodeNormal(normalize(v_normal)), 0.0, 0.0);\n"
+	"#endif\n"
+	"	fragColor = color * texel;\n"
+	"}\n";
+
+static const char* g_legacyHeader =
+	"#version 110\n"
+	"#define fragColor gl_FragColor\n";
+
+static void SetColor(float color[4], float r, float g, float b, float a)
+{
+	color[0] = r;
+	color[1] = g;
+	color[2] = b;
+	color[3] = a;
+}
+
+static void UploadMaterials(void)
+{
+	MaterialBlock blocks[MAX_MATERIALS];
+
+	memset(blocks, 0, sizeof(blocks));
+	for (int i = 0; i < g_materialCount; i++) {
+		memcpy(blocks[i].ambient, g_materials[i].ambient, sizeof(blocks[i].ambient));
+		memcpy(blocks[i].diffuse, g_materials[i].diffuse, sizeof(blocks[i].diffuse));
+		memcpy(blocks[i].specular, g_materials[i].specular, sizeof(blocks[i].specular));
+		blocks[i].shininess = g_materials[i].shininess;
+	}
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_materialBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(blocks), blocks);
+	CachedBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+bool InitRenderer(void)
+{
+	GLint alignment = 0;
+
+	// Slot 0 backs MATERIAL_NONE: the fixed-function default material
+	memset(g_materials, 0, sizeof(g_materials));
+	SetColor(g_materials[0].ambient, 0.2f, 0.2f, 0.2f, 1);
+	SetColor(g_materials[0].diffuse, 0.8f, 0.8f, 0.8f, 1);
+	SetColor(g_materials[0].specular, 0, 0, 0, 1);
+	g_materialCount = 1;
+	MatrixIdentity(&g_view);
+
+	if (!g_glCaps.uniformBufferObject || !g_glCaps.vertexArrayObject)
+		return false;
+
+	// Vertex shaders are written for their version and only fragment
+	// shaders are shared, so the header can turn every varying into an
+	// input. The vertex stage declares fragColor too and never writes it.
+	snprintf(g_sceneHeader, sizeof(g_sceneHeader),
+		"#version 140\n"
+		"#define MAX_MATERIALS %d\n"
+		"#define varying in\n"
+		"#define texture2D texture\n"
+		"out vec4 fragColor;\n", MAX_MATERIALS);
+
+	// Point lights need integer texture buffers and the shadow map needs
+	// framebuffer objects; without them the scene program leaves out the
+	// clustered light loop and the shadow lookup
+	bool clustered = false;
+	if (g_glCaps.textureBufferObject || g_glCaps.framebufferObject) {
+		char header[320];
+		snprintf(header, sizeof(header), "%s%s%s", g_sceneHeader,
+			g_glCaps.textureBufferObject ? "#define CLUSTERED_LIGHTS\n" : "",
+			g_glCaps.framebufferObject ? "#define SHADOW_MAP\n" : "");
+		g_sceneProgram = CreateShaderProgram("scene", header,
+			g_sceneVertexShader, g_sceneFragmentShader);
+		clustered = g_sceneProgram != 0 && g_glCaps.textureBufferObject;
+		g_shadowReceiving = g_sceneProgram != 0 && g_glCaps.framebufferObject;
+	}
+	if (!g_sceneProgram) {
+		g_sceneProgram = CreateShaderProgram("scene", g_sceneHeader,
+			g_sceneVertexShader, g_sceneFragmentShader);
+	}
+	if (!g_sceneProgram)
+		return false;
+
+	// Deferred shading lights the point lights from a G-buffer, and only
+	// when they could be lit forward
+	if (clustered && g_glCaps.multipleRenderTargets) {
+		char header[320];
+		snprintf(header, sizeof(header), "%s#define GBUFFER\n#define SHADOW_MAP\n", g_sceneHeader);
+		g_gbufferProgram = CreateShaderProgram("scene g-buffer", header,
+			g_sceneVertexShader, g_sceneFragmentShader);
+	}
+
+	// Other programs draw into the same G-buffer and mark their pixels for
+	// the lighting pass to skip, rather than leave whatever was under them
+	snprintf(g_customHeader, sizeof(g_customHeader), "%s#define WIREFRAME\n%s", g_sceneHeader,
+		g_gbufferProgram ? "#define GBUFFER\nout vec4 gbufferAlbedo;\n" : "");
+
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment < 1)
+		alignment = 256;
+	g_objectStride = (sizeof(ObjectBlock) + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &g_frameBuffer);
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+	glGenBuffers(1, &g_materialBuffer);
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(MaterialBlock), NULL, GL_STATIC_DRAW);
+	glGenBuffers(1, &g_objectBuffer);
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_objectBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, OBJECT_SLOTS * g_objectStride, NULL, GL_STREAM_DRAW);
+	glGenBuffers(1, &g_recordedBuffer);
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_recordedBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, RECORDED_OBJECTS * g_objectStride, NULL, GL_DYNAMIC_DRAW);
+	CachedBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	CachedBindBufferBase(GL_UNIFORM_BUFFER, BLOCK_FRAME, g_frameBuffer);
+	CachedBindBufferBase(GL_UNIFORM_BUFFER, BLOCK_MATERIALS, g_materialBuffer);
+	if (clustered)
+		InitLightClusters(g_sceneProgram);
+	if (g_shadowReceiving) {
+		CachedUseProgram(g_sceneProgram);
+		glUniform1i(glGetUniformLocation(g_sceneProgram, "u_shadowMap"), SHADOW_TEXTURE_UNIT);
+	}
+	if (g_gbufferProgram) {
+		CachedUseProgram(g_gbufferProgram);
+		glUniform1i(glGetUniformLocation(g_gbufferProgram, "u_shadowMap"), SHADOW_TEXTURE_UNIT);
+	}
+	g_rendererEnabled = true;
+	UploadMaterials();
+	return true;
+}
+
+bool IsRendererEnabled(void)
+{
+	return g_rendererEnabled;
+}
+
+MaterialHandle CreateMaterial(const Material* material)
+{
+	if (g_materialCount >= MAX_MATERIALS)
+		return MATERIAL_NONE;
+
+	MaterialHandle handle = g_materialCount++;
+	g_materials[handle] = *material;
+	if (g_rendererEnabled)
+		UploadMaterials();
+	return handle;
+}
+
+void SetRendererLighting(bool enabled)
+{
+	g_lighting = enabled;
+	if (g_rendererEnabled)
+		return;
+	if (enabled)
+		CachedEnable(GL_LIGHTING);
+	else
+		CachedDisable(GL_LIGHTING);
+}
+
+void SetRendererTexturing(bool enabled)
+{
+	g_texturing = enabled;
+	if (g_rendererEnabled)
+		return;
+	if (enabled)
+		CachedEnable(GL_TEXTURE_2D);
+	else
+		CachedDisable(GL_TEXTURE_2D);
+}
+
+void SetRendererWireframe(RendererWireframe mode)
+{
+	g_wireframe = mode;
+	if (!g_rendererEnabled)
+		glPolygonMode(GL_FRONT_AND_BACK, mode != WIREFRAME_OFF ? GL_LINE : GL_FILL);
+}
+
+void BeginRendererFrame(const Matrix4* projection, const Matrix4* view,
+	const float lightPosition[4])
+{
+	g_lastDraws = g_draws;
+	g_lastObjects = g_objects;
+	g_lastReplayedObjects = g_replayedObjects;
+	g_draws = g_objects = g_replayedObjects = 0;
+	g_view = *view;
+	g_frameWireframe = g_wireframe;
+
+	if (!g_rendererEnabled) {
+		glMatrixMode(GL_PROJECTION);
+		glLoadMatrixf(projection->m);
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(view->m);
+		glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
+		return;
+	}
+
+	// GL_LIGHT0 defaults, and the default light model ambient
+	FrameBlock frame;
+	memset(&frame, 0, sizeof(frame));
+	memcpy(frame.projection, projection->m, sizeof(frame.projection));
+	MatrixTransform(view, lightPosition, frame.lightPosition);
+	SetColor(frame.lightAmbient, 0, 0, 0, 1);
+	SetColor(frame.lightDiffuse, 1, 1, 1, 1);
+	SetColor(frame.lightSpecular, 1, 1, 1, 1);
+	SetColor(frame.sceneAmbient, 0.2f, 0.2f, 0.2f, 1);
+	frame.lighting = g_lighting;
+	frame.texturing = g_texturing;
+	frame.wireframe = g_frameWireframe;
+	Matrix4 shadowMatrix;
+	if (g_shadowReceiving && GetShadowMatrix(view, &shadowMatrix)) {
+		memcpy(frame.shadowMatrix, shadowMatrix.m, sizeof(frame.shadowMatrix));
+		frame.shadowing = 1;
+	}
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_frameBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+	BuildLightClusters(projection, view, g_lighting);
+
+	// Orphan last frame's object blocks rather than wait for the GPU to
+	// finish reading them
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_objectBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, OBJECT_SLOTS * g_objectStride, NULL, GL_STREAM_DRAW);
+	g_objectSlot = 0;
+}
+
+static void LoadFixedFunctionObject(const Matrix4* modelView, MaterialHandle material, bool textured)
+{
+	const Material* m = &g_materials[material];
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(modelView->m);
+	CachedMaterialfv(GL_FRONT, GL_AMBIENT, m->ambient);
+	CachedMaterialfv(GL_FRONT, GL_DIFFUSE, m->diffuse);
+	CachedMaterialfv(GL_FRONT, GL_SPECULAR, m->specular);
+	CachedMaterialf(GL_FRONT, GL_SHININESS, m->shininess);
+	CachedColor4fv(m->diffuse);
+	if (!textured)
+		CachedBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void FillObjectBlock(ObjectBlock* object, const Matrix4* modelView,
+	MaterialHandle material, bool textured)
+{
+	memset(object, 0, sizeof(*object));
+	memcpy(object->modelView, modelView->m, sizeof(object->modelView));
+	object->material = material;
+	object->textured = textured;
+}
+
+void SetRendererObject(const Matrix4* model, MaterialHandle material, bool textured)
+{
+	Matrix4 modelView;
+
+	if (material < 0 || material >= g_materialCount)
+		material = MATERIAL_NONE;
+	MatrixMultiply(&modelView, &g_view, model);
+	g_objects++;
+
+	if (!g_rendererEnabled) {
+		LoadFixedFunctionObject(&modelView, material, textured);
+		return;
+	}
+
+	ObjectBlock object;
+	FillObjectBlock(&object, &modelView, material, textured);
+
+	if (g_objectSlot == OBJECT_SLOTS) {
+		CachedBindBuffer(GL_UNIFORM_BUFFER, g_objectBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, OBJECT_SLOTS * g_objectStride, NULL, GL_STREAM_DRAW);
+		g_objectSlot = 0;
+	}
+	GLintptr offset = g_objectSlot++ * g_objectStride;
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_objectBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(object), &object);
+	CachedBindBufferRange(GL_UNIFORM_BUFFER, BLOCK_OBJECT, g_objectBuffer, offset, sizeof(object));
+}
+
+void ClearRecordedObjects(void)
+{
+	g_recordedCount = 0;
+	if (!g_rendererEnabled)
+		return;
+
+	// Orphaned, so replays the GPU has yet to finish keep their blocks
+	CachedBindBuffer(GL_UNIFORM_BUFFER, g_recordedBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, RECORDED_OBJECTS * g_objectStride, NULL, GL_DYNAMIC_DRAW);
+}
+
+static void LoadRecordedObject(int slot)
+{
+	const RecordedObject* recorded = &g_recordedObjects[slot];
+
+	if (!g_rendererEnabled) {
+		LoadFixedFunctionObject(&recorded->modelView, recorded->material, recorded->textured);
+		return;
+	}
+	CachedBindBufferRange(GL_UNIFORM_BUFFER, BLOCK_OBJECT, g_recordedBuffer,
+		slot * g_objectStride, sizeof(ObjectBlock));
+}
+
+int RecordRendererObject(const Matrix4* model, MaterialHandle material, bool textured)
+{
+	if (g_recordedCount == RECORDED_OBJECTS)
+		return -1;
+	if (material < 0 || material >= g_materialCount)
+		material = MATERIAL_NONE;
+
+	int slot = g_recordedCount++;
+	RecordedObject* recorded = &g_recordedObjects[slot];
+	MatrixMultiply(&recorded->modelView, &g_view, model);
+	recorded->material = material;
+	recorded->textured = textured;
+	g_objects++;
+
+	if (g_rendererEnabled) {
+		ObjectBlock object;
+		FillObjectBlock(&object, &recorded->modelView, material, textured);
+		CachedBindBuffer(GL_UNIFORM_BUFFER, g_recordedBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, slot * g_objectStride, sizeof(object), &object);
+	}
+	LoadRecordedObject(slot);
+	return slot;
+}
+
+void SetRecordedObject(int slot)
+{
+	g_replayedObjects++;
+	LoadRecordedObject(slot);
+}
+
+bool SetRendererGBuffer(bool enabled)
+{
+	g_gbuffer = enabled && g_gbufferProgram != 0;
+	return g_gbuffer || !enabled;
+}
+
+void UseSceneProgram(void)
+{
+	if (g_rendererEnabled)
+		CachedUseProgram(g_gbuffer ? g_gbufferProgram : g_sceneProgram);
+	else if (g_glCaps.shaderObjects)
+		CachedUseProgram(0);
+}
+
+void DrawMesh(const Mesh* mesh)
+{
+	g_draws++;
+	if (g_rendererEnabled && mesh->vertexArray) {
+		// Left bound: the next draw usually binds another mesh, and the
+		// state cache drops the bind when it is the same one
+		if (g_frameWireframe != WIREFRAME_OFF)
+			UploadMeshWireframe(mesh);
+		if (g_frameWireframe != WIREFRAME_OFF && mesh->wireArray) {
+			CachedBindVertexArray(mesh->wireArray);
+			glDrawArrays(GL_TRIANGLES, 0, mesh->indexCount);
+			return;
+		}
+		CachedBindVertexArray(mesh->vertexArray);
+		glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, NULL);
+		return;
+	}
+
+	if (g_glCaps.vertexArrayObject)
+		CachedBindVertexArray(0);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex), mesh->vertices[0].position);
+	glNormalPointer(GL_FLOAT, sizeof(MeshVertex), mesh->vertices[0].normal);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(MeshVertex), mesh->vertices[0].texCoord);
+	glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, mesh->indices);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+const char* SceneShaderHeader(void)
+{
+	return g_rendererEnabled ? g_customHeader : g_legacyHeader;
+}
+
+const char* SceneVertexShader(void)
+{
+	return g_rendererEnabled ? g_sceneVertexShader : g_lightingVertexShader;
+}
+
+void PrintRendererStats(FILE* out)
+{
+	if (!g_rendererEnabled) {
+		fprintf(out, "Renderer: fixed function, %d draws last frame\n", g_lastDraws);
+		return;
+	}
+	fprintf(out, "Renderer: GLSL 1.40 with uniform blocks, %d materials\n", g_materialCount - 1);
+	fprintf(out, "  %d draws, %d object blocks written (%d bytes), %d replayed last frame\n",
+		g_lastDraws, g_lastObjects, (int) (g_lastObjects * sizeof(ObjectBlock)),
+		g_lastReplayedObjects);
+	if (g_frameWireframe != WIREFRAME_OFF)
+		fprintf(out, "  wireframe %s, from unshared triangles in one filled pass\n",
+			g_frameWireframe == WIREFRAME_OVERLAY ? "over the shading" : "only");
+}
@@ -0,0 +1,115 @@
+// renderer.h
+//
+// Scene drawing through a GLSL 1.40 program that takes its light, materials
+// and transforms from uniform buffer objects instead of fixed-function
+// state. The Frame block (projection, the light in eye space, the lighting
+// and texturing switches) is written once per frame; the Materials block
+// only when a material is created; each draw's Object block (model-view
+// matrix, material index) goes into the next slot of a per-frame buffer
+// and is selected with glBindBufferRange. Lighting is per vertex and
+// matches fixed-function GL_LIGHT0, so the picture does not change.
+//
+// With texture buffer objects the scene program also shades the point
+// lights set with SetPointLights() (light_clusters.h) per pixel, on top of
+// GL_LIGHT0; BeginRendererFrame() assigns them to clusters. With
+// framebuffer objects it also darkens GL_LIGHT0's contribution where the
+// shadow map (shadow_map.h) has a caster. Programs built from
+// SceneShaderHeader() keep to GL_LIGHT0 and are never shadowed. When the
+// point lights can be shaded and the driver has multiple render targets,
+// a G-buffer variant of the scene program lets deferred.h shade them after
+// all geometry is drawn instead.
+//
+// The wireframe is drawn in the same filled pass as everything else, its
+// edges found in the fragment shader from barycentric coordinates rather
+// than rasterized as lines. Only the fixed-function fallback gets
+// glPolygonMode(GL_LINE) instead.
+//
+// GLUT cannot ask for a core profile, so the program runs in whatever
+// context it gets, but it uses nothing the core profile lacks. Without
+// uniform buffers (before GL 3.1) the same calls drive the fixed-function
+// pipeline instead: glLoadMatrixf, glMaterialfv and client vertex arrays.
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <stdio.h>
+
+#include "gl_extensions.h"
+#include "matrix.h"
+#include "mesh.h"
+
+#define MAX_MATERIALS 16
+
+struct Material {
+	float ambient[4];
+	float diffuse[4];              // also the unlit color
+	float specular[4];
+	float shininess;
+};
+
+typedef int MaterialHandle;
+#define MATERIAL_NONE 0
+
+// Call after InitGLExtensions(). Returns false when the fixed-function
+// fallback is in use.
+bool InitRenderer(void);
+bool IsRendererEnabled(void);
+
+MaterialHandle CreateMaterial(const Material* material);
+
+void SetRendererLighting(bool enabled);
+void SetRendererTexturing(bool enabled);
+
+enum RendererWireframe {
+	WIREFRAME_OFF = 0,
+	WIREFRAME_ONLY,            // the edges alone, shaded as the surface
+	WIREFRAME_OVERLAY          // the edges darkened over the shaded surface
+};
+
+// Takes effect from the next frame. In the fixed-function fallback both
+// modes draw lines only.
+void SetRendererWireframe(RendererWireframe mode);
+
+// Starts a frame; lightPosition is in world space, as glLightfv would take
+// it with the view matrix loaded
+void BeginRendererFrame(const Matrix4* projection, const Matrix4* view,
+	const float lightPosition[4]);
+
+// Transform and material for the draws that follow. Untextured objects
+// ignore whatever texture is bound.
+void SetRendererObject(const Matrix4* model, MaterialHandle material, bool textured);
+
+// Objects for recorded command lists, written once with the current view
+// and kept until cleared. RecordRendererObject() also makes the object
+// current, like SetRendererObject(), and returns its slot, or -1 when
+// storage is full.
+void ClearRecordedObjects(void);
+int RecordRendererObject(const Matrix4* model, MaterialHandle material, bool textured);
+void SetRecordedObject(int slot);
+
+// Whether UseSceneProgram() binds the G-buffer variant, which writes
+// GL_LIGHT0's shading to fragColor and leaves the point lights to
+// deferred.h. Returns false when asked for a variant there is not.
+bool SetRendererGBuffer(bool enabled);
+
+// Binds the scene program. Programs built from SceneShaderHeader() and
+// SceneVertexShader() may be bound in its place.
+void UseSceneProgram(void);
+void DrawMesh(const Mesh* mesh);
+
+// For programs that shade scene objects with their own fragment shader.
+// The header goes first and carries the #version; fragment shaders read
+// varying vec4 v_color and vec2 v_texCoord, sample with texture2D and
+// write fragColor, and the header maps those onto whichever GLSL version
+// the active path compiles. With the GLSL path the header defines
+// WIREFRAME, and such shaders read varying vec3 v_barycentric and float
+// v_wireframe (a RendererWireframe) to draw the wireframe as the scene
+// program does. When there is a G-buffer variant the header
+// also defines GBUFFER and declares out vec4 gbufferAlbedo, which such
+// shaders set to vec4(0.0) so deferred.h leaves their pixels as shaded.
+const char* SceneShaderHeader(void);
+const char* SceneVertexShader(void);
+
+void PrintRendererStats(FILE* out);
+
+#endif
@@ -0,0 +1,137 @@
+// shader.cpp
+//
+// GLSL compile and link with info log reporting.
+
+#include "shader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void PrintInfoLog(const char* label, const char* stage, GLuint object, bool program)
+{
+	GLint length = 0;
+
+	if (program)
+		glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+	else
+		glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+
+	char* log = (char*) malloc(length > 1 ? length : 1);
+	log[0] = '\0';
+	if (length > 1) {
+		if (program)
+			glGetProgramInfoLog(object, length, NULL, log);
+		else
+			glGetShaderInfoLog(object, length, NULL, log);
+	}
+	fprintf(stderr, "Shader %s: %s failed\n%s\n", label, stage, log);
+	free(log);
+}
+
+static GLuint CompileShader(const char* label, GLenum type, const char* header, const char* source)
+{
+	const GLchar* sources[2] = { header ? header : "", source };
+	GLuint shader = glCreateShader(type);
+	GLint status = 0;
+
+	glShaderSource(shader, 2, sources, NULL);
+	glCompileShader(shader);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		PrintInfoLog(label, type == GL_VERTEX_SHADER ? "vertex compile" : "fragment compile",
+			shader, false);
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+static void BindUniformBlock(GLuint program, const char* name, GLuint binding)
+{
+	GLuint index = glGetUniformBlockIndex(program, name);
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, index, binding);
+}
+
+GLuint CreateShaderProgram(const char* label, const char* header,
+	const char* vertexSource, const char* fragmentSource)
+{
+	if (!g_glCaps.shaderObjects)
+		return 0;
+
+	GLuint vertex = CompileShader(label, GL_VERTEX_SHADER, header, vertexSource);
+	GLuint fragment = CompileShader(label, GL_FRAGMENT_SHADER, header, fragmentSource);
+	GLuint program = 0;
+
+	if (vertex && fragment) {
+		GLint status = 0;
+		program = glCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		glBindAttribLocation(program, ATTRIB_POSITION, "a_position");
+		glBindAttribLocation(program, ATTRIB_NORMAL, "a_normal");
+		glBindAttribLocation(program, ATTRIB_TEXCOORD, "a_texCoord");
+		if (g_glCaps.multipleRenderTargets) {
+			glBindFragDataLocation(program, FRAG_COLOR, "fragColor");
+			glBindFragDataLocation(program, FRAG_ALBEDO, "gbufferAlbedo");
+			glBindFragDataLocation(program, FRAG_NORMAL, "gbufferNormal");
+		}
+		glLinkProgram(program);
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		if (!status) {
+			PrintInfoLog(label, "link", program, true);
+			glDeleteProgram(program);
+			program = 0;
+		} else if (g_glCaps.uniformBufferObject) {
+			BindUniformBlock(program, "Frame", BLOCK_FRAME);
+			BindUniformBlock(program, "Materials", BLOCK_MATERIALS);
+			BindUniformBlock(program, "Object", BLOCK_OBJECT);
+			BindUniformBlock(program, "Clusters", BLOCK_CLUSTERS);
+		}
+	}
+
+	// Attached shaders live on with the program
+	if (vertex)
+		glDeleteShader(vertex);
+	if (fragment)
+		glDeleteShader(fragment);
+	return program;
+}
+
+// Per-vertex lighting for GL_LIGHT0 as fixed-function computes it: scene
+// ambient, light ambient, Lambert diffuse and a Blinn specular with the
+// non-local viewer
+const char* const g_lightingVertexShader =
+	"uniform bool u_lighting;\n"
+	"varying vec4 v_color;\n"
+	"varying vec2 v_texCoord;\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = ftransform();\n"
+	"	v_texCoord = gl_MultiTexCoord0.xy;\n"
+	"	if (!u_lighting) {\n"
+	"		v_color = gl_Color;\n"
+	"		return;\n"
+	"	}\n"
+	"\n"
+	"	vec3 position = vec3(gl_ModelViewMatrix * gl_Vertex);\n"
+	"	vec3 normal = normalize(gl_NormalMatrix * gl_Normal);\n"
+	"	vec4 lightPos = gl_LightSource[0].position;\n"
+	"	vec3 light = normalize(lightPos.xyz - position * lightPos.w);\n"
+	"	float diffuse = max(dot(normal, light), 0.0);\n"
+	"	vec4 color = gl_FrontLightModelProduct.sceneColor +\n"
+	"		gl_FrontLightProduct[0].ambient + diffuse * gl_FrontLightProduct[0].diffuse;\n"
+	"	if (diffuse > 0.0) {\n"
+	"		vec3 halfway = normalize(light + vec3(0.0, 0.0, 1.0));\n"
+	"		float specular = pow(max(dot(normal, halfway), 0.0), gl_FrontMaterial.shininess);\n"
+	"		color += specular * gl_FrontLightProduct[0].specular;\n"
+	"	}\n"
+	"	v_color = vec4(color.rgb, gl_FrontMaterial.diffuse.a);\n"
+	"}\n";
+
+void DeleteShaderProgram(GLuint program)
+{
+	if (program)
+		glDeleteProgram(program);
+}
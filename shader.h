@@ -0,0 +1,48 @@
+// shader.h
+//
+// GLSL program helpers. Requires g_glCaps.shaderObjects; every user keeps a
+// fixed-function path for drivers without it.
+
+#ifndef SHADER_H
+#define SHADER_H
+
+#include "gl_extensions.h"
+
+// Attribute locations and uniform block bindings every program is linked
+// with, so one vertex array and one set of buffer bindings serve them all
+enum {
+	ATTRIB_POSITION = 0,       // in vec3 a_position
+	ATTRIB_NORMAL,             // in vec3 a_normal
+	ATTRIB_TEXCOORD            // in vec2 a_texCoord
+};
+
+// Fragment outputs, where the driver lets them be bound (multiple render
+// targets): one color target, or the G-buffer of deferred.h
+enum {
+	FRAG_COLOR = 0,            // out vec4 fragColor
+	FRAG_ALBEDO,               // out vec4 gbufferAlbedo
+	FRAG_NORMAL                // out vec4 gbufferNormal
+};
+
+enum {
+	BLOCK_FRAME = 0,           // uniform Frame
+	BLOCK_MATERIALS,           // uniform Materials
+	BLOCK_OBJECT,              // uniform Object
+	BLOCK_CLUSTERS             // uniform Clusters
+};
+
+// Compiles and links a vertex/fragment pair. header (may be NULL) goes in
+// front of both sources, so it carries the #version line and any #defines.
+// Returns 0 and prints the info log, tagged with label, on failure.
+GLuint CreateShaderProgram(const char* label, const char* header,
+	const char* vertexSource, const char* fragmentSource);
+void DeleteShaderProgram(GLuint program);
+
+// Vertex shader reproducing fixed-function lighting of GL_LIGHT0 (when the
+// bool uniform u_lighting is set) and passing texture coordinate 0 on as
+// varying vec2 v_texCoord. Needs "#version 110" or later in the header.
+// Fragment shaders read the lit color from varying vec4 v_color and write
+// fragColor; see SceneShaderHeader() in renderer.h.
+extern const char* const g_lightingVertexShader;
+
+#endif
@@ -0,0 +1,244 @@
+// shadow_map.cpp
+//
+// Two depth textures, each the depth attachment of its own framebuffer:
+// MAP_STATIC keeps the static casters between redraws, MAP_FRAME gets a
+// copy of it each frame plus the dynamic casters and is what the scene
+// samples.
+
+#include "shadow_map.h"
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "renderer.h"
+#include "shader.h"
+
+#include <math.h>
+#include <string.h>
+
+enum {
+	MAP_STATIC,
+	MAP_FRAME,
+	SHADOW_MAPS
+};
+
+static bool g_shadowsEnabled = false;
+static bool g_frameDrawn = false;      // MAP_FRAME has been drawn at least once
+static int g_size = 0;
+static GLuint g_program = 0;
+static GLint g_lightMatrixLocation = -1;
+static GLuint g_framebuffers[SHADOW_MAPS];
+static GLuint g_textures[SHADOW_MAPS];
+static GLint g_savedViewport[4];
+
+// The light the static map was drawn for, and its view-projection
+static bool g_staticValid = false;
+static float g_staticLight[4], g_staticCenter[3], g_staticRadius;
+static Matrix4 g_lightMatrix;
+
+static int g_frames = 0, g_staticDraws = 0;
+static int g_casterDraws = 0, g_lastStaticCasters = 0, g_lastDynamicCasters = 0;
+
+static const char* g_depthVertexShader =
+	"uniform mat4 u_lightMatrix;\n"
+	"in vec3 a_position;\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = u_lightMatrix * vec4(a_position, 1.0);\n"
+	"}\n";
+
+static const char* g_depthFragmentShader =
+	"void main()\n"
+	"{\n"
+	"}\n";
+
+bool InitShadowMap(int size)
+{
+	if (!IsRendererEnabled() || !g_glCaps.framebufferObject || size < 1)
+		return false;
+
+	g_program = CreateShaderProgram("shadow depth", SceneShaderHeader(),
+		g_depthVertexShader, g_depthFragmentShader);
+	if (!g_program)
+		return false;
+	g_lightMatrixLocation = glGetUniformLocation(g_program, "u_lightMatrix");
+
+	// Linear filtering with the comparison on gives four-tap
+	// percentage-closer filtering on most hardware
+	glGenTextures(SHADOW_MAPS, g_textures);
+	glGenFramebuffers(SHADOW_MAPS, g_framebuffers);
+	bool complete = true;
+	for (int i = 0; i < SHADOW_MAPS; i++) {
+		CachedBindTexture(GL_TEXTURE_2D, g_textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+			GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, g_framebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, g_textures[i], 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	CachedBindTexture(GL_TEXTURE_2D, 0);
+	if (!complete) {
+		glDeleteFramebuffers(SHADOW_MAPS, g_framebuffers);
+		CachedDeleteTextures(SHADOW_MAPS, g_textures);
+		DeleteShaderProgram(g_program);
+		g_program = 0;
+		return false;
+	}
+
+	g_size = size;
+	g_staticValid = false;
+	g_shadowsEnabled = true;
+	return true;
+}
+
+bool IsShadowMapEnabled(void)
+{
+	return g_shadowsEnabled;
+}
+
+// A perspective frustum from the light that just holds the sphere. A
+// directional light (w = 0) is placed far off along its direction.
+static void BuildLightMatrix(const float lightPosition[4], const float center[3], float radius)
+{
+	float eye[3];
+	for (int i = 0; i < 3; i++)
+		eye[i] = lightPosition[3] != 0 ? lightPosition[i] / lightPosition[3] : lightPosition[i];
+	if (lightPosition[3] == 0) {
+		float length = sqrtf(eye[0] * eye[0] + eye[1] * eye[1] + eye[2] * eye[2]);
+		for (int i = 0; i < 3; i++)
+			eye[i] = center[i] + eye[i] / (length > 0 ? length : 1) * radius * 8;
+	}
+
+	float dx = eye[0] - center[0], dy = eye[1] - center[1], dz = eye[2] - center[2];
+	float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+	if (distance < radius * 1.05f)
+		distance = radius * 1.05f;
+	float fovy = 2 * asinf(radius / distance) * 180 / 3.14159265f;
+	float nearPlane = distance - radius > radius * 0.05f ? distance - radius : radius * 0.05f;
+
+	// Straight down (or up) the y axis, y cannot be the up vector
+	bool vertical = fabsf(dx) < 1e-3f * distance && fabsf(dz) < 1e-3f * distance;
+	Matrix4 projection, view;
+	MatrixPerspective(&projection, fovy, 1, nearPlane, distance + radius);
+	MatrixLookAt(&view, eye[0], eye[1], eye[2], center[0], center[1], center[2],
+		0, vertical ? 0.0f : 1.0f, vertical ? 1.0f : 0.0f);
+	MatrixMultiply(&g_lightMatrix, &projection, &view);
+}
+
+static void BindShadowFramebuffer(int map)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, g_framebuffers[map]);
+	glViewport(0, 0, g_size, g_size);
+}
+
+bool BeginShadowMap(const float lightPosition[4], const float center[3], float radius)
+{
+	if (!g_shadowsEnabled)
+		return false;
+
+	g_frames++;
+	g_lastStaticCasters = g_lastDynamicCasters = 0;
+	g_casterDraws = 0;
+	glGetIntegerv(GL_VIEWPORT, g_savedViewport);
+	CachedUseProgram(g_program);
+	CachedEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2, 4);
+
+	if (g_staticValid && memcmp(lightPosition, g_staticLight, sizeof(g_staticLight)) == 0 &&
+		memcmp(center, g_staticCenter, sizeof(g_staticCenter)) == 0 && radius == g_staticRadius)
+		return false;
+
+	memcpy(g_staticLight, lightPosition, sizeof(g_staticLight));
+	memcpy(g_staticCenter, center, sizeof(g_staticCenter));
+	g_staticRadius = radius;
+	g_staticValid = true;
+	g_staticDraws++;
+	BuildLightMatrix(lightPosition, center, radius);
+
+	BindShadowFramebuffer(MAP_STATIC);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	return true;
+}
+
+void DrawShadowCaster(const Mesh* mesh, const Matrix4* model)
+{
+	if (!g_shadowsEnabled || !mesh->vertexArray)
+		return;
+
+	Matrix4 lightModel;
+	MatrixMultiply(&lightModel, &g_lightMatrix, model);
+	glUniformMatrix4fv(g_lightMatrixLocation, 1, GL_FALSE, lightModel.m);
+	CachedBindVertexArray(mesh->vertexArray);
+	glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_INT, NULL);
+	g_casterDraws++;
+}
+
+void BeginDynamicShadowCasters(void)
+{
+	if (!g_shadowsEnabled)
+		return;
+
+	g_lastStaticCasters = g_casterDraws;
+	g_casterDraws = 0;
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, g_framebuffers[MAP_STATIC]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, g_framebuffers[MAP_FRAME]);
+	glBlitFramebuffer(0, 0, g_size, g_size, 0, 0, g_size, g_size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	BindShadowFramebuffer(MAP_FRAME);
+}
+
+void EndShadowMap(void)
+{
+	if (!g_shadowsEnabled)
+		return;
+
+	g_lastDynamicCasters = g_casterDraws;
+	CachedDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(g_savedViewport[0], g_savedViewport[1], g_savedViewport[2], g_savedViewport[3]);
+	CachedActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+	CachedBindTexture(GL_TEXTURE_2D, g_textures[MAP_FRAME]);
+	CachedActiveTexture(GL_TEXTURE0);
+	g_frameDrawn = true;
+}
+
+void InvalidateStaticShadows(void)
+{
+	g_staticValid = false;
+}
+
+bool GetShadowMatrix(const Matrix4* view, Matrix4* out)
+{
+	if (!g_shadowsEnabled || !g_frameDrawn)
+		return false;
+
+	// Clip space to texture coordinates and depth, [-1, 1] to [0, 1]
+	Matrix4 bias, inverseView;
+	MatrixIdentity(&bias);
+	MatrixTranslate(&bias, 0.5f, 0.5f, 0.5f);
+	bias.m[0] = bias.m[5] = bias.m[10] = 0.5f;
+	MatrixRigidInverse(&inverseView, view);
+	MatrixMultiply(out, &bias, &g_lightMatrix);
+	MatrixMultiply(out, out, &inverseView);
+	return true;
+}
+
+void PrintShadowMapStats(FILE* out)
+{
+	if (!g_shadowsEnabled) {
+		fprintf(out, "Shadow map: off\n");
+		return;
+	}
+	fprintf(out, "Shadow map: %dx%d, static casters drawn %d times in %d frames\n",
+		g_size, g_size, g_staticDraws, g_frames);
+	fprintf(out, "  last frame %d static and %d dynamic caster draws\n",
+		g_lastStaticCasters, g_lastDynamicCasters);
+}
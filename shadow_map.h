@@ -0,0 +1,55 @@
+// shadow_map.h
+//
+// A shadow map for the main light, split by how often its casters move.
+// Static casters (the cube) are drawn into their own depth texture only
+// when the light or the shadowed region changes; every frame that depth is
+// blitted into a second texture and the dynamic casters (the teapot) are
+// drawn over it. The scene program samples the second texture with a
+// hardware depth comparison and removes the light's diffuse and specular
+// contribution where a caster is nearer to the light.
+//
+// The light is a point light looking at a sphere around the shadowed
+// region, with a perspective frustum just wide enough to hold it. Casters
+// outside the sphere are clipped and receivers outside it are lit.
+//
+// Needs the GLSL renderer and framebuffer objects. Without them, or until
+// a shadow map has been drawn, nothing is shadowed.
+
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <stdio.h>
+
+#include "matrix.h"
+#include "mesh.h"
+
+#define SHADOW_TEXTURE_UNIT 5
+
+// size is the map's width and height in texels
+bool InitShadowMap(int size);
+bool IsShadowMapEnabled(void);
+
+// Starts the frame's shadow pass with the light in world space, as
+// glLightfv takes it, and the sphere to shadow. Returns true when the
+// static map is out of date; it is then bound and cleared, and the static
+// casters should be drawn before BeginDynamicShadowCasters().
+bool BeginShadowMap(const float lightPosition[4], const float center[3], float radius);
+void DrawShadowCaster(const Mesh* mesh, const Matrix4* model);
+
+// Copies the static map into the frame's map for the dynamic casters
+void BeginDynamicShadowCasters(void);
+
+// Restores the framebuffer and viewport and binds the frame's map to
+// SHADOW_TEXTURE_UNIT
+void EndShadowMap(void);
+
+// Redraws the static casters next frame, after one of them moved
+void InvalidateStaticShadows(void);
+
+// Called by BeginRendererFrame(): the matrix from eye space to shadow map
+// coordinates for this view, or false when there is no map to sample
+bool GetShadowMatrix(const Matrix4* view, Matrix4* out);
+
+void PrintShadowMapStats(FILE* out);
+
+#endif
@@ -0,0 +1,269 @@
+// simulation.cpp
+//
+// The command queue is a single producer, single consumer ring: the GLUT
+// thread writes an entry and then advances head, the simulation thread
+// reads up to head and then advances tail. A full ring drops the command,
+// which at 256 entries per tick means input arriving far faster than a
+// person can type.
+//
+// Held keys move the scene at a steady rate for exactly as long as they
+// were down: each tick applies the time since the key was last accounted
+// for, and the key up, which may arrive a tick or two late, applies the
+// difference between then and its own timestamp, negative if the ticks
+// overshot.
+
+#include "simulation.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "input.h"
+#include "platform.h"
+#include "triple_buffer.h"
+
+#define SIMULATION_QUEUE_SIZE  256   // power of two
+#define SIMULATION_MAX_CATCHUP 30    // ticks run before giving up on a stall
+
+// Per second of holding a key; what 30 Hz key repeat used to give
+#define MOVEMENT_SPEED         3.0f
+#define ROTATE_SPEED           90.0f   // degrees
+#define PERSPECTIVE_SPEED      75.0f   // degrees
+
+enum SimulationCommandType {
+	COMMAND_KEY_DOWN,
+	COMMAND_KEY_UP,
+	COMMAND_KEYS_RELEASED,
+	COMMAND_VIEW_DISTANCE
+};
+
+struct SimulationCommand {
+	SimulationCommandType type;
+	unsigned char key;
+	float value;
+	double time;
+};
+
+static SimulationCommand g_commands[SIMULATION_QUEUE_SIZE];
+static volatile long g_commandHead = 0;   // written by the GLUT thread
+static volatile long g_commandTail = 0;   // written by the simulation thread
+
+static SceneState g_states[3];
+static TripleBuffer g_stateBuffer;
+static SceneState g_current;               // owned by whoever runs ticks
+static double g_nextTickTime;
+static bool g_keyHeld[256];
+static double g_keyAccounted[256];         // time the key has been applied up to
+
+static Thread g_simulationThread;
+static Event g_simulationEvent;
+static volatile long g_simulationQuit = 0;
+static bool g_simulationRunning = false;
+static bool g_simulationStarted = false;
+
+static void PostCommand(const SimulationCommand* command)
+{
+	long head = AtomicLoad(&g_commandHead);
+
+	if (head - AtomicLoad(&g_commandTail) >= SIMULATION_QUEUE_SIZE)
+		return;
+	g_commands[head & (SIMULATION_QUEUE_SIZE - 1)] = *command;
+	AtomicStore(&g_commandHead, head + 1);
+}
+
+static void WrapAngle(float* angle)
+{
+	if (*angle < 0) *angle += 360;
+	if (*angle > 360) *angle -= 360;
+}
+
+// Continuous effect of holding key for seconds
+static void ApplyHeldKey(SceneState* state, unsigned char key, float seconds)
+{
+	float movementSpeed = MOVEMENT_SPEED * seconds;
+	float rotateSpeed = ROTATE_SPEED * seconds;
+	float perspectiveSpeed = PERSPECTIVE_SPEED * seconds;
+
+	switch (key)
+	{
+	case 'w' : state->cameraCenterPosition.y += movementSpeed; break;
+	case 'a' : state->cameraCenterPosition.x -= movementSpeed; break;
+	case 's' : state->cameraCenterPosition.y -= movementSpeed; break;
+	case 'd' : state->cameraCenterPosition.x += movementSpeed; break;
+
+	case 'u' : state->teapotPosition.y += movementSpeed; break;
+	case 'h' : state->teapotPosition.x -= movementSpeed; break;
+	case 'j' : state->teapotPosition.y -= movementSpeed; break;
+	case 'k' : state->teapotPosition.x += movementSpeed; break;
+	case 'y' : state->teapotPosition.z -= movementSpeed; break;
+	case 'i' : state->teapotPosition.z += movementSpeed; break;
+
+	case '3' : state->teapotRotation.x -= rotateSpeed; WrapAngle(&state->teapotRotation.x); break;
+	case '4' : state->teapotRotation.x += rotateSpeed; WrapAngle(&state->teapotRotation.x); break;
+	case '5' : state->teapotRotation.y -= rotateSpeed; WrapAngle(&state->teapotRotation.y); break;
+	case '6' : state->teapotRotation.y += rotateSpeed; WrapAngle(&state->teapotRotation.y); break;
+	case '7' : state->teapotRotation.z -= rotateSpeed; WrapAngle(&state->teapotRotation.z); break;
+	case '8' : state->teapotRotation.z += rotateSpeed; WrapAngle(&state->teapotRotation.z); break;
+
+	case '=' : state->perspectiveView -= perspectiveSpeed; break;   // the + key
+	case '-' : state->perspectiveView += perspectiveSpeed; break;
+	}
+}
+
+static void KeyDown(SceneState* state, unsigned char key, double time)
+{
+	if (g_keyHeld[key])
+		return;
+	g_keyHeld[key] = true;
+	g_keyAccounted[key] = time;
+
+	// Toggles act once per press
+	if (key == '1')
+		state->isLookAtCube = !state->isLookAtCube;
+}
+
+static void KeyUp(SceneState* state, unsigned char key, double time)
+{
+	if (!g_keyHeld[key])
+		return;
+	ApplyHeldKey(state, key, (float) (time - g_keyAccounted[key]));
+	g_keyHeld[key] = false;
+}
+
+// Advances the scene to tickTime
+static void Tick(SceneState* state, double tickTime)
+{
+	long head = AtomicLoad(&g_commandHead);
+
+	for (long tail = g_commandTail; tail != head; tail++) {
+		const SimulationCommand* command = &g_commands[tail & (SIMULATION_QUEUE_SIZE - 1)];
+		if (command->type == COMMAND_KEY_DOWN)
+			KeyDown(state, command->key, command->time);
+		else if (command->type == COMMAND_KEY_UP)
+			KeyUp(state, command->key, command->time);
+		else if (command->type == COMMAND_KEYS_RELEASED) {
+			for (int key = 0; key < 256; key++)
+				KeyUp(state, (unsigned char) key, command->time);
+		}
+		else
+			state->viewDistance = command->value;
+		if (command->time > state->inputTime)
+			state->inputTime = command->time;
+	}
+	AtomicStore(&g_commandTail, head);
+
+	for (int key = 0; key < 256; key++) {
+		if (!g_keyHeld[key])
+			continue;
+		ApplyHeldKey(state, (unsigned char) key, (float) (tickTime - g_keyAccounted[key]));
+		g_keyAccounted[key] = tickTime;
+	}
+
+	state->time += 1.0 / SIMULATION_TICK_RATE;
+	state->tick++;
+	state->tickTime = tickTime;
+}
+
+// Runs every tick that is due and publishes the result; returns the
+// seconds until the next tick
+static double RunDueTicks(void)
+{
+	double now = GetTimeSeconds();
+	int ticks = 0;
+
+	while (g_nextTickTime <= now && ticks < SIMULATION_MAX_CATCHUP) {
+		Tick(&g_current, g_nextTickTime);
+		g_nextTickTime += 1.0 / SIMULATION_TICK_RATE;
+		ticks++;
+	}
+	// After a long stall, resume from now instead of fast forwarding, held
+	// keys included
+	if (g_nextTickTime <= now) {
+		g_nextTickTime = now + 1.0 / SIMULATION_TICK_RATE;
+		for (int key = 0; key < 256; key++) {
+			if (g_keyHeld[key])
+				g_keyAccounted[key] = now;
+		}
+	}
+
+	if (ticks > 0) {
+		g_states[TripleBufferBack(&g_stateBuffer)] = g_current;
+		TripleBufferPublish(&g_stateBuffer);
+	}
+	return g_nextTickTime - now;
+}
+
+static void SimulationWorker(void* arg)
+{
+	while (!AtomicLoad(&g_simulationQuit)) {
+		double wait = RunDueTicks();
+		EventWait(&g_simulationEvent, (int) (wait * 1000));
+	}
+}
+
+void StartSimulation(const SceneState* initial)
+{
+	g_current = *initial;
+	g_current.tickTime = GetTimeSeconds();
+	g_current.inputTime = 0;
+	for (int i = 0; i < 3; i++)
+		g_states[i] = g_current;
+	TripleBufferInit(&g_stateBuffer);
+	g_nextTickTime = GetTimeSeconds();
+	g_simulationStarted = true;
+
+	EventInit(&g_simulationEvent);
+	g_simulationRunning = ThreadStart(&g_simulationThread, SimulationWorker, NULL);
+	if (!g_simulationRunning)
+		fprintf(stderr, "Cannot start simulation thread; simulating on the render thread\n");
+	atexit(StopSimulation);
+}
+
+void StopSimulation(void)
+{
+	if (!g_simulationRunning)
+		return;
+	AtomicStore(&g_simulationQuit, 1);
+	EventSignal(&g_simulationEvent);
+	ThreadJoin(&g_simulationThread);
+	g_simulationRunning = false;
+}
+
+void PostSimulationKey(unsigned char key, bool down, double time)
+{
+	SimulationCommand command = { down ? COMMAND_KEY_DOWN : COMMAND_KEY_UP,
+		UnshiftedKey(key), 0, time };
+	PostCommand(&command);
+}
+
+void PostSimulationKeysReleased(double time)
+{
+	SimulationCommand command = { COMMAND_KEYS_RELEASED, 0, 0, time };
+	PostCommand(&command);
+}
+
+void PostSimulationViewDistance(float distance, double time)
+{
+	SimulationCommand command = { COMMAND_VIEW_DISTANCE, 0, distance, time };
+	PostCommand(&command);
+}
+
+void LatchSceneState(SceneState* scene, double now)
+{
+	for (int key = 0; key < 256; key++) {
+		// Keys are tracked unshifted
+		double since = GetKeyHeldSince((unsigned char) key);
+		if (since == 0 || UnshiftedKey((unsigned char) key) != key)
+			continue;
+		if (since < scene->tickTime)
+			since = scene->tickTime;
+		if (now > since)
+			ApplyHeldKey(scene, (unsigned char) key, (float) (now - since));
+	}
+}
+
+const SceneState* AcquireSceneState(void)
+{
+	if (g_simulationStarted && !g_simulationRunning)
+		RunDueTicks();
+	return &g_states[TripleBufferAcquire(&g_stateBuffer)];
+}
@@ -0,0 +1,56 @@
+// simulation.h
+//
+// Scene simulation on its own thread. Input callbacks post commands to it
+// through a lock-free queue; it applies them at a fixed tick rate and
+// publishes a complete SceneState after each batch of ticks through a
+// triple buffer. The render thread draws whichever snapshot is newest when
+// the frame starts, so a slow frame never holds up the simulation and a
+// burst of ticks never blocks a frame. Without threads the due ticks run
+// inline when a snapshot is acquired.
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#define SIMULATION_TICK_RATE  120   // ticks per second
+
+struct Vector3 {
+    float x, y, z;
+
+    Vector3() { x = y = z = 0; }
+    Vector3(float a, float b, float c) : x(a), y(b), z(c) {}
+};
+
+struct SceneState {
+	Vector3 cameraCenterPosition;
+	Vector3 teapotPosition;
+	Vector3 teapotRotation;
+	float perspectiveView;         // vertical field of view, degrees
+	bool isLookAtCube;
+	float viewDistance;
+	double time;                   // seconds of simulated time
+	long tick;
+	double tickTime;               // GetTimeSeconds() the state is current to
+	double inputTime;              // timestamp of the newest input applied
+};
+
+// initial is copied; StopSimulation is registered with atexit
+void StartSimulation(const SceneState* initial);
+void StopSimulation(void);
+
+// Called from the GLUT thread only. Keys act for as long as they are held,
+// measured between the down and up timestamps (GetTimeSeconds).
+void PostSimulationKey(unsigned char key, bool down, double time);
+// Every held key up at time, for when the key ups will never come
+void PostSimulationKeysReleased(double time);
+void PostSimulationViewDistance(float distance, double time);
+
+// Newest published snapshot; stays valid and unchanged until the next call.
+// Called from the render thread only.
+const SceneState* AcquireSceneState(void);
+
+// Late latching: advances a copy of a snapshot by the keys the render
+// thread sees held (see GetKeyHeldSince), from the snapshot's tickTime or
+// the key down to now, the same way the next ticks will
+void LatchSceneState(SceneState* scene, double now);
+
+#endif
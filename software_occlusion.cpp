@@ -0,0 +1,377 @@
+// software_occlusion.cpp
+//
+// Pixel (x, y) covers [x, x + 1) x [y, y + 1) with y up, like NDC. Every
+// triangle is set up once as three edge functions and a 1 / w plane, all
+// in pixels; one job per row of tiles then walks the triangles touching
+// it, and reduces its tiles when done.
+
+#include "software_occlusion.h"
+#include "job_system.h"
+#include "platform.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	define OCCLUSION_SSE
+#	include <xmmintrin.h>
+#endif
+
+#define TILES_X (OCCLUSION_BUFFER_WIDTH / OCCLUSION_TILE)
+#define TILES_Y (OCCLUSION_BUFFER_HEIGHT / OCCLUSION_TILE)
+
+// Ax + By + C per edge, >= 0 inside, biased so that only pixels wholly
+// inside pass; the depth plane is biased to its farthest over a pixel
+struct OccluderTriangle {
+	float edges[3][3];
+	float depth[3];
+	int x0, y0, x1, y1;            // pixel bounds, inclusive, x0 a multiple of 4
+};
+
+static bool g_softOcclusionEnabled = false;
+static Matrix4 g_viewProjection;
+static float g_nearPlane = 0;
+static OccluderTriangle g_triangles[MAX_OCCLUDER_TRIANGLES];
+static int g_triangleCount = 0;
+
+// 1 / w of the nearest occluder, 0 where there is none
+static float g_depth[OCCLUSION_BUFFER_HEIGHT][OCCLUSION_BUFFER_WIDTH];
+static float g_tileDepth[TILES_Y][TILES_X];      // farthest pixel of each tile
+
+static Job g_bandJobs[TILES_Y];
+static int g_bandIndices[TILES_Y];
+static double g_bandSeconds[TILES_Y];
+static JobCounter g_rasterCounter = 0;
+static bool g_rasterPending = false;
+
+// Per frame, and the last complete frame
+static int g_occluders = 0, g_nearTriangles = 0, g_tested = 0, g_culled = 0;
+static int g_lastOccluders = 0, g_lastNearTriangles = 0, g_lastTested = 0, g_lastCulled = 0;
+static double g_rasterSeconds = 0, g_waitSeconds = 0;
+static double g_lastRasterSeconds = 0, g_lastWaitSeconds = 0;
+
+void SetSoftwareOcclusion(bool enabled)
+{
+	g_softOcclusionEnabled = enabled;
+}
+
+bool IsSoftwareOcclusionEnabled(void)
+{
+	return g_softOcclusionEnabled;
+}
+
+// Waits for the band jobs, if any are out, and adds up their time
+static void FinishRasterization(void)
+{
+	if (!g_rasterPending)
+		return;
+
+	double start = GetTimeSeconds();
+	WaitForCounter(&g_rasterCounter);
+	g_waitSeconds += GetTimeSeconds() - start;
+	for (int band = 0; band < TILES_Y; band++)
+		g_rasterSeconds += g_bandSeconds[band];
+	g_rasterPending = false;
+}
+
+void BeginSoftwareOcclusion(const Matrix4* projection, const Matrix4* view)
+{
+	FinishRasterization();
+	g_lastOccluders = g_occluders;
+	g_lastNearTriangles = g_nearTriangles;
+	g_lastTested = g_tested;
+	g_lastCulled = g_culled;
+	g_lastRasterSeconds = g_rasterSeconds;
+	g_lastWaitSeconds = g_waitSeconds;
+	g_occluders = g_nearTriangles = g_tested = g_culled = 0;
+	g_rasterSeconds = g_waitSeconds = 0;
+	if (!g_softOcclusionEnabled)
+		return;
+
+	MatrixMultiply(&g_viewProjection, projection, view);
+	g_nearPlane = projection->m[14] / (projection->m[10] - 1);
+	g_triangleCount = 0;
+}
+
+// Clip space to pixels; false in front of the near plane
+static bool ProjectPoint(const float clip[4], float* x, float* y, float* depth)
+{
+	if (clip[3] < g_nearPlane)
+		return false;
+	*depth = 1 / clip[3];
+	*x = (clip[0] * *depth * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+	*y = (clip[1] * *depth * 0.5f + 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+	return true;
+}
+
+// The pixel holding coordinate v, clamped to [0, size)
+static int ClampPixel(float v, int size)
+{
+	return v <= 0 ? 0 : (v >= size - 1 ? size - 1 : (int) v);
+}
+
+static void SetupTriangle(const float x[3], const float y[3], const float depth[3])
+{
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (fabsf(area) < 1e-6f || g_triangleCount == MAX_OCCLUDER_TRIANGLES)
+		return;
+
+	// Occluders are closed, so either winding is a front face; make it
+	// counterclockwise
+	int order[3] = { 0, 1, 2 };
+	if (area < 0) {
+		order[1] = 2;
+		order[2] = 1;
+		area = -area;
+	}
+
+	float xMin = x[0], xMax = x[0], yMin = y[0], yMax = y[0];
+	for (int i = 1; i < 3; i++) {
+		xMin = x[i] < xMin ? x[i] : xMin;
+		xMax = x[i] > xMax ? x[i] : xMax;
+		yMin = y[i] < yMin ? y[i] : yMin;
+		yMax = y[i] > yMax ? y[i] : yMax;
+	}
+	if (xMax < 0 || yMax < 0 || xMin >= OCCLUSION_BUFFER_WIDTH || yMin >= OCCLUSION_BUFFER_HEIGHT)
+		return;
+	OccluderTriangle* tri = &g_triangles[g_triangleCount];
+	tri->x0 = ClampPixel(xMin, OCCLUSION_BUFFER_WIDTH) & ~3;
+	tri->y0 = ClampPixel(yMin, OCCLUSION_BUFFER_HEIGHT);
+	tri->x1 = ClampPixel(xMax, OCCLUSION_BUFFER_WIDTH);
+	tri->y1 = ClampPixel(yMax, OCCLUSION_BUFFER_HEIGHT);
+
+	for (int i = 0; i < 3; i++) {
+		int a = order[i], b = order[(i + 1) % 3];
+		float* edge = tri->edges[i];
+		edge[0] = y[a] - y[b];
+		edge[1] = x[b] - x[a];
+		edge[2] = -(edge[0] * x[a] + edge[1] * y[a]) - 0.5f * (fabsf(edge[0]) + fabsf(edge[1]));
+	}
+
+	// 1 / w is linear in screen space
+	const int* o = order;
+	float dx1 = x[o[1]] - x[o[0]], dy1 = y[o[1]] - y[o[0]], dz1 = depth[o[1]] - depth[o[0]];
+	float dx2 = x[o[2]] - x[o[0]], dy2 = y[o[2]] - y[o[0]], dz2 = depth[o[2]] - depth[o[0]];
+	tri->depth[0] = (dz1 * dy2 - dz2 * dy1) / area;
+	tri->depth[1] = (dz2 * dx1 - dz1 * dx2) / area;
+	tri->depth[2] = depth[o[0]] - tri->depth[0] * x[o[0]] - tri->depth[1] * y[o[0]] -
+		0.5f * (fabsf(tri->depth[0]) + fabsf(tri->depth[1]));
+	g_triangleCount++;
+}
+
+void AddOccluder(const Mesh* mesh, const Matrix4* model)
+{
+	if (!g_softOcclusionEnabled || mesh->vertices == NULL)
+		return;
+
+	Matrix4 modelViewProjection;
+	MatrixMultiply(&modelViewProjection, &g_viewProjection, model);
+	g_occluders++;
+	for (int i = 0; i + 2 < mesh->indexCount; i += 3) {
+		float x[3], y[3], depth[3];
+		bool inFront = true;
+		for (int corner = 0; corner < 3; corner++) {
+			const float* p = mesh->vertices[mesh->indices[i + corner]].position;
+			float clip[4] = { p[0], p[1], p[2], 1 };
+			MatrixTransform(&modelViewProjection, clip, clip);
+			inFront = inFront && ProjectPoint(clip, &x[corner], &y[corner], &depth[corner]);
+		}
+		if (inFront)
+			SetupTriangle(x, y, depth);
+		else
+			g_nearTriangles++;
+	}
+}
+
+#ifdef OCCLUSION_SSE
+
+// Four pixels a step from x0 (a multiple of 4) through x1
+static void RasterizeSpan(const OccluderTriangle* tri, int x0, int x1, float y, float* row)
+{
+	const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 edgeX[3], edgeRow[3];
+	for (int i = 0; i < 3; i++) {
+		edgeX[i] = _mm_set1_ps(tri->edges[i][0]);
+		edgeRow[i] = _mm_set1_ps(tri->edges[i][1] * y + tri->edges[i][2]);
+	}
+	__m128 depthX = _mm_set1_ps(tri->depth[0]);
+	__m128 depthRow = _mm_set1_ps(tri->depth[1] * y + tri->depth[2]);
+	__m128 zero = _mm_setzero_ps();
+
+	for (int x = x0; x <= x1; x += 4) {
+		__m128 px = _mm_add_ps(_mm_set1_ps((float) x), offsets);
+		__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[0], px), edgeRow[0]), zero);
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[1], px), edgeRow[1]), zero));
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[2], px), edgeRow[2]), zero));
+		if (_mm_movemask_ps(inside) == 0)
+			continue;
+
+		__m128 old = _mm_loadu_ps(row + x);
+		__m128 nearer = _mm_max_ps(old, _mm_add_ps(_mm_mul_ps(depthX, px), depthRow));
+		_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+	}
+}
+
+// Whether any pixel from x0 (a multiple of 4) through x1 is as far as
+// depth or farther; pixels up to the next multiple of 4 count too
+static bool SpanVisible(const float* row, int x0, int x1, float depth)
+{
+	__m128 box = _mm_set1_ps(depth);
+	for (int x = x0; x <= x1; x += 4)
+		if (_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(row + x), box)) != 0)
+			return true;
+	return false;
+}
+
+static float TileMin(int tileX, int tileY)
+{
+	const float* row = &g_depth[tileY * OCCLUSION_TILE][tileX * OCCLUSION_TILE];
+	__m128 least = _mm_loadu_ps(row);
+	for (int y = 0; y < OCCLUSION_TILE; y++, row += OCCLUSION_BUFFER_WIDTH)
+		for (int x = 0; x < OCCLUSION_TILE; x += 4)
+			least = _mm_min_ps(least, _mm_loadu_ps(row + x));
+	least = _mm_min_ps(least, _mm_shuffle_ps(least, least, _MM_SHUFFLE(1, 0, 3, 2)));
+	least = _mm_min_ps(least, _mm_shuffle_ps(least, least, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(least);
+}
+
+#else
+
+static void RasterizeSpan(const OccluderTriangle* tri, int x0, int x1, float y, float* row)
+{
+	float edgeRow[3];
+	for (int i = 0; i < 3; i++)
+		edgeRow[i] = tri->edges[i][1] * y + tri->edges[i][2];
+	float depthRow = tri->depth[1] * y + tri->depth[2];
+
+	for (int x = x0; x <= x1; x++) {
+		float px = x + 0.5f;
+		if (tri->edges[0][0] * px + edgeRow[0] >= 0 && tri->edges[1][0] * px + edgeRow[1] >= 0 &&
+			tri->edges[2][0] * px + edgeRow[2] >= 0) {
+			float depth = tri->depth[0] * px + depthRow;
+			if (depth > row[x])
+				row[x] = depth;
+		}
+	}
+}
+
+static bool SpanVisible(const float* row, int x0, int x1, float depth)
+{
+	for (int x = x0; x <= x1; x++)
+		if (row[x] <= depth)
+			return true;
+	return false;
+}
+
+static float TileMin(int tileX, int tileY)
+{
+	const float* row = &g_depth[tileY * OCCLUSION_TILE][tileX * OCCLUSION_TILE];
+	float least = row[0];
+	for (int y = 0; y < OCCLUSION_TILE; y++, row += OCCLUSION_BUFFER_WIDTH)
+		for (int x = 0; x < OCCLUSION_TILE; x++)
+			least = row[x] < least ? row[x] : least;
+	return least;
+}
+
+#endif
+
+// One row of tiles
+static void RasterizeBand(void* data)
+{
+	int band = *(int*) data;
+	double start = GetTimeSeconds();
+	int y0 = band * OCCLUSION_TILE, y1 = y0 + OCCLUSION_TILE - 1;
+
+	memset(g_depth[y0], 0, OCCLUSION_TILE * sizeof(g_depth[0]));
+	for (int i = 0; i < g_triangleCount; i++) {
+		const OccluderTriangle* tri = &g_triangles[i];
+		if (tri->y1 < y0 || tri->y0 > y1)
+			continue;
+		int top = tri->y1 < y1 ? tri->y1 : y1;
+		for (int y = tri->y0 > y0 ? tri->y0 : y0; y <= top; y++)
+			RasterizeSpan(tri, tri->x0, tri->x1, y + 0.5f, g_depth[y]);
+	}
+
+	for (int x = 0; x < TILES_X; x++)
+		g_tileDepth[band][x] = TileMin(x, band);
+	g_bandSeconds[band] = GetTimeSeconds() - start;
+}
+
+void RasterizeOccluders(void)
+{
+	if (!g_softOcclusionEnabled)
+		return;
+
+	for (int band = 0; band < TILES_Y; band++) {
+		g_bandIndices[band] = band;
+		g_bandJobs[band].func = RasterizeBand;
+		g_bandJobs[band].data = &g_bandIndices[band];
+	}
+	RunJobs(g_bandJobs, TILES_Y, &g_rasterCounter);
+	g_rasterPending = true;
+}
+
+bool IsMeshOccluded(const Mesh* mesh, const Matrix4* model)
+{
+	if (!g_softOcclusionEnabled)
+		return false;
+	FinishRasterization();
+	g_tested++;
+
+	// Screen bounds and nearest depth of the bounding box
+	Matrix4 modelViewProjection;
+	MatrixMultiply(&modelViewProjection, &g_viewProjection, model);
+	float xMin = 1e30f, xMax = -1e30f, yMin = 1e30f, yMax = -1e30f, nearest = 0;
+	for (int corner = 0; corner < 8; corner++) {
+		float clip[4] = {
+			corner & 1 ? mesh->boundsMax[0] : mesh->boundsMin[0],
+			corner & 2 ? mesh->boundsMax[1] : mesh->boundsMin[1],
+			corner & 4 ? mesh->boundsMax[2] : mesh->boundsMin[2],
+			1
+		};
+		float x, y, depth;
+		MatrixTransform(&modelViewProjection, clip, clip);
+		if (!ProjectPoint(clip, &x, &y, &depth))
+			return false;
+		xMin = x < xMin ? x : xMin;
+		xMax = x > xMax ? x : xMax;
+		yMin = y < yMin ? y : yMin;
+		yMax = y > yMax ? y : yMax;
+		nearest = depth > nearest ? depth : nearest;
+	}
+
+	// Off the buffer is the view frustum's business, not ours
+	if (xMax < 0 || yMax < 0 || xMin >= OCCLUSION_BUFFER_WIDTH || yMin >= OCCLUSION_BUFFER_HEIGHT)
+		return false;
+	int x0 = ClampPixel(xMin, OCCLUSION_BUFFER_WIDTH), x1 = ClampPixel(xMax, OCCLUSION_BUFFER_WIDTH);
+	int y0 = ClampPixel(yMin, OCCLUSION_BUFFER_HEIGHT), y1 = ClampPixel(yMax, OCCLUSION_BUFFER_HEIGHT);
+
+	// Behind every tile it touches, or failing that every pixel
+	bool hidden = true;
+	for (int ty = y0 / OCCLUSION_TILE; hidden && ty <= y1 / OCCLUSION_TILE; ty++)
+		for (int tx = x0 / OCCLUSION_TILE; hidden && tx <= x1 / OCCLUSION_TILE; tx++)
+			hidden = g_tileDepth[ty][tx] > nearest;
+	for (int y = y0; !hidden && y <= y1; y++)
+		if (SpanVisible(g_depth[y], x0 & ~3, x1, nearest))
+			return false;
+
+	g_culled++;
+	return true;
+}
+
+void PrintSoftwareOcclusionStats(FILE* out)
+{
+	if (!g_softOcclusionEnabled) {
+		fprintf(out, "Software occlusion: off\n");
+		return;
+	}
+	fprintf(out, "Software occlusion: %dx%d buffer, %d occluders last frame, "
+		"%d triangles left out at the near plane\n", OCCLUSION_BUFFER_WIDTH,
+		OCCLUSION_BUFFER_HEIGHT, g_lastOccluders, g_lastNearTriangles);
+	fprintf(out, "  %d of %d objects culled, %.3f ms rasterizing in %d jobs, %.3f ms waited for"
+#ifdef OCCLUSION_SSE
+		" (SSE)"
+#endif
+		"\n", g_lastCulled, g_lastTested, g_lastRasterSeconds * 1000, TILES_Y,
+		g_lastWaitSeconds * 1000);
+}
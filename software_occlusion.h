@@ -0,0 +1,47 @@
+// software_occlusion.h
+//
+// Occlusion culling on the CPU, before anything is submitted. A few large
+// occluders are rasterized into a small depth buffer, in bands spread over
+// the job system, four pixels at a time with SSE where the compiler
+// targets it. Each pixel keeps the nearest occluder depth (as 1 / w, so
+// larger is nearer) and each OCCLUSION_TILE square the farthest of its
+// pixels. An object's bounding box is occluded when its nearest point is
+// behind every tile, or failing that every pixel, it covers.
+//
+// Occluders only write pixels they cover entirely, at their farthest
+// depth over the pixel, so an object is never culled because of the low
+// resolution. Triangles and boxes reaching in front of the near plane are
+// left out of the buffer and never culled, respectively.
+//
+// This all runs while the GPU is still busy with the previous frame and
+// needs no readback, so objects are culled the frame they disappear.
+
+#ifndef SOFTWARE_OCCLUSION_H
+#define SOFTWARE_OCCLUSION_H
+
+#include <stdio.h>
+
+#include "matrix.h"
+#include "mesh.h"
+
+#define OCCLUSION_BUFFER_WIDTH  256     // a multiple of OCCLUSION_TILE
+#define OCCLUSION_BUFFER_HEIGHT 128
+#define OCCLUSION_TILE          8
+#define MAX_OCCLUDER_TRIANGLES  4096
+
+void SetSoftwareOcclusion(bool enabled);
+bool IsSoftwareOcclusionEnabled(void);
+
+// Clears the buffer for a camera. Occluders are then added and rasterized
+// before any box is tested.
+void BeginSoftwareOcclusion(const Matrix4* projection, const Matrix4* view);
+void AddOccluder(const Mesh* mesh, const Matrix4* model);
+void RasterizeOccluders(void);
+
+// Whether the mesh's bounds, placed by model, are hidden behind the
+// occluders. Always false when disabled.
+bool IsMeshOccluded(const Mesh* mesh, const Matrix4* model);
+
+void PrintSoftwareOcclusionStats(FILE* out);
+
+#endif
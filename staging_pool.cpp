@@ -0,0 +1,230 @@
+// staging_pool.cpp
+//
+// Size classed block cache for staging_pool.h. Block bookkeeping lives in a
+// fixed table beside the memory, so the buffers themselves stay page aligned
+// and the pool never allocates from the heap for its own use. The table is
+// guarded by a spin lock, which needs no initialization and is held only for
+// a short table scan.
+
+#include "staging_pool.h"
+#include "platform.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+#	include <sys/mman.h>
+#endif
+
+#define STAGING_MAX_BLOCKS      256
+#define STAGING_MIN_CLASS       12      // 4 KB
+#define STAGING_MAX_CLASS       30      // 1 GB
+#define STAGING_HUGE_PAGE_MIN   (2 * 1024 * 1024)
+
+struct StagingBlock {
+	void* memory;
+	size_t size;
+	int sizeClass;
+	bool inUse;
+	bool hugePages;
+};
+
+static StagingBlock g_blocks[STAGING_MAX_BLOCKS];
+static volatile long g_stagingLock = 0;
+static bool g_stagingHugePages = false;
+static int g_systemAllocations = 0;
+static int g_acquires = 0;
+static int g_misses = 0;
+
+static void LockPool(void)
+{
+	while (AtomicCompareExchange(&g_stagingLock, 1, 0) != 0)
+		SleepMs(0);
+}
+
+static void UnlockPool(void)
+{
+	AtomicStore(&g_stagingLock, 0);
+}
+
+static void* AllocatePages(size_t size, bool hugePages, bool* gotHugePages)
+{
+	void* memory = NULL;
+
+	*gotHugePages = false;
+#ifdef _WIN32
+	if (hugePages) {
+		SIZE_T large = GetLargePageMinimum();
+		if (large != 0 && size % large == 0) {
+			memory = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES,
+				PAGE_READWRITE);
+			*gotHugePages = memory != NULL;
+		}
+	}
+	if (memory == NULL)
+		memory = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+#	ifdef MAP_HUGETLB
+	if (hugePages) {
+		memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory == MAP_FAILED)
+			memory = NULL;
+		*gotHugePages = memory != NULL;
+	}
+#	endif
+	if (memory == NULL) {
+		memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+			return NULL;
+#	ifdef MADV_HUGEPAGE
+		// Transparent huge pages are the next best thing
+		if (hugePages)
+			madvise(memory, size, MADV_HUGEPAGE);
+#	endif
+	}
+#endif
+	return memory;
+}
+
+static void FreePages(void* memory, size_t size)
+{
+#ifdef _WIN32
+	VirtualFree(memory, 0, MEM_RELEASE);
+#else
+	munmap(memory, size);
+#endif
+}
+
+static int SizeClass(size_t bytes)
+{
+	int sizeClass = STAGING_MIN_CLASS;
+	while (sizeClass < STAGING_MAX_CLASS && ((size_t) 1 << sizeClass) < bytes)
+		sizeClass++;
+	return ((size_t) 1 << sizeClass) < bytes ? -1 : sizeClass;
+}
+
+void* AcquireStagingBuffer(size_t bytes)
+{
+	int sizeClass = SizeClass(bytes);
+	StagingBlock* empty = NULL;
+
+	if (sizeClass < 0)
+		return NULL;
+
+	LockPool();
+	g_acquires++;
+	for (int i = 0; i < STAGING_MAX_BLOCKS; i++) {
+		StagingBlock* block = &g_blocks[i];
+		if (block->memory == NULL) {
+			if (empty == NULL)
+				empty = block;
+		} else if (!block->inUse && block->sizeClass == sizeClass) {
+			block->inUse = true;
+			UnlockPool();
+			return block->memory;
+		}
+	}
+
+	// Nothing cached: reserve the table entry, allocate outside the lock
+	g_misses++;
+	if (empty == NULL) {
+		UnlockPool();
+		return NULL;
+	}
+	empty->inUse = true;
+	empty->sizeClass = sizeClass;
+	empty->size = (size_t) 1 << sizeClass;
+	empty->memory = (void*) 1;   // claimed, not yet backed
+	bool hugePages = g_stagingHugePages && empty->size >= STAGING_HUGE_PAGE_MIN;
+	UnlockPool();
+
+	bool gotHugePages;
+	void* memory = AllocatePages(empty->size, hugePages, &gotHugePages);
+
+	LockPool();
+	if (memory == NULL) {
+		empty->memory = NULL;
+		empty->inUse = false;
+	} else {
+		empty->memory = memory;
+		empty->hugePages = gotHugePages;
+		g_systemAllocations++;
+	}
+	UnlockPool();
+	return memory;
+}
+
+void ReleaseStagingBuffer(void* buffer)
+{
+	if (buffer == NULL)
+		return;
+
+	LockPool();
+	for (int i = 0; i < STAGING_MAX_BLOCKS; i++) {
+		if (g_blocks[i].memory == buffer) {
+			g_blocks[i].inUse = false;
+			break;
+		}
+	}
+	UnlockPool();
+}
+
+void SetStagingHugePages(bool enable)
+{
+	g_stagingHugePages = enable;
+}
+
+void TrimStagingPool(void)
+{
+	StagingBlock released[STAGING_MAX_BLOCKS];
+	int count = 0;
+
+	LockPool();
+	for (int i = 0; i < STAGING_MAX_BLOCKS; i++) {
+		StagingBlock* block = &g_blocks[i];
+		if (block->memory != NULL && block->memory != (void*) 1 && !block->inUse) {
+			released[count++] = *block;
+			memset(block, 0, sizeof(*block));
+		}
+	}
+	UnlockPool();
+
+	for (int i = 0; i < count; i++)
+		FreePages(released[i].memory, released[i].size);
+}
+
+void GetStagingStats(StagingStats* stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	LockPool();
+	for (int i = 0; i < STAGING_MAX_BLOCKS; i++) {
+		StagingBlock* block = &g_blocks[i];
+		if (block->memory == NULL || block->memory == (void*) 1)
+			continue;
+		stats->blocks++;
+		stats->bytesReserved += block->size;
+		if (block->hugePages)
+			stats->hugePageBlocks++;
+		if (block->inUse) {
+			stats->blocksInUse++;
+			stats->bytesInUse += block->size;
+		}
+	}
+	stats->systemAllocations = g_systemAllocations;
+	stats->acquires = g_acquires;
+	stats->misses = g_misses;
+	UnlockPool();
+}
+
+void PrintStagingStats(FILE* out)
+{
+	StagingStats stats;
+
+	GetStagingStats(&stats);
+	fprintf(out, "Staging: %d blocks (%d in use, %d huge page), %.2f MB reserved, %.2f MB in use\n",
+		stats.blocks, stats.blocksInUse, stats.hugePageBlocks,
+		stats.bytesReserved / 1048576.0, stats.bytesInUse / 1048576.0);
+	fprintf(out, "  %d acquires, %d misses, %d OS allocations\n",
+		stats.acquires, stats.misses, stats.systemAllocations);
+}
@@ -0,0 +1,40 @@
+// staging_pool.h
+//
+// Pool of page aligned staging buffers for texture generation, decoding and
+// upload. Requests are rounded up to a power of two size class and served
+// from blocks returned earlier, so once every size in use has been seen the
+// texture paths run without touching the heap. Blocks come straight from the
+// OS (VirtualAlloc / mmap), optionally backed by huge pages. Thread safe.
+
+#ifndef STAGING_POOL_H
+#define STAGING_POOL_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+struct StagingStats {
+	int blocks;                 // owned by the pool
+	int blocksInUse;
+	size_t bytesReserved;
+	size_t bytesInUse;
+	int systemAllocations;      // cumulative OS allocations
+	int hugePageBlocks;
+	int acquires;               // cumulative
+	int misses;                 // acquires that needed a new block
+};
+
+// Returns NULL only if the OS refuses the memory
+void* AcquireStagingBuffer(size_t bytes);
+void ReleaseStagingBuffer(void* buffer);
+
+// Applies to blocks allocated from now on; falls back silently if the OS
+// has no huge pages for us
+void SetStagingHugePages(bool enable);
+
+// Returns cached blocks that are not in use to the OS
+void TrimStagingPool(void);
+
+void GetStagingStats(StagingStats* stats);
+void PrintStagingStats(FILE* out);
+
+#endif
@@ -0,0 +1,262 @@
+// teapot.cpp
+//
+// Patch data from GLUT's teapot.c (Newell's teapot). The first six patches
+// are a quarter of the body, rim, lid and bottom and are mirrored four
+// ways; the handle and spout are halves mirrored across y.
+
+#include "teapot.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define TEAPOT_PATCHES 10
+
+static const int g_patchData[TEAPOT_PATCHES][16] = {
+	// rim
+	{ 102, 103, 104, 105, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	// body
+	{ 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 },
+	{ 24, 25, 26, 27, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40 },
+	// lid
+	{ 96, 96, 96, 96, 97, 98, 99, 100, 101, 101, 101, 101, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117 },
+	// bottom
+	{ 118, 118, 118, 118, 124, 122, 119, 121, 123, 126, 125, 120, 40, 39, 38, 37 },
+	// handle
+	{ 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56 },
+	{ 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 28, 65, 66, 67 },
+	// spout
+	{ 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83 },
+	{ 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95 }
+};
+
+static const float g_controlPoints[127][3] = {
+	{ 0.2f, 0, 2.7f }, { 0.2f, -0.112f, 2.7f }, { 0.112f, -0.2f, 2.7f }, { 0, -0.2f, 2.7f },
+	{ 1.3375f, 0, 2.53125f }, { 1.3375f, -0.749f, 2.53125f }, { 0.749f, -1.3375f, 2.53125f },
+	{ 0, -1.3375f, 2.53125f }, { 1.4375f, 0, 2.53125f }, { 1.4375f, -0.805f, 2.53125f },
+	{ 0.805f, -1.4375f, 2.53125f }, { 0, -1.4375f, 2.53125f }, { 1.5f, 0, 2.4f },
+	{ 1.5f, -0.84f, 2.4f }, { 0.84f, -1.5f, 2.4f }, { 0, -1.5f, 2.4f }, { 1.75f, 0, 1.875f },
+	{ 1.75f, -0.98f, 1.875f }, { 0.98f, -1.75f, 1.875f }, { 0, -1.75f, 1.875f },
+	{ 2, 0, 1.35f }, { 2, -1.12f, 1.35f }, { 1.12f, -2, 1.35f }, { 0, -2, 1.35f },
+	{ 2, 0, 0.9f }, { 2, -1.12f, 0.9f }, { 1.12f, -2, 0.9f }, { 0, -2, 0.9f }, { -2, 0, 0.9f },
+	{ 2, 0, 0.45f }, { 2, -1.12f, 0.45f }, { 1.12f, -2, 0.45f }, { 0, -2, 0.45f },
+	{ 1.5f, 0, 0.225f }, { 1.5f, -0.84f, 0.225f }, { 0.84f, -1.5f, 0.225f }, { 0, -1.5f, 0.225f },
+	{ 1.5f, 0, 0.15f }, { 1.5f, -0.84f, 0.15f }, { 0.84f, -1.5f, 0.15f }, { 0, -1.5f, 0.15f },
+	{ -1.6f, 0, 2.025f }, { -1.6f, -0.3f, 2.025f }, { -1.5f, -0.3f, 2.25f }, { -1.5f, 0, 2.25f },
+	{ -2.3f, 0, 2.025f }, { -2.3f, -0.3f, 2.025f }, { -2.5f, -0.3f, 2.25f }, { -2.5f, 0, 2.25f },
+	{ -2.7f, 0, 2.025f }, { -2.7f, -0.3f, 2.025f }, { -3, -0.3f, 2.25f }, { -3, 0, 2.25f },
+	{ -2.7f, 0, 1.8f }, { -2.7f, -0.3f, 1.8f }, { -3, -0.3f, 1.8f }, { -3, 0, 1.8f },
+	{ -2.7f, 0, 1.575f }, { -2.7f, -0.3f, 1.575f }, { -3, -0.3f, 1.35f }, { -3, 0, 1.35f },
+	{ -2.5f, 0, 1.125f }, { -2.5f, -0.3f, 1.125f }, { -2.65f, -0.3f, 0.9375f },
+	{ -2.65f, 0, 0.9375f }, { -2, -0.3f, 0.9f }, { -1.9f, -0.3f, 0.6f }, { -1.9f, 0, 0.6f },
+	{ 1.7f, 0, 1.425f }, { 1.7f, -0.66f, 1.425f }, { 1.7f, -0.66f, 0.6f }, { 1.7f, 0, 0.6f },
+	{ 2.6f, 0, 1.425f }, { 2.6f, -0.66f, 1.425f }, { 3.1f, -0.66f, 0.825f }, { 3.1f, 0, 0.825f },
+	{ 2.3f, 0, 2.1f }, { 2.3f, -0.25f, 2.1f }, { 2.4f, -0.25f, 2.025f }, { 2.4f, 0, 2.025f },
+	{ 2.7f, 0, 2.4f }, { 2.7f, -0.25f, 2.4f }, { 3.3f, -0.25f, 2.4f }, { 3.3f, 0, 2.4f },
+	{ 2.8f, 0, 2.475f }, { 2.8f, -0.25f, 2.475f }, { 3.525f, -0.25f, 2.49375f },
+	{ 3.525f, 0, 2.49375f }, { 2.9f, 0, 2.475f }, { 2.9f, -0.15f, 2.475f },
+	{ 3.45f, -0.15f, 2.5125f }, { 3.45f, 0, 2.5125f }, { 2.8f, 0, 2.4f }, { 2.8f, -0.15f, 2.4f },
+	{ 3.2f, -0.15f, 2.4f }, { 3.2f, 0, 2.4f }, { 0, 0, 3.15f }, { 0.8f, 0, 3.15f },
+	{ 0.8f, -0.45f, 3.15f }, { 0.45f, -0.8f, 3.15f }, { 0, -0.8f, 3.15f }, { 0, 0, 2.85f },
+	{ 1.4f, 0, 2.4f }, { 1.4f, -0.784f, 2.4f }, { 0.784f, -1.4f, 2.4f }, { 0, -1.4f, 2.4f },
+	{ 0.4f, 0, 2.55f }, { 0.4f, -0.224f, 2.55f }, { 0.224f, -0.4f, 2.55f }, { 0, -0.4f, 2.55f },
+	{ 1.3f, 0, 2.55f }, { 1.3f, -0.728f, 2.55f }, { 0.728f, -1.3f, 2.55f }, { 0, -1.3f, 2.55f },
+	{ 1.3f, 0, 2.4f }, { 1.3f, -0.728f, 2.4f }, { 0.728f, -1.3f, 2.4f }, { 0, -1.3f, 2.4f },
+	{ 0, 0, 0 }, { 1.425f, -0.798f, 0 }, { 1.5f, 0, 0.075f }, { 1.425f, 0, 0 },
+	{ 0.798f, -1.425f, 0 }, { 0, -1.5f, 0.075f }, { 0, -1.425f, 0 }, { 1.5f, -0.84f, 0.075f },
+	{ 0.84f, -1.5f, 0.075f }
+};
+
+// Cubic Bernstein weights and their derivatives at t
+static void Bernstein(float t, float b[4], float d[4])
+{
+	float s = 1 - t;
+	b[0] = s * s * s;
+	b[1] = 3 * t * s * s;
+	b[2] = 3 * t * t * s;
+	b[3] = t * t * t;
+	d[0] = -3 * s * s;
+	d[1] = 3 * s * s - 6 * t * s;
+	d[2] = 6 * t * s - 3 * t * t;
+	d[3] = 3 * t * t;
+}
+
+// Position and the two tangents of patch[v row][u column] at (u, v)
+static void EvaluatePatch(const float patch[4][4][3], float u, float v,
+	float position[3], float du[3], float dv[3])
+{
+	float bu[4], bv[4], dbu[4], dbv[4];
+
+	Bernstein(u, bu, dbu);
+	Bernstein(v, bv, dbv);
+	for (int l = 0; l < 3; l++) {
+		position[l] = du[l] = dv[l] = 0;
+		for (int j = 0; j < 4; j++) {
+			for (int k = 0; k < 4; k++) {
+				float p = patch[j][k][l];
+				position[l] += bu[k] * bv[j] * p;
+				du[l] += dbu[k] * bv[j] * p;
+				dv[l] += bu[k] * dbv[j] * p;
+			}
+		}
+	}
+}
+
+// GL_AUTO_NORMAL's du x dv. Where a patch edge collapses to a point (the
+// lid knob and the bottom center) that is zero, so take it a little way
+// into the patch instead.
+static void PatchNormal(const float patch[4][4][3], float u, float v, float normal[3])
+{
+	for (int attempt = 0; attempt < 3; attempt++) {
+		float position[3], du[3], dv[3];
+		EvaluatePatch(patch, u, v, position, du, dv);
+		normal[0] = du[1] * dv[2] - du[2] * dv[1];
+		normal[1] = du[2] * dv[0] - du[0] * dv[2];
+		normal[2] = du[0] * dv[1] - du[1] * dv[0];
+
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length > 1e-6f) {
+			normal[0] /= length;
+			normal[1] /= length;
+			normal[2] /= length;
+			return;
+		}
+		u += u < 0.5f ? 0.001f : -0.001f;
+		v += v < 0.5f ? 0.001f : -0.001f;
+	}
+}
+
+// Appends one patch as glEvalMesh2(GL_FILL) would draw it, in the
+// placement glutSolidTeapot sets up: rotated 270 degrees about x, scaled
+// by size / 2, with the base 1.5 units below the origin before scaling
+static void AddPatch(const float patch[4][4][3], float size, int grid,
+	MeshVertex* vertices, int* vertexCount, unsigned int* indices, int* indexCount)
+{
+	int first = *vertexCount;
+	float scale = 0.5f * size;
+
+	for (int j = 0; j <= grid; j++) {
+		for (int i = 0; i <= grid; i++) {
+			float u = (float) i / grid, v = (float) j / grid;
+			float position[3], du[3], dv[3], normal[3];
+			EvaluatePatch(patch, u, v, position, du, dv);
+			PatchNormal(patch, u, v, normal);
+
+			MeshVertex* out = &vertices[(*vertexCount)++];
+			out->position[0] = position[0] * scale;
+			out->position[1] = (position[2] - 1.5f) * scale;
+			out->position[2] = -position[1] * scale;
+			out->normal[0] = normal[0];
+			out->normal[1] = normal[2];
+			out->normal[2] = -normal[1];
+			out->texCoord[0] = u;
+			out->texCoord[1] = v;
+		}
+	}
+
+	// Each row is a quad strip; split its quads the way a strip would be
+	for (int j = 0; j < grid; j++) {
+		for (int i = 0; i < grid; i++) {
+			unsigned int a0 = first + j * (grid + 1) + i, a1 = a0 + 1;
+			unsigned int b0 = a0 + grid + 1, b1 = b0 + 1;
+			unsigned int* quad = &indices[*indexCount];
+			quad[0] = a0;
+			quad[1] = b0;
+			quad[2] = a1;
+			quad[3] = a1;
+			quad[4] = b0;
+			quad[5] = b1;
+			*indexCount += 6;
+		}
+	}
+}
+
+bool CreateTeapotMesh(Mesh* mesh, float size, int grid)
+{
+	// Six patches four ways and four two ways
+	int patches = 6 * 4 + 4 * 2;
+	MeshVertex* vertices = (MeshVertex*) malloc(patches * (grid + 1) * (grid + 1) * sizeof(MeshVertex));
+	unsigned int* indices = (unsigned int*) malloc(patches * grid * grid * 6 * sizeof(unsigned int));
+	int vertexCount = 0, indexCount = 0;
+	bool ok = false;
+
+	if (grid > 0 && vertices != NULL && indices != NULL) {
+		for (int i = 0; i < TEAPOT_PATCHES; i++) {
+			// Mirroring reverses u too, so the winding and normals stay outward
+			float p[4][4][3], q[4][4][3], r[4][4][3], s[4][4][3];
+			for (int j = 0; j < 4; j++) {
+				for (int k = 0; k < 4; k++) {
+					for (int l = 0; l < 3; l++) {
+						float forward = g_controlPoints[g_patchData[i][j * 4 + k]][l];
+						float reversed = g_controlPoints[g_patchData[i][j * 4 + (3 - k)]][l];
+						p[j][k][l] = forward;
+						q[j][k][l] = l == 1 ? -reversed : reversed;
+						r[j][k][l] = l == 0 ? -reversed : reversed;
+						s[j][k][l] = l < 2 ? -forward : forward;
+					}
+				}
+			}
+			AddPatch(p, size, grid, vertices, &vertexCount, indices, &indexCount);
+			AddPatch(q, size, grid, vertices, &vertexCount, indices, &indexCount);
+			if (i < 6) {
+				AddPatch(r, size, grid, vertices, &vertexCount, indices, &indexCount);
+				AddPatch(s, size, grid, vertices, &vertexCount, indices, &indexCount);
+			}
+		}
+		ok = CreateMesh(mesh, vertices, vertexCount, indices, indexCount);
+	}
+	free(vertices);
+	free(indices);
+	return ok;
+}
+
+float TeapotTessellationError(float size, int grid)
+{
+	// Points in a grid cell, as fractions of it, and the two corners whose
+	// midpoint the mesh puts there: the center lies on the diagonal the
+	// cell is split along, the edge midpoints on the edges. Corners are
+	// numbered (u0, v0), (u1, v0), (u0, v1), (u1, v1).
+	static const struct {
+		float u, v;
+		int a, b;
+	} samples[5] = {
+		{ 0.5f, 0.5f, 1, 2 },
+		{ 0.5f, 0, 0, 1 }, { 0, 0.5f, 0, 2 }, { 1, 0.5f, 1, 3 }, { 0.5f, 1, 2, 3 }
+	};
+	float error = 0;
+
+	if (grid < 1)
+		return 0;
+
+	// Mirroring moves the surface and the mesh alike, so the ten patches
+	// as stored give the error of all of them
+	for (int i = 0; i < TEAPOT_PATCHES; i++) {
+		float p[4][4][3];
+		for (int j = 0; j < 4; j++)
+			for (int k = 0; k < 4; k++)
+				for (int l = 0; l < 3; l++)
+					p[j][k][l] = g_controlPoints[g_patchData[i][j * 4 + k]][l];
+
+		for (int row = 0; row < grid; row++) {
+			for (int column = 0; column < grid; column++) {
+				float corners[4][3], du[3], dv[3];
+				for (int c = 0; c < 4; c++)
+					EvaluatePatch(p, (float) (column + c % 2) / grid, (float) (row + c / 2) / grid,
+						corners[c], du, dv);
+
+				for (int s = 0; s < 5; s++) {
+					float surface[3], distance2 = 0;
+					EvaluatePatch(p, (column + samples[s].u) / grid, (row + samples[s].v) / grid,
+						surface, du, dv);
+					for (int l = 0; l < 3; l++) {
+						float d = surface[l] - (corners[samples[s].a][l] + corners[samples[s].b][l]) / 2;
+						distance2 += d * d;
+					}
+					if (distance2 > error * error)
+						error = sqrtf(distance2);
+				}
+			}
+		}
+	}
+	return error * 0.5f * size;
+}
@@ -0,0 +1,20 @@
+// teapot.h
+//
+// The Utah teapot as a mesh: the same Bezier patches, placement and grid
+// as glutSolidTeapot, evaluated once on the CPU instead of through GL
+// evaluators every frame, so it can be drawn from a vertex buffer.
+
+#ifndef TEAPOT_H
+#define TEAPOT_H
+
+#include "mesh.h"
+
+// grid is the number of quads along each patch edge; glutSolidTeapot
+// uses 7
+bool CreateTeapotMesh(Mesh* mesh, float size, int grid);
+
+// The furthest CreateTeapotMesh(size, grid) strays from the true surface,
+// measured at the centers and edge midpoints of its grid cells
+float TeapotTessellationError(float size, int grid);
+
+#endif
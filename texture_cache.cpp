@@ -0,0 +1,173 @@
+// texture_cache.cpp
+//
+// Cache file layout: a TextureCacheHeader followed by the levels, finest
+// first, each at the offset recorded in the header. Files are written to a
+// temporary name and renamed into place so a crash never leaves a partial
+// entry behind. Called from the streaming thread.
+
+#include "texture_cache.h"
+
+#include <string.h>
+
+#define TEXTURE_CACHE_MAGIC    0x31435854   // "TXC1"
+#define TEXTURE_CACHE_VERSION  2
+
+struct TextureCacheHeader {
+	unsigned int magic;
+	unsigned int version;
+	TextureCacheKey key;
+	unsigned int width, height, levels;
+	unsigned int format;           // TexelFormat
+	unsigned long long levelOffset[TEXTURE_CACHE_MAX_LEVELS];
+	unsigned long long levelBytes[TEXTURE_CACHE_MAX_LEVELS];
+};
+
+static char g_cacheDirectory[260] = "texcache";
+static volatile long g_cacheHits = 0;
+static volatile long g_cacheMisses = 0;
+static volatile long g_cacheStores = 0;
+
+static int LevelSize(int size, int level)
+{
+	size >>= level;
+	return size > 0 ? size : 1;
+}
+
+static void CacheFileName(char* path, size_t size, TextureCacheKey key, const char* suffix)
+{
+	snprintf(path, size, "%s/%08lx%08lx.tex%s", g_cacheDirectory,
+		(unsigned long) (key >> 32), (unsigned long) (key & 0xffffffffUL), suffix);
+}
+
+TextureCacheKey HashTextureKey(const void* data, size_t size, TextureCacheKey seed)
+{
+	const unsigned char* p = (const unsigned char*) data;
+	TextureCacheKey hash = seed ? seed : 14695981039346656037ULL;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+TextureCacheKey HashTextureKeyString(const char* text, TextureCacheKey seed)
+{
+	return HashTextureKey(text, strlen(text), seed);
+}
+
+bool OpenCachedTexture(CachedTexture* cached, TextureCacheKey key,
+	int width, int height, int levels)
+{
+	char path[300];
+
+	memset(cached, 0, sizeof(*cached));
+	if (g_cacheDirectory[0] == '\0')
+		return false;
+
+	CacheFileName(path, sizeof(path), key, "");
+	if (!MapFile(&cached->file, path)) {
+		AtomicIncrement(&g_cacheMisses);
+		return false;
+	}
+
+	const TextureCacheHeader* header = (const TextureCacheHeader*) cached->file.data;
+	bool ok = cached->file.size >= sizeof(TextureCacheHeader) &&
+		header->magic == TEXTURE_CACHE_MAGIC && header->version == TEXTURE_CACHE_VERSION &&
+		header->key == key && (int) header->width == width &&
+		(int) header->height == height && (int) header->levels == levels;
+	// A compressed entry is only usable if this driver can sample it
+	if (ok && !IsTexelFormatSupported((TexelFormat) header->format))
+		ok = false;
+
+	for (int level = 0; ok && level < levels; level++) {
+		unsigned long long offset = header->levelOffset[level];
+		unsigned long long bytes = header->levelBytes[level];
+		if (offset > cached->file.size || bytes > cached->file.size - offset)
+			ok = false;
+		cached->levelData[level] = cached->file.data + offset;
+		cached->levelBytes[level] = (size_t) bytes;
+	}
+
+	if (!ok) {
+		UnmapFile(&cached->file);
+		AtomicIncrement(&g_cacheMisses);
+		return false;
+	}
+	cached->width = width;
+	cached->height = height;
+	cached->levels = levels;
+	cached->format = (TexelFormat) header->format;
+	AtomicIncrement(&g_cacheHits);
+	return true;
+}
+
+void CloseCachedTexture(CachedTexture* cached)
+{
+	UnmapFile(&cached->file);
+}
+
+bool StoreCachedTexture(TextureCacheKey key, int width, int height, int levels,
+	TexelFormat format, const unsigned char* const* levelData)
+{
+	TextureCacheHeader header;
+	char path[300], temp[300];
+
+	if (g_cacheDirectory[0] == '\0' || levels > TEXTURE_CACHE_MAX_LEVELS ||
+		!MakeDirectory(g_cacheDirectory))
+		return false;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = TEXTURE_CACHE_MAGIC;
+	header.version = TEXTURE_CACHE_VERSION;
+	header.key = key;
+	header.width = width;
+	header.height = height;
+	header.levels = levels;
+	header.format = format;
+
+	unsigned long long offset = sizeof(header);
+	for (int level = 0; level < levels; level++) {
+		size_t bytes = TexelImageSize(format, LevelSize(width, level), LevelSize(height, level));
+		header.levelOffset[level] = offset;
+		header.levelBytes[level] = bytes;
+		offset += bytes;
+	}
+
+	CacheFileName(path, sizeof(path), key, "");
+	CacheFileName(temp, sizeof(temp), key, ".tmp");
+	FILE* file = fopen(temp, "wb");
+	bool ok = file != NULL && fwrite(&header, sizeof(header), 1, file) == 1;
+	for (int level = 0; ok && level < levels; level++)
+		ok = fwrite(levelData[level], 1, header.levelBytes[level], file) == header.levelBytes[level];
+	if (file != NULL && fclose(file) != 0)
+		ok = false;
+	if (ok)
+		ok = RenameFile(temp, path);
+	if (!ok)
+		remove(temp);
+	else
+		AtomicIncrement(&g_cacheStores);
+	return ok;
+}
+
+void SetTextureCacheDirectory(const char* path)
+{
+	if (path == NULL) {
+		g_cacheDirectory[0] = '\0';
+		return;
+	}
+	strncpy(g_cacheDirectory, path, sizeof(g_cacheDirectory) - 1);
+	g_cacheDirectory[sizeof(g_cacheDirectory) - 1] = '\0';
+}
+
+void PrintTextureCacheStats(FILE* out)
+{
+	if (g_cacheDirectory[0] == '\0') {
+		fprintf(out, "Texture cache: disabled\n");
+		return;
+	}
+	fprintf(out, "Texture cache (%s): %ld hits, %ld misses, %ld stored\n",
+		g_cacheDirectory,
+		AtomicLoad(&g_cacheHits), AtomicLoad(&g_cacheMisses), AtomicLoad(&g_cacheStores));
+}
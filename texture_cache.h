@@ -0,0 +1,48 @@
+// texture_cache.h
+//
+// On-disk cache of finished mip chains. Entries are keyed by a 64 bit hash
+// of whatever produced the texture (generator name and parameters, or the
+// bytes of the source image) and hold every mip level ready for upload,
+// already packed into its reduced or compressed texel format. On a hit the
+// file is memory mapped and the streaming thread copies levels straight
+// from the mapping into upload slots, skipping generation, decoding, mip
+// building and packing.
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <stdio.h>
+
+#include "gl_extensions.h"
+#include "platform.h"
+#include "texture_format.h"
+
+#define TEXTURE_CACHE_MAX_LEVELS 16
+
+typedef unsigned long long TextureCacheKey;
+
+struct CachedTexture {
+	MappedFile file;
+	int width, height, levels;
+	TexelFormat format;
+	const unsigned char* levelData[TEXTURE_CACHE_MAX_LEVELS];
+	size_t levelBytes[TEXTURE_CACHE_MAX_LEVELS];
+};
+
+// FNV-1a; chain calls through seed to hash several pieces
+TextureCacheKey HashTextureKey(const void* data, size_t size, TextureCacheKey seed);
+TextureCacheKey HashTextureKeyString(const char* text, TextureCacheKey seed);
+
+// Maps the entry for key if present and matching the given dimensions
+bool OpenCachedTexture(CachedTexture* cached, TextureCacheKey key,
+	int width, int height, int levels);
+void CloseCachedTexture(CachedTexture* cached);
+
+// Writes a mip chain already packed in format (see PackTexels)
+bool StoreCachedTexture(TextureCacheKey key, int width, int height, int levels,
+	TexelFormat format, const unsigned char* const* levelData);
+
+void SetTextureCacheDirectory(const char* path);   // NULL disables the cache
+void PrintTextureCacheStats(FILE* out);
+
+#endif
@@ -0,0 +1,169 @@
+// texture_compress.cpp
+//
+// BC1 and BC3 block encoders for texture_compress.h.
+
+#include "texture_compress.h"
+
+#include <string.h>
+
+static int BlockBytes(GLenum format)
+{
+	return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+}
+
+GLenum ChooseCompressedFormat(const unsigned char* rgba, int width, int height)
+{
+	size_t count = (size_t) width * height;
+
+	for (size_t i = 0; i < count; i++) {
+		if (rgba[4 * i + 3] != 255)
+			return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	}
+	return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+size_t CompressedRowSize(GLenum format, int width)
+{
+	return (size_t) ((width + 3) / 4) * BlockBytes(format);
+}
+
+size_t CompressedImageSize(GLenum format, int width, int height)
+{
+	return CompressedRowSize(format, width) * ((height + 3) / 4);
+}
+
+static unsigned short To565(int r, int g, int b)
+{
+	return (unsigned short) (((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+static void From565(unsigned short c, int* rgb)
+{
+	rgb[0] = ((c >> 11) & 31) * 255 / 31;
+	rgb[1] = ((c >> 5) & 63) * 255 / 63;
+	rgb[2] = (c & 31) * 255 / 31;
+}
+
+// block holds 16 RGBA texels; writes 8 bytes
+static void EncodeColorBlock(const unsigned char* block, unsigned char* out)
+{
+	int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			if (block[4 * i + c] < lo[c]) lo[c] = block[4 * i + c];
+			if (block[4 * i + c] > hi[c]) hi[c] = block[4 * i + c];
+		}
+	}
+	// Inset the box slightly; the extremes are rarely the best endpoints
+	for (int c = 0; c < 3; c++) {
+		int inset = (hi[c] - lo[c]) / 16;
+		lo[c] += inset;
+		hi[c] -= inset;
+	}
+
+	unsigned short c0 = To565(hi[0], hi[1], hi[2]);
+	unsigned short c1 = To565(lo[0], lo[1], lo[2]);
+	unsigned int indices = 0;
+
+	if (c0 < c1) {
+		unsigned short swap = c0;
+		c0 = c1;
+		c1 = swap;
+	}
+	if (c0 != c1) {
+		// Four color mode: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+		int palette[4][3];
+		From565(c0, palette[0]);
+		From565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestError = 1 << 30;
+			for (int p = 0; p < 4; p++) {
+				int error = 0;
+				for (int c = 0; c < 3; c++) {
+					int d = block[4 * i + c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < bestError) {
+					bestError = error;
+					best = p;
+				}
+			}
+			indices |= (unsigned int) best << (2 * i);
+		}
+	}
+
+	out[0] = (unsigned char) (c0 & 0xff);
+	out[1] = (unsigned char) (c0 >> 8);
+	out[2] = (unsigned char) (c1 & 0xff);
+	out[3] = (unsigned char) (c1 >> 8);
+	out[4] = (unsigned char) (indices & 0xff);
+	out[5] = (unsigned char) ((indices >> 8) & 0xff);
+	out[6] = (unsigned char) ((indices >> 16) & 0xff);
+	out[7] = (unsigned char) (indices >> 24);
+}
+
+// Eight value interpolated alpha; writes 8 bytes
+static void EncodeAlphaBlock(const unsigned char* block, unsigned char* out)
+{
+	int a0 = 0, a1 = 255;
+
+	for (int i = 0; i < 16; i++) {
+		if (block[4 * i + 3] > a0) a0 = block[4 * i + 3];
+		if (block[4 * i + 3] < a1) a1 = block[4 * i + 3];
+	}
+
+	unsigned long long bits = 0;
+	if (a0 != a1) {
+		int palette[8];
+		palette[0] = a0;
+		palette[1] = a1;
+		for (int p = 1; p < 7; p++)
+			palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestError = 1 << 30;
+			for (int p = 0; p < 8; p++) {
+				int d = block[4 * i + 3] - palette[p];
+				if (d * d < bestError) {
+					bestError = d * d;
+					best = p;
+				}
+			}
+			bits |= (unsigned long long) best << (3 * i);
+		}
+	}
+
+	out[0] = (unsigned char) a0;
+	out[1] = (unsigned char) a1;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (unsigned char) (bits >> (8 * i));
+}
+
+void CompressImage(GLenum format, const unsigned char* rgba, int width, int height,
+	unsigned char* dst)
+{
+	unsigned char block[64];
+
+	for (int by = 0; by < height; by += 4) {
+		for (int bx = 0; bx < width; bx += 4) {
+			// Edge blocks repeat the last row / column
+			for (int y = 0; y < 4; y++) {
+				int sy = by + y < height ? by + y : height - 1;
+				for (int x = 0; x < 4; x++) {
+					int sx = bx + x < width ? bx + x : width - 1;
+					memcpy(block + 4 * (4 * y + x), rgba + 4 * ((size_t) sy * width + sx), 4);
+				}
+			}
+			if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+				EncodeAlphaBlock(block, dst);
+				dst += 8;
+			}
+			EncodeColorBlock(block, dst);
+			dst += 8;
+		}
+	}
+}
@@ -0,0 +1,25 @@
+// texture_compress.h
+//
+// CPU block compression to S3TC/BC formats. The encoder fits each 4x4 block
+// to the bounding box of its colors: quick enough to run on the streaming
+// thread, and the result is cached on disk, so it runs once per texture.
+
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <stddef.h>
+
+#include "gl_extensions.h"
+
+// BC1 (DXT1) when the image is opaque, BC3 (DXT5) otherwise
+GLenum ChooseCompressedFormat(const unsigned char* rgba, int width, int height);
+
+size_t CompressedImageSize(GLenum format, int width, int height);
+// Bytes in one row of 4x4 blocks
+size_t CompressedRowSize(GLenum format, int width);
+
+// Compresses an RGBA8 image (rows packed) into dst, CompressedImageSize bytes
+void CompressImage(GLenum format, const unsigned char* rgba, int width, int height,
+	unsigned char* dst);
+
+#endif
@@ -0,0 +1,253 @@
+// texture_dynamic.cpp
+//
+// Dirty rectangle tracking and partial uploads for texture_dynamic.h.
+
+#include "texture_dynamic.h"
+#include "gl_state.h"
+#include "staging_pool.h"
+
+#include <string.h>
+
+#define MAX_DYNAMIC_TEXTURES  16
+#define DYNAMIC_PBO_COUNT     2
+
+struct DynamicTexture {
+	bool used;
+	char label[32];
+	GLuint name;
+	int width, height;
+	unsigned char* pixels;          // system copy, from the staging pool
+	DynamicTextureFunc update;
+	void* user;
+	bool uploaded;                  // first full upload done
+	GLuint pbo[DYNAMIC_PBO_COUNT];
+	int nextPbo;
+
+	// Cumulative
+	int frames;
+	int rects;
+	size_t bytes;                   // uploaded
+	size_t fullBytes;               // had every frame been a full upload
+};
+
+static DynamicTexture g_dynamicTextures[MAX_DYNAMIC_TEXTURES];
+
+static DynamicTexture* GetDynamicTexture(DynamicTextureHandle handle)
+{
+	if (handle <= 0 || handle > MAX_DYNAMIC_TEXTURES || !g_dynamicTextures[handle - 1].used)
+		return NULL;
+	return &g_dynamicTextures[handle - 1];
+}
+
+DynamicTextureHandle CreateDynamicTexture(const char* label, int width, int height,
+	DynamicTextureFunc update, void* user)
+{
+	for (int i = 0; i < MAX_DYNAMIC_TEXTURES; i++) {
+		DynamicTexture* tex = &g_dynamicTextures[i];
+		if (tex->used)
+			continue;
+
+		memset(tex, 0, sizeof(*tex));
+		tex->pixels = (unsigned char*) AcquireStagingBuffer((size_t) width * height * 4);
+		if (tex->pixels == NULL)
+			return DYNAMIC_TEXTURE_NONE;
+		memset(tex->pixels, 0, (size_t) width * height * 4);
+
+		tex->used = true;
+		strncpy(tex->label, label ? label : "", sizeof(tex->label) - 1);
+		tex->width = width;
+		tex->height = height;
+		tex->update = update;
+		tex->user = user;
+
+		glGenTextures(1, &tex->name);
+		CachedBindTexture(GL_TEXTURE_2D, tex->name);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+		if (g_glCaps.pixelBufferObject)
+			glGenBuffers(DYNAMIC_PBO_COUNT, tex->pbo);
+		return i + 1;
+	}
+	return DYNAMIC_TEXTURE_NONE;
+}
+
+void DestroyDynamicTexture(DynamicTextureHandle handle)
+{
+	DynamicTexture* tex = GetDynamicTexture(handle);
+
+	if (tex == NULL)
+		return;
+	if (tex->pbo[0])
+		CachedDeleteBuffers(DYNAMIC_PBO_COUNT, tex->pbo);
+	CachedDeleteTextures(1, &tex->name);
+	ReleaseStagingBuffer(tex->pixels);
+	tex->used = false;
+}
+
+GLuint GetDynamicTextureName(DynamicTextureHandle handle)
+{
+	DynamicTexture* tex = GetDynamicTexture(handle);
+	return tex ? tex->name : 0;
+}
+
+void BindDynamicTexture(DynamicTextureHandle handle)
+{
+	CachedBindTexture(GL_TEXTURE_2D, GetDynamicTextureName(handle));
+}
+
+static bool Overlaps(const DirtyRect* a, const DirtyRect* b)
+{
+	return a->x <= b->x + b->width && b->x <= a->x + a->width &&
+		a->y <= b->y + b->height && b->y <= a->y + a->height;
+}
+
+// Clips to the texture and merges touching or overlapping rectangles into
+// their bounding box, so no texel is sent twice. Returns the new count, or
+// -1 when the rectangles cover enough that one full upload is cheaper.
+static int MergeDirtyRects(const DynamicTexture* tex, DirtyRect* rects, int count)
+{
+	size_t area = 0;
+
+	for (int i = 0; i < count; i++) {
+		DirtyRect* r = &rects[i];
+		int x1 = r->x + r->width, y1 = r->y + r->height;
+		r->x = r->x < 0 ? 0 : r->x;
+		r->y = r->y < 0 ? 0 : r->y;
+		r->width = (x1 > tex->width ? tex->width : x1) - r->x;
+		r->height = (y1 > tex->height ? tex->height : y1) - r->y;
+		if (r->width <= 0 || r->height <= 0)
+			rects[i--] = rects[--count];
+	}
+
+	for (bool merged = true; merged; ) {
+		merged = false;
+		for (int i = 0; i < count; i++) {
+			for (int j = i + 1; j < count; j++) {
+				if (!Overlaps(&rects[i], &rects[j]))
+					continue;
+				DirtyRect* a = &rects[i];
+				const DirtyRect* b = &rects[j];
+				int x1 = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+				int y1 = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+				a->x = a->x < b->x ? a->x : b->x;
+				a->y = a->y < b->y ? a->y : b->y;
+				a->width = x1 - a->x;
+				a->height = y1 - a->y;
+				rects[j--] = rects[--count];
+				merged = true;
+			}
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+		area += (size_t) rects[i].width * rects[i].height;
+	// Past about half the texture the per-call overhead outweighs the saving
+	if (area * 2 > (size_t) tex->width * tex->height)
+		return -1;
+	return count;
+}
+
+static void UploadRects(DynamicTexture* tex, const DirtyRect* rects, int count)
+{
+	size_t total = 0;
+
+	for (int i = 0; i < count; i++)
+		total += (size_t) rects[i].width * rects[i].height * 4;
+	if (total == 0)
+		return;
+
+	CachedBindTexture(GL_TEXTURE_2D, tex->name);
+
+	if (tex->pbo[0]) {
+		// Alternate buffers and orphan the storage, so mapping never waits
+		// for the GPU to finish last frame's copy
+		GLuint pbo = tex->pbo[tex->nextPbo];
+		tex->nextPbo = (tex->nextPbo + 1) % DYNAMIC_PBO_COUNT;
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, total, NULL, GL_STREAM_DRAW);
+		unsigned char* dst = (unsigned char*) glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+		if (dst != NULL) {
+			size_t offset = 0;
+			for (int i = 0; i < count; i++) {
+				const DirtyRect* r = &rects[i];
+				for (int y = 0; y < r->height; y++) {
+					memcpy(dst + offset + (size_t) y * r->width * 4,
+						tex->pixels + 4 * ((size_t) (r->y + y) * tex->width + r->x),
+						(size_t) r->width * 4);
+				}
+				offset += (size_t) r->width * r->height * 4;
+			}
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			offset = 0;
+			for (int i = 0; i < count; i++) {
+				const DirtyRect* r = &rects[i];
+				glTexSubImage2D(GL_TEXTURE_2D, 0, r->x, r->y, r->width, r->height,
+					GL_RGBA, GL_UNSIGNED_BYTE, (const GLvoid*) offset);
+				offset += (size_t) r->width * r->height * 4;
+			}
+			CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			tex->rects += count;
+			tex->bytes += total;
+			return;
+		}
+		// Lost the mapping; send from system memory this time
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, tex->width);
+	for (int i = 0; i < count; i++) {
+		const DirtyRect* r = &rects[i];
+		glTexSubImage2D(GL_TEXTURE_2D, 0, r->x, r->y, r->width, r->height,
+			GL_RGBA, GL_UNSIGNED_BYTE, tex->pixels + 4 * ((size_t) r->y * tex->width + r->x));
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	tex->rects += count;
+	tex->bytes += total;
+}
+
+void UpdateDynamicTextures(double time)
+{
+	DirtyRect rects[DYNAMIC_MAX_DIRTY];
+
+	for (int i = 0; i < MAX_DYNAMIC_TEXTURES; i++) {
+		DynamicTexture* tex = &g_dynamicTextures[i];
+		if (!tex->used)
+			continue;
+
+		int count = tex->update(time, tex->width, tex->height, tex->pixels,
+			rects, DYNAMIC_MAX_DIRTY, tex->user);
+		if (count > DYNAMIC_MAX_DIRTY)
+			count = -1;
+		if (count > 0)
+			count = MergeDirtyRects(tex, rects, count);
+		if (count < 0 || !tex->uploaded) {
+			rects[0].x = rects[0].y = 0;
+			rects[0].width = tex->width;
+			rects[0].height = tex->height;
+			count = 1;
+			tex->uploaded = true;
+		}
+
+		UploadRects(tex, rects, count);
+		tex->frames++;
+		tex->fullBytes += (size_t) tex->width * tex->height * 4;
+	}
+}
+
+void PrintDynamicTextureStats(FILE* out)
+{
+	for (int i = 0; i < MAX_DYNAMIC_TEXTURES; i++) {
+		DynamicTexture* tex = &g_dynamicTextures[i];
+		if (!tex->used || tex->frames == 0)
+			continue;
+		fprintf(out, "Dynamic [%u] %-20s %4dx%-4d %s: %.1f rects/frame, %.1f KB/frame (%.1f%% of full uploads)\n",
+			tex->name, tex->label, tex->width, tex->height, tex->pbo[0] ? "PBO" : "client",
+			(double) tex->rects / tex->frames, tex->bytes / 1024.0 / tex->frames,
+			tex->fullBytes ? 100.0 * tex->bytes / tex->fullBytes : 0.0);
+	}
+}
@@ -0,0 +1,47 @@
+// texture_dynamic.h
+//
+// Textures whose contents change over time. Each keeps an RGBA8 copy in
+// system memory that its update function redraws in place, reporting the
+// rectangles it touched. Only those rectangles go to the GPU: packed into a
+// pixel buffer object (two per texture, alternated and orphaned each frame
+// so the driver never stalls on one still being read) and copied with one
+// glTexSubImage2D each. Without PBOs the rectangles are sent straight from
+// the system copy using GL_UNPACK_ROW_LENGTH. Dynamic textures have a single
+// level and are not part of the texture manager's budget.
+
+#ifndef TEXTURE_DYNAMIC_H
+#define TEXTURE_DYNAMIC_H
+
+#include <stdio.h>
+
+#include "gl_extensions.h"
+
+typedef int DynamicTextureHandle;   // 0 is "no texture"
+
+#define DYNAMIC_TEXTURE_NONE  0
+#define DYNAMIC_MAX_DIRTY     16
+
+struct DirtyRect {
+	int x, y, width, height;
+};
+
+// Redraws pixels (width x height RGBA8, bottom row first) for time in
+// seconds and fills dirty with the rectangles that changed. Returns their
+// count, or -1 to mark the whole texture. The first call should draw
+// everything; the texture is uploaded in full after it regardless.
+typedef int (*DynamicTextureFunc)(double time, int width, int height,
+	unsigned char* pixels, DirtyRect* dirty, int maxDirty, void* user);
+
+DynamicTextureHandle CreateDynamicTexture(const char* label, int width, int height,
+	DynamicTextureFunc update, void* user);
+void DestroyDynamicTexture(DynamicTextureHandle handle);
+
+GLuint GetDynamicTextureName(DynamicTextureHandle handle);
+void BindDynamicTexture(DynamicTextureHandle handle);
+
+// Runs every update function and uploads what changed; call once per frame
+void UpdateDynamicTextures(double time);
+
+void PrintDynamicTextureStats(FILE* out);
+
+#endif
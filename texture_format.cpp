@@ -0,0 +1,225 @@
+// texture_format.cpp
+//
+// Texel format analysis and packing for texture_format.h.
+
+#include "texture_format.h"
+#include "texture_compress.h"
+
+#include <string.h>
+
+static bool g_texelReduction = true;
+static bool g_texelCompression = false;
+
+// True if v survives quantizing to bits and expanding back by bit replication
+static bool Survives(int v, int bits)
+{
+	int q = v >> (8 - bits);
+	return ((q << (8 - bits)) | (q >> (2 * bits - 8))) == v;
+}
+
+TexelFormat ChooseTexelFormat(const unsigned char* rgba, int width, int height)
+{
+	size_t count = (size_t) width * height;
+	bool gray = true, opaque = true, fits565 = true;
+
+	if (g_texelCompression && g_glCaps.textureCompressionS3TC)
+		return ChooseCompressedFormat(rgba, width, height) == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ?
+			TEXEL_BC1 : TEXEL_BC3;
+	if (!g_texelReduction)
+		return TEXEL_RGBA8;
+
+	for (size_t i = 0; i < count && (gray || fits565 || opaque); i++) {
+		const unsigned char* p = rgba + 4 * i;
+		if (p[0] != p[1] || p[1] != p[2])
+			gray = false;
+		if (p[3] != 255)
+			opaque = false;
+		if (fits565 && !(Survives(p[0], 5) && Survives(p[1], 6) && Survives(p[2], 5)))
+			fits565 = false;
+	}
+
+	if (gray)
+		return opaque ? TEXEL_R8 : TEXEL_RG8;
+	if (opaque && fits565 && g_glCaps.packedPixels)
+		return TEXEL_RGB565;
+	return TEXEL_RGBA8;
+}
+
+bool IsTexelFormatSupported(TexelFormat format)
+{
+	switch (format) {
+	case TEXEL_BC1:
+	case TEXEL_BC3:
+		return g_glCaps.textureCompressionS3TC;
+	case TEXEL_RGB565:
+		return g_glCaps.packedPixels;
+	case TEXEL_RGBA8:
+	case TEXEL_RG8:       // LUMINANCE8_ALPHA8 without texture_rg
+	case TEXEL_R8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+int TexelBitsPerTexel(TexelFormat format)
+{
+	switch (format) {
+	case TEXEL_RGB565:
+	case TEXEL_RG8:
+		return 16;
+	case TEXEL_R8:
+	case TEXEL_BC3:
+		return 8;
+	case TEXEL_BC1:
+		return 4;
+	default:
+		return 32;
+	}
+}
+
+int TexelBlockRows(TexelFormat format)
+{
+	return (format == TEXEL_BC1 || format == TEXEL_BC3) ? 4 : 1;
+}
+
+static GLenum CompressedFormat(TexelFormat format)
+{
+	return format == TEXEL_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+size_t TexelRowSize(TexelFormat format, int width)
+{
+	if (TexelBlockRows(format) > 1)
+		return CompressedRowSize(CompressedFormat(format), width);
+	return (size_t) width * TexelBitsPerTexel(format) / 8;
+}
+
+size_t TexelImageSize(TexelFormat format, int width, int height)
+{
+	int blockRows = TexelBlockRows(format);
+	return TexelRowSize(format, width) * ((height + blockRows - 1) / blockRows);
+}
+
+void PackTexels(TexelFormat format, const unsigned char* rgba, int width, int height,
+	unsigned char* dst)
+{
+	size_t count = (size_t) width * height;
+
+	switch (format) {
+	case TEXEL_RGB565:
+		for (size_t i = 0; i < count; i++, rgba += 4, dst += 2) {
+			unsigned short c = (unsigned short) ((rgba[0] >> 3) << 11 | (rgba[1] >> 2) << 5 | rgba[2] >> 3);
+			memcpy(dst, &c, 2);    // GL_UNSIGNED_SHORT_5_6_5 is in native order
+		}
+		break;
+	case TEXEL_RG8:
+		for (size_t i = 0; i < count; i++, rgba += 4, dst += 2) {
+			dst[0] = rgba[0];
+			dst[1] = rgba[3];
+		}
+		break;
+	case TEXEL_R8:
+		for (size_t i = 0; i < count; i++, rgba += 4)
+			*dst++ = rgba[0];
+		break;
+	case TEXEL_BC1:
+	case TEXEL_BC3:
+		CompressImage(CompressedFormat(format), rgba, width, height, dst);
+		break;
+	default:
+		memcpy(dst, rgba, count * 4);
+		break;
+	}
+}
+
+// Single and dual channel textures sample through a swizzle when possible
+static bool UseSwizzle(void)
+{
+	return g_glCaps.textureRG && g_glCaps.textureSwizzle;
+}
+
+static void GetUploadFormat(TexelFormat format, GLenum* internalFormat,
+	GLenum* pixelFormat, GLenum* type)
+{
+	*type = GL_UNSIGNED_BYTE;
+	switch (format) {
+	case TEXEL_RGB565:
+		*internalFormat = g_glCaps.rgb565 ? GL_RGB565 : GL_RGB5;
+		*pixelFormat = GL_RGB;
+		*type = GL_UNSIGNED_SHORT_5_6_5;
+		break;
+	case TEXEL_RG8:
+		*internalFormat = UseSwizzle() ? GL_RG8 : GL_LUMINANCE8_ALPHA8;
+		*pixelFormat = UseSwizzle() ? GL_RG : GL_LUMINANCE_ALPHA;
+		break;
+	case TEXEL_R8:
+		*internalFormat = UseSwizzle() ? GL_R8 : GL_LUMINANCE8;
+		*pixelFormat = UseSwizzle() ? GL_RED : GL_LUMINANCE;
+		break;
+	case TEXEL_BC1:
+	case TEXEL_BC3:
+		*internalFormat = CompressedFormat(format);
+		*pixelFormat = GL_RGBA;
+		break;
+	default:
+		*internalFormat = GL_RGBA8;
+		*pixelFormat = GL_RGBA;
+		break;
+	}
+}
+
+void DefineTexelLevel(TexelFormat format, int level, int width, int height)
+{
+	GLenum internalFormat, pixelFormat, type;
+
+	GetUploadFormat(format, &internalFormat, &pixelFormat, &type);
+	glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0,
+		pixelFormat, type, NULL);
+}
+
+void SetTexelSwizzle(TexelFormat format)
+{
+	GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+
+	if (!g_glCaps.textureSwizzle)
+		return;
+	if (UseSwizzle() && format == TEXEL_R8) {
+		swizzle[1] = swizzle[2] = GL_RED;
+		swizzle[3] = GL_ONE;
+	} else if (UseSwizzle() && format == TEXEL_RG8) {
+		swizzle[1] = swizzle[2] = GL_RED;
+		swizzle[3] = GL_GREEN;
+	}
+	// Set every time: a restreamed name may have changed format
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+void UploadTexelRows(TexelFormat format, int level, int yoffset, int width, int rows,
+	int bytes, const GLvoid* pixels)
+{
+	GLenum internalFormat, pixelFormat, type;
+
+	GetUploadFormat(format, &internalFormat, &pixelFormat, &type);
+	if (TexelBlockRows(format) > 1)
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, yoffset, width, rows,
+			internalFormat, bytes, pixels);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, yoffset, width, rows,
+			pixelFormat, type, pixels);
+}
+
+void SetTexelReduction(bool enable)
+{
+	g_texelReduction = enable;
+}
+
+void SetTexelCompression(bool enable)
+{
+	g_texelCompression = enable;
+}
+
+int GetTexelPackingMode(void)
+{
+	return (g_texelReduction ? 1 : 0) | (g_texelCompression && g_glCaps.textureCompressionS3TC ? 2 : 0);
+}
@@ -0,0 +1,58 @@
+// texture_format.h
+//
+// Picks the smallest texel format that holds an image without visible loss.
+// The streaming thread analyzes the finest level of each generated image
+// and packs the whole chain into the chosen layout before upload, so a
+// grayscale texture costs a quarter of the memory and upload bandwidth of
+// RGBA8. Gray formats sample as (L, L, L, A) either way: through a texture
+// swizzle on R8/RG8 when the driver has one, through LUMINANCE8 and
+// LUMINANCE8_ALPHA8 otherwise.
+
+#ifndef TEXTURE_FORMAT_H
+#define TEXTURE_FORMAT_H
+
+#include <stddef.h>
+
+#include "gl_extensions.h"
+
+// Packed layouts, as stored in slots and in the texture cache
+enum TexelFormat {
+	TEXEL_RGBA8,
+	TEXEL_RGB565,     // opaque color exactly representable in 5:6:5
+	TEXEL_RG8,        // gray, alpha
+	TEXEL_R8,         // gray, opaque
+	TEXEL_BC1,        // S3TC, opaque
+	TEXEL_BC3,        // S3TC with alpha
+	TEXEL_FORMAT_COUNT
+};
+
+// Analyzes an RGBA8 image (rows packed)
+TexelFormat ChooseTexelFormat(const unsigned char* rgba, int width, int height);
+
+// Whether the current context can sample format; call after InitGLExtensions
+bool IsTexelFormatSupported(TexelFormat format);
+int TexelBitsPerTexel(TexelFormat format);
+// 4 for the block compressed formats, 1 otherwise
+int TexelBlockRows(TexelFormat format);
+// Bytes in one row, or one row of 4x4 blocks
+size_t TexelRowSize(TexelFormat format, int width);
+size_t TexelImageSize(TexelFormat format, int width, int height);
+
+// Converts an RGBA8 image (rows packed) into format, TexelImageSize bytes
+void PackTexels(TexelFormat format, const unsigned char* rgba, int width, int height,
+	unsigned char* dst);
+
+// GL side, for the texture bound to GL_TEXTURE_2D. SetTexelSwizzle is
+// texture state; call it once, when the first level is defined.
+void DefineTexelLevel(TexelFormat format, int level, int width, int height);
+void SetTexelSwizzle(TexelFormat format);
+void UploadTexelRows(TexelFormat format, int level, int yoffset, int width, int rows,
+	int bytes, const GLvoid* pixels);
+
+void SetTexelReduction(bool enable);     // off: everything is RGBA8
+void SetTexelCompression(bool enable);   // on: S3TC whenever the driver has it
+// Changes whenever the settings above would pick different formats; mixed
+// into texture cache keys
+int GetTexelPackingMode(void);
+
+#endif
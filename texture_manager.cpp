@@ -0,0 +1,285 @@
+// texture_manager.cpp
+//
+// Texture registry and GPU memory budget for texture_manager.h.
+//
+// Releasing memory is done by respecifying levels as 0x0 rather than
+// deleting the texture, so a handle keeps the same GL name for its lifetime.
+
+#include "texture_manager.h"
+#include "gl_state.h"
+#include "texture_stream.h"
+
+#include <string.h>
+
+#define MAX_MANAGED_TEXTURES  256
+#define TEXTURE_MAX_LEVELS    16
+#define TEXTURE_IDLE_FRAMES   120   // unused this long: evict rather than trim
+
+struct ManagedTexture {
+	bool used;
+	char label[32];
+	GLuint name;
+	int width, height, levels;
+	int bitsPerTexel;               // updated once the streamer picks a format
+	int droppedLevels;              // top levels released; == levels if evicted
+	unsigned long lastUsedFrame;
+	TextureLoadFunc load;
+	void* user;
+};
+
+static ManagedTexture g_textures[MAX_MANAGED_TEXTURES];
+static unsigned long g_textureFrame = 1;
+static size_t g_textureBudget = 0;
+static int g_evictions = 0;
+static int g_mipDrops = 0;
+static int g_reloads = 0;
+
+static ManagedTexture* GetManagedTexture(TextureHandle handle)
+{
+	if (handle <= 0 || handle > MAX_MANAGED_TEXTURES || !g_textures[handle - 1].used)
+		return NULL;
+	return &g_textures[handle - 1];
+}
+
+static int LevelSize(int size, int level)
+{
+	size >>= level;
+	return size > 0 ? size : 1;
+}
+
+static size_t LevelBytes(const ManagedTexture* tex, int level)
+{
+	return ((size_t) LevelSize(tex->width, level) * LevelSize(tex->height, level) * tex->bitsPerTexel + 7) / 8;
+}
+
+static size_t ChainBytes(const ManagedTexture* tex, int firstLevel)
+{
+	size_t bytes = 0;
+	for (int level = firstLevel; level < tex->levels; level++)
+		bytes += LevelBytes(tex, level);
+	return bytes;
+}
+
+static size_t ResidentBytes(void)
+{
+	size_t bytes = 0;
+	for (int i = 0; i < MAX_MANAGED_TEXTURES; i++) {
+		ManagedTexture* tex = &g_textures[i];
+		if (!tex->used)
+			continue;
+		// Count what the streamer actually uploaded, not the estimate
+		int bits = GetStreamedTextureBits(tex->name);
+		if (bits > 0)
+			tex->bitsPerTexel = bits;
+		bytes += ChainBytes(tex, tex->droppedLevels);
+	}
+	return bytes;
+}
+
+static void LoadTexture(TextureHandle handle)
+{
+	ManagedTexture* tex = &g_textures[handle - 1];
+
+	CachedBindTexture(GL_TEXTURE_2D, tex->name);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	tex->droppedLevels = 0;
+	tex->load(handle, tex->name, tex->user);
+}
+
+static void ReleaseLevel(int level)
+{
+	glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+}
+
+static void EvictTexture(ManagedTexture* tex)
+{
+	CachedBindTexture(GL_TEXTURE_2D, tex->name);
+	for (int level = tex->droppedLevels; level < tex->levels; level++)
+		ReleaseLevel(level);
+	tex->droppedLevels = tex->levels;
+	g_evictions++;
+}
+
+static void DropTopLevel(ManagedTexture* tex)
+{
+	CachedBindTexture(GL_TEXTURE_2D, tex->name);
+	ReleaseLevel(tex->droppedLevels);
+	tex->droppedLevels++;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, tex->droppedLevels);
+	g_mipDrops++;
+}
+
+TextureHandle CreateManagedTexture(const char* label, int width, int height,
+	int bitsPerTexel, TextureLoadFunc load, void* user)
+{
+	for (int i = 0; i < MAX_MANAGED_TEXTURES; i++) {
+		ManagedTexture* tex = &g_textures[i];
+		if (tex->used)
+			continue;
+
+		memset(tex, 0, sizeof(*tex));
+		tex->used = true;
+		strncpy(tex->label, label ? label : "", sizeof(tex->label) - 1);
+		glGenTextures(1, &tex->name);
+		tex->width = width;
+		tex->height = height;
+		tex->levels = 1;
+		while ((width > 1 || height > 1) && tex->levels < TEXTURE_MAX_LEVELS) {
+			width = LevelSize(width, 1);
+			height = LevelSize(height, 1);
+			tex->levels++;
+		}
+		tex->bitsPerTexel = bitsPerTexel;
+		tex->lastUsedFrame = g_textureFrame;
+		tex->load = load;
+		tex->user = user;
+
+		LoadTexture(i + 1);
+		return i + 1;
+	}
+	return TEXTURE_NONE;
+}
+
+void DestroyManagedTexture(TextureHandle handle)
+{
+	ManagedTexture* tex = GetManagedTexture(handle);
+
+	if (tex == NULL || IsTextureStreaming(tex->name))
+		return;
+	CachedDeleteTextures(1, &tex->name);
+	tex->used = false;
+}
+
+GLuint GetTextureName(TextureHandle handle)
+{
+	ManagedTexture* tex = GetManagedTexture(handle);
+	return tex ? tex->name : 0;
+}
+
+void BindManagedTexture(TextureHandle handle)
+{
+	ManagedTexture* tex = GetManagedTexture(handle);
+
+	if (tex == NULL) {
+		CachedBindTexture(GL_TEXTURE_2D, 0);
+		return;
+	}
+	tex->lastUsedFrame = g_textureFrame;
+	CachedBindTexture(GL_TEXTURE_2D, tex->name);
+}
+
+void BeginTextureFrame(void)
+{
+	g_textureFrame++;
+}
+
+// Least recently used texture that can still give memory back. Textures
+// used this frame are only considered when allowCurrent is set, and then
+// only for trimming, never for eviction.
+static ManagedTexture* FindVictim(bool allowCurrent)
+{
+	ManagedTexture* victim = NULL;
+
+	for (int i = 0; i < MAX_MANAGED_TEXTURES; i++) {
+		ManagedTexture* tex = &g_textures[i];
+		if (!tex->used || tex->droppedLevels == tex->levels || IsTextureStreaming(tex->name))
+			continue;
+		bool current = tex->lastUsedFrame == g_textureFrame;
+		if (current && (!allowCurrent || tex->droppedLevels >= tex->levels - 1))
+			continue;
+		if (victim == NULL || tex->lastUsedFrame < victim->lastUsedFrame)
+			victim = tex;
+	}
+	return victim;
+}
+
+void EnforceTextureBudget(void)
+{
+	size_t resident = ResidentBytes();
+
+	if (g_textureBudget == 0)
+		return;
+
+	// Give memory back, oldest first
+	while (resident > g_textureBudget) {
+		ManagedTexture* tex = FindVictim(false);
+		if (tex == NULL)
+			tex = FindVictim(true);
+		if (tex == NULL)
+			break;
+
+		size_t before = ChainBytes(tex, tex->droppedLevels);
+		bool idle = g_textureFrame - tex->lastUsedFrame > TEXTURE_IDLE_FRAMES;
+		if (!idle && tex->droppedLevels < tex->levels - 1)
+			DropTopLevel(tex);
+		else
+			EvictTexture(tex);
+		resident -= before - ChainBytes(tex, tex->droppedLevels);
+	}
+
+	// Restore textures bound this frame while evicted or trimmed, leaving an
+	// eighth of the budget spare so we do not trim and reload every frame
+	for (int i = 0; i < MAX_MANAGED_TEXTURES; i++) {
+		ManagedTexture* tex = &g_textures[i];
+		if (!tex->used || tex->droppedLevels == 0 || tex->lastUsedFrame != g_textureFrame)
+			continue;
+		size_t missing = ChainBytes(tex, 0) - ChainBytes(tex, tex->droppedLevels);
+		if (resident + missing > g_textureBudget - g_textureBudget / 8)
+			continue;
+		LoadTexture(i + 1);
+		resident += missing;
+		g_reloads++;
+	}
+}
+
+void SetTextureBudget(size_t bytes)
+{
+	g_textureBudget = bytes;
+}
+
+void GetTextureStats(TextureStats* stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	for (int i = 0; i < MAX_MANAGED_TEXTURES; i++) {
+		ManagedTexture* tex = &g_textures[i];
+		if (!tex->used)
+			continue;
+		stats->textures++;
+		if (tex->droppedLevels < tex->levels)
+			stats->resident++;
+		if (tex->droppedLevels > 0 && tex->droppedLevels < tex->levels)
+			stats->trimmed++;
+		stats->residentBytes += ChainBytes(tex, tex->droppedLevels);
+		stats->fullBytes += ChainBytes(tex, 0);
+	}
+	stats->budgetBytes = g_textureBudget;
+	stats->evictions = g_evictions;
+	stats->mipDrops = g_mipDrops;
+	stats->reloads = g_reloads;
+}
+
+void PrintTextureStats(FILE* out)
+{
+	TextureStats stats;
+
+	GetTextureStats(&stats);
+	fprintf(out, "Textures: %d registered, %d resident, %d trimmed\n",
+		stats.textures, stats.resident, stats.trimmed);
+	fprintf(out, "  GPU memory: %.2f MB resident of %.2f MB, budget %s",
+		stats.residentBytes / 1048576.0, stats.fullBytes / 1048576.0,
+		stats.budgetBytes ? "" : "unlimited\n");
+	if (stats.budgetBytes)
+		fprintf(out, "%.2f MB\n", stats.budgetBytes / 1048576.0);
+	fprintf(out, "  evictions %d, mip drops %d, reloads %d\n",
+		stats.evictions, stats.mipDrops, stats.reloads);
+	for (int i = 0; i < MAX_MANAGED_TEXTURES; i++) {
+		ManagedTexture* tex = &g_textures[i];
+		if (!tex->used)
+			continue;
+		fprintf(out, "  [%u] %-20s %4dx%-4d %2d/%-2d levels %8.1f KB, last used %lu frames ago\n",
+			tex->name, tex->label, tex->width, tex->height,
+			tex->levels - tex->droppedLevels, tex->levels,
+			ChainBytes(tex, tex->droppedLevels) / 1024.0,
+			g_textureFrame - tex->lastUsedFrame);
+	}
+}
@@ -0,0 +1,59 @@
+// texture_manager.h
+//
+// Texture registry. Hands out texture names, tracks how many bytes each
+// texture occupies on the GPU (every resident mip level counted) and keeps
+// the total under a budget. When over budget it walks textures from least
+// to most recently used: textures idle for a while are evicted outright,
+// recently used ones lose their top mip level instead. Evicted or trimmed
+// textures are brought back through their load function the next time they
+// are bound and memory allows.
+
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "gl_extensions.h"
+
+typedef int TextureHandle;      // 0 is "no texture"
+
+#define TEXTURE_NONE 0
+
+// (Re)creates the texture contents for name at full resolution
+typedef void (*TextureLoadFunc)(TextureHandle handle, GLuint name, void* user);
+
+struct TextureStats {
+	int textures;               // registered
+	int resident;               // with any level in GPU memory
+	int trimmed;                // resident with top levels dropped
+	size_t residentBytes;
+	size_t fullBytes;           // if every texture were fully resident
+	size_t budgetBytes;         // 0 means unlimited
+	int evictions;              // cumulative counters
+	int mipDrops;
+	int reloads;
+};
+
+// Registers a texture and loads it immediately through load. bitsPerTexel
+// is an estimate until the streamer reports the format it picked.
+TextureHandle CreateManagedTexture(const char* label, int width, int height,
+	int bitsPerTexel, TextureLoadFunc load, void* user);
+void DestroyManagedTexture(TextureHandle handle);
+
+GLuint GetTextureName(TextureHandle handle);
+
+// Binds to GL_TEXTURE_2D and marks the texture used this frame
+void BindManagedTexture(TextureHandle handle);
+
+// Advances the LRU clock; call once per frame before drawing
+void BeginTextureFrame(void);
+// Evicts or trims until under budget, reloads when there is headroom; call
+// after the frame's draws, so textures bound this frame count as in use
+void EnforceTextureBudget(void);
+
+void SetTextureBudget(size_t bytes);
+void GetTextureStats(TextureStats* stats);
+void PrintTextureStats(FILE* out);
+
+#endif
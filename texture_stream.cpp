@@ -0,0 +1,610 @@
+// texture_stream.cpp
+//
+// Streaming thread and per-frame upload pump for texture_stream.h.
+//
+// Slots cycle FREE -> WRITABLE -> FILLED -> INFLIGHT -> FREE. The GLUT thread
+// owns FREE and INFLIGHT slots (mapping, uploading, fencing), the worker owns
+// WRITABLE ones until it publishes them as FILLED. State changes go through
+// the atomics in platform.h so slot contents are visible before the state.
+
+#include "texture_stream.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "platform.h"
+#include "staging_pool.h"
+#include "texture_format.h"
+
+#include <string.h>
+
+#define STREAM_SLOT_COUNT    8
+#define STREAM_SLOT_BYTES    (256 * 1024)
+#define STREAM_MAX_TEXTURES  64
+#define STREAM_REQUEST_SLOTS (STREAM_MAX_TEXTURES + 1)   // one spare, or a full ring looks empty
+#define STREAM_MAX_LEVELS    16
+#define STREAM_JOB_TEXELS    16384   // texels per job when splitting a level
+
+enum {
+	SLOT_FREE,
+	SLOT_WRITABLE,
+	SLOT_FILLED,
+	SLOT_INFLIGHT
+};
+
+enum {
+	STREAM_PERSISTENT,   // one persistently mapped buffer, fenced per slot
+	STREAM_PBO,          // one PBO per slot, orphaned and remapped each use
+	STREAM_CLIENT        // no PBOs; glTexSubImage2D from client memory
+};
+
+struct StreamSlot {
+	volatile long state;
+	unsigned char* ptr;
+	size_t offset;        // offset into g_streamBuffer (persistent mode)
+	GLuint pbo;           // PBO mode only
+	GLsync fence;         // persistent mode only
+	long sequence;        // fill order, so uploads stay coarsest first
+	int texture;
+	int level;
+	TexelFormat format;
+	int yoffset;
+	int rows;
+	int bytes;
+};
+
+// One level being downsampled or packed by the job system
+struct LevelWork {
+	const unsigned char* src;
+	int width, height;
+	unsigned char* dst;
+	TexelFormat format;
+};
+
+struct StreamTextureInfo {
+	GLuint name;
+	int width, height, levels;
+	TextureGenerator generator;
+	TextureKeyFunc cacheKey;
+	void* user;
+
+	// GL thread only
+	TexelFormat format;   // known once the coarsest level is defined
+	int rowsPending[STREAM_MAX_LEVELS];
+	bool levelDefined[STREAM_MAX_LEVELS];
+	int baseLevel;
+};
+
+static int g_streamMode = STREAM_CLIENT;
+static bool g_streamRunning = false;
+static GLuint g_streamBuffer = 0;
+static unsigned char* g_clientMemory = NULL;
+static StreamSlot g_slots[STREAM_SLOT_COUNT];
+static StreamTextureInfo g_streamTextures[STREAM_MAX_TEXTURES];
+static int g_streamTextureCount = 0;
+static int g_uploadBudget = 1024 * 1024;
+
+// Pending requests, GL thread -> worker
+static int g_requests[STREAM_REQUEST_SLOTS];
+static int g_requestHead = 0, g_requestTail = 0;
+static Mutex g_requestMutex;
+
+static Thread g_workerThread;
+static Event g_workerEvent;
+static volatile long g_streamQuit = 0;
+static long g_fillSequence = 0;          // worker only
+
+static int LevelSize(int size, int level)
+{
+	size >>= level;
+	return size > 0 ? size : 1;
+}
+
+static int MipLevelCount(int width, int height)
+{
+	int levels = 1;
+	while ((width > 1 || height > 1) && levels < STREAM_MAX_LEVELS) {
+		width = LevelSize(width, 1);
+		height = LevelSize(height, 1);
+		levels++;
+	}
+	return levels;
+}
+
+// Rows per job so each covers about STREAM_JOB_TEXELS texels, rounded to
+// whole blocks
+static int JobRows(int width, int blockRows)
+{
+	int rows = STREAM_JOB_TEXELS / width;
+	rows -= rows % blockRows;
+	return rows > blockRows ? rows : blockRows;
+}
+
+// 2x2 box filter of rows [y0, y1) of the next level
+static void DownsampleRows(int y0, int y1, void* user)
+{
+	const LevelWork* work = (const LevelWork*) user;
+	const unsigned char* src = work->src;
+	int sw = work->width, sh = work->height;
+	int dw = LevelSize(sw, 1);
+	unsigned char* dst = work->dst + (size_t) y0 * dw * 4;
+
+	for (int y = y0; y < y1; y++) {
+		int r0 = 2 * y, r1 = (2 * y + 1 < sh) ? 2 * y + 1 : r0;
+		for (int x = 0; x < dw; x++) {
+			int x0 = 2 * x, x1 = (2 * x + 1 < sw) ? 2 * x + 1 : x0;
+			const unsigned char* a = src + 4 * (r0 * sw + x0);
+			const unsigned char* b = src + 4 * (r0 * sw + x1);
+			const unsigned char* c = src + 4 * (r1 * sw + x0);
+			const unsigned char* d = src + 4 * (r1 * sw + x1);
+			for (int k = 0; k < 4; k++)
+				*dst++ = (unsigned char) ((a[k] + b[k] + c[k] + d[k] + 2) / 4);
+		}
+	}
+}
+
+static void DownsampleLevel(const unsigned char* src, int sw, int sh, unsigned char* dst)
+{
+	LevelWork work = { src, sw, sh, dst, TEXEL_RGBA8 };
+	int dw = LevelSize(sw, 1);
+	ParallelFor(LevelSize(sh, 1), JobRows(dw, 1), DownsampleRows, &work);
+}
+
+// Packs block rows [b0, b1); the last may be partial
+static void PackBlockRows(int b0, int b1, void* user)
+{
+	const LevelWork* work = (const LevelWork*) user;
+	int blockRows = TexelBlockRows(work->format);
+	int y0 = b0 * blockRows;
+	int y1 = b1 * blockRows < work->height ? b1 * blockRows : work->height;
+
+	PackTexels(work->format, work->src + (size_t) y0 * work->width * 4, work->width, y1 - y0,
+		work->dst + TexelRowSize(work->format, work->width) * b0);
+}
+
+// Block compression dominates a cache miss, so levels are split across
+// the job system in bands of whole block rows
+static void PackLevel(TexelFormat format, const unsigned char* src, int width, int height,
+	unsigned char* dst)
+{
+	LevelWork work = { src, width, height, dst, format };
+	int blockRows = TexelBlockRows(format);
+
+	ParallelFor((height + blockRows - 1) / blockRows, JobRows(width, blockRows) / blockRows,
+		PackBlockRows, &work);
+}
+
+static int PopRequest(void)
+{
+	int index = -1;
+
+	MutexLock(&g_requestMutex);
+	if (g_requestHead != g_requestTail) {
+		index = g_requests[g_requestHead];
+		g_requestHead = (g_requestHead + 1) % STREAM_REQUEST_SLOTS;
+	}
+	MutexUnlock(&g_requestMutex);
+	return index;
+}
+
+// Blocks the worker until the GL thread hands over a mapped slot
+static StreamSlot* WaitWritableSlot(void)
+{
+	while (!AtomicLoad(&g_streamQuit)) {
+		for (int i = 0; i < STREAM_SLOT_COUNT; i++) {
+			if (AtomicLoad(&g_slots[i].state) == SLOT_WRITABLE)
+				return &g_slots[i];
+		}
+		EventWait(&g_workerEvent, 10);
+	}
+	return NULL;
+}
+
+// Copies a mip chain into slots coarsest level first, split into slot sized
+// bands of whole rows (whole block rows for compressed formats). Returns
+// false if the streamer shut down meanwhile.
+static bool SubmitLevels(int index, TexelFormat format, const unsigned char* const* levelData)
+{
+	StreamTextureInfo* tex = &g_streamTextures[index];
+
+	for (int level = tex->levels - 1; level >= 0; level--) {
+		int w = LevelSize(tex->width, level);
+		int h = LevelSize(tex->height, level);
+		int unitRows = TexelBlockRows(format);
+		int units = (h + unitRows - 1) / unitRows;
+		size_t unitBytes = TexelRowSize(format, w);
+		int bandUnits = (int) (STREAM_SLOT_BYTES / unitBytes);
+
+		if (bandUnits < 1)
+			bandUnits = 1;
+		for (int unit = 0; unit < units; unit += bandUnits) {
+			int count = (units - unit < bandUnits) ? units - unit : bandUnits;
+			int y = unit * unitRows;
+			StreamSlot* slot = WaitWritableSlot();
+			if (slot == NULL)
+				return false;
+			memcpy(slot->ptr, levelData[level] + unit * unitBytes, count * unitBytes);
+			slot->texture = index;
+			slot->level = level;
+			slot->format = format;
+			slot->yoffset = y;
+			slot->rows = (h - y < count * unitRows) ? h - y : count * unitRows;
+			slot->bytes = (int) (count * unitBytes);
+			slot->sequence = g_fillSequence++;
+			AtomicStore(&slot->state, SLOT_FILLED);
+		}
+	}
+	return true;
+}
+
+static void StreamTextureLevels(int index)
+{
+	StreamTextureInfo* tex = &g_streamTextures[index];
+	TextureCacheKey key = 0;
+	unsigned char* levelData[STREAM_MAX_LEVELS];
+	unsigned char* packedData[STREAM_MAX_LEVELS];
+	CachedTexture cached;
+	size_t total = 0, packedTotal = 0;
+
+	if (tex->cacheKey) {
+		int mode = GetTexelPackingMode();
+		key = HashTextureKey(&mode, sizeof(mode), tex->cacheKey(tex->user));
+	}
+
+	// A cached chain is copied straight from the mapped file
+	if (key && OpenCachedTexture(&cached, key, tex->width, tex->height, tex->levels)) {
+		SubmitLevels(index, cached.format, cached.levelData);
+		CloseCachedTexture(&cached);
+		return;
+	}
+
+	for (int level = 0; level < tex->levels; level++)
+		total += (size_t) LevelSize(tex->width, level) * LevelSize(tex->height, level) * 4;
+
+	unsigned char* scratch = (unsigned char*) AcquireStagingBuffer(total);
+	if (scratch == NULL)
+		return;
+
+	// Generate the full image, then the chain below it
+	levelData[0] = scratch;
+	tex->generator(0, tex->height, tex->width, tex->height, scratch, tex->user);
+	for (int level = 1; level < tex->levels; level++) {
+		int pw = LevelSize(tex->width, level - 1);
+		int ph = LevelSize(tex->height, level - 1);
+		levelData[level] = levelData[level - 1] + (size_t) pw * ph * 4;
+		DownsampleLevel(levelData[level - 1], pw, ph, levelData[level]);
+	}
+
+	// Pack into the smallest format the finest level allows. Box filtered
+	// mips of a gray or opaque image stay gray or opaque.
+	TexelFormat format = ChooseTexelFormat(levelData[0], tex->width, tex->height);
+	unsigned char* packed = NULL;
+	if (format != TEXEL_RGBA8) {
+		for (int level = 0; level < tex->levels; level++)
+			packedTotal += TexelImageSize(format, LevelSize(tex->width, level), LevelSize(tex->height, level));
+		packed = (unsigned char*) AcquireStagingBuffer(packedTotal);
+	}
+	if (packed != NULL) {
+		unsigned char* p = packed;
+		for (int level = 0; level < tex->levels; level++) {
+			int w = LevelSize(tex->width, level), h = LevelSize(tex->height, level);
+			packedData[level] = p;
+			PackLevel(format, levelData[level], w, h, p);
+			p += TexelImageSize(format, w, h);
+		}
+	} else {
+		format = TEXEL_RGBA8;
+		memcpy(packedData, levelData, sizeof(levelData));
+	}
+
+	if (key)
+		StoreCachedTexture(key, tex->width, tex->height, tex->levels, format, packedData);
+	SubmitLevels(index, format, packedData);
+
+	ReleaseStagingBuffer(packed);
+	ReleaseStagingBuffer(scratch);
+}
+
+static void StreamWorker(void* arg)
+{
+	while (!AtomicLoad(&g_streamQuit)) {
+		int index = PopRequest();
+		if (index < 0)
+			EventWait(&g_workerEvent, 100);
+		else
+			StreamTextureLevels(index);
+	}
+}
+
+void InitTextureStreaming(void)
+{
+	if (g_streamRunning)
+		return;
+
+	if (g_glCaps.bufferStorage && g_glCaps.mapBufferRange && g_glCaps.sync)
+		g_streamMode = STREAM_PERSISTENT;
+	else if (g_glCaps.pixelBufferObject)
+		g_streamMode = STREAM_PBO;
+	else
+		g_streamMode = STREAM_CLIENT;
+
+	memset(g_slots, 0, sizeof(g_slots));
+	// Packed R8 and RG8 rows are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (g_streamMode == STREAM_PERSISTENT) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLsizeiptr size = (GLsizeiptr) STREAM_SLOT_COUNT * STREAM_SLOT_BYTES;
+		glGenBuffers(1, &g_streamBuffer);
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_streamBuffer);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+		unsigned char* base = (unsigned char*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (base == NULL) {
+			CachedDeleteBuffers(1, &g_streamBuffer);
+			g_streamBuffer = 0;
+			g_streamMode = g_glCaps.pixelBufferObject ? STREAM_PBO : STREAM_CLIENT;
+		} else {
+			for (int i = 0; i < STREAM_SLOT_COUNT; i++) {
+				g_slots[i].offset = (size_t) i * STREAM_SLOT_BYTES;
+				g_slots[i].ptr = base + g_slots[i].offset;
+				g_slots[i].state = SLOT_WRITABLE;
+			}
+		}
+	}
+
+	if (g_streamMode == STREAM_PBO) {
+		for (int i = 0; i < STREAM_SLOT_COUNT; i++) {
+			glGenBuffers(1, &g_slots[i].pbo);
+			g_slots[i].state = SLOT_FREE;
+		}
+	} else if (g_streamMode == STREAM_CLIENT) {
+		g_clientMemory = (unsigned char*) AcquireStagingBuffer((size_t) STREAM_SLOT_COUNT * STREAM_SLOT_BYTES);
+		for (int i = 0; i < STREAM_SLOT_COUNT; i++) {
+			g_slots[i].ptr = g_clientMemory + (size_t) i * STREAM_SLOT_BYTES;
+			g_slots[i].state = SLOT_WRITABLE;
+		}
+	}
+
+	MutexInit(&g_requestMutex);
+	EventInit(&g_workerEvent);
+	g_streamQuit = 0;
+	g_streamRunning = ThreadStart(&g_workerThread, StreamWorker, NULL);
+
+	// Map the PBO slots now so the worker can start on the first request
+	UpdateTextureStreaming();
+}
+
+void ShutdownTextureStreaming(void)
+{
+	if (!g_streamRunning)
+		return;
+
+	AtomicStore(&g_streamQuit, 1);
+	EventSignal(&g_workerEvent);
+	ThreadJoin(&g_workerThread);
+	g_streamRunning = false;
+
+	for (int i = 0; i < STREAM_SLOT_COUNT; i++) {
+		StreamSlot* slot = &g_slots[i];
+		if (slot->fence)
+			glDeleteSync(slot->fence);
+		if (slot->pbo) {
+			if (slot->state == SLOT_WRITABLE || slot->state == SLOT_FILLED) {
+				CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			}
+			CachedDeleteBuffers(1, &slot->pbo);
+		}
+	}
+	if (g_streamBuffer) {
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_streamBuffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		CachedDeleteBuffers(1, &g_streamBuffer);
+		g_streamBuffer = 0;
+	}
+	if (g_streamMode != STREAM_CLIENT)
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	ReleaseStagingBuffer(g_clientMemory);
+	g_clientMemory = NULL;
+
+	EventDestroy(&g_workerEvent);
+	MutexDestroy(&g_requestMutex);
+}
+
+bool StreamTexture(GLuint texName, int width, int height,
+	TextureGenerator generator, void* user)
+{
+	return StreamTextureCached(texName, width, height, generator, NULL, user);
+}
+
+bool StreamTextureCached(GLuint texName, int width, int height,
+	TextureGenerator generator, TextureKeyFunc cacheKey, void* user)
+{
+	int index = -1;
+
+	if (!g_streamRunning)
+		return false;
+
+	// Restreaming a finished texture (e.g. after eviction) reuses its entry
+	for (int i = 0; i < g_streamTextureCount; i++) {
+		if (g_streamTextures[i].name == texName) {
+			if (g_streamTextures[i].baseLevel != 0)
+				return false;
+			index = i;
+			break;
+		}
+	}
+	if (index < 0) {
+		if (g_streamTextureCount == STREAM_MAX_TEXTURES)
+			return false;
+		index = g_streamTextureCount++;
+	}
+
+	StreamTextureInfo* tex = &g_streamTextures[index];
+	memset(tex, 0, sizeof(*tex));
+	tex->name = texName;
+	tex->width = width;
+	tex->height = height;
+	tex->levels = MipLevelCount(width, height);
+	tex->generator = generator;
+	tex->cacheKey = cacheKey;
+	tex->user = user;
+	tex->baseLevel = tex->levels;
+	for (int level = 0; level < tex->levels; level++)
+		tex->rowsPending[level] = LevelSize(height, level);
+
+	// Sample only the levels that have arrived; until the coarsest one does
+	// the texture is incomplete and fixed-function draws it untextured
+	CachedBindTexture(GL_TEXTURE_2D, texName);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, tex->levels - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex->levels - 1);
+
+	MutexLock(&g_requestMutex);
+	g_requests[g_requestTail] = index;
+	g_requestTail = (g_requestTail + 1) % STREAM_REQUEST_SLOTS;
+	MutexUnlock(&g_requestMutex);
+	EventSignal(&g_workerEvent);
+	return true;
+}
+
+static StreamSlot* NextFilledSlot(void)
+{
+	StreamSlot* next = NULL;
+
+	for (int i = 0; i < STREAM_SLOT_COUNT; i++) {
+		StreamSlot* slot = &g_slots[i];
+		if (AtomicLoad(&slot->state) == SLOT_FILLED &&
+			(next == NULL || slot->sequence < next->sequence))
+			next = slot;
+	}
+	return next;
+}
+
+static void UploadSlot(StreamSlot* slot)
+{
+	StreamTextureInfo* tex = &g_streamTextures[slot->texture];
+	int w = LevelSize(tex->width, slot->level);
+	int h = LevelSize(tex->height, slot->level);
+	const GLvoid* pixels = slot->ptr;
+
+	CachedBindTexture(GL_TEXTURE_2D, tex->name);
+	if (!tex->levelDefined[slot->level]) {
+		// The coarsest level always arrives first
+		if (slot->level == tex->levels - 1) {
+			tex->format = slot->format;
+			SetTexelSwizzle(slot->format);
+		}
+		DefineTexelLevel(slot->format, slot->level, w, h);
+		tex->levelDefined[slot->level] = true;
+	}
+
+	if (g_streamMode == STREAM_PERSISTENT) {
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_streamBuffer);
+		pixels = (const GLvoid*) slot->offset;
+	} else if (g_streamMode == STREAM_PBO) {
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		pixels = NULL;
+	}
+
+	UploadTexelRows(slot->format, slot->level, slot->yoffset, w, slot->rows, slot->bytes, pixels);
+
+	if (g_streamMode == STREAM_PERSISTENT) {
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		AtomicStore(&slot->state, SLOT_INFLIGHT);
+	} else {
+		// Orphaning on the next map (PBO) or the copy glTexSubImage2D made
+		// (client memory) means the slot can be refilled right away
+		if (g_streamMode == STREAM_PBO)
+			CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		AtomicStore(&slot->state, SLOT_FREE);
+	}
+
+	// Lower the base level across every level that is now complete
+	int baseLevel = tex->baseLevel;
+	tex->rowsPending[slot->level] -= slot->rows;
+	while (baseLevel > 0 && tex->rowsPending[baseLevel - 1] == 0)
+		baseLevel--;
+	if (baseLevel != tex->baseLevel) {
+		tex->baseLevel = baseLevel;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+	}
+}
+
+void UpdateTextureStreaming(void)
+{
+	bool released = false;
+
+	if (!g_streamRunning)
+		return;
+
+	// Retire uploads the GPU has finished reading
+	for (int i = 0; i < STREAM_SLOT_COUNT; i++) {
+		StreamSlot* slot = &g_slots[i];
+		if (AtomicLoad(&slot->state) != SLOT_INFLIGHT)
+			continue;
+		GLenum status = glClientWaitSync(slot->fence, 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+			glDeleteSync(slot->fence);
+			slot->fence = NULL;
+			AtomicStore(&slot->state, SLOT_WRITABLE);
+			released = true;
+		}
+	}
+
+	// Upload in fill order within the per-frame budget; always make progress
+	int budget = g_uploadBudget;
+	bool uploaded = false;
+	for (StreamSlot* slot = NextFilledSlot(); slot != NULL; slot = NextFilledSlot()) {
+		if (uploaded && slot->bytes > budget)
+			break;
+		int bytes = slot->bytes;
+		UploadSlot(slot);
+		budget -= bytes;
+		uploaded = true;
+	}
+
+	// Hand free slots back to the worker
+	for (int i = 0; i < STREAM_SLOT_COUNT; i++) {
+		StreamSlot* slot = &g_slots[i];
+		if (AtomicLoad(&slot->state) != SLOT_FREE)
+			continue;
+		if (g_streamMode == STREAM_PBO) {
+			CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, STREAM_SLOT_BYTES, NULL, GL_STREAM_DRAW);
+			slot->ptr = (unsigned char*) glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+			CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			if (slot->ptr == NULL)
+				continue;
+		}
+		AtomicStore(&slot->state, SLOT_WRITABLE);
+		released = true;
+	}
+
+	if (released)
+		EventSignal(&g_workerEvent);
+}
+
+bool IsTextureStreaming(GLuint texName)
+{
+	for (int i = 0; i < g_streamTextureCount; i++) {
+		if (g_streamTextures[i].name == texName)
+			return g_streamTextures[i].baseLevel != 0;
+	}
+	return false;
+}
+
+int GetStreamedTextureBits(GLuint texName)
+{
+	for (int i = 0; i < g_streamTextureCount; i++) {
+		const StreamTextureInfo* tex = &g_streamTextures[i];
+		if (tex->name == texName && tex->levelDefined[tex->levels - 1])
+			return TexelBitsPerTexel(tex->format);
+	}
+	return 0;
+}
+
+void SetTextureStreamBudget(int bytesPerFrame)
+{
+	g_uploadBudget = bytesPerFrame > 0 ? bytesPerFrame : 1;
+}
@@ -0,0 +1,55 @@
+// texture_stream.h
+//
+// Asynchronous texture streaming. A worker thread generates images, builds
+// their mip chains and writes them, coarsest level first, into pixel buffer
+// objects. Once per frame the GLUT thread copies finished slots into the
+// textures with glTexSubImage2D, staying inside a byte budget so a large
+// texture never hitches a frame. GL_TEXTURE_BASE_LEVEL is lowered as finer
+// levels complete, so a streamed texture shows its average color almost
+// immediately and sharpens over the next few frames.
+//
+// Uses persistently mapped buffers fenced with sync objects when the driver
+// has ARB_buffer_storage, orphaned PBOs with ARB_pixel_buffer_object, and
+// plain client memory otherwise.
+
+#ifndef TEXTURE_STREAM_H
+#define TEXTURE_STREAM_H
+
+#include "gl_extensions.h"
+#include "texture_cache.h"
+
+// Fills rows [y0, y0 + rows) of an RGBA8 image; dst points at row y0.
+// Runs on the streaming thread.
+typedef void (*TextureGenerator)(int y0, int rows, int width, int height,
+	unsigned char* dst, void* user);
+
+// Computes the texture cache key for a generator's user data. Runs on the
+// streaming thread, so it may hash a whole source file.
+typedef TextureCacheKey (*TextureKeyFunc)(void* user);
+
+void InitTextureStreaming(void);
+void ShutdownTextureStreaming(void);
+
+// Queues texName for streaming; call on the GL thread. The texture stays
+// incomplete (and so untextured) until its 1x1 level arrives. Streaming a
+// name again is allowed once its previous stream has completed.
+bool StreamTexture(GLuint texName, int width, int height,
+	TextureGenerator generator, void* user);
+// As StreamTexture, but reuses the mip chain from the on-disk texture cache
+// when cacheKey(user) has an entry, and stores one otherwise
+bool StreamTextureCached(GLuint texName, int width, int height,
+	TextureGenerator generator, TextureKeyFunc cacheKey, void* user);
+
+// Uploads finished slots and recycles retired ones. Call once per frame on
+// the GL thread, before drawing.
+void UpdateTextureStreaming(void);
+
+// True while texName has mip levels still on their way
+bool IsTextureStreaming(GLuint texName);
+// Bits per texel of the format the streamer picked; 0 until the first level
+// has arrived
+int GetStreamedTextureBits(GLuint texName);
+
+void SetTextureStreamBudget(int bytesPerFrame);
+
+#endif
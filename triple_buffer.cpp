@@ -0,0 +1,35 @@
+// triple_buffer.cpp
+//
+// Index juggling for triple_buffer.h.
+
+#include "triple_buffer.h"
+
+#define TRIPLE_BUFFER_FRESH  4
+
+void TripleBufferInit(TripleBuffer* buffer)
+{
+	buffer->back = 0;
+	buffer->middle = 1;
+	buffer->front = 2;
+}
+
+int TripleBufferBack(const TripleBuffer* buffer)
+{
+	return buffer->back;
+}
+
+int TripleBufferPublish(TripleBuffer* buffer)
+{
+	long previous = AtomicExchange(&buffer->middle, buffer->back | TRIPLE_BUFFER_FRESH);
+	buffer->back = (int) (previous & ~TRIPLE_BUFFER_FRESH);
+	return buffer->back;
+}
+
+int TripleBufferAcquire(TripleBuffer* buffer)
+{
+	if (AtomicLoad(&buffer->middle) & TRIPLE_BUFFER_FRESH) {
+		long previous = AtomicExchange(&buffer->middle, buffer->front);
+		buffer->front = (int) (previous & ~TRIPLE_BUFFER_FRESH);
+	}
+	return buffer->front;
+}
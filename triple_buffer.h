@@ -0,0 +1,34 @@
+// triple_buffer.h
+//
+// Lock-free handoff of the latest value from one writer thread to one
+// reader thread. The caller owns three copies of the value; the writer
+// fills one, the reader holds another, and the third sits in the middle
+// as the newest complete copy. Publishing and acquiring each swap an
+// index with the middle in one atomic exchange, so neither side ever
+// waits: the writer can publish any number of times between reads (older
+// unread copies are simply overwritten) and the reader keeps its copy
+// until something newer exists.
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include "platform.h"
+
+struct TripleBuffer {
+	volatile long middle;       // index, with TRIPLE_BUFFER_FRESH when unread
+	int back;                   // writer only
+	int front;                  // reader only
+};
+
+void TripleBufferInit(TripleBuffer* buffer);
+
+// Writer: index of the copy to fill
+int TripleBufferBack(const TripleBuffer* buffer);
+// Writer: publishes the back copy; returns the index to fill next
+int TripleBufferPublish(TripleBuffer* buffer);
+
+// Reader: index of the newest published copy, which stays untouched by
+// the writer until the next call
+int TripleBufferAcquire(TripleBuffer* buffer);
+
+#endif
@@ -0,0 +1,639 @@
+// virtual_texture.cpp
+//
+// Page cache, feedback analysis and indirection for virtual_texture.h.
+//
+// Indirection texels hold (slot x, slot y, resident level, 255). The
+// sampling shader reads them with a bias of log2(VIRTUAL_PAGE_SIZE): the
+// indirection texture has one texel per page, so that bias makes the
+// hardware pick the same mip level it would for the full virtual texture.
+
+#include "virtual_texture.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "renderer.h"
+#include "shader.h"
+#include "staging_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define VIRTUAL_MAX_TEXTURES     16
+#define VIRTUAL_MAX_LEVELS       16
+#define VIRTUAL_MAX_PAGES        256    // per side at level 0; page coords fit a byte
+#define VIRTUAL_SLOT_SIZE        (VIRTUAL_PAGE_SIZE + 2 * VIRTUAL_PAGE_BORDER)
+#define VIRTUAL_FEEDBACK_SCALE   8
+#define VIRTUAL_FEEDBACK_BIAS    3.0f   // log2(VIRTUAL_FEEDBACK_SCALE)
+#define VIRTUAL_PAGE_BIAS        7.0f   // log2(VIRTUAL_PAGE_SIZE)
+#define VIRTUAL_LOADS_PER_FRAME  8
+
+struct PhysicalPage {
+	int texture;                    // index + 1, 0 when free
+	int level, x, y;
+	unsigned long lastUsed;         // frame it was last wanted
+	bool pinned;
+};
+
+struct VirtualTexture {
+	bool used;
+	char label[32];
+	int width, height, levels;
+	int pagesX, pagesY;             // at level 0
+	VirtualPageFunc func;
+	void* user;
+	short* pageSlot[VIRTUAL_MAX_LEVELS];        // -1 if not resident
+	unsigned char* indirection[VIRTUAL_MAX_LEVELS];
+	GLuint indirectionTexture;
+	bool dirty;                     // indirection needs rebuilding
+};
+
+// A page being generated on the job system
+struct PageLoad {
+	VirtualTexture* tex;
+	int slot, level, x, y;
+	unsigned char* pixels;
+};
+
+struct SampleProgram {
+	GLuint program;
+	GLint lighting, indirection, atlas, pages, slotScale, pageScale, border;
+};
+
+struct FeedbackProgram {
+	GLuint program;
+	GLint size, pages, maxLevel, id;
+};
+
+static bool g_virtualReady = false;
+static GLuint g_atlas = 0;
+static int g_slotsPerSide = 0;
+static PhysicalPage* g_pages = NULL;
+static VirtualTexture g_virtualTextures[VIRTUAL_MAX_TEXTURES];
+static unsigned char* g_pageBuffers[VIRTUAL_LOADS_PER_FRAME];
+static unsigned long g_virtualFrame = 1;
+static SampleProgram g_sample;
+static FeedbackProgram g_feedbackShader;
+
+// Feedback readback: two PBOs read a frame apart, or one synchronous copy
+static GLuint g_feedbackPbo[2];
+static bool g_feedbackPending[2];
+static int g_feedbackPboSize[2][2];            // width and height each was read at
+static int g_feedbackIndex = 0;
+static int g_feedbackWidth = 0, g_feedbackHeight = 0;
+static unsigned char* g_feedback = NULL;
+static size_t g_feedbackBytes = 0;
+static bool g_feedbackReady = false;           // synchronous copy is waiting
+static unsigned int* g_requests = NULL;
+static GLint g_savedViewport[4];
+static GLfloat g_savedClearColor[4];
+
+// Cumulative
+static int g_pageLoads = 0;
+static int g_pageEvictions = 0;
+static int g_lastRequests = 0;
+
+static const char* g_feedbackFragmentShader =
+	"uniform vec2 u_size;\n"
+	"uniform vec2 u_pages;\n"
+	"uniform float u_maxLevel;\n"
+	"uniform float u_id;\n"
+	"varying vec2 v_texCoord;\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	// Rendering at 1/8 size makes derivatives 8 times larger\n"
+	"	vec2 dx = dFdx(v_texCoord * u_size), dy = dFdy(v_texCoord * u_size);\n"
+	"	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) - FEEDBACK_BIAS;\n"
+	"	float level = clamp(floor(lod + 0.5), 0.0, u_maxLevel);\n"
+	"	vec2 pages = max(u_pages * exp2(-level), 1.0);\n"
+	"	vec2 page = min(floor(clamp(v_texCoord, 0.0, 1.0) * pages), pages - 1.0);\n"
+	"	fragColor = vec4(page, level, u_id) / 255.0;\n"
+	"}\n";
+
+static const char* g_sampleFragmentShader =
+	"uniform sampler2D u_indirection;\n"
+	"uniform sampler2D u_atlas;\n"
+	"uniform vec2 u_pages;\n"
+	"uniform float u_slotScale;\n"
+	"uniform float u_pageScale;\n"
+	"uniform float u_border;\n"
+	"varying vec4 v_color;\n"
+	"varying vec2 v_texCoord;\n"
+	"#ifdef WIREFRAME\n"
+	"varying vec3 v_barycentric;\n"
+	"varying float v_wireframe;\n"
+	"#endif\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"#ifdef WIREFRAME\n"
+	"	// The scene program's wireframe (renderer.cpp)\n"
+	"	vec3 pixels = v_barycentric / max(fwidth(v_barycentric), vec3(1e-6));\n"
+	"	float edge = min(min(pixels.x, pixels.y), pixels.z);\n"
+	"	if (v_wireframe > 0.5 && v_wireframe < 1.5 && edge > 1.0)\n"
+	"		discard;\n"
+	"#endif\n"
+	"	vec2 uv = clamp(v_texCoord, 0.0, 0.99999);\n"
+	"	vec4 entry = floor(texture2D(u_indirection, uv, PAGE_BIAS) * 255.0 + 0.5);\n"
+	"	vec2 pages = max(u_pages * exp2(-entry.z), 1.0);\n"
+	"	vec2 atlas = entry.xy * u_slotScale + u_border + fract(uv * pages) * u_pageScale;\n"
+	"	fragColor = v_color * texture2D(u_atlas, atlas);\n"
+	"#ifdef WIREFRAME\n"
+	"	if (v_wireframe > 1.5)\n"
+	"		fragColor.rgb *= clamp(edge, 0.0, 1.0);\n"
+	"#endif\n"
+	"#ifdef GBUFFER\n"
+	"	gbufferAlbedo = vec4(0.0);\n"
+	"#endif\n"
+	"}\n";
+
+static int LevelPages(int pages, int level)
+{
+	pages >>= level;
+	return pages > 0 ? pages : 1;
+}
+
+static bool IsPowerOfTwo(int n)
+{
+	return n > 0 && (n & (n - 1)) == 0;
+}
+
+static VirtualTexture* GetVirtualTexture(VirtualTextureHandle handle)
+{
+	if (handle <= 0 || handle > VIRTUAL_MAX_TEXTURES || !g_virtualTextures[handle - 1].used)
+		return NULL;
+	return &g_virtualTextures[handle - 1];
+}
+
+bool InitVirtualTexturing(int slotsPerSide)
+{
+	GLint maxSize = 0;
+	char header[384];
+
+	if (g_virtualReady)
+		return true;
+	if (!g_glCaps.shaderObjects)
+		return false;
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	if (slotsPerSide * VIRTUAL_SLOT_SIZE > maxSize)
+		slotsPerSide = maxSize / VIRTUAL_SLOT_SIZE;
+	if (slotsPerSide > 256)
+		slotsPerSide = 256;                     // slot coords fit a byte
+	if (slotsPerSide < 2)
+		return false;
+
+	snprintf(header, sizeof(header), "%s#define FEEDBACK_BIAS %.1f\n#define PAGE_BIAS %.1f\n",
+		SceneShaderHeader(), VIRTUAL_FEEDBACK_BIAS, VIRTUAL_PAGE_BIAS);
+	g_feedbackShader.program = CreateShaderProgram("virtual feedback", header,
+		SceneVertexShader(), g_feedbackFragmentShader);
+	g_sample.program = CreateShaderProgram("virtual sample", header,
+		SceneVertexShader(), g_sampleFragmentShader);
+	if (!g_feedbackShader.program || !g_sample.program) {
+		DeleteShaderProgram(g_feedbackShader.program);
+		DeleteShaderProgram(g_sample.program);
+		return false;
+	}
+
+	GLuint p = g_feedbackShader.program;
+	g_feedbackShader.size = glGetUniformLocation(p, "u_size");
+	g_feedbackShader.pages = glGetUniformLocation(p, "u_pages");
+	g_feedbackShader.maxLevel = glGetUniformLocation(p, "u_maxLevel");
+	g_feedbackShader.id = glGetUniformLocation(p, "u_id");
+
+	p = g_sample.program;
+	g_sample.lighting = glGetUniformLocation(p, "u_lighting");
+	g_sample.indirection = glGetUniformLocation(p, "u_indirection");
+	g_sample.atlas = glGetUniformLocation(p, "u_atlas");
+	g_sample.pages = glGetUniformLocation(p, "u_pages");
+	g_sample.slotScale = glGetUniformLocation(p, "u_slotScale");
+	g_sample.pageScale = glGetUniformLocation(p, "u_pageScale");
+	g_sample.border = glGetUniformLocation(p, "u_border");
+
+	int atlasSize = slotsPerSide * VIRTUAL_SLOT_SIZE;
+	CachedUseProgram(g_sample.program);
+	glUniform1i(g_sample.indirection, 0);
+	glUniform1i(g_sample.atlas, 1);
+	glUniform1f(g_sample.slotScale, (float) VIRTUAL_SLOT_SIZE / atlasSize);
+	glUniform1f(g_sample.pageScale, (float) VIRTUAL_PAGE_SIZE / atlasSize);
+	glUniform1f(g_sample.border, (float) VIRTUAL_PAGE_BORDER / atlasSize);
+	CachedUseProgram(0);
+
+	// The cache has no mips: every level is its own set of pages
+	glGenTextures(1, &g_atlas);
+	CachedBindTexture(GL_TEXTURE_2D, g_atlas);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0,
+		GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	CachedBindTexture(GL_TEXTURE_2D, 0);
+
+	g_slotsPerSide = slotsPerSide;
+	g_pages = (PhysicalPage*) calloc(slotsPerSide * slotsPerSide, sizeof(PhysicalPage));
+	for (int i = 0; i < VIRTUAL_LOADS_PER_FRAME; i++)
+		g_pageBuffers[i] = (unsigned char*) AcquireStagingBuffer(VIRTUAL_SLOT_SIZE * VIRTUAL_SLOT_SIZE * 4);
+	if (g_glCaps.pixelBufferObject)
+		glGenBuffers(2, g_feedbackPbo);
+	memset(g_virtualTextures, 0, sizeof(g_virtualTextures));
+	g_virtualReady = true;
+	return true;
+}
+
+// Takes over slot for the page; its texels arrive with UploadPage
+static void AssignPage(VirtualTexture* tex, int slot, int level, int x, int y, bool pinned)
+{
+	PhysicalPage* page = &g_pages[slot];
+
+	// Evict whatever the slot held
+	if (page->texture) {
+		VirtualTexture* owner = &g_virtualTextures[page->texture - 1];
+		owner->pageSlot[page->level][page->y * LevelPages(owner->pagesX, page->level) + page->x] = -1;
+		owner->dirty = true;
+		g_pageEvictions++;
+	}
+
+	page->texture = (int) (tex - g_virtualTextures) + 1;
+	page->level = level;
+	page->x = x;
+	page->y = y;
+	page->lastUsed = g_virtualFrame;
+	page->pinned = pinned;
+	tex->pageSlot[level][y * LevelPages(tex->pagesX, level) + x] = (short) slot;
+	tex->dirty = true;
+	g_pageLoads++;
+}
+
+static void GeneratePage(void* data)
+{
+	PageLoad* load = (PageLoad*) data;
+
+	load->tex->func(load->level, load->x * VIRTUAL_PAGE_SIZE - VIRTUAL_PAGE_BORDER,
+		load->y * VIRTUAL_PAGE_SIZE - VIRTUAL_PAGE_BORDER, VIRTUAL_SLOT_SIZE,
+		load->pixels, load->tex->user);
+}
+
+static void UploadPage(const PageLoad* load)
+{
+	CachedBindTexture(GL_TEXTURE_2D, g_atlas);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (load->slot % g_slotsPerSide) * VIRTUAL_SLOT_SIZE,
+		(load->slot / g_slotsPerSide) * VIRTUAL_SLOT_SIZE, VIRTUAL_SLOT_SIZE, VIRTUAL_SLOT_SIZE,
+		GL_RGBA, GL_UNSIGNED_BYTE, load->pixels);
+}
+
+// A free slot, else the least recently wanted one not wanted this frame
+static int FindSlot(void)
+{
+	int best = -1;
+
+	for (int i = 0; i < g_slotsPerSide * g_slotsPerSide; i++) {
+		PhysicalPage* page = &g_pages[i];
+		if (page->texture == 0)
+			return i;
+		if (page->pinned || page->lastUsed == g_virtualFrame)
+			continue;
+		if (best < 0 || page->lastUsed < g_pages[best].lastUsed)
+			best = i;
+	}
+	return best;
+}
+
+VirtualTextureHandle CreateVirtualTexture(const char* label, int width, int height,
+	VirtualPageFunc func, void* user)
+{
+	if (!g_virtualReady || !IsPowerOfTwo(width) || !IsPowerOfTwo(height) ||
+		width < VIRTUAL_PAGE_SIZE || height < VIRTUAL_PAGE_SIZE ||
+		width > VIRTUAL_PAGE_SIZE * VIRTUAL_MAX_PAGES || height > VIRTUAL_PAGE_SIZE * VIRTUAL_MAX_PAGES)
+		return VIRTUAL_TEXTURE_NONE;
+
+	for (int i = 0; i < VIRTUAL_MAX_TEXTURES; i++) {
+		VirtualTexture* tex = &g_virtualTextures[i];
+		if (tex->used)
+			continue;
+
+		int slot = FindSlot();
+		if (slot < 0)
+			return VIRTUAL_TEXTURE_NONE;
+
+		memset(tex, 0, sizeof(*tex));
+		tex->used = true;
+		strncpy(tex->label, label ? label : "", sizeof(tex->label) - 1);
+		tex->width = width;
+		tex->height = height;
+		tex->pagesX = width / VIRTUAL_PAGE_SIZE;
+		tex->pagesY = height / VIRTUAL_PAGE_SIZE;
+		tex->func = func;
+		tex->user = user;
+		tex->levels = 1;
+		while (LevelPages(tex->pagesX, tex->levels - 1) > 1 || LevelPages(tex->pagesY, tex->levels - 1) > 1)
+			tex->levels++;
+
+		for (int level = 0; level < tex->levels; level++) {
+			int count = LevelPages(tex->pagesX, level) * LevelPages(tex->pagesY, level);
+			tex->pageSlot[level] = (short*) malloc(count * sizeof(short));
+			tex->indirection[level] = (unsigned char*) malloc(count * 4);
+			for (int j = 0; j < count; j++)
+				tex->pageSlot[level][j] = -1;
+		}
+
+		// The indirection texture's mip chain mirrors the page grid's
+		glGenTextures(1, &tex->indirectionTexture);
+		CachedBindTexture(GL_TEXTURE_2D, tex->indirectionTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex->levels - 1);
+		for (int level = 0; level < tex->levels; level++)
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, LevelPages(tex->pagesX, level),
+				LevelPages(tex->pagesY, level), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+		// Everything falls back to the coarsest page, so it stays resident
+		PageLoad root = { tex, slot, tex->levels - 1, 0, 0, g_pageBuffers[0] };
+		AssignPage(tex, slot, root.level, 0, 0, true);
+		GeneratePage(&root);
+		UploadPage(&root);
+		return i + 1;
+	}
+	return VIRTUAL_TEXTURE_NONE;
+}
+
+// Points every page at itself if resident, else at its parent's entry
+static void RebuildIndirection(VirtualTexture* tex)
+{
+	CachedBindTexture(GL_TEXTURE_2D, tex->indirectionTexture);
+	for (int level = tex->levels - 1; level >= 0; level--) {
+		int pagesX = LevelPages(tex->pagesX, level);
+		int pagesY = LevelPages(tex->pagesY, level);
+		for (int y = 0; y < pagesY; y++) {
+			for (int x = 0; x < pagesX; x++) {
+				unsigned char* entry = tex->indirection[level] + 4 * (y * pagesX + x);
+				int slot = tex->pageSlot[level][y * pagesX + x];
+				if (slot >= 0) {
+					entry[0] = (unsigned char) (slot % g_slotsPerSide);
+					entry[1] = (unsigned char) (slot / g_slotsPerSide);
+					entry[2] = (unsigned char) level;
+					entry[3] = 255;
+				} else {
+					int parentX = LevelPages(tex->pagesX, level + 1);
+					memcpy(entry, tex->indirection[level + 1] + 4 * ((y / 2) * parentX + x / 2), 4);
+				}
+			}
+		}
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, pagesX, pagesY,
+			GL_RGBA, GL_UNSIGNED_BYTE, tex->indirection[level]);
+	}
+	tex->dirty = false;
+}
+
+void BeginVirtualFeedback(void)
+{
+	if (!g_virtualReady)
+		return;
+
+	glGetIntegerv(GL_VIEWPORT, g_savedViewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, g_savedClearColor);
+	g_feedbackWidth = (g_savedViewport[2] + VIRTUAL_FEEDBACK_SCALE - 1) / VIRTUAL_FEEDBACK_SCALE;
+	g_feedbackHeight = (g_savedViewport[3] + VIRTUAL_FEEDBACK_SCALE - 1) / VIRTUAL_FEEDBACK_SCALE;
+	glViewport(0, 0, g_feedbackWidth, g_feedbackHeight);
+	CachedEnable(GL_SCISSOR_TEST);
+	glScissor(0, 0, g_feedbackWidth, g_feedbackHeight);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	CachedUseProgram(g_feedbackShader.program);
+}
+
+void SetVirtualFeedbackTexture(VirtualTextureHandle handle)
+{
+	VirtualTexture* tex = GetVirtualTexture(handle);
+
+	if (!g_virtualReady || tex == NULL)
+		return;
+	glUniform2f(g_feedbackShader.size, (float) tex->width, (float) tex->height);
+	glUniform2f(g_feedbackShader.pages, (float) tex->pagesX, (float) tex->pagesY);
+	glUniform1f(g_feedbackShader.maxLevel, (float) (tex->levels - 1));
+	glUniform1f(g_feedbackShader.id, (float) handle);
+}
+
+void EndVirtualFeedback(void)
+{
+	if (!g_virtualReady)
+		return;
+
+	CachedUseProgram(0);
+	CachedDisable(GL_SCISSOR_TEST);
+	glClearColor(g_savedClearColor[0], g_savedClearColor[1], g_savedClearColor[2], g_savedClearColor[3]);
+	glViewport(g_savedViewport[0], g_savedViewport[1], g_savedViewport[2], g_savedViewport[3]);
+
+	size_t bytes = (size_t) g_feedbackWidth * g_feedbackHeight * 4;
+	if (bytes > g_feedbackBytes) {
+		ReleaseStagingBuffer(g_feedback);
+		free(g_requests);
+		g_feedback = (unsigned char*) AcquireStagingBuffer(bytes);
+		g_requests = (unsigned int*) malloc(bytes);
+		g_feedbackBytes = g_feedback && g_requests ? bytes : 0;
+		g_feedbackPending[0] = g_feedbackPending[1] = false;
+	}
+	if (g_feedbackBytes == 0)
+		return;
+
+	if (g_feedbackPbo[0]) {
+		// Read into a PBO now, map it next frame once the copy is done
+		CachedBindBuffer(GL_PIXEL_PACK_BUFFER, g_feedbackPbo[g_feedbackIndex]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		glReadPixels(0, 0, g_feedbackWidth, g_feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		CachedBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		g_feedbackPending[g_feedbackIndex] = true;
+		g_feedbackPboSize[g_feedbackIndex][0] = g_feedbackWidth;
+		g_feedbackPboSize[g_feedbackIndex][1] = g_feedbackHeight;
+		g_feedbackIndex ^= 1;
+	} else {
+		glReadPixels(0, 0, g_feedbackWidth, g_feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, g_feedback);
+		g_feedbackReady = true;
+	}
+}
+
+static int CompareUnsigned(const void* a, const void* b)
+{
+	unsigned int x = *(const unsigned int*) a, y = *(const unsigned int*) b;
+	return x < y ? -1 : x > y;
+}
+
+// Request keys are id:12 level:4 y:8 x:8; coarser levels load first
+static int CompareCoarsestFirst(const void* a, const void* b)
+{
+	int la = (*(const unsigned int*) a >> 16) & 15, lb = (*(const unsigned int*) b >> 16) & 15;
+	return lb - la;
+}
+
+// Turns the feedback image into a sorted list of unique page requests
+static int GatherRequests(const unsigned char* feedback, int pixels)
+{
+	int count = 0;
+
+	for (int i = 0; i < pixels; i++) {
+		const unsigned char* p = feedback + 4 * i;
+		if (p[3] != 0)
+			g_requests[count++] = (unsigned int) p[3] << 20 | (p[2] & 15) << 16 | p[1] << 8 | p[0];
+	}
+	qsort(g_requests, count, sizeof(unsigned int), CompareUnsigned);
+
+	int unique = 0;
+	for (int i = 0; i < count; i++) {
+		if (unique == 0 || g_requests[i] != g_requests[unique - 1])
+			g_requests[unique++] = g_requests[i];
+	}
+	return unique;
+}
+
+static void ProcessRequests(int count)
+{
+	int missing = 0;
+
+	// Mark wanted pages and their resident ancestors used; compact the
+	// ones that are not resident to the front of the list
+	for (int i = 0; i < count; i++) {
+		unsigned int key = g_requests[i];
+		VirtualTexture* tex = GetVirtualTexture(key >> 20);
+		int level = (key >> 16) & 15, x = key & 255, y = (key >> 8) & 255;
+		if (tex == NULL || level >= tex->levels || x >= LevelPages(tex->pagesX, level) ||
+			y >= LevelPages(tex->pagesY, level))
+			continue;
+		if (tex->pageSlot[level][y * LevelPages(tex->pagesX, level) + x] < 0)
+			g_requests[missing++] = key;
+		for (; level < tex->levels; level++, x /= 2, y /= 2) {
+			int slot = tex->pageSlot[level][y * LevelPages(tex->pagesX, level) + x];
+			if (slot >= 0)
+				g_pages[slot].lastUsed = g_virtualFrame;
+		}
+	}
+	g_lastRequests = count;
+
+	// Claim slots for this frame's loads, generate the pages in parallel,
+	// then upload them here on the GL thread
+	PageLoad loads[VIRTUAL_LOADS_PER_FRAME];
+	Job jobs[VIRTUAL_LOADS_PER_FRAME];
+	int loadCount = 0;
+	qsort(g_requests, missing, sizeof(unsigned int), CompareCoarsestFirst);
+	for (int i = 0; i < missing && loadCount < VIRTUAL_LOADS_PER_FRAME; i++) {
+		unsigned int key = g_requests[i];
+		int slot = FindSlot();
+		if (slot < 0)
+			break;
+		PageLoad* load = &loads[loadCount];
+		load->tex = GetVirtualTexture(key >> 20);
+		load->slot = slot;
+		load->level = (key >> 16) & 15;
+		load->x = key & 255;
+		load->y = (key >> 8) & 255;
+		load->pixels = g_pageBuffers[loadCount];
+		AssignPage(load->tex, slot, load->level, load->x, load->y, false);
+		jobs[loadCount].func = GeneratePage;
+		jobs[loadCount].data = load;
+		loadCount++;
+	}
+
+	JobCounter counter = 0;
+	RunJobs(jobs, loadCount, &counter);
+	WaitForCounter(&counter);
+	for (int i = 0; i < loadCount; i++)
+		UploadPage(&loads[i]);
+}
+
+void UpdateVirtualTexturing(void)
+{
+	const unsigned char* feedback = NULL;
+	int count = 0;
+
+	if (!g_virtualReady)
+		return;
+
+	if (g_feedbackPbo[0]) {
+		if (g_feedbackPending[g_feedbackIndex]) {
+			CachedBindBuffer(GL_PIXEL_PACK_BUFFER, g_feedbackPbo[g_feedbackIndex]);
+			feedback = (const unsigned char*) glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+			if (feedback != NULL) {
+				// Read at last frame's size, which a resize may since have changed
+				const int* size = g_feedbackPboSize[g_feedbackIndex];
+				count = GatherRequests(feedback, size[0] * size[1]);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			CachedBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			g_feedbackPending[g_feedbackIndex] = false;
+		}
+	} else if (g_feedbackReady) {
+		count = GatherRequests(g_feedback, g_feedbackWidth * g_feedbackHeight);
+		g_feedbackReady = false;
+	}
+
+	ProcessRequests(count);
+
+	for (int i = 0; i < VIRTUAL_MAX_TEXTURES; i++) {
+		if (g_virtualTextures[i].used && g_virtualTextures[i].dirty)
+			RebuildIndirection(&g_virtualTextures[i]);
+	}
+	g_virtualFrame++;
+}
+
+bool IsVirtualTextureAvailable(VirtualTextureHandle handle)
+{
+	return g_virtualReady && GetVirtualTexture(handle) != NULL;
+}
+
+bool BindVirtualTexture(VirtualTextureHandle handle)
+{
+	VirtualTexture* tex = GetVirtualTexture(handle);
+
+	if (!g_virtualReady || tex == NULL)
+		return false;
+
+	CachedUseProgram(g_sample.program);
+	glUniform1i(g_sample.lighting, CachedIsEnabled(GL_LIGHTING));
+	glUniform2f(g_sample.pages, (float) tex->pagesX, (float) tex->pagesY);
+	CachedActiveTexture(GL_TEXTURE1);
+	CachedBindTexture(GL_TEXTURE_2D, g_atlas);
+	CachedActiveTexture(GL_TEXTURE0);
+	CachedBindTexture(GL_TEXTURE_2D, tex->indirectionTexture);
+	return true;
+}
+
+void UnbindVirtualTexture(void)
+{
+	CachedActiveTexture(GL_TEXTURE1);
+	CachedBindTexture(GL_TEXTURE_2D, 0);
+	CachedActiveTexture(GL_TEXTURE0);
+	CachedUseProgram(0);
+}
+
+void PrintVirtualTextureStats(FILE* out)
+{
+	int resident = 0;
+	size_t indirectionBytes = 0;
+
+	if (!g_virtualReady)
+		return;
+
+	for (int i = 0; i < g_slotsPerSide * g_slotsPerSide; i++) {
+		if (g_pages[i].texture)
+			resident++;
+	}
+	fprintf(out, "Virtual textures: %d of %d cache pages resident, %d wanted last frame\n",
+		resident, g_slotsPerSide * g_slotsPerSide, g_lastRequests);
+	fprintf(out, "  %d page loads, %d evictions\n", g_pageLoads, g_pageEvictions);
+	for (int i = 0; i < VIRTUAL_MAX_TEXTURES; i++) {
+		VirtualTexture* tex = &g_virtualTextures[i];
+		if (!tex->used)
+			continue;
+		size_t bytes = 0;
+		for (int level = 0; level < tex->levels; level++)
+			bytes += (size_t) LevelPages(tex->pagesX, level) * LevelPages(tex->pagesY, level) * 4;
+		indirectionBytes += bytes;
+		fprintf(out, "  [%d] %-20s %6dx%-6d %2d levels, %.1f MB if fully resident\n",
+			i + 1, tex->label, tex->width, tex->height, tex->levels,
+			(double) tex->width * tex->height * 4 * 4 / 3 / 1048576.0);
+	}
+	fprintf(out, "  GPU memory: %.2f MB page cache, %.1f KB indirection\n",
+		(double) g_slotsPerSide * VIRTUAL_SLOT_SIZE * g_slotsPerSide * VIRTUAL_SLOT_SIZE * 4 / 1048576.0,
+		indirectionBytes / 1024.0);
+}
@@ -0,0 +1,71 @@
+// virtual_texture.h
+//
+// Sparse virtual texturing. A virtual texture can be far larger than any
+// real one: it is split into fixed size pages per mip level and only the
+// pages the camera actually needs are kept, in slots of one shared
+// physical page cache texture. Each frame a feedback pass renders the
+// virtual textured objects at low resolution with a shader that writes the
+// page and level every pixel wants; the pages missing from the cache are
+// generated and uploaded, coarsest first, a few per frame, evicting the
+// least recently wanted. Sampling goes through a per texture indirection
+// texture (one texel per page, with a mip chain matching the virtual
+// texture's) that maps each page to its cache slot, or to the nearest
+// coarser page that is resident, so a missing page shows blurry rather
+// than wrong. GPU memory is the cache plus the indirection textures, no
+// matter how large the virtual textures are.
+//
+// Needs GLSL; InitVirtualTexturing() returns false without it.
+
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <stdio.h>
+
+#include "gl_extensions.h"
+
+#define VIRTUAL_PAGE_SIZE    128    // texels per page side, not counting the border
+#define VIRTUAL_PAGE_BORDER  1      // texels copied from neighbors, for bilinear filtering
+
+typedef int VirtualTextureHandle;   // 0 is "no texture"
+
+#define VIRTUAL_TEXTURE_NONE 0
+
+// Fills size x size RGBA8 texels (bottom row first) of level whose lower
+// left is texel (x0, y0) of that level. The region includes the page
+// border, so it starts at -1 for the first page and runs one texel past
+// the level's edge for the last; wrap or clamp as suits the content.
+// Runs on job system threads, several pages at once.
+typedef void (*VirtualPageFunc)(int level, int x0, int y0, int size,
+	unsigned char* dst, void* user);
+
+// slotsPerSide^2 pages of cache, shrunk to fit GL_MAX_TEXTURE_SIZE
+bool InitVirtualTexturing(int slotsPerSide);
+
+// width and height are powers of two from VIRTUAL_PAGE_SIZE up to 256
+// pages. The coarsest page is generated now and never evicted.
+VirtualTextureHandle CreateVirtualTexture(const char* label, int width, int height,
+	VirtualPageFunc func, void* user);
+
+// Feedback pass, before the frame is cleared. Draws into a corner of the
+// back buffer at 1/8 size with the renderer's camera; draw every virtual
+// textured object in between, each after SetRendererObject and
+// SetVirtualFeedbackTexture.
+void BeginVirtualFeedback(void);
+void SetVirtualFeedbackTexture(VirtualTextureHandle handle);
+void EndVirtualFeedback(void);
+
+// Reads feedback (a frame late when PBOs allow an asynchronous read),
+// loads missing pages and updates the indirection textures
+void UpdateVirtualTexturing(void);
+
+// True once BindVirtualTexture() would succeed for handle
+bool IsVirtualTextureAvailable(VirtualTextureHandle handle);
+
+// Binds the sampling program and the texture's indirection and the page
+// cache on units 0 and 1. Returns false, binding nothing, if unavailable.
+bool BindVirtualTexture(VirtualTextureHandle handle);
+void UnbindVirtualTexture(void);
+
+void PrintVirtualTextureStats(FILE* out);
+
+#endif